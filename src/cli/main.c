@@ -36,6 +36,7 @@
 #include "common/imageio_module.h"
 #include "common/exif.h"
 #include "common/history.h"
+#include "control/control.h"
 
 #include <sys/time.h>
 #include <unistd.h>
@@ -46,7 +47,7 @@ int usleep(useconds_t usec);
 static void
 usage(const char* progname)
 {
-  fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [--width <max width>,--height <max height>,--bpp <bpp>,--hq <0|1|true|false>,--verbose] [--core <darktable options>]\n", progname);
+  fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [--width <max width>,--height <max height>,--bpp <bpp>,--hq <0|1|true|false>,--verbose,--telemetry] [--core <darktable options>]\n", progname);
 }
 
 int main(int argc, char *arg[])
@@ -63,7 +64,7 @@ int main(int argc, char *arg[])
   char *output_filename = NULL;
   int file_counter = 0;
   int width = 0, height = 0, bpp = 0;
-  gboolean verbose = FALSE, high_quality = TRUE;
+  gboolean verbose = FALSE, high_quality = TRUE, telemetry = FALSE;
 
   int k;
   for(k=1; k<argc; k++)
@@ -116,6 +117,10 @@ int main(int argc, char *arg[])
       {
         verbose = TRUE;
       }
+      else if(!strcmp(arg[k], "--telemetry"))
+      {
+        telemetry = TRUE;
+      }
       else if(!strcmp(arg[k], "--core"))
       {
         // everything from here on should be passed to the core
@@ -267,7 +272,17 @@ int main(int argc, char *arg[])
 
   //TODO: add a callback to set the bpp without going through the config
 
-  storage->store(storage,sdata, id, format, fdata, 1, 1, high_quality);
+  // there are no worker threads without gui, the export runs right here. account it like an export job:
+  const double start = dt_get_wtime();
+  storage->store(storage,sdata, id, format, fdata, 1, 1, high_quality, FALSE);
+  dt_control_telemetry_add(darktable.control, "export", 0.0, dt_get_wtime() - start, -1);
+
+  if(telemetry)
+  {
+    gchar *str = dt_control_telemetry_to_string(darktable.control);
+    printf("%s", str);
+    g_free(str);
+  }
 
   // cleanup time
   if(storage->finalize_store) storage->finalize_store(storage, sdata);
@@ -19,6 +19,8 @@
 #ifndef DT_COMMON_BILATERAL_H
 #define DT_COMMON_BILATERAL_H
 
+#include "develop/pixelpipe_scratch.h"
+
 #ifdef HAVE_OPENCL
 // function definition on opencl path takes precedence
 #include "common/bilateralcl.h"
@@ -62,6 +64,7 @@ dt_bilateral_singlebuffer_size(
 
 typedef struct dt_bilateral_t
 {
+  struct dt_dev_pixelpipe_t *pipe;  // temporary memory comes from this pipe, if not NULL
   int size_x, size_y, size_z;
   int width, height;
   float sigma_s, sigma_r;
@@ -86,6 +89,7 @@ image_to_grid(
 
 dt_bilateral_t *
 dt_bilateral_init(
+  struct dt_dev_pixelpipe_t *pipe, // pipe for temporary memory, may be NULL
   const int width,       // width of input image
   const int height,      // height of input image
   const float sigma_s,   // spatial sigma (blur pixel coords)
@@ -102,11 +106,12 @@ dt_bilateral_init(
   b->size_x = CLAMPS((int)_x, 4, 900) + 1;
   b->size_y = CLAMPS((int)_y, 4, 900) + 1;
   b->size_z = CLAMPS((int)_z, 4, 50) + 1;
+  b->pipe = pipe;
   b->width = width;
   b->height = height;
   b->sigma_s = MAX(height/(b->size_y-1.0f), width/(b->size_x-1.0f));
   b->sigma_r = 100.0f/(b->size_z-1.0f);
-  b->buf = dt_alloc_align(16, b->size_x*b->size_y*b->size_z*sizeof(float));
+  b->buf = dt_pipe_scratch_alloc(pipe, b->size_x*b->size_y*b->size_z*sizeof(float));
 
   memset(b->buf, 0, b->size_x*b->size_y*b->size_z*sizeof(float));
 #if 0
@@ -375,7 +380,7 @@ dt_bilateral_free(
   dt_bilateral_t *b)
 {
   if(!b) return;
-  free(b->buf);
+  dt_pipe_scratch_free(b->pipe, b->buf);
   free(b);
 }
 
@@ -73,6 +73,7 @@ void dt_colorlabels_remove_label (const int imgid, const int color)
 void dt_colorlabels_toggle_label_selection (const int color)
 {
   sqlite3_stmt *stmt;
+  dt_database_start_transaction(darktable.db);
   // store away all previously unlabeled images in selection:
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "insert into memory.color_labels_temp select a.imgid from selected_images as a join color_labels as b on a.imgid = b.imgid where b.color = ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, color);
@@ -93,6 +94,7 @@ void dt_colorlabels_toggle_label_selection (const int color)
 
   // clean up
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "delete from memory.color_labels_temp", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 
   dt_collection_hint_message(darktable.collection);
 }
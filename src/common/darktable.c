@@ -30,12 +30,17 @@
 #include "common/camera_control.h"
 #endif
 #include "common/film.h"
+#include "common/folders.h"
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/imageio_module.h"
+#include "common/interpolation.h"
 #include "common/mipmap_cache.h"
 #include "common/opencl.h"
 #include "common/points.h"
+#include "common/sidecar_writer.h"
+#include "common/tags.h"
+#include "develop/pixelpipe_shared.h"
 #include "develop/imageop.h"
 #include "develop/blend.h"
 #include "libs/lib.h"
@@ -632,6 +637,7 @@ int dt_init(int argc, char *argv[], const int init_gui)
     darktable.control->running = 0;
     darktable.control->accelerators = NULL;
     dt_pthread_mutex_init(&darktable.control->run_mutex, NULL);
+    dt_control_telemetry_init(darktable.control);
   }
 
   // initialize collection query
@@ -667,6 +673,14 @@ int dt_init(int argc, char *argv[], const int init_gui)
   memset(darktable.image_cache, 0, sizeof(dt_image_cache_t));
   dt_image_cache_init(darktable.image_cache);
 
+  // writes xmp files in the background, needs the image cache:
+  darktable.sidecar_writer = (dt_sidecar_writer_t *)malloc(sizeof(dt_sidecar_writer_t));
+  dt_sidecar_writer_init(darktable.sidecar_writer);
+
+  // demosaiced images shared between concurrent export pipes:
+  darktable.pipe_shared = (dt_dev_pixelpipe_shared_t *)malloc(sizeof(dt_dev_pixelpipe_shared_t));
+  dt_dev_pixelpipe_shared_init(darktable.pipe_shared);
+
   darktable.mipmap_cache = (dt_mipmap_cache_t *)malloc(sizeof(dt_mipmap_cache_t));
   memset(darktable.mipmap_cache, 0, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
@@ -794,6 +808,12 @@ void dt_cleanup()
     dt_gui_gtk_cleanup(darktable.gui);
     free(darktable.gui);
   }
+  // flush pending xmp files while the image cache and the db are still around:
+  dt_sidecar_writer_cleanup(darktable.sidecar_writer);
+  free(darktable.sidecar_writer);
+  dt_dev_pixelpipe_shared_cleanup(darktable.pipe_shared);
+  dt_interpolation_cleanup();
+  free(darktable.pipe_shared);
   dt_image_cache_cleanup(darktable.image_cache);
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
@@ -804,6 +824,10 @@ void dt_cleanup()
     free(darktable.control);
     dt_undo_cleanup(darktable.undo);
   }
+  else
+  {
+    dt_control_telemetry_cleanup(darktable.control);
+  }
   dt_conf_cleanup(darktable.conf);
   free(darktable.conf);
   dt_points_cleanup(darktable.points);
@@ -821,6 +845,8 @@ void dt_cleanup()
   DestroyMagick();
 #endif
 
+  dt_tag_index_invalidate(); // frees the tag index
+  dt_folders_invalidate();   // and the folder tree
   dt_database_destroy(darktable.db);
 
   dt_bauhaus_cleanup();
@@ -127,6 +127,8 @@ struct dt_control_t;
 struct dt_develop_t;
 struct dt_mipmap_cache_t;
 struct dt_image_cache_t;
+struct dt_sidecar_writer_t;
+struct dt_dev_pixelpipe_shared_t;
 struct dt_lib_t;
 struct dt_conf_t;
 struct dt_points_t;
@@ -177,6 +179,8 @@ typedef struct darktable_t
   struct dt_gui_gtk_t            *gui;
   struct dt_mipmap_cache_t       *mipmap_cache;
   struct dt_image_cache_t        *image_cache;
+  struct dt_sidecar_writer_t     *sidecar_writer;
+  struct dt_dev_pixelpipe_shared_t *pipe_shared;
   struct dt_bauhaus_t            *bauhaus;
   const struct dt_database_t     *db;
   const struct dt_fswatch_t      *fswatch;
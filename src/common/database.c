@@ -37,6 +37,15 @@ typedef struct dt_database_t
 
   /* ondisk DB */
   sqlite3 *handle;
+
+  /* per thread hashtables of prepared statements, keyed by sql text */
+  pthread_key_t stmt_cache_key;
+  dt_pthread_mutex_t stmt_cache_mutex;
+  GList *stmt_caches;
+
+  /* recursive, held for the whole duration of a batch transaction */
+  pthread_mutex_t transaction_mutex;
+  int transaction_depth;
 } dt_database_t;
 
 
@@ -88,6 +97,14 @@ dt_database_t *dt_database_init(char *alternative)
   db->dbfilename = g_strdup(dbfilename);
   db->is_new_database = FALSE;
 
+  pthread_key_create(&db->stmt_cache_key, NULL);
+  dt_pthread_mutex_init(&db->stmt_cache_mutex, NULL);
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&db->transaction_mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+
   /* test if databasefile is available */
   if(!g_file_test(dbfilename, G_FILE_TEST_IS_REGULAR))
     db->is_new_database = TRUE;
@@ -123,7 +140,11 @@ dt_database_t *dt_database_init(char *alternative)
   sqlite3_exec(db->handle, "attach database ':memory:' as memory",NULL,NULL,NULL);
 
   sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  // write-ahead logging lets readers go on while bulk updates are written
+  if(dt_conf_get_bool("database/wal"))
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+  else
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
 
   g_free(dbname);
@@ -132,8 +153,63 @@ dt_database_t *dt_database_init(char *alternative)
 
 void dt_database_destroy(const dt_database_t *db)
 {
+  dt_database_t *d = (dt_database_t *)db;
+  // all cached statements need to go before the handle can be closed:
+  for(GList *l = d->stmt_caches; l; l = g_list_next(l))
+    g_hash_table_destroy((GHashTable *)l->data);
+  g_list_free(d->stmt_caches);
+  pthread_key_delete(d->stmt_cache_key);
+  dt_pthread_mutex_destroy(&d->stmt_cache_mutex);
+  pthread_mutex_destroy(&d->transaction_mutex);
+
   sqlite3_close(db->handle);
-  g_free((dt_database_t *)db);
+  g_free(d);
+}
+
+static void _database_finalize_stmt(gpointer stmt)
+{
+  sqlite3_finalize((sqlite3_stmt *)stmt);
+}
+
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db, const char *sql)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  GHashTable *cache = (GHashTable *)pthread_getspecific(d->stmt_cache_key);
+  if(!cache)
+  {
+    cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _database_finalize_stmt);
+    pthread_setspecific(d->stmt_cache_key, cache);
+    dt_pthread_mutex_lock(&d->stmt_cache_mutex);
+    d->stmt_caches = g_list_prepend(d->stmt_caches, cache);
+    dt_pthread_mutex_unlock(&d->stmt_cache_mutex);
+  }
+
+  sqlite3_stmt *stmt = (sqlite3_stmt *)g_hash_table_lookup(cache, sql);
+  if(stmt)
+  {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return stmt;
+  }
+  DT_DEBUG_SQLITE3_PREPARE_V2(d->handle, sql, -1, &stmt, NULL);
+  if(stmt) g_hash_table_insert(cache, g_strdup(sql), stmt);
+  return stmt;
+}
+
+void dt_database_start_transaction(const dt_database_t *db)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  pthread_mutex_lock(&d->transaction_mutex);
+  if(d->transaction_depth++ == 0)
+    DT_DEBUG_SQLITE3_EXEC(d->handle, "begin", NULL, NULL, NULL);
+}
+
+void dt_database_release_transaction(const dt_database_t *db)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  if(--d->transaction_depth == 0)
+    DT_DEBUG_SQLITE3_EXEC(d->handle, "commit", NULL, NULL, NULL);
+  pthread_mutex_unlock(&d->transaction_mutex);
 }
 
 sqlite3 *dt_database_get(const dt_database_t *db)
@@ -33,6 +33,19 @@ gboolean dt_database_is_new(const struct dt_database_t *db);
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
 gboolean dt_database_get_already_locked(const struct dt_database_t *db);
+
+/** returns a prepared statement for the given sql text. statements are cached
+ *  per thread and come back reset and with cleared bindings. call sqlite3_reset()
+ *  when done with it, never sqlite3_finalize(). */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db, const char *sql);
+/** starts a batch of statements which is committed as one transaction. calls can
+ *  be nested, only the outermost pair begins and commits. other threads trying to
+ *  start a batch block until the current one is released, so every begin has to go
+ *  through here. plain statements of other threads are not held back, they end up
+ *  in the open transaction. don't take the gdk lock while holding a batch. */
+void dt_database_start_transaction(const struct dt_database_t *db);
+/** ends the batch started by dt_database_start_transaction() in this thread. */
+void dt_database_release_transaction(const struct dt_database_t *db);
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -0,0 +1,265 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_COMMON_EAW_H
+#define DT_COMMON_EAW_H
+
+// edge avoiding a-trous wavelets on 4-channel float buffers, as used by the
+// equalizer (atrous.c) and the wavelet mode of denoiseprofile.c. header only,
+// so src/tests/eaw.c can compare the variants without linking darktable.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+/** edge stopping functions of the modules using the wavelets. */
+typedef enum dt_eaw_weight_t
+{
+  /** separate weights for L and chroma: exp(-param*dL^2), exp(-param*(da^2+db^2)). */
+  DT_EAW_WEIGHT_SHARPEN = 0,
+  /** 3d color distance with param = 1/sigma^2 of the band, for the noise stabilized input. */
+  DT_EAW_WEIGHT_DENOISE = 1
+}
+dt_eaw_weight_t;
+
+/* sse version of dt_fast_expf defined in darktable.h */
+static inline __m128
+dt_eaw_fast_expf_sse(const __m128 x)
+{
+  const __m128 i1 = _mm_set1_ps((float)0x3f800000u);
+  const __m128 i2i1 = _mm_set1_ps((float)0x00adf880u);
+  __m128  f = _mm_add_ps(i1, _mm_mul_ps(x, i2i1));   // f(n) = i1 + x(n)*(i2-i1)
+  __m128i i = _mm_cvtps_epi32(f);                    // i(n) = int(f(n))
+  __m128i mask = _mm_srai_epi32(i, 31);              // mask(n) = 0xffffffff if i(n) < 0
+  i = _mm_andnot_si128(mask, i);                     // i(n) = 0 if i(n) < 0
+  return _mm_castsi128_ps(i);                        // return *(float*)&i
+}
+
+// very fast approximation for 2^-x (returns 0 for x > 126)
+static inline float
+dt_eaw_fast_mexp2f(const float x)
+{
+  const float i1 = (float)0x3f800000u; // 2^0
+  const float i2 = (float)0x3f000000u; // 2^-1
+  const float k0 = i1 + x * (i2 - i1);
+  union { float f; uint32_t i; } k;
+  k.i = k0 >= (float)0x800000u ? k0 : 0;
+  return k.f;
+}
+
+/* Computes the vector
+ * (wl, wc, wc, 1)
+ *
+ * where:
+ * wl = exp(-sharpen*SQR(c1[0] - c2[0]))
+ * wc = exp(-sharpen*(SQR(c1[1] - c2[1]) + SQR(c1[2] - c2[2]))
+ */
+static inline __m128
+dt_eaw_weight_sharpen(const __m128 *c1, const __m128 *c2, const float sharpen)
+{
+  const __m128 vsharpen = _mm_set1_ps(-sharpen);  // (-s, -s, -s, -s)
+  __m128 diff = _mm_sub_ps(*c1, *c2);
+  __m128 square = _mm_mul_ps(diff, diff);         // (?, d3, d2, d1)
+  __m128 square2 = _mm_shuffle_ps(square, square, _MM_SHUFFLE(3, 1, 2, 0)); // (?, d2, d3, d1)
+  __m128 added = _mm_add_ps(square, square2);     // (?, d2+d3, d2+d3, 2*d1)
+  added = _mm_sub_ss(added, square);              // (?, d2+d3, d2+d3, d1)
+  __m128 sharpened = _mm_mul_ps(added, vsharpen); // (?, -s*(d2+d3), -s*(d2+d3), -s*d1)
+  __m128 exp = dt_eaw_fast_expf_sse(sharpened);   // (?, wc, wc, wl)
+  exp = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(exp), 4)); // (wc, wc, wl, 0)
+  exp = _mm_castsi128_ps(_mm_srli_si128(_mm_castps_si128(exp), 4)); // (0, wc, wc, wl)
+  exp = _mm_or_ps(exp, _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f)); // (1, wc, wc, wl)
+  return exp;
+}
+
+static inline __m128
+dt_eaw_weight_denoise(const __m128 *c1, const __m128 *c2, const float inv_sigma2)
+{
+  // 3d distance based on color
+  __m128 diff = _mm_sub_ps(*c1, *c2);
+  __m128 sqr  = _mm_mul_ps(diff, diff);
+  float *fsqr = (float *)&sqr;
+  const float dot = (fsqr[0] + fsqr[1] + fsqr[2])*inv_sigma2;
+  const float var = 0.02f; // FIXME: this should ideally depend on the image before noise stabilizing transforms!
+  const float off2 = 9.0f;// (3 sigma)^2
+  const float x = dot*var - off2;
+  return _mm_set1_ps(dt_eaw_fast_mexp2f(x > 0.0f ? x : 0.0f));
+}
+
+// coarse value of pixel (i, j): the 5x5 a-trous kernel with holes of mult pixels,
+// weighted by the edge stopping function. border replicates the edge pixels where
+// the kernel reaches outside the image, the caller knows when that's not needed.
+static inline __m128
+_dt_eaw_coarse(const dt_eaw_weight_t mode, const float *const in, const int i, const int j, const int mult,
+               const float param, const int width, const int height, const int border)
+{
+  static const float filter[5] = {1.0f/16.0f, 4.0f/16.0f, 6.0f/16.0f, 4.0f/16.0f, 1.0f/16.0f};
+  const __m128 *px = ((const __m128 *)in) + (size_t)j*width + i;
+  __m128 sum = _mm_setzero_ps();
+  __m128 wgt = _mm_setzero_ps();
+  for(int jj=0; jj<5; jj++)
+  {
+    int y = j + mult*(jj-2);
+    if(border) y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+    const __m128 *row = ((const __m128 *)in) + (size_t)y*width;
+    for(int ii=0; ii<5; ii++)
+    {
+      int x = i + mult*(ii-2);
+      if(border) x = x < 0 ? 0 : (x >= width ? width - 1 : x);
+      const __m128 *px2 = row + x;
+      const __m128 f = _mm_set1_ps(filter[ii]*filter[jj]);
+      const __m128 wp = mode == DT_EAW_WEIGHT_SHARPEN ? dt_eaw_weight_sharpen(px, px2, param)
+                                                      : dt_eaw_weight_denoise(px, px2, param);
+      const __m128 w = _mm_mul_ps(f, wp);
+      sum = _mm_add_ps(sum, _mm_mul_ps(w, *px2));
+      wgt = _mm_add_ps(wgt, w);
+    }
+  }
+  return mode == DT_EAW_WEIGHT_SHARPEN ? _mm_mul_ps(sum, _mm_rcp_ps(wgt)) : _mm_div_ps(sum, wgt);
+}
+
+// soft thresholding and boost of a detail coefficient: boost*sign(d)*max(0, |d|-thrs).
+static inline __m128
+_dt_eaw_shrink(const __m128 detail, const __m128 threshold, const __m128 boost)
+{
+  const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000u));
+  const __m128 absamt = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_andnot_ps(mask, detail), threshold));
+  const __m128 amount = _mm_or_ps(_mm_and_ps(detail, mask), absamt);
+  return _mm_mul_ps(boost, amount);
+}
+
+// one decomposition level. writes the coarse image to out and the detail either to
+// detail, or shrunk and boosted into acc (overwritten if first, else added).
+static inline void
+_dt_eaw_decompose(const dt_eaw_weight_t mode, float *const out, const float *const in, float *const detail,
+                  float *const acc, const int first, const float *thrsf, const float *boostf,
+                  const int scale, const float param, const int width, const int height)
+{
+  const int mult = 1<<scale;
+  const __m128 threshold = acc ? _mm_loadu_ps(thrsf) : _mm_setzero_ps();
+  const __m128 boost     = acc ? _mm_loadu_ps(boostf) : _mm_setzero_ps();
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    const int border_row = j < 2*mult || j >= height - 2*mult;
+    const __m128 *px = ((const __m128 *)in) + (size_t)j*width;
+    float *pcoarse = out + (size_t)4*j*width;
+    float *pdetail = detail ? detail + (size_t)4*j*width : NULL;
+    __m128 *pacc = acc ? ((__m128 *)acc) + (size_t)j*width : NULL;
+    for(int i=0; i<width; i++, px++, pcoarse+=4)
+    {
+      // only the pixels close to the edges need the clamped coordinates:
+      const __m128 sum = (border_row || i < 2*mult || i >= width - 2*mult)
+                         ? _dt_eaw_coarse(mode, in, i, j, mult, param, width, height, 1)
+                         : _dt_eaw_coarse(mode, in, i, j, mult, param, width, height, 0);
+      const __m128 d = _mm_sub_ps(*px, sum);
+      _mm_stream_ps(pcoarse, sum);
+      if(pdetail)
+      {
+        _mm_stream_ps(pdetail, d);
+        pdetail += 4;
+      }
+      if(pacc)
+      {
+        const __m128 a = _dt_eaw_shrink(d, threshold, boost);
+        *pacc = first ? a : _mm_add_ps(*pacc, a);
+        pacc++;
+      }
+    }
+  }
+  _mm_sfence();
+}
+
+/**
+ * one level of the decomposition: the coarse image goes to out, in - out to detail.
+ * all buffers are width*height 4-channel floats, 16 byte aligned.
+ */
+static inline void
+dt_eaw_decompose(float *const out, const float *const in, float *const detail, const int scale,
+                 const dt_eaw_weight_t mode, const float param, const int width, const int height)
+{
+  // spelled out so the weight gets inlined:
+  if(mode == DT_EAW_WEIGHT_SHARPEN)
+    _dt_eaw_decompose(DT_EAW_WEIGHT_SHARPEN, out, in, detail, NULL, 0, NULL, NULL, scale, param, width, height);
+  else
+    _dt_eaw_decompose(DT_EAW_WEIGHT_DENOISE, out, in, detail, NULL, 0, NULL, NULL, scale, param, width, height);
+}
+
+/**
+ * one level of the reconstruction: out = in + boost*shrink(detail, thrs), with
+ * per channel thresholds and boosts.
+ */
+static inline void
+dt_eaw_synthesize(float *const out, const float *const in, const float *const detail,
+                  const float *thrsf, const float *boostf, const int width, const int height)
+{
+  const __m128 threshold = _mm_loadu_ps(thrsf);
+  const __m128 boost     = _mm_loadu_ps(boostf);
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    const __m128 *pin = (const __m128 *)in + (size_t)j*width;
+    const __m128 *pdetail = (const __m128 *)detail + (size_t)j*width;
+    float *pout = out + (size_t)4*j*width;
+    for(int i=0; i<width; i++, pin++, pdetail++, pout+=4)
+      _mm_stream_ps(pout, _mm_add_ps(*pin, _dt_eaw_shrink(*pdetail, threshold, boost)));
+  }
+  _mm_sfence();
+}
+
+/**
+ * decomposition and reconstruction in one go, for thresholds known up front.
+ * as the reconstruction only adds up the shrunk details of all levels, they are
+ * accumulated in acc right away (first level: pass first = 1) instead of being
+ * kept in one full buffer per level. the result is dt_eaw_add() of the coarsest
+ * level and acc.
+ */
+static inline void
+dt_eaw_decompose_and_synthesize(float *const out, const float *const in, float *const acc, const int first,
+                                const float *thrsf, const float *boostf, const int scale,
+                                const dt_eaw_weight_t mode, const float param, const int width, const int height)
+{
+  if(mode == DT_EAW_WEIGHT_SHARPEN)
+    _dt_eaw_decompose(DT_EAW_WEIGHT_SHARPEN, out, in, NULL, acc, first, thrsf, boostf, scale, param, width, height);
+  else
+    _dt_eaw_decompose(DT_EAW_WEIGHT_DENOISE, out, in, NULL, acc, first, thrsf, boostf, scale, param, width, height);
+}
+
+/** out = coarse + acc, out may be the same buffer as coarse. */
+static inline void
+dt_eaw_add(float *const out, const float *const coarse, const float *const acc, const int width, const int height)
+{
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    const __m128 *pc = (const __m128 *)coarse + (size_t)j*width;
+    const __m128 *pa = (const __m128 *)acc + (size_t)j*width;
+    __m128 *po = (__m128 *)out + (size_t)j*width;
+    for(int i=0; i<width; i++) po[i] = _mm_add_ps(pc[i], pa[i]);
+  }
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
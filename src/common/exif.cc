@@ -1230,6 +1230,8 @@ static void _exif_import_tags(dt_image_t *img,Exiv2::XmpData::iterator &pos)
   sqlite3_finalize(stmt_upd_tagxtag);
   sqlite3_finalize(stmt_ins_tagged);
   sqlite3_finalize(stmt_upd_tagxtag2);
+  // the tags and pairs have been written behind the back of the tag index:
+  if(cnt > 0) dt_tag_index_invalidate();
 }
 
 // need a write lock on *img (non-const) to write stars (and soon color labels).
@@ -1269,6 +1271,8 @@ int dt_exif_xmp_read (dt_image_t *img, const char* filename, const int history_o
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img->id);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    // the pair counts changed, even if the xmp brings no tags of its own:
+    dt_tag_index_invalidate();
 
     if(!history_only)
     {
@@ -1939,6 +1943,16 @@ int dt_exif_thumbnail(
         y_beg = 0;
         y_end = jpg.height - 1;
       }
+      // only decode as much as the mip needs, the crop fits into width x height after orientation:
+      const int full_ht = jpg.height;
+      const float box_wd = (orientation & 4) ? height : width, box_ht = (orientation & 4) ? width : height;
+      const float fit = fminf(box_wd/jpg.width, box_ht/(float)(y_end - y_beg + 1));
+      dt_imageio_jpeg_set_scale(&jpg, (int)ceilf(fit*jpg.width), (int)ceilf(fit*jpg.height));
+      if(jpg.height != full_ht)
+      {
+        y_beg = y_beg*jpg.height/full_ht;
+        y_end = MIN(jpg.height - 1, y_end*jpg.height/full_ht);
+      }
       uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t)*jpg.width*jpg.height*4);
       if(!tmp) return 1;
       if(!dt_imageio_jpeg_decompress(&jpg, tmp))
@@ -25,6 +25,8 @@
 #include "common/collection.h"
 #include "common/image_cache.h"
 #include "common/debug.h"
+#include "common/folders.h"
+#include "common/tags.h"
 #include "views/view.h"
 
 #include <stdio.h>
@@ -143,7 +145,14 @@ int dt_film_open(const int32_t id)
     sqlite3_step(stmt);
   }
   sqlite3_finalize(stmt);
-  // TODO: prefetch to cache using image_open
+  // prefetch thumbnails of the whole roll in the background, instead of the last roll's:
+  dt_film_mipmaps_cancel();
+  if(dt_conf_get_bool("cache_pregenerate_thumbnails"))
+  {
+    dt_job_t j;
+    dt_film_mipmaps_init(&j, id, DT_MIPMAP_3);
+    dt_control_add_job(darktable.control, &j);
+  }
   dt_film_set_query(id);
   dt_control_queue_redraw_center();
   dt_view_manager_reset(darktable.view_manager);
@@ -219,6 +228,7 @@ int dt_film_new(dt_film_t *film, const char *directory)
       film->id = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
     dt_pthread_mutex_unlock(&darktable.db_insert);
+    if(film->id > 0) dt_folders_film_added(film->id, directory);
   }
 
   if(film->id<=0)
@@ -275,6 +285,7 @@ int dt_film_import_blocking(const char *dirname)
     if(sqlite3_step(stmt) == SQLITE_ROW)
       film->id = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
+    if(film->id > 0) dt_folders_film_added(film->id, dirname);
   }
 
   /* bail out if we got troubles */
@@ -349,6 +360,30 @@ int _film_filename_cmp(gchar *a, gchar *b)
   return g_strcmp0(g_path_get_basename(a), g_path_get_basename(b));
 }
 
+#if GLIB_CHECK_VERSION (2, 26, 0)
+/* applies all gpx files in the folder of the film roll to its images, in one job. */
+static void _film_apply_gpx_files(dt_film_t *film)
+{
+  GSList *gpx_files = NULL;
+  g_dir_rewind(film->dir);
+  const gchar *dfn = NULL;
+  while ((dfn = g_dir_read_name(film->dir)) != NULL)
+  {
+    /* check if we have a gpx to be auto applied to filmroll */
+    if(strlen(dfn) > 4 && (strcmp(dfn+strlen(dfn)-4,".gpx") == 0 ||
+                           strcmp(dfn+strlen(dfn)-4,".GPX") == 0))
+      gpx_files = g_slist_append(gpx_files, g_build_path (G_DIR_SEPARATOR_S, film->dirname, dfn, NULL));
+  }
+  if(gpx_files)
+  {
+    gchar *tz = dt_conf_get_string("plugins/lighttable/geotagging/tz");
+    dt_control_gpx_apply(gpx_files, film->id, tz);
+    g_free(tz);
+  }
+  g_slist_free_full(gpx_files, g_free);
+}
+#endif
+
 void dt_film_import1(dt_film_t *film)
 {
   gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
@@ -389,19 +424,7 @@ void dt_film_import1(dt_film_t *film)
       {
         /* check if we can find a gpx data file to be auto applied
            to images in the jsut imported filmroll */
-        g_dir_rewind(cfr->dir);
-        const gchar *dfn = NULL;
-        while ((dfn = g_dir_read_name(cfr->dir)) != NULL)
-        {
-          /* check if we have a gpx to be auto applied to filmroll */
-          if(strcmp(dfn+strlen(dfn)-4,".gpx") == 0 ||
-              strcmp(dfn+strlen(dfn)-4,".GPX") == 0)
-          {
-            gchar *gpx_file = g_build_path (G_DIR_SEPARATOR_S, cfr->dirname, dfn, NULL);
-            dt_control_gpx_apply(gpx_file, cfr->id, dt_conf_get_string("plugins/lighttable/geotagging/tz"));
-            g_free(gpx_file);
-          }
-        }
+        _film_apply_gpx_files(cfr);
       }
 #endif
 
@@ -440,19 +463,7 @@ void dt_film_import1(dt_film_t *film)
   {
     /* check if we can find a gpx data file to be auto applied
        to images in the just imported filmroll */
-    g_dir_rewind(cfr->dir);
-    const gchar *dfn = NULL;
-    while ((dfn = g_dir_read_name(cfr->dir)) != NULL)
-    {
-      /* check if we have a gpx to be auto applied to filmroll */
-      if(strcmp(dfn+strlen(dfn)-4,".gpx") == 0 ||
-          strcmp(dfn+strlen(dfn)-4,".GPX") == 0)
-      {
-        gchar *gpx_file = g_build_path (G_DIR_SEPARATOR_S, cfr->dirname, dfn, NULL);
-        dt_control_gpx_apply(gpx_file, cfr->id, dt_conf_get_string("plugins/lighttable/geotagging/tz"));
-        g_free(gpx_file);
-      }
-    }
+    _film_apply_gpx_files(cfr);
   }
 #endif
 }
@@ -482,6 +493,7 @@ void dt_film_remove_empty()
     DT_DEBUG_SQLITE3_BIND_INT(inner_stmt, 1, id);
     sqlite3_step(inner_stmt);
     sqlite3_finalize(inner_stmt);
+    dt_folders_film_removed(id);
   }
   sqlite3_finalize(stmt);
   if(raise_signal)
@@ -539,6 +551,7 @@ void dt_film_remove(const int id)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_tag_index_invalidate();
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "delete from tagged_images where imgid in "
                               "(select id from images where film_id = ?1)", -1, &stmt, NULL);
@@ -594,6 +607,7 @@ void dt_film_remove(const int id)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_folders_film_removed(id);
   // dt_control_update_recent_films();
   dt_control_signal_raise(darktable.signals , DT_SIGNAL_FILMROLLS_CHANGED);
 }
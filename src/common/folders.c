@@ -0,0 +1,275 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+#include "common/folders.h"
+
+#include <string.h>
+
+/*
+ * the folder hierarchy of all film rolls, with the number of images per folder summed
+ * up along the way to the root. the collect module used to split all film roll folders
+ * into a tree store on its own and to count images with a LIKE query per folder.
+ *
+ * it is loaded on first use. adding and removing film rolls is mirrored by
+ * dt_folders_film_added() and dt_folders_film_removed(). code adding or removing images
+ * calls dt_folders_film_changed(), which counts the images of the film roll again, so
+ * calling it more often than needed does no harm. renaming film roll folders is rare
+ * enough to just call dt_folders_invalidate().
+ */
+static struct
+{
+  gboolean loaded;
+  dt_folder_t *root;
+  GHashTable *paths; // path -> dt_folder_t, keys owned by the nodes
+  GHashTable *films; // film id -> dt_folder_t
+}
+folder_index = { FALSE, NULL, NULL, NULL };
+
+static GStaticMutex folder_index_mutex = G_STATIC_MUTEX_INIT;
+
+static gint _folders_compare(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(((const dt_folder_t *)a)->name, ((const dt_folder_t *)b)->name);
+}
+
+static dt_folder_t *_folders_new_node(dt_folder_t *parent, const gchar *name, const gchar *path)
+{
+  dt_folder_t *f = (dt_folder_t *)g_malloc0(sizeof(dt_folder_t));
+  f->name = g_strdup(name);
+  f->path = g_strdup(path);
+  f->film_id = -1;
+  f->parent = parent;
+  if(parent) parent->children = g_list_insert_sorted(parent->children, f, _folders_compare);
+  return f;
+}
+
+static void _folders_free_node(dt_folder_t *f)
+{
+  g_list_free_full(f->children, (GDestroyNotify)_folders_free_node);
+  g_free(f->name);
+  g_free(f->path);
+  g_free(f);
+}
+
+// the node of folder, which is created along with its parents if create is set. empty
+// path components are skipped, so "/a//b/" ends up in "/a/b". needs folder_index_mutex.
+static dt_folder_t *_folders_lookup(const char *folder, const gboolean create)
+{
+  gchar **parts = g_strsplit(folder, "/", -1);
+  GString *path = g_string_new("");
+  dt_folder_t *node = folder_index.root;
+  for(int k = 0; parts[k] && node; k++)
+  {
+    if(parts[k][0] == '\0') continue;
+    g_string_append_c(path, '/');
+    g_string_append(path, parts[k]);
+    dt_folder_t *child = (dt_folder_t *)g_hash_table_lookup(folder_index.paths, path->str);
+    if(!child && create)
+    {
+      child = _folders_new_node(node, parts[k], path->str);
+      g_hash_table_insert(folder_index.paths, child->path, child);
+    }
+    node = child;
+  }
+  g_string_free(path, TRUE);
+  g_strfreev(parts);
+  return node;
+}
+
+// sets the number of images of the film roll in f and updates the totals up to the root.
+static void _folders_set_count(dt_folder_t *f, const guint count)
+{
+  const guint old = f->count;
+  f->count = count;
+  for(; f; f = f->parent) f->total = f->total - old + count;
+}
+
+// removes f and then its parents, as long as they neither hold a film roll nor have children left.
+static void _folders_prune(dt_folder_t *f)
+{
+  while(f && f != folder_index.root && f->film_id < 0 && !f->children)
+  {
+    dt_folder_t *parent = f->parent;
+    parent->children = g_list_remove(parent->children, f);
+    g_hash_table_remove(folder_index.paths, f->path);
+    _folders_free_node(f);
+    f = parent;
+  }
+}
+
+static dt_folder_t *_folders_add_film(const gint film_id, const char *folder)
+{
+  dt_folder_t *f = (dt_folder_t *)g_hash_table_lookup(folder_index.films, GINT_TO_POINTER(film_id));
+  if(f) return f;
+  f = _folders_lookup(folder, TRUE);
+  f->film_id = film_id;
+  g_hash_table_insert(folder_index.films, GINT_TO_POINTER(film_id), f);
+  return f;
+}
+
+// needs folder_index_mutex.
+static void _folders_load()
+{
+  if(folder_index.loaded) return;
+  const double start = dt_get_wtime();
+
+  folder_index.root = _folders_new_node(NULL, "", "");
+  folder_index.paths = g_hash_table_new(g_str_hash, g_str_equal);
+  folder_index.films = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, folder FROM film_rolls", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    if(sqlite3_column_text(stmt, 1))
+      _folders_add_film(sqlite3_column_int(stmt, 0), (const char *)sqlite3_column_text(stmt, 1));
+  sqlite3_finalize(stmt);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT film_id, COUNT(*) FROM images GROUP BY film_id", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_folder_t *f = (dt_folder_t *)g_hash_table_lookup(folder_index.films, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+    if(f) _folders_set_count(f, sqlite3_column_int(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+
+  folder_index.loaded = TRUE;
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF, "[folders] loaded %u folders of %u film rolls with %u images in %.3f secs\n",
+           g_hash_table_size(folder_index.paths), g_hash_table_size(folder_index.films),
+           folder_index.root->total, dt_get_wtime() - start);
+}
+
+static dt_folder_t *_folders_copy(const dt_folder_t *f, dt_folder_t *parent)
+{
+  dt_folder_t *c = (dt_folder_t *)g_malloc(sizeof(dt_folder_t));
+  *c = *f;
+  c->name = g_strdup(f->name);
+  c->path = g_strdup(f->path);
+  c->parent = parent;
+  c->children = NULL;
+  for(const GList *l = f->children; l; l = g_list_next(l))
+    c->children = g_list_prepend(c->children, _folders_copy((const dt_folder_t *)l->data, c));
+  c->children = g_list_reverse(c->children);
+  return c;
+}
+
+dt_folder_t *dt_folders_get_tree()
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  _folders_load();
+  dt_folder_t *root = _folders_copy(folder_index.root, NULL);
+  g_static_mutex_unlock(&folder_index_mutex);
+  return root;
+}
+
+void dt_folders_free_tree(dt_folder_t *root)
+{
+  if(root) _folders_free_node(root);
+}
+
+guint dt_folders_count_images(const char *path)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  _folders_load();
+  const dt_folder_t *f = _folders_lookup(path, FALSE);
+  const guint total = f ? f->total : 0;
+  g_static_mutex_unlock(&folder_index_mutex);
+  return total;
+}
+
+guint dt_folders_count_film_images(const char *path)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  _folders_load();
+  const dt_folder_t *f = _folders_lookup(path, FALSE);
+  const guint count = f ? f->count : 0;
+  g_static_mutex_unlock(&folder_index_mutex);
+  return count;
+}
+
+gint dt_folders_get_film_id(const char *path)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  _folders_load();
+  const dt_folder_t *f = _folders_lookup(path, FALSE);
+  const gint film_id = f ? f->film_id : -1;
+  g_static_mutex_unlock(&folder_index_mutex);
+  return film_id;
+}
+
+void dt_folders_film_added(const gint film_id, const char *folder)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  if(folder_index.loaded && folder) _folders_add_film(film_id, folder);
+  g_static_mutex_unlock(&folder_index_mutex);
+}
+
+void dt_folders_film_removed(const gint film_id)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  dt_folder_t *f = folder_index.loaded
+                   ? (dt_folder_t *)g_hash_table_lookup(folder_index.films, GINT_TO_POINTER(film_id)) : NULL;
+  if(f)
+  {
+    g_hash_table_remove(folder_index.films, GINT_TO_POINTER(film_id));
+    _folders_set_count(f, 0);
+    f->film_id = -1;
+    _folders_prune(f);
+  }
+  g_static_mutex_unlock(&folder_index_mutex);
+}
+
+void dt_folders_film_changed(const gint film_id)
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  dt_folder_t *f = folder_index.loaded
+                   ? (dt_folder_t *)g_hash_table_lookup(folder_index.films, GINT_TO_POINTER(film_id)) : NULL;
+  if(f)
+  {
+    // uses images_film_id_index:
+    sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db,
+                                                    "SELECT COUNT(*) FROM images WHERE film_id = ?1");
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+    if(sqlite3_step(stmt) == SQLITE_ROW) _folders_set_count(f, sqlite3_column_int(stmt, 0));
+    sqlite3_reset(stmt);
+  }
+  g_static_mutex_unlock(&folder_index_mutex);
+}
+
+void dt_folders_invalidate()
+{
+  g_static_mutex_lock(&folder_index_mutex);
+  if(folder_index.loaded)
+  {
+    g_hash_table_destroy(folder_index.paths);
+    g_hash_table_destroy(folder_index.films);
+    _folders_free_node(folder_index.root);
+    folder_index.root = NULL;
+    folder_index.paths = folder_index.films = NULL;
+    folder_index.loaded = FALSE;
+  }
+  g_static_mutex_unlock(&folder_index_mutex);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,67 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_FOLDERS_H
+#define DT_FOLDERS_H
+
+#include <glib.h>
+
+/** one folder of the hierarchy spanned by the film roll folders. */
+typedef struct dt_folder_t
+{
+  gchar *name;              // last path component
+  gchar *path;              // full path, without trailing separator
+  gint film_id;             // the film roll in exactly this folder, or -1
+  guint count;              // images of that film roll
+  guint total;              // images in this folder and all folders below
+  struct dt_folder_t *parent;
+  GList *children;          // dt_folder_t, sorted by name
+}
+dt_folder_t;
+
+/** returns a copy of the folder tree, the root has an empty name and path. free with dt_folders_free_tree(). */
+dt_folder_t *dt_folders_get_tree();
+
+/** frees a tree returned by dt_folders_get_tree(). */
+void dt_folders_free_tree(dt_folder_t *root);
+
+/** number of images in path and all folders below it. */
+guint dt_folders_count_images(const char *path);
+
+/** number of images of the film roll in exactly path, without the folders below it. */
+guint dt_folders_count_film_images(const char *path);
+
+/** id of the film roll in exactly path, or -1. */
+gint dt_folders_get_film_id(const char *path);
+
+/** a film roll has been added to the database. */
+void dt_folders_film_added(const gint film_id, const char *folder);
+
+/** a film roll and all of its images have been removed from the database. */
+void dt_folders_film_removed(const gint film_id);
+
+/** images have been added to or removed from the film roll. */
+void dt_folders_film_changed(const gint film_id);
+
+/** drops the folder tree, to be reloaded from the database on next use. */
+void dt_folders_invalidate();
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -22,6 +22,7 @@
 #include <xmmintrin.h>
 #include "common/opencl.h"
 #include "common/gaussian.h"
+#include "develop/pixelpipe_scratch.h"
 
 #define CLAMPF(a, mn, mx) ((a) < (mn) ? (mn) : ((a) > (mx) ? (mx) : (a)))
 #define MMCLAMPPS(a, mn, mx) (_mm_min_ps((mx), _mm_max_ps((a), (mn))))
@@ -110,6 +111,7 @@ dt_gaussian_singlebuffer_size(
 
 dt_gaussian_t *
 dt_gaussian_init(
+  struct dt_dev_pixelpipe_t *pipe, // pipe for temporary memory, may be NULL
   const int width,       // width of input image
   const int height,      // height of input image
   const int channels,    // channels per pixel
@@ -121,6 +123,7 @@ dt_gaussian_init(
   dt_gaussian_t *g = (dt_gaussian_t *)malloc(sizeof(dt_gaussian_t));
   if(!g) return NULL;
 
+  g->pipe = pipe;
   g->width = width;
   g->height = height;
   g->channels = channels;
@@ -138,7 +141,7 @@ dt_gaussian_init(
     g->min[k] = min[k];
   }
 
-  g->buf = dt_alloc_align(64, width*height*channels*sizeof(float));
+  g->buf = dt_pipe_scratch_alloc(pipe, width*height*channels*sizeof(float));
   if(!g->buf) goto error;
 
   return g;
@@ -480,7 +483,7 @@ dt_gaussian_free(
   dt_gaussian_t *g)
 {
   if(!g) return;
-  free(g->buf);
+  dt_pipe_scratch_free(g->pipe, g->buf);
   free(g->min);
   free(g->max);
   free(g);
@@ -33,8 +33,11 @@ typedef enum dt_gaussian_order_t
 dt_gaussian_order_t;
 
 
+struct dt_dev_pixelpipe_t;
+
 typedef struct dt_gaussian_t
 {
+  struct dt_dev_pixelpipe_t *pipe;  // temporary memory comes from this pipe, if not NULL
   int width, height, channels;
   float sigma;
   int order;
@@ -44,7 +47,7 @@ typedef struct dt_gaussian_t
 }
 dt_gaussian_t;
 
-dt_gaussian_t *dt_gaussian_init(const int width, const int height, const int channels, const float *max, const float *min, const float sigma, const int order);
+dt_gaussian_t *dt_gaussian_init(struct dt_dev_pixelpipe_t *pipe, const int width, const int height, const int channels, const float *max, const float *min, const float sigma, const int order);
 
 size_t dt_gaussian_memory_use(const int width, const int height, const int channels);
 
@@ -24,17 +24,22 @@ typedef struct _gpx_track_point_t
 {
   gdouble longitude, latitude, elevation;
   GTimeVal time;
+  /* track segment the point belongs to, only points of the
+     same segment are interpolated between */
+  uint32_t segment;
 } _gpx_track_point_t;
 
 typedef struct dt_gpx_t
 {
-  /* the list of track records parsed */
-  GList *track;
+  /* the track points of all files parsed, sorted by time */
+  GArray *track;
 
   /* currently parsed track point */
   _gpx_track_point_t *current_track_point;
   uint32_t current_parser_element;
   gboolean invalid_track_point;
+  /* segment of the track points parsed right now, and the number of segments so far */
+  uint32_t segment, segments;
 
 } dt_gpx_t;
 
@@ -66,14 +71,52 @@ static GMarkupParser _gpx_parser =
 };
 
 
-dt_gpx_t *dt_gpx_new(const gchar *filename)
+static inline double _gpx_time(const _gpx_track_point_t *tp)
+{
+  return tp->time.tv_sec + 1e-6 * tp->time.tv_usec;
+}
+
+static gint _gpx_sort_by_time(gconstpointer a, gconstpointer b)
+{
+  const _gpx_track_point_t *pa = (const _gpx_track_point_t *)a, *pb = (const _gpx_track_point_t *)b;
+  if(pa->time.tv_sec != pb->time.tv_sec) return pa->time.tv_sec < pb->time.tv_sec ? -1 : 1;
+  if(pa->time.tv_usec != pb->time.tv_usec) return pa->time.tv_usec < pb->time.tv_usec ? -1 : 1;
+  // keep points of the same time in the order they were parsed
+  return pa->segment < pb->segment ? -1 : (pa->segment > pb->segment ? 1 : 0);
+}
+
+/* sorts the track points of all tracks and files by time and drops the
+   ones recorded twice, as happens with overlapping segments or when the
+   same track is contained in more than one file */
+static void _gpx_merge(dt_gpx_t *gpx)
+{
+  g_array_sort(gpx->track, _gpx_sort_by_time);
+
+  guint n = 0;
+  for (guint k = 0; k < gpx->track->len; k++)
+  {
+    const _gpx_track_point_t *tp = &g_array_index(gpx->track, _gpx_track_point_t, k);
+    if (n > 0)
+    {
+      const _gpx_track_point_t *last = &g_array_index(gpx->track, _gpx_track_point_t, n - 1);
+      if (last->time.tv_sec == tp->time.tv_sec && last->time.tv_usec == tp->time.tv_usec)
+        continue;
+    }
+    if (n != k)
+      g_array_index(gpx->track, _gpx_track_point_t, n) = *tp;
+    n++;
+  }
+  g_array_set_size(gpx->track, n);
+}
+
+static gboolean _gpx_parse(dt_gpx_t *gpx, const gchar *filename)
 {
-  dt_gpx_t *gpx = NULL;
   GMarkupParseContext *ctx = NULL;
   GError *err = NULL;
   GMappedFile *gpxmf = NULL;
   gchar *gpxmf_content = NULL;
   gint gpxmf_size = 0;
+  const guint old_len = gpx->track->len;
 
 
   /* map gpx file to parse into memory */
@@ -86,9 +129,8 @@ dt_gpx_t *dt_gpx_new(const gchar *filename)
   if (!gpxmf_content || gpxmf_size < 10)
     goto error;
 
-  /* allocate new dt_gpx_t context */
-  gpx = g_malloc(sizeof(dt_gpx_t));
-  memset(gpx, 0, sizeof(dt_gpx_t));
+  /* points outside of any trkseg element get a segment of their own */
+  gpx->segment = gpx->segments++;
 
   /* initialize the parser and start parse gpx xml data */
   ctx = g_markup_parse_context_new(&_gpx_parser, 0, gpx, NULL);
@@ -97,10 +139,12 @@ dt_gpx_t *dt_gpx_new(const gchar *filename)
     goto error;
 
 
-  /* cleanup and return gpx context */
+  /* cleanup and merge the new points into the track */
   g_markup_parse_context_free(ctx);
+  g_mapped_file_unref(gpxmf);
+  _gpx_merge(gpx);
 
-  return gpx;
+  return TRUE;
 
 error:
   if (err)
@@ -112,18 +156,45 @@ error:
   if (ctx)
     g_markup_parse_context_free(ctx);
 
-  if (gpx)
-    g_free(gpx);
+  if (gpxmf)
+    g_mapped_file_unref(gpxmf);
+
+  g_free(gpx->current_track_point);
+  gpx->current_track_point = NULL;
+
+  /* drop whatever was parsed of this file */
+  g_array_set_size(gpx->track, old_len);
+
+  return FALSE;
+}
+
+dt_gpx_t *dt_gpx_new(const gchar *filename)
+{
+  /* allocate new dt_gpx_t context */
+  dt_gpx_t *gpx = g_malloc(sizeof(dt_gpx_t));
+  memset(gpx, 0, sizeof(dt_gpx_t));
+  gpx->track = g_array_new(FALSE, FALSE, sizeof(_gpx_track_point_t));
+
+  if (!_gpx_parse(gpx, filename))
+  {
+    dt_gpx_destroy(gpx);
+    return NULL;
+  }
 
-  return NULL;
+  return gpx;
+}
+
+gboolean dt_gpx_add(struct dt_gpx_t *gpx, const gchar *filename)
+{
+  g_assert(gpx != NULL);
+  return _gpx_parse(gpx, filename);
 }
 
 void dt_gpx_destroy(struct dt_gpx_t *gpx)
 {
   g_assert(gpx != NULL);
 
-  if (gpx->track)
-    g_list_foreach(gpx->track, (GFunc)g_free, NULL);
+  g_array_free(gpx->track, TRUE);
 
   g_free(gpx);
 }
@@ -132,41 +203,61 @@ gboolean dt_gpx_get_location(struct dt_gpx_t *gpx, GTimeVal *timestamp, gdouble
 {
   g_assert(gpx != NULL);
 
-  GList *item = g_list_first(gpx->track);
+  const guint n = gpx->track->len;
+  const _gpx_track_point_t *track = (const _gpx_track_point_t *)gpx->track->data;
 
   /* verify that we got at least 2 trackpoints */
-  if (!item || !item->next)
+  if (n < 2)
     return FALSE;
 
-  do
+  /* if timestamp is out of time range return false but fill
+     closest location value start or end point */
+  if (timestamp->tv_sec <= track[0].time.tv_sec)
   {
+    *lon = track[0].longitude;
+    *lat = track[0].latitude;
+    return FALSE;
+  }
+  if (timestamp->tv_sec >= track[n-1].time.tv_sec)
+  {
+    *lon = track[n-1].longitude;
+    *lat = track[n-1].latitude;
+    return FALSE;
+  }
 
-    _gpx_track_point_t *tp = (_gpx_track_point_t *)item->data;
-
-    /* if timestamp is out of time range return false but fill
-       closest location value start or end point */
-    if ((!item->next && timestamp->tv_sec >= tp->time.tv_sec)
-        || (timestamp->tv_sec <= tp->time.tv_sec))
-    {
-      *lon = tp->longitude;
-      *lat = tp->latitude;
-      return FALSE;
-    }
-
-    /* check if timestamp is within current and next trackpoint */
-    if (timestamp->tv_sec >= tp->time.tv_sec &&
-        timestamp->tv_sec <= ((_gpx_track_point_t*)item->next->data)->time.tv_sec)
-    {
-      *lon = tp->longitude;
-      *lat = tp->latitude;
-      return TRUE;
-    }
+  /* binary search for the last point not after timestamp */
+  const double t = timestamp->tv_sec + 1e-6 * timestamp->tv_usec;
+  guint lo = 0, hi = n - 1;
+  while (hi - lo > 1)
+  {
+    const guint mid = (lo + hi) / 2;
+    if (_gpx_time(track + mid) <= t) lo = mid;
+    else hi = mid;
+  }
+  const _gpx_track_point_t *p0 = track + lo, *p1 = track + hi;
 
+  /* between two segments (e.g. the receiver was off over night) don't
+     interpolate, take the point closer in time */
+  const double t0 = _gpx_time(p0), t1 = _gpx_time(p1);
+  if (p0->segment != p1->segment)
+  {
+    const _gpx_track_point_t *tp = (t - t0 <= t1 - t) ? p0 : p1;
+    *lon = tp->longitude;
+    *lat = tp->latitude;
+    return TRUE;
   }
-  while ((item = g_list_next(item)) != NULL);
 
-  /* should not reach this point */
-  return FALSE;
+  /* linear interpolation along the segment */
+  const double f = t1 > t0 ? (t - t0) / (t1 - t0) : 0.0;
+  double dlon = p1->longitude - p0->longitude;
+  /* the short way across the date line */
+  if (dlon > 180.0) dlon -= 360.0;
+  else if (dlon < -180.0) dlon += 360.0;
+  *lon = p0->longitude + f * dlon;
+  if (*lon > 180.0) *lon -= 360.0;
+  else if (*lon < -180.0) *lon += 360.0;
+  *lat = p0->latitude + f * (p1->latitude - p0->latitude);
+  return TRUE;
 }
 
 /*
@@ -179,7 +270,11 @@ void _gpx_parser_start_element(GMarkupParseContext *ctx,
 {
   dt_gpx_t *gpx = (dt_gpx_t *)user_data;
 
-  if (strcmp(element_name, "trkpt") == 0)
+  if (strcmp(element_name, "trkseg") == 0)
+  {
+    gpx->segment = gpx->segments++;
+  }
+  else if (strcmp(element_name, "trkpt") == 0)
   {
     if (gpx->current_track_point)
     {
@@ -200,6 +295,7 @@ void _gpx_parser_start_element(GMarkupParseContext *ctx,
       /* initialize with NAN for validation check */
       gpx->current_track_point->longitude = NAN;
       gpx->current_track_point->latitude = NAN;
+      gpx->current_track_point->segment = gpx->segment;
 
       /* go thru the attributes to find and get values of lon / lat*/
       while (*attribute_name)
@@ -258,10 +354,9 @@ void _gpx_parser_end_element (GMarkupParseContext *context, const gchar *element
   /* closing trackpoint lets take care of data parsed */
   if (strcmp(element_name, "trkpt") == 0)
   {
-    if (!gpx->invalid_track_point)
-      gpx->track = g_list_append(gpx->track, gpx->current_track_point);
-    else
-      g_free(gpx->current_track_point);
+    if (gpx->current_track_point && !gpx->invalid_track_point)
+      g_array_append_val(gpx->track, *gpx->current_track_point);
+    g_free(gpx->current_track_point);
 
     gpx->current_track_point = NULL;
   }
@@ -23,11 +23,14 @@ struct dt_gpx_t;
 
 /* loads and parses a gpx track file */
 struct dt_gpx_t *dt_gpx_new(const gchar *filename);
+/* merges the track points of another gpx file into the track, returns FALSE if it couldn't be parsed */
+gboolean dt_gpx_add(struct dt_gpx_t *, const gchar *filename);
 void dt_gpx_destroy(struct dt_gpx_t *);
 
 /* fetch the lon,lat coords for time t, if within time range
   of gpx record return TRUE, FALSE is returned if out of time frame
-  and closest record of lon,lat is filled */
+  and closest record of lon,lat is filled. within a track segment the
+  location is interpolated between the surrounding track points. */
 gboolean dt_gpx_get_location(struct dt_gpx_t *, GTimeVal *timestamp, gdouble *lon, gdouble *lat);
 
 #endif
@@ -0,0 +1,90 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_COMMON_HASH_H
+#define DT_COMMON_HASH_H
+
+#include <inttypes.h>
+#include <string.h>
+
+/*
+ * 64-bit hashing for cache keys, eight bytes at a time. the mixing steps are the
+ * ones of murmurhash3 (x64 variant), which is a lot faster than feeding bytes to
+ * djb2 and spreads small differences (a slider moved by one step) over all bits.
+ *
+ * dt_hash64_add() and dt_hash64_add_data() can be chained to hash a sequence of
+ * values, dt_hash64_finish() should be applied before the result is used as a key.
+ */
+
+#define DT_HASH64_INIT 0x6a09e667f3bcc908ull
+
+static inline uint64_t dt_hash64_rotl(const uint64_t x, const int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+/** mixes one 64-bit value into hash. */
+static inline uint64_t dt_hash64_add(uint64_t hash, uint64_t value)
+{
+  value *= 0x87c37b91114253d5ull;
+  value = dt_hash64_rotl(value, 31);
+  value *= 0x4cf5ad432745937full;
+  hash ^= value;
+  hash = dt_hash64_rotl(hash, 27);
+  return hash*5 + 0x52dce729;
+}
+
+/** mixes size bytes at data into hash. */
+static inline uint64_t dt_hash64_add_data(uint64_t hash, const void *data, const size_t size)
+{
+  const uint8_t *c = (const uint8_t *)data;
+  size_t k = 0;
+  for(; k + 8 <= size; k += 8)
+  {
+    uint64_t value;
+    memcpy(&value, c + k, 8);
+    hash = dt_hash64_add(hash, value);
+  }
+  // the remaining bytes, along with the length so that trailing zeros count:
+  uint64_t tail = 0;
+  memcpy(&tail, c + k, size - k);
+  hash = dt_hash64_add(hash, tail);
+  return dt_hash64_add(hash, size);
+}
+
+/** final avalanche, every bit of the result depends on every bit of hash. */
+static inline uint64_t dt_hash64_finish(uint64_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/** hash of size bytes at data. */
+static inline uint64_t dt_hash64(const void *data, const size_t size)
+{
+  return dt_hash64_finish(dt_hash64_add_data(DT_HASH64_INIT, data, size));
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,185 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_COMMON_HISTOGRAM_H
+#define DT_COMMON_HISTOGRAM_H
+
+// histograms of 4-channel buffers, laid out as hist[4*bin + channel] like the ones
+// the modules and the histogram lib draw. every pixel is counted: each thread bins
+// into its own counters, which are summed up once in the end. header only, so that
+// src/tests/histogram.c can check it without linking darktable.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef enum dt_histogram_channels_t
+{
+  DT_HISTOGRAM_FIRST = 0,    // only the first channel (raw data)
+  DT_HISTOGRAM_RGB = 1,      // the first three channels
+  DT_HISTOGRAM_RGB_MAX = 2   // the first three channels, and the largest of their bins in the fourth
+}
+dt_histogram_channels_t;
+
+static inline int _dt_histogram_threads()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+static inline int _dt_histogram_thread()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+// sums up the per-thread counters into hist.
+static inline void _dt_histogram_merge(float *hist, const uint32_t *partial, const int threads, const int bins)
+{
+  for(int k=0; k<4*bins; k++)
+  {
+    uint32_t sum = 0;
+    for(int t=0; t<threads; t++) sum += partial[(size_t)t*4*bins + k];
+    hist[k] = sum;
+  }
+}
+
+// one row of dt_histogram_collect_f(), inlined with constant channels.
+static inline void _dt_histogram_row_f(uint32_t *h, const float *p, const int width, const __m128 add,
+                                       const __m128 mul, const __m128 last, const dt_histogram_channels_t channels)
+{
+  for(int i=0; i<width; i++, p+=4)
+  {
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p), add), mul);
+    // clamps nan to the first bin, too:
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), last);
+    // four times the bins, the offsets into h:
+    const __m128i b = _mm_slli_epi32(_mm_cvttps_epi32(v), 2);
+    const int b0 = _mm_cvtsi128_si32(b);
+    h[b0]++;
+    if(channels == DT_HISTOGRAM_FIRST) continue;
+    const int b1 = _mm_cvtsi128_si32(_mm_srli_si128(b, 4)), b2 = _mm_cvtsi128_si32(_mm_srli_si128(b, 8));
+    h[b1 + 1]++;
+    h[b2 + 2]++;
+    if(channels == DT_HISTOGRAM_RGB_MAX)
+    {
+      // the offsets are small and positive, so the 16-bit max of sse2 does. branch free, too,
+      // which keeps gcc -O3 from duplicating the loop tail for every outcome of the comparisons.
+      const __m128i m = _mm_max_epi16(_mm_max_epi16(b, _mm_srli_si128(b, 4)), _mm_srli_si128(b, 8));
+      h[_mm_cvtsi128_si32(m) + 3]++;
+    }
+  }
+}
+
+/**
+ * bins width x height pixels of 4 floats, rows stride floats apart, into hist (4*bins floats).
+ * channel c is counted in bin (in[c] + offset[c])*scale[c]*bins, clamped to the first and the last bin.
+ */
+static inline void dt_histogram_collect_f(float *hist, const int bins, const float *const in, const int width,
+                                          const int height, const size_t stride, const float *offset,
+                                          const float *scale, const dt_histogram_channels_t channels)
+{
+  memset(hist, 0, sizeof(float)*4*bins);
+  const int threads = _dt_histogram_threads();
+  uint32_t *partial = (uint32_t *)calloc((size_t)threads*4*bins, sizeof(uint32_t));
+  if(!partial) return;
+
+  const __m128 add = _mm_set_ps(0.0f, offset[2], offset[1], offset[0]);
+  const __m128 mul = _mm_set_ps(0.0f, scale[2]*bins, scale[1]*bins, scale[0]*bins);
+  const __m128 last = _mm_set1_ps(bins - 1);
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    uint32_t *h = partial + (size_t)_dt_histogram_thread()*4*bins;
+    const float *p = in + (size_t)j*stride;
+    switch(channels)
+    {
+      case DT_HISTOGRAM_FIRST:
+        _dt_histogram_row_f(h, p, width, add, mul, last, DT_HISTOGRAM_FIRST);
+        break;
+      case DT_HISTOGRAM_RGB:
+        _dt_histogram_row_f(h, p, width, add, mul, last, DT_HISTOGRAM_RGB);
+        break;
+      case DT_HISTOGRAM_RGB_MAX:
+        _dt_histogram_row_f(h, p, width, add, mul, last, DT_HISTOGRAM_RGB_MAX);
+        break;
+    }
+  }
+  _dt_histogram_merge(hist, partial, threads, bins);
+  free(partial);
+}
+
+/**
+ * bins the pixels of box (x0, y0, x1, y1, inclusive) of an 8-bit bgra buffer of the given width into
+ * hist (4*bins floats, bins <= 256), as red, green, blue and the largest of the three bins.
+ */
+static inline void dt_histogram_collect_8(float *hist, const int bins, const uint8_t *const in, const int width,
+                                          const int *box)
+{
+  memset(hist, 0, sizeof(float)*4*bins);
+  const int threads = _dt_histogram_threads();
+  uint32_t *partial = (uint32_t *)calloc((size_t)threads*4*bins, sizeof(uint32_t));
+  if(!partial) return;
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=box[1]; j<=box[3]; j++)
+  {
+    uint32_t *h = partial + (size_t)_dt_histogram_thread()*4*bins;
+    const uint8_t *p = in + 4*((size_t)j*width + box[0]);
+    for(int i=box[0]; i<=box[2]; i++, p+=4)
+    {
+      const int r = (p[2]*bins) >> 8, g = (p[1]*bins) >> 8, b = (p[0]*bins) >> 8;
+      h[4*r]++;
+      h[4*g + 1]++;
+      h[4*b + 2]++;
+      const int m = r > g ? (r > b ? r : b) : (g > b ? g : b);
+      h[4*m + 3]++;
+    }
+  }
+  _dt_histogram_merge(hist, partial, threads, bins);
+  free(partial);
+}
+
+/** largest count of channel ch in bins [first, last). */
+static inline float dt_histogram_max(const float *hist, const int ch, const int first, const int last)
+{
+  float max = 0.0f;
+  for(int k=first; k<last; k++) max = hist[4*k + ch] > max ? hist[4*k + ch] : max;
+  return max;
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
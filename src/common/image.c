@@ -20,11 +20,13 @@
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/exif.h"
+#include "common/folders.h"
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/grouping.h"
 #include "common/mipmap_cache.h"
+#include "common/sidecar_writer.h"
 #include "common/tags.h"
 #include "control/control.h"
 #include "control/conf.h"
@@ -216,6 +218,11 @@ void dt_image_path_append_version(int imgid, char *pathname, const int len)
   if(sqlite3_step(stmt) == SQLITE_ROW)
     version = sqlite3_column_int(stmt, 0);
   sqlite3_finalize(stmt);
+  dt_image_path_append_version_no_db(version, pathname, len);
+}
+
+void dt_image_path_append_version_no_db(int version, char *pathname, const int len)
+{
   if(version != 0)
   {
     // add version information:
@@ -343,16 +350,20 @@ int32_t dt_image_duplicate(const int32_t imgid)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "select a.id from images as a join images as b where "
+                              "select a.id, a.film_id from images as a join images as b where "
                               "a.film_id = b.film_id and a.filename = b.filename and "
                               "b.id = ?1 order by a.id desc", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  int32_t newid = -1;
+  int32_t newid = -1, film_id = -1;
   if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
     newid = sqlite3_column_int(stmt, 0);
+    film_id = sqlite3_column_int(stmt, 1);
+  }
   sqlite3_finalize(stmt);
   if(newid != -1)
   {
+    dt_folders_film_changed(film_id);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 "insert into color_labels (imgid, color) select ?1, color from "
                                 "color_labels where imgid = ?2", -1, &stmt, NULL);
@@ -382,6 +393,7 @@ int32_t dt_image_duplicate(const int32_t imgid)
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    dt_tag_index_invalidate();
     if(darktable.gui && darktable.gui->grouping)
     {
       const dt_image_t *img = dt_image_cache_read_get(darktable.image_cache, newid);
@@ -400,9 +412,11 @@ void dt_image_remove(const int32_t imgid)
   if (dt_image_local_copy_reset(imgid))
     return;
 
+  // called for every image when removing many, so statements are cached:
   sqlite3_stmt *stmt;
   const dt_image_t *img = dt_image_cache_read_get(darktable.image_cache, imgid);
   int old_group_id = img->group_id;
+  const int32_t film_id = img->film_id;
   dt_image_cache_read_release(darktable.image_cache, img);
 
   // make sure we remove from the cache first, or else the cache will look for imgid in sql
@@ -412,44 +426,45 @@ void dt_image_remove(const int32_t imgid)
   if(darktable.gui && darktable.gui->expanded_group_id == old_group_id)
     darktable.gui->expanded_group_id = new_group_id;
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from images where id = ?1", -1, &stmt, NULL);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from images where id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "update tagxtag set count = count - 1 where "
-                              "(id2 in (select tagid from tagged_images where imgid = ?1)) or "
-                              "(id1 in (select tagid from tagged_images where imgid = ?1))",
-                              -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  dt_folders_film_changed(film_id);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "update tagxtag set count = count - 1 where "
+                                    "(id2 in (select tagid from tagged_images where imgid = ?1)) or "
+                                    "(id1 in (select tagid from tagged_images where imgid = ?1))");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from tagged_images where imgid = ?1", -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  dt_tag_index_invalidate();
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from tagged_images where imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from history where imgid = ?1", -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from history where imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from color_labels where imgid = ?1", -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from color_labels where imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from meta_data where id = ?1", -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from meta_data where id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "delete from selected_images where imgid = ?1", -1, &stmt, NULL);
+  sqlite3_reset(stmt);
+  stmt = dt_database_prepare_cached(darktable.db,
+                                    "delete from selected_images where imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
   // also clear all thumbnails in mipmap_cache.
   dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
 }
@@ -558,6 +573,7 @@ uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean o
   rc = sqlite3_step(stmt);
   if (rc != SQLITE_DONE) fprintf(stderr, "sqlite3 error %d\n", rc);
   sqlite3_finalize(stmt);
+  dt_folders_film_changed(film_id);
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "select id from images where film_id = ?1 and filename = ?2",
@@ -829,11 +845,13 @@ int32_t dt_image_move(const int32_t imgid, const int32_t filmid)
       // then update database and cache
       // if update was performed in above loop, dt_image_path_append_version()
       // would return wrong version!
+      int32_t old_film_id = -1;
       while (dup_list)
       {
         long int id = GPOINTER_TO_INT(dup_list->data);
         const dt_image_t *cimg = dt_image_cache_read_get(darktable.image_cache, id);
         dt_image_t *img = dt_image_cache_write_get(darktable.image_cache, cimg);
+        old_film_id = img->film_id;
         img->film_id = filmid;
         // write through to db, but not to xmp
         dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
@@ -841,6 +859,8 @@ int32_t dt_image_move(const int32_t imgid, const int32_t filmid)
         dup_list = g_list_delete_link(dup_list, dup_list);
       }
       g_list_free(dup_list);
+      dt_folders_film_changed(old_film_id);
+      dt_folders_film_changed(filmid);
 
       // finaly, rename local copy if any
       if (g_file_test(copysrcpath, G_FILE_TEST_EXISTS))
@@ -942,6 +962,7 @@ int32_t dt_image_copy(const int32_t imgid, const int32_t filmid)
 
       if(newid != -1)
       {
+        dt_folders_film_changed(filmid);
         DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                     "insert into color_labels (imgid, color) select ?1, color from "
                                     "color_labels where imgid = ?2", -1, &stmt, NULL);
@@ -971,6 +992,7 @@ int32_t dt_image_copy(const int32_t imgid, const int32_t filmid)
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newid);
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
+        dt_tag_index_invalidate();
 
         // write xmp file
         dt_image_write_sidecar_file(newid);
@@ -1104,7 +1126,7 @@ void dt_image_synch_xmp(const int selected)
 {
   if(selected > 0)
   {
-    dt_image_write_sidecar_file(selected);
+    dt_sidecar_writer_queue(darktable.sidecar_writer, selected);
   }
   else if(dt_conf_get_bool("write_sidecar_files"))
   {
@@ -1114,7 +1136,7 @@ void dt_image_synch_xmp(const int selected)
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
       const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
+      dt_sidecar_writer_queue(darktable.sidecar_writer, imgid);
     }
     sqlite3_finalize(stmt);
   }
@@ -135,6 +135,8 @@ const char *dt_image_film_roll_name(const char *path);
 void dt_image_film_roll(const dt_image_t *img, char *pathname, int len);
 /** appends version numbering for duplicated images. */
 void dt_image_path_append_version(int imgid, char *pathname, const int len);
+/** same as above, but with the duplicate version already known, so no db access takes place. */
+void dt_image_path_append_version_no_db(int version, char *pathname, const int len);
 /** prints a one-line exif information string. */
 void dt_image_print_exif(const dt_image_t *img, char *line, int len);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. */
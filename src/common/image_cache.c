@@ -21,6 +21,7 @@
 #include "common/exif.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/sidecar_writer.h"
 #include "control/conf.h"
 #include "develop/develop.h"
 
@@ -225,13 +226,12 @@ dt_image_cache_write_release(
   dt_image_cache_write_mode_t mode)
 {
   if(img->id <= 0) return;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "update images set width = ?1, height = ?2, maker = ?3, model = ?4, "
-                              "lens = ?5, exposure = ?6, aperture = ?7, iso = ?8, focal_length = ?9, "
-                              "focus_distance = ?10, film_id = ?11, datetime_taken = ?12, flags = ?13, "
-                              "crop = ?14, orientation = ?15, raw_parameters = ?16, group_id = ?17, longitude = ?18, "
-                              "latitude = ?19, color_matrix = ?20, colorspace = ?21 where id = ?22", -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db,
+                       "update images set width = ?1, height = ?2, maker = ?3, model = ?4, "
+                       "lens = ?5, exposure = ?6, aperture = ?7, iso = ?8, focal_length = ?9, "
+                       "focus_distance = ?10, film_id = ?11, datetime_taken = ?12, flags = ?13, "
+                       "crop = ?14, orientation = ?15, raw_parameters = ?16, group_id = ?17, longitude = ?18, "
+                       "latitude = ?19, color_matrix = ?20, colorspace = ?21 where id = ?22");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img->width);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, img->height);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, img->exif_maker, strlen(img->exif_maker), SQLITE_STATIC);
@@ -256,14 +256,15 @@ dt_image_cache_write_release(
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 22, img->id);
   int rc = sqlite3_step(stmt);
   if (rc != SQLITE_DONE) fprintf(stderr, "[image_cache_write_release] sqlite3 error %d\n", rc);
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
 
   // TODO: make this work in relaxed mode, too.
   if(mode == DT_IMAGE_CACHE_SAFE)
   {
     // rest about sidecars:
-    // also synch dttags file:
-    dt_image_write_sidecar_file(img->id);
+    // also synch dttags file. this is done in the background,
+    // repeated changes to the same image are only written once.
+    dt_sidecar_writer_queue(darktable.sidecar_writer, img->id);
   }
   dt_cache_write_release(&cache->cache, img->id);
 }
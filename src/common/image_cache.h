@@ -79,7 +79,7 @@ dt_image_cache_write_get(
 
 // drops the write privileges on an image struct.
 // this triggers a write-through to sql, and if the setting
-// is present, also to xmp sidecar files (safe setting).
+// is present, also queues a write of the xmp sidecar file (safe setting).
 void
 dt_image_cache_write_release(
   dt_image_cache_t *cache,
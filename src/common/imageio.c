@@ -25,6 +25,7 @@
 #include "common/exif.h"
 #include "common/image_cache.h"
 #include "common/imageio.h"
+#include "common/imageio_deflate.h"
 #include "common/imageio_module.h"
 #include "common/imageio_exr.h"
 #ifdef HAVE_OPENJPEG
@@ -505,14 +506,15 @@ int dt_imageio_export(
   const char                 *filename,
   dt_imageio_module_format_t *format,
   dt_imageio_module_data_t   *format_params,
-  const gboolean              high_quality)
+  const gboolean              high_quality,
+  const gboolean              demosaic_half_size)
 {
   if (strcmp(format->mime(format_params),"x-copy")==0)
     /* This is a just a copy, skip process and just export */
     return format->write_image(format_params, filename, NULL, NULL, 0, imgid);
   else
     return dt_imageio_export_with_flags(imgid, filename, format, format_params,
-                                        0, 0, high_quality, 0, NULL);
+                                        0, 0, high_quality, demosaic_half_size, 0, NULL);
 }
 
 // internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
@@ -524,6 +526,7 @@ int dt_imageio_export_with_flags(
   const int32_t               ignore_exif,
   const int32_t               display_byteorder,
   const gboolean              high_quality,
+  const gboolean              demosaic_half_size,
   const int32_t               thumbnail_export,
   const char                 *filter)
 {
@@ -608,6 +611,7 @@ int dt_imageio_export_with_flags(
     }
   }
 
+  pipe.demosaic_half_size = demosaic_half_size;
   dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, 1.0);
   dt_dev_pixelpipe_create_nodes(&pipe, &dev);
   dt_dev_pixelpipe_synch_all(&pipe, &dev);
@@ -705,17 +709,8 @@ int dt_imageio_export_with_flags(
     // ldr output: char
     if(high_quality_processing)
     {
-      const float *const inbuf = (float *)outbuf;
-      for(int k=0; k<processed_width*processed_height; k++)
-      {
-        // convert in place, this is unfortunately very serial..
-        const uint8_t r = CLAMP(inbuf[4*k+0]*0xff, 0, 0xff);
-        const uint8_t g = CLAMP(inbuf[4*k+1]*0xff, 0, 0xff);
-        const uint8_t b = CLAMP(inbuf[4*k+2]*0xff, 0, 0xff);
-        outbuf[4*k+0] = r;
-        outbuf[4*k+1] = g;
-        outbuf[4*k+2] = b;
-      }
+      // convert in place, this is unfortunately very serial, but at least sse:
+      dt_imageio_float_to_8((const float *)outbuf, outbuf, (size_t)processed_width*processed_height);
     }
     else
     {
@@ -734,21 +729,38 @@ int dt_imageio_export_with_flags(
   }
   else if(bpp == 16)
   {
-    // uint16_t per color channel
-    float    *buff  = (float *)   outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y=0; y<processed_height; y++) for(int x=0; x<processed_width ; x++)
-      {
-        // convert in place
-        const int k = x + processed_width*y;
-        for(int i=0; i<3; i++) buf16[4*k+i] = CLAMP(buff[4*k+i]*0x10000, 0, 0xffff);
-      }
+    // uint16_t per color channel, converted in place
+    dt_imageio_float_to_16((const float *)outbuf, (uint16_t *)outbuf, (size_t)processed_width*processed_height);
   }
   // else output float, no further harm done to the pixels :)
 
   format_params->width  = processed_width;
   format_params->height = processed_height;
 
+  // the pixels are final. for real exports, hand the pipe and the full input buffer back before
+  // encoding and writing, which take long: the export decodes the next images into these meanwhile.
+  gboolean released = FALSE;
+  if(!thumbnail_export)
+  {
+    if(outbuf == pipe.backbuf)
+    {
+      const size_t bufsize = (size_t)processed_width*processed_height*(bpp == 8 ? 4 : 4*sizeof(float));
+      moutbuf = (uint8_t *)dt_alloc_align(64, bufsize);
+      if(moutbuf)
+      {
+        memcpy(moutbuf, pipe.backbuf, bufsize);
+        outbuf = moutbuf;
+      }
+    }
+    if(outbuf != pipe.backbuf)
+    {
+      dt_dev_pixelpipe_cleanup(&pipe);
+      dt_dev_cleanup(&dev);
+      dt_mipmap_cache_read_release(darktable.mipmap_cache, &buf);
+      released = TRUE;
+    }
+  }
+
   if(!ignore_exif)
   {
     int length;
@@ -766,9 +778,12 @@ int dt_imageio_export_with_flags(
     res = format->write_image (format_params, filename, outbuf, NULL, 0, imgid);
   }
 
-  dt_dev_pixelpipe_cleanup(&pipe);
-  dt_dev_cleanup(&dev);
-  dt_mipmap_cache_read_release(darktable.mipmap_cache, &buf);
+  if(!released)
+  {
+    dt_dev_pixelpipe_cleanup(&pipe);
+    dt_dev_cleanup(&dev);
+    dt_mipmap_cache_read_release(darktable.mipmap_cache, &buf);
+  }
   free(moutbuf);
 
   if(!thumbnail_export)
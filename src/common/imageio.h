@@ -58,7 +58,8 @@ dt_imageio_export(
   const char *filename,
   struct dt_imageio_module_format_t *format,
   struct dt_imageio_module_data_t *format_params,
-  const gboolean high_quality);
+  const gboolean high_quality,
+  const gboolean demosaic_half_size);
 
 int
 dt_imageio_export_with_flags(
@@ -69,6 +70,7 @@ dt_imageio_export_with_flags(
   const int32_t                      ignore_exif,
   const int32_t                      display_byteorder,
   const gboolean                     high_quality,
+  const gboolean                     demosaic_half_size,
   const int32_t                      thumbnail_export,
   const char                        *filter);
 
@@ -0,0 +1,267 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_IMAGEIO_DEFLATE_H
+#define DT_IMAGEIO_DEFLATE_H
+
+// helpers for the output formats: parallel deflate and png row filtering, as well
+// as the sse conversion of the pipeline output to integers. header only, so the
+// format plugins and src/tests/encode.c can use them without linking darktable.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+/** input bytes per independently compressed deflate block. */
+#define DT_IMAGEIO_DEFLATE_BLOCK (256*1024)
+/** history carried over from the previous block, the full deflate window. */
+#define DT_IMAGEIO_DEFLATE_WINDOW 32768
+
+/**
+ * compresses len bytes into one zlib stream, using all threads.
+ * like pigz, the input is cut into blocks which are deflated independently (primed with
+ * the preceding 32k as dictionary, so the ratio hardly suffers), byte aligned with sync
+ * flushes and concatenated. the adler32 checksums of the blocks are combined at the end.
+ * returns a malloc'ed buffer and its size in out_len, NULL on failure.
+ */
+static inline uint8_t *dt_imageio_deflate(const uint8_t *in, const size_t len, const int level, size_t *out_len)
+{
+  const size_t block = DT_IMAGEIO_DEFLATE_BLOCK;
+  const int n = len ? (len + block - 1)/block : 1;
+  uint8_t **part = (uint8_t **)calloc(n, sizeof(uint8_t *));
+  size_t *part_len = (size_t *)calloc(n, sizeof(size_t));
+  uLong *adler = (uLong *)calloc(n, sizeof(uLong));
+  uint8_t *out = NULL;
+  int err = !part || !part_len || !adler;
+
+  if(!err)
+  {
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) reduction(|:err)
+#endif
+    for(int k=0; k<n; k++)
+    {
+      const size_t off = k*block;
+      const size_t l = len - off < block ? len - off : block;
+      z_stream s;
+      memset(&s, 0, sizeof(s));
+      // raw deflate, header and trailer are written for the whole stream below:
+      if(deflateInit2(&s, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        err |= 1;
+        continue;
+      }
+      if(off)
+      {
+        const size_t dict = off < DT_IMAGEIO_DEFLATE_WINDOW ? off : DT_IMAGEIO_DEFLATE_WINDOW;
+        deflateSetDictionary(&s, in + off - dict, dict);
+      }
+      // leave room for the sync flush marker:
+      const size_t cap = deflateBound(&s, l) + 16;
+      part[k] = (uint8_t *)malloc(cap);
+      if(!part[k])
+      {
+        deflateEnd(&s);
+        err |= 1;
+        continue;
+      }
+      s.next_in = (Bytef *)(in + off);
+      s.avail_in = l;
+      s.next_out = part[k];
+      s.avail_out = cap;
+      // only the last block may set the final bit:
+      const int last = (k == n-1);
+      const int ret = deflate(&s, last ? Z_FINISH : Z_SYNC_FLUSH);
+      if((last && ret != Z_STREAM_END) || (!last && ret != Z_OK) || s.avail_in) err |= 1;
+      part_len[k] = cap - s.avail_out;
+      deflateEnd(&s);
+      adler[k] = adler32(adler32(0L, Z_NULL, 0), in + off, l);
+    }
+  }
+
+  if(!err)
+  {
+    size_t total = 6;
+    for(int k=0; k<n; k++) total += part_len[k];
+    out = (uint8_t *)malloc(total);
+  }
+  if(out)
+  {
+    // zlib header: deflate with 32k window, and the level hint zlib itself would write.
+    const int cmf = 0x78;
+    const int flevel = level == Z_DEFAULT_COMPRESSION ? 2 : level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    int flg = flevel << 6;
+    flg += 31 - (cmf*256 + flg) % 31;
+    uint8_t *o = out;
+    *o++ = cmf;
+    *o++ = flg;
+    uLong sum = adler[0];
+    for(int k=0; k<n; k++)
+    {
+      memcpy(o, part[k], part_len[k]);
+      o += part_len[k];
+      if(k)
+      {
+        const size_t l = len - k*block < block ? len - k*block : block;
+        sum = adler32_combine(sum, adler[k], l);
+      }
+    }
+    *o++ = sum >> 24;
+    *o++ = sum >> 16;
+    *o++ = sum >> 8;
+    *o++ = sum;
+    *out_len = o - out;
+  }
+
+  if(part) for(int k=0; k<n; k++) free(part[k]);
+  free(part);
+  free(part_len);
+  free(adler);
+  return out;
+}
+
+static inline int _dt_imageio_png_paeth(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  if(pb <= pc) return b;
+  return c;
+}
+
+/**
+ * prepares the png idat data: every row of rowbytes bytes from in is written to out
+ * prefixed by its filter type byte (out needs height*(rowbytes+1) bytes). per row the
+ * filter with the smallest sum of absolute differences is picked, the same heuristic
+ * libpng uses. bpp is the number of bytes per pixel. rows are filtered in parallel.
+ */
+static inline void dt_imageio_png_filter(const uint8_t *in, uint8_t *out, const int height, const size_t rowbytes, const int bpp)
+{
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    const uint8_t *row = in + j*rowbytes;
+    const uint8_t *up = j ? row - rowbytes : NULL;
+    uint8_t *o = out + j*(rowbytes+1);
+
+    // sum up the costs of all five filters in one go:
+    uint64_t cost[5] = { 0 };
+    for(size_t i=0; i<rowbytes; i++)
+    {
+      const int x = row[i];
+      const int a = i >= (size_t)bpp ? row[i-bpp] : 0;
+      const int b = up ? up[i] : 0;
+      const int c = (up && i >= (size_t)bpp) ? up[i-bpp] : 0;
+      cost[0] += abs((int8_t)x);
+      cost[1] += abs((int8_t)(x - a));
+      cost[2] += abs((int8_t)(x - b));
+      cost[3] += abs((int8_t)(x - ((a + b) >> 1)));
+      cost[4] += abs((int8_t)(x - _dt_imageio_png_paeth(a, b, c)));
+    }
+    int f = 0;
+    for(int k=1; k<5; k++) if(cost[k] < cost[f]) f = k;
+
+    o[0] = f;
+    o++;
+    for(size_t i=0; i<rowbytes; i++)
+    {
+      const int x = row[i];
+      const int a = i >= (size_t)bpp ? row[i-bpp] : 0;
+      const int b = up ? up[i] : 0;
+      const int c = (up && i >= (size_t)bpp) ? up[i-bpp] : 0;
+      switch(f)
+      {
+        case 0: o[i] = x; break;
+        case 1: o[i] = x - a; break;
+        case 2: o[i] = x - b; break;
+        case 3: o[i] = x - ((a + b) >> 1); break;
+        default: o[i] = x - _dt_imageio_png_paeth(a, b, c); break;
+      }
+    }
+  }
+}
+
+/**
+ * converts n rgba float pixels in [0,1] to 8 bit, clamped and truncated like
+ * CLAMP(x*0xff, 0, 0xff). alpha is left alone. may work in place (out == in),
+ * which is also why this runs serially.
+ */
+static inline void dt_imageio_float_to_8(const float *in, uint8_t *out, const size_t n)
+{
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 zero = _mm_setzero_ps();
+  size_t k = 0;
+  for(; k+4<=n; k+=4)
+  {
+    // load all four pixels before anything gets written, for the in place case:
+    __m128i p[4];
+    for(int i=0; i<4; i++)
+      p[i] = _mm_cvttps_epi32(_mm_min_ps(scale, _mm_max_ps(zero, _mm_mul_ps(scale, _mm_loadu_ps(in + 4*(k+i))))));
+    const __m128i p16 = _mm_packs_epi32(p[0], p[1]);
+    const __m128i q16 = _mm_packs_epi32(p[2], p[3]);
+    uint8_t px[16] __attribute__((aligned(16)));
+    _mm_store_si128((__m128i *)px, _mm_packus_epi16(p16, q16));
+    for(int i=0; i<4; i++) for(int c=0; c<3; c++) out[4*(k+i)+c] = px[4*i+c];
+  }
+  for(; k<n; k++)
+  {
+    uint8_t px[3];
+    for(int c=0; c<3; c++) px[c] = fminf(255.0f, fmaxf(0.0f, in[4*k+c]*255.0f));
+    for(int c=0; c<3; c++) out[4*k+c] = px[c];
+  }
+}
+
+/**
+ * converts n rgba float pixels in [0,1] to 16 bit, clamped and truncated like
+ * CLAMP(x*0x10000, 0, 0xffff). alpha is left alone. may work in place.
+ */
+static inline void dt_imageio_float_to_16(const float *in, uint16_t *out, const size_t n)
+{
+  const __m128 scale = _mm_set1_ps(65536.0f);
+  const __m128 max = _mm_set1_ps(65535.0f);
+  const __m128 zero = _mm_setzero_ps();
+  // sse2 has no unsigned 32->16 bit pack, so shift into the signed range and back:
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(-32768);
+  size_t k = 0;
+  for(; k+2<=n; k+=2)
+  {
+    __m128i p[2];
+    for(int i=0; i<2; i++)
+      p[i] = _mm_sub_epi32(_mm_cvttps_epi32(_mm_min_ps(max, _mm_max_ps(zero, _mm_mul_ps(scale, _mm_loadu_ps(in + 4*(k+i)))))), bias32);
+    uint16_t px[8] __attribute__((aligned(16)));
+    _mm_store_si128((__m128i *)px, _mm_xor_si128(_mm_packs_epi32(p[0], p[1]), bias16));
+    for(int i=0; i<2; i++) for(int c=0; c<3; c++) out[4*(k+i)+c] = px[4*i+c];
+  }
+  for(; k<n; k++)
+  {
+    uint16_t px[3];
+    for(int c=0; c<3; c++) px[c] = fminf(65535.0f, fmaxf(0.0f, in[4*k+c]*65536.0f));
+    for(int c=0; c<3; c++) out[4*k+c] = px[c];
+  }
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -27,7 +27,7 @@ extern "C"
 	void gui_init    (struct dt_imageio_module_storage_t *self);
 	void gui_cleanup (struct dt_imageio_module_storage_t *self);
 	void init    (struct dt_imageio_module_storage_t *self);
-	int store(struct dt_imageio_module_storage_t *self,struct dt_imageio_module_data_t *self_data, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality);
+	int store(struct dt_imageio_module_storage_t *self,struct dt_imageio_module_data_t *self_data, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size);
 	size_t params_size   (struct dt_imageio_module_storage_t *self);
 	void* get_params   (struct dt_imageio_module_storage_t *self);
 	void  free_params  (struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data);
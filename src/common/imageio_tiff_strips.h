@@ -0,0 +1,101 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_IMAGEIO_TIFF_STRIPS_H
+#define DT_IMAGEIO_TIFF_STRIPS_H
+
+// writes the strips of the tiff output on all cores. header only, so that
+// src/tests/encode.c can write and read back a tiff without linking darktable.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <tiffio.h>
+#include <zlib.h>
+
+/** number of strips compressed in parallel before they are written. */
+#define DT_TIFFIO_BATCH 64
+
+/**
+ * writes the rgb channels of width x height pixels of 4 channels (uint8_t or uint16_t,
+ * as given by bpp) as deflated strips of rows_per_strip rows to tif, which has to be
+ * set up for that already. the strips are deflated on all cores, a batch at a time to
+ * keep the memory bounded, and written in order as raw strips. these bypass libtiff's
+ * encoder, so 16-bit samples are swapped here if the file byte order isn't the native one.
+ * returns 0 on success.
+ */
+static inline int dt_imageio_tiff_write_strips(TIFF *tif, const void *in, const int width, const int height,
+                                               const int bpp, const int rows_per_strip, const int level)
+{
+  const int bytes = bpp == 16 ? sizeof(uint16_t) : sizeof(uint8_t);
+  const int swab = bpp == 16 && TIFFIsByteSwapped(tif);
+  const size_t rowsize = (size_t)width*3*bytes;
+  const int strips = (height + rows_per_strip - 1)/rows_per_strip;
+  uint8_t *zdata[DT_TIFFIO_BATCH];
+  uLongf zlength[DT_TIFFIO_BATCH];
+  int err = 0;
+  for(int s0=0; s0<strips && !err; s0+=DT_TIFFIO_BATCH)
+  {
+    const int n = strips - s0 < DT_TIFFIO_BATCH ? strips - s0 : DT_TIFFIO_BATCH;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) reduction(|:err)
+#endif
+    for(int i=0; i<n; i++)
+    {
+      const int y0 = (s0+i)*rows_per_strip;
+      const int rows = height - y0 < rows_per_strip ? height - y0 : rows_per_strip;
+      const size_t size = rowsize*rows;
+      uint8_t *stripdata = (uint8_t *)malloc(size);
+      zlength[i] = compressBound(size);
+      zdata[i] = (uint8_t *)malloc(zlength[i]);
+      if(!stripdata || !zdata[i])
+      {
+        err |= 1;
+        free(stripdata);
+        continue;
+      }
+      if(bpp == 16)
+      {
+        const uint16_t *in16 = (const uint16_t *)in;
+        uint16_t *wdata = (uint16_t *)stripdata;
+        for(int y=y0; y<y0+rows; y++) for(int x=0; x<width; x++) for(int k=0; k<3; k++)
+              *(wdata++) = in16[4*(size_t)width*y + 4*x + k];
+        if(swab) TIFFSwabArrayOfShort((uint16_t *)stripdata, size/sizeof(uint16_t));
+      }
+      else
+      {
+        const uint8_t *in8 = (const uint8_t *)in;
+        uint8_t *wdata = stripdata;
+        for(int y=y0; y<y0+rows; y++) for(int x=0; x<width; x++) for(int k=0; k<3; k++)
+              *(wdata++) = in8[4*(size_t)width*y + 4*x + k];
+      }
+      if(compress2(zdata[i], &zlength[i], stripdata, size, level) != Z_OK) err |= 1;
+      free(stripdata);
+    }
+    for(int i=0; i<n; i++)
+    {
+      if(!err && TIFFWriteRawStrip(tif, s0+i, zdata[i], zlength[i]) < 0) err = 1;
+      free(zdata[i]);
+    }
+  }
+  return err;
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -18,10 +18,12 @@
 
 #include "common/darktable.h"
 #include "common/interpolation.h"
+#include "common/resample.h"
 #include "control/conf.h"
 
 #include <math.h>
 #include <stddef.h>
+#include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <glib.h>
@@ -1268,6 +1270,155 @@ prepare_resampling_plan(
   return 0;
 }
 
+/** number of resampling plans kept around. the same sizes are asked for over and
+ * over again (every pipe run, every thumbnail of an export), and building the
+ * plans evaluates the kernel for every tap. */
+#define RESAMPLING_PLAN_CACHE 16
+
+typedef struct resampling_plan_t
+{
+  enum dt_interpolation_type itor;
+  int in, in_x0, out, out_x0;
+  float scale;
+  dt_resample_plan_t plan;
+  int users;
+  int cached;
+  uint64_t used;
+}
+resampling_plan_t;
+
+static resampling_plan_t plan_cache[RESAMPLING_PLAN_CACHE];
+static uint64_t plan_cache_tick = 0;
+static GStaticMutex plan_cache_mutex = G_STATIC_MUTEX_INIT;
+
+static inline int
+plan_matches(
+  const resampling_plan_t *p,
+  const struct dt_interpolation* itor,
+  const int in,
+  const int in_x0,
+  const int out,
+  const int out_x0,
+  const float scale)
+{
+  return p->plan.length && p->itor == itor->id && p->in == in && p->in_x0 == in_x0
+         && p->out == out && p->out_x0 == out_x0 && p->scale == scale;
+}
+
+/** returns a resampling plan from the cache, or builds it. has to be given back
+ * with release_resampling_plan(). NULL on failure. */
+static resampling_plan_t *
+get_resampling_plan(
+  const struct dt_interpolation* itor,
+  const int in,
+  const int in_x0,
+  const int out,
+  const int out_x0,
+  const float scale)
+{
+  g_static_mutex_lock(&plan_cache_mutex);
+  for (int k=0; k<RESAMPLING_PLAN_CACHE; k++)
+  {
+    resampling_plan_t *p = plan_cache + k;
+    if (plan_matches(p, itor, in, in_x0, out, out_x0, scale))
+    {
+      p->users++;
+      p->used = ++plan_cache_tick;
+      g_static_mutex_unlock(&plan_cache_mutex);
+      return p;
+    }
+  }
+  g_static_mutex_unlock(&plan_cache_mutex);
+
+  // Not there, build it without holding the lock
+  dt_resample_plan_t plan;
+  plan.out = out;
+  if (prepare_resampling_plan(itor, in, in_x0, out, out_x0, scale, &plan.length, &plan.kernel, &plan.index, &plan.meta))
+  {
+    return NULL;
+  }
+
+  g_static_mutex_lock(&plan_cache_mutex);
+  resampling_plan_t *victim = NULL;
+  for (int k=0; k<RESAMPLING_PLAN_CACHE; k++)
+  {
+    resampling_plan_t *p = plan_cache + k;
+    if (plan_matches(p, itor, in, in_x0, out, out_x0, scale))
+    {
+      // Another thread was faster
+      p->users++;
+      p->used = ++plan_cache_tick;
+      g_static_mutex_unlock(&plan_cache_mutex);
+      free(plan.length);
+      return p;
+    }
+    if (!p->users && (!victim || p->used < victim->used))
+    {
+      victim = p;
+    }
+  }
+  if (victim)
+  {
+    free(victim->plan.length);
+    victim->cached = 1;
+  }
+  else
+  {
+    // All slots in use, this one is private to the caller
+    victim = (resampling_plan_t*)malloc(sizeof(resampling_plan_t));
+    victim->cached = 0;
+  }
+  victim->itor = itor->id;
+  victim->in = in;
+  victim->in_x0 = in_x0;
+  victim->out = out;
+  victim->out_x0 = out_x0;
+  victim->scale = scale;
+  victim->plan = plan;
+  victim->users = 1;
+  victim->used = ++plan_cache_tick;
+  g_static_mutex_unlock(&plan_cache_mutex);
+  return victim;
+}
+
+static void
+release_resampling_plan(
+  resampling_plan_t *p)
+{
+  if (!p)
+  {
+    return;
+  }
+  g_static_mutex_lock(&plan_cache_mutex);
+  p->users--;
+  const int drop = !p->cached;
+  g_static_mutex_unlock(&plan_cache_mutex);
+  if (drop)
+  {
+    /* The length array is in fact the only memory allocated, see
+     * prepare_resampling_plan() */
+    free(p->plan.length);
+    free(p);
+  }
+}
+
+void
+dt_interpolation_cleanup()
+{
+  g_static_mutex_lock(&plan_cache_mutex);
+  for (int k=0; k<RESAMPLING_PLAN_CACHE; k++)
+  {
+    resampling_plan_t *p = plan_cache + k;
+    // No pipe should be running anymore, leave plans still in use alone anyway
+    if (!p->users)
+    {
+      free(p->plan.length);
+      memset(p, 0, sizeof(resampling_plan_t));
+    }
+  }
+  g_static_mutex_unlock(&plan_cache_mutex);
+}
+
 void
 dt_interpolation_resample(
   const struct dt_interpolation* itor,
@@ -1278,15 +1429,8 @@ dt_interpolation_resample(
   const dt_iop_roi_t* const roi_in,
   const int32_t in_stride)
 {
-  int* hindex = NULL;
-  int* hlength = NULL;
-  float* hkernel = NULL;
-  int* vindex = NULL;
-  int* vlength = NULL;
-  float* vkernel = NULL;
-  int* vmeta = NULL;
-
-  int r;
+  resampling_plan_t* hplan = NULL;
+  resampling_plan_t* vplan = NULL;
 
   debug_info(
     "resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n",
@@ -1325,15 +1469,15 @@ dt_interpolation_resample(
   int64_t ts_plan = getts();
 #endif
 
-  // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale, &hlength, &hkernel, &hindex, NULL);
-  if (r)
+  // Fetch the resampling plans, usually they have been computed before
+  hplan = get_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale);
+  if (!hplan)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale, &vlength, &vkernel, &vindex, &vmeta);
-  if (r)
+  vplan = get_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale);
+  if (!vplan)
   {
     goto exit;
   }
@@ -1346,93 +1490,22 @@ dt_interpolation_resample(
   int64_t ts_resampling = getts();
 #endif
 
-  // Process each output line
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) shared(out, hindex, hlength, hkernel, vindex, vlength, vkernel, vmeta)
-#endif
-  for (int oy=0; oy<roi_out->height; oy++)
+  /* Separable resampling: first along the lines, then along the columns,
+   * band by band so the intermediate lines stay in cache */
+  if (dt_resample_separable(out, out_stride, in, in_stride, &hplan->plan, &vplan->plan))
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3*oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3*oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3*oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-    int hiidx = 0; // H(orizontal) I(ndex) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for (int ox=0; ox < roi_out->width; ox++)
-    {
-      debug_extra("output %p [% 4d % 4d]\n", out, ox, oy);
-
-      // This will hold the resulting pixel
-      __m128 vs = _mm_setzero_ps();
-
-      // Number of horizontal samples contributing to the output
-      int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for (int iy=0; iy < vl; iy++)
-      {
-        // This is our input line
-        const float* i = (float*)((char*)in + in_stride*vindex[viidx++]);
-
-        __m128 vhs = _mm_setzero_ps();
-
-        for (int ix=0; ix< hl; ix++)
-        {
-          // Apply the precomputed filter kernel
-          int baseidx = hindex[hiidx++]*4;
-          float htap = hkernel[hkidx++];
-          __m128 vhtap = _mm_set_ps1(htap);
-          vhs = _mm_add_ps(vhs, _mm_mul_ps(*(__m128*)&i[baseidx], vhtap));
-        }
-
-        // Accumulate contribution from this line
-        float vtap = vkernel[vkidx++];
-        __m128 vvtap = _mm_set_ps1(vtap);
-        vs = _mm_add_ps(vs, _mm_mul_ps(vhs, vvtap));
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-        hiidx -= hl;
-      }
-
-      // Output pixel is ready
-      float* o = (float*)((char*)out + oy*out_stride + ox*4*sizeof(float));
-      _mm_stream_ps(o, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hiidx += hl;
-      hkidx += hl;
-    }
-
-    // Progress in vertical context
-    viidx += vl;
-    vkidx += vl;
+    fprintf(stderr, "[resampling] could not allocate the line buffers for %dx%d pixels\n", roi_out->width, roi_out->height);
+    goto exit;
   }
 
-  _mm_sfence();
-
 #if DEBUG_RESAMPLING_TIMING
   ts_resampling = getts() - ts_resampling;
   fprintf(stderr, "resampling %p plan:%"PRId64"us resampling:%"PRId64"us\n", in, ts_plan, ts_resampling);
 #endif
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  free(hlength);
-  free(vlength);
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
 }
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
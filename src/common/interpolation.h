@@ -152,6 +152,10 @@ dt_interpolation_resample(
   const dt_iop_roi_t* const roi_in,
   const int32_t in_stride);
 
+/** Frees the cached resampling plans, called on shutdown. */
+void
+dt_interpolation_cleanup();
+
 #endif /* INTERPOLATION_H */
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -254,7 +254,7 @@ exit:
   return r;
 }
 
-static int
+int
 dt_mipmap_cache_serialize(dt_mipmap_cache_t *cache)
 {
   gchar dbfilename[DT_MAX_PATH_LEN];
@@ -272,11 +272,15 @@ dt_mipmap_cache_serialize(dt_mipmap_cache_t *cache)
   // only store smallest thumbs.
   const dt_mipmap_size_t mip = DT_MIPMAP_2;
 
+  // write to a temporary file first, so an interrupted run leaves the last complete cache behind:
+  gchar tmpfilename[DT_MAX_PATH_LEN];
+  snprintf(tmpfilename, sizeof(tmpfilename), "%s.tmp", dbfilename);
+
   _iterate_data_t d;
   d.f = NULL;
   d.blob = (uint8_t *)malloc(cache->mip[mip].buffer_size);
   int written = 0;
-  FILE *f = fopen(dbfilename, "wb");
+  FILE *f = fopen(tmpfilename, "wb");
   if(!f) goto write_error;
   d.f = f;
   // fprintf(stderr, "[mipmap_cache] serializing to `%s'\n", dbfilename);
@@ -307,12 +311,17 @@ dt_mipmap_cache_serialize(dt_mipmap_cache_t *cache)
   }
 
   free(d.blob);
-  fclose(f);
+  if(fclose(f) || g_rename(tmpfilename, dbfilename))
+  {
+    f = NULL;
+    goto write_error;
+  }
   return 0;
 
 write_error:
   fprintf(stderr, "[mipmap_cache] serialization to `%s' failed!\n", dbfilename);
   if(f) fclose(f);
+  g_unlink(tmpfilename);
   free(d.blob);
   return 1;
 }
@@ -465,6 +474,7 @@ read_finalize:
 
 static void _init_f(float   *buf, uint32_t *width, uint32_t *height, const uint32_t imgid);
 static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint32_t imgid, const dt_mipmap_size_t size);
+static void _init_8_cascade(dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip, const uint8_t *in, const uint32_t wd, const uint32_t ht);
 
 static int32_t
 scratchmem_allocate(void *data, const uint32_t key, int32_t *cost, void **buf)
@@ -724,7 +734,9 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
   }
 
   // full buffer needs dynamic alloc:
-  const int full_entries = MAX(2, parallel); // even with one thread you want two buffers. one for dr one for thumbs.
+  // even with one thread you want two buffers. one for dr one for thumbs.
+  // the export decodes a few images ahead, these need room too:
+  const int full_entries = MAX(2, parallel) + CLAMP(dt_conf_get_int("parallel_export_prefetch"), 0, 4);
   int32_t max_mem_bufs = nearest_power_of_two(full_entries);
 
   // for this buffer, because it can be very busy during import, we want the minimum
@@ -945,12 +957,17 @@ dt_mipmap_cache_read_get(
           // 8-bit thumbs, possibly need to be compressed:
           if(cache->compression_type)
           {
-            // get per-thread temporary storage without malloc from a separate cache:
-            const int key = dt_control_get_threadid();
+            // get per-thread temporary storage without malloc from a separate cache.
+            // threads which aren't control workers (openmp threads of darktable-generate-cache) go by their openmp number:
+            int key = dt_control_get_threadid();
+#ifdef _OPENMP
+            if(key == darktable.control->num_threads) key += omp_get_thread_num();
+#endif
             // const void *cbuf =
             dt_cache_read_get(&cache->scratchmem.cache, key);
             uint8_t *scratchmem = (uint8_t *)dt_cache_write_get(&cache->scratchmem.cache, key);
             _init_8(scratchmem, &dsc->width, &dsc->height, imgid, mip);
+            _init_8_cascade(cache, imgid, mip, scratchmem, dsc->width, dsc->height);
             buf->width  = dsc->width;
             buf->height = dsc->height;
             buf->imgid  = imgid;
@@ -963,6 +980,7 @@ dt_mipmap_cache_read_get(
           else
           {
             _init_8((uint8_t *)(dsc+1), &dsc->width, &dsc->height, imgid, mip);
+            _init_8_cascade(cache, imgid, mip, (uint8_t *)(dsc+1), dsc->width, dsc->height);
           }
         }
         dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
@@ -1266,6 +1284,9 @@ _init_8(
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        // no need to decode more pixels than the mip will hold:
+        if(orientation & 4) dt_imageio_jpeg_set_scale(&jpg, ht, wd);
+        else                dt_imageio_jpeg_set_scale(&jpg, wd, ht);
         uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t)*jpg.width*jpg.height*4);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
         {
@@ -1296,6 +1317,8 @@ _init_8(
         // JPEG: decode (directly rescaled to mip4)
         dt_imageio_jpeg_t jpg;
         if(dt_imageio_jpeg_decompress_header(image->data, image->data_size, &jpg)) goto libraw_fail;
+        if(orientation & 4) dt_imageio_jpeg_set_scale(&jpg, ht, wd);
+        else                dt_imageio_jpeg_set_scale(&jpg, wd, ht);
         uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t)*jpg.width*jpg.height*4);
         if(dt_imageio_jpeg_decompress(&jpg, tmp))
         {
@@ -1335,7 +1358,7 @@ libraw_fail:
     dat.head.max_height = ht;
     dat.buf = buf;
     // export with flags: ignore exif (don't load from disk), don't swap byte order, don't do hq processing, and signal we want thumbnail export
-    res = dt_imageio_export_with_flags(imgid, "unused", &format, (dt_imageio_module_data_t *)&dat, 1, 1, 0, 1, NULL);
+    res = dt_imageio_export_with_flags(imgid, "unused", &format, (dt_imageio_module_data_t *)&dat, 1, 1, 0, 0, 1, NULL);
     if(!res)
     {
       // might be smaller, or have a different aspect than what we got as input.
@@ -1361,6 +1384,113 @@ libraw_fail:
 }
 
 // compression stuff: alloc a buffer if needed
+// area averaging downscale of an 8-bit thumbnail to fit into ow x oh.
+static void
+_downsample_8(
+  const uint8_t *in,
+  const uint32_t iw,
+  const uint32_t ih,
+  uint8_t *out,
+  const uint32_t ow,
+  const uint32_t oh,
+  uint32_t *width,
+  uint32_t *height)
+{
+  const float scale = fmaxf(1.0f, fmaxf(iw/(float)ow, ih/(float)oh));
+  const uint32_t wd = *width  = MIN(ow, iw/scale);
+  const uint32_t ht = *height = MIN(oh, ih/scale);
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static) shared(in, out)
+#endif
+  for(uint32_t j=0; j<ht; j++)
+  {
+    const float y0 = j*scale, y1 = MIN((j+1)*scale, (float)ih);
+    for(uint32_t i=0; i<wd; i++)
+    {
+      const float x0 = i*scale, x1 = MIN((i+1)*scale, (float)iw);
+      float sum[4] = {0.0f}, weight = 0.0f;
+      for(uint32_t y=(uint32_t)y0; y<y1; y++)
+      {
+        const float wy = fminf(y+1, y1) - fmaxf(y, y0);
+        for(uint32_t x=(uint32_t)x0; x<x1; x++)
+        {
+          const float w = wy * (fminf(x+1, x1) - fmaxf(x, x0));
+          const uint8_t *px = in + 4*(y*iw + x);
+          for(int k=0; k<4; k++) sum[k] += w*px[k];
+          weight += w;
+        }
+      }
+      uint8_t *px = out + 4*(j*wd + i);
+      for(int k=0; k<4; k++) px[k] = CLAMP((int)(sum[k]/weight + 0.5f), 0, 0xff);
+    }
+  }
+}
+
+// fills all smaller 8-bit mips which are not in the cache yet from the freshly generated
+// buffer of this mip, so zooming in lighttable doesn't decode the same file over and over.
+static void
+_init_8_cascade(
+  dt_mipmap_cache_t *cache,
+  const uint32_t imgid,
+  const dt_mipmap_size_t mip,
+  const uint8_t *in,
+  const uint32_t wd,
+  const uint32_t ht)
+{
+  if(mip <= DT_MIPMAP_0 || mip > DT_MIPMAP_3 || wd == 0 || ht == 0) return;
+  const size_t bufsize = 4*cache->mip[mip-1].max_width*cache->mip[mip-1].max_height;
+  uint8_t *tmp[2] = { (uint8_t *)dt_alloc_align(64, bufsize), (uint8_t *)dt_alloc_align(64, bufsize) };
+  if(!tmp[0] || !tmp[1])
+  {
+    free(tmp[0]);
+    free(tmp[1]);
+    return;
+  }
+  const uint8_t *src = in;
+  uint32_t sw = wd, sh = ht;
+  for(int k=mip-1; k>=DT_MIPMAP_0; k--)
+  {
+    uint8_t *dst = tmp[k&1];
+    uint32_t dw, dh;
+    // each level is made from the next larger one, always a factor of two or less:
+    _downsample_8(src, sw, sh, dst, cache->mip[k].max_width, cache->mip[k].max_height, &dw, &dh);
+    src = dst;
+    sw = dw;
+    sh = dh;
+
+    const uint32_t key = get_key(imgid, k);
+    if(dt_cache_contains(&cache->mip[k].cache, key)) continue;
+    struct dt_mipmap_buffer_dsc* dsc = (struct dt_mipmap_buffer_dsc*)dt_cache_read_get(&cache->mip[k].cache, key);
+    if(!dsc) continue;
+    if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
+    {
+      // we're write locked, as requested by the alloc callback.
+      dsc->width  = dw;
+      dsc->height = dh;
+      if(cache->compression_type)
+      {
+        dt_mipmap_buffer_t buf;
+        buf.width  = dw;
+        buf.height = dh;
+        buf.imgid  = imgid;
+        buf.size   = k;
+        buf.buf    = (uint8_t *)(dsc+1);
+        dt_mipmap_cache_compress(&buf, dst);
+      }
+      else
+      {
+        memcpy(dsc+1, dst, 4*dw*dh);
+      }
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+      dt_cache_write_release(&cache->mip[k].cache, key);
+      __sync_fetch_and_add (&(cache->mip[k].stats_fetches), 1);
+    }
+    dt_cache_read_release(&cache->mip[k].cache, key);
+  }
+  free(tmp[0]);
+  free(tmp[1]);
+}
+
 uint8_t*
 dt_mipmap_cache_alloc_scratchmem(
   const dt_mipmap_cache_t *cache)
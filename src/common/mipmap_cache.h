@@ -127,6 +127,9 @@ dt_mipmap_cache_alloc(
 void dt_mipmap_cache_init   (dt_mipmap_cache_t *cache);
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache);
 void dt_mipmap_cache_print  (dt_mipmap_cache_t *cache);
+// writes the small thumbnails to the cache file of the library, which is read again on init.
+// done by dt_mipmap_cache_cleanup(), but can be called earlier while no thumbnails are generated.
+int  dt_mipmap_cache_serialize(dt_mipmap_cache_t *cache);
 
 // get a buffer for reading.
 // see dt_mipmap_get_flags_t for explanation on the exact
@@ -0,0 +1,168 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_RESAMPLE_H
+#define DT_RESAMPLE_H
+
+// the inner loops of dt_interpolation_resample(): applies precomputed horizontal
+// and vertical resampling plans to a 4-channel float image. header only, so that
+// src/tests/resample.c can benchmark it without linking darktable.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <xmmintrin.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** output rows processed by one thread in one go. */
+#define DT_RESAMPLE_BAND 32
+
+/**
+ * one dimension of the resampling plan, as built by prepare_resampling_plan() in
+ * interpolation.c: output sample x uses length[x] taps, starting at kernel[meta[3*x+1]]
+ * and index[meta[3*x+2]]. the kernel is normalized already.
+ */
+typedef struct dt_resample_plan_t
+{
+  int out;
+  int *length;
+  float *kernel;
+  int *index;
+  int *meta;
+}
+dt_resample_plan_t;
+
+// first and last input line needed by output lines [oy0, oy1).
+static inline void _dt_resample_band_lines(const dt_resample_plan_t *v, const int oy0, const int oy1, int *first, int *last)
+{
+  int mn = INT32_MAX, mx = -1;
+  for(int oy=oy0; oy<oy1; oy++)
+  {
+    const int *index = v->index + v->meta[3*oy+2];
+    for(int k=0; k<v->length[v->meta[3*oy]]; k++)
+    {
+      if(index[k] < mn) mn = index[k];
+      if(index[k] > mx) mx = index[k];
+    }
+  }
+  *first = mn;
+  *last = mx;
+}
+
+/**
+ * separable resampling: out (h->out x v->out pixels) from in, strides in bytes, both
+ * 16 byte aligned. the output is cut into bands of DT_RESAMPLE_BAND lines. per band the
+ * input lines it touches are resampled horizontally into a buffer small enough to stay
+ * in cache, and then combined vertically line by line. this costs about h+v taps per
+ * pixel instead of h*v for the direct 2d kernel, and gives the same result since the
+ * sums are evaluated in the same order. returns non-zero, without touching out, if the
+ * buffers could not be allocated.
+ */
+static inline int dt_resample_separable(
+    float *out, const int out_stride,
+    const float *const in, const int in_stride,
+    const dt_resample_plan_t *const h, const dt_resample_plan_t *const v)
+{
+  const int width = h->out, height = v->out;
+  const int bands = (height + DT_RESAMPLE_BAND - 1)/DT_RESAMPLE_BAND;
+
+  // size of the biggest band, for the thread local buffers:
+  int max_lines = 0;
+  for(int b=0; b<bands; b++)
+  {
+    int first, last;
+    _dt_resample_band_lines(v, b*DT_RESAMPLE_BAND, b*DT_RESAMPLE_BAND + DT_RESAMPLE_BAND < height ? b*DT_RESAMPLE_BAND + DT_RESAMPLE_BAND : height, &first, &last);
+    if(last - first + 1 > max_lines) max_lines = last - first + 1;
+  }
+
+  // per thread: horizontally resampled input lines, plus one line to accumulate the output.
+  // allocated up front, a thread cannot leave the omp for below on its own.
+#ifdef _OPENMP
+  const int threads = omp_get_max_threads();
+#else
+  const int threads = 1;
+#endif
+  const size_t thread_size = (size_t)width*(max_lines + 1);
+  __m128 *buf = (__m128 *)_mm_malloc(sizeof(__m128)*thread_size*threads, 16);
+  if(!buf) return 1;
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads)
+#endif
+  {
+#ifdef _OPENMP
+    __m128 *tmp = buf + thread_size*omp_get_thread_num();
+#else
+    __m128 *tmp = buf;
+#endif
+    __m128 *acc = tmp + (size_t)width*max_lines;
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(int b=0; b<bands; b++)
+    {
+      const int oy0 = b*DT_RESAMPLE_BAND;
+      const int oy1 = oy0 + DT_RESAMPLE_BAND < height ? oy0 + DT_RESAMPLE_BAND : height;
+      int first, last;
+      _dt_resample_band_lines(v, oy0, oy1, &first, &last);
+
+      // horizontal pass over the input lines of this band:
+      for(int iy=first; iy<=last; iy++)
+      {
+        const float *i = (const float *)((const char *)in + (size_t)in_stride*iy);
+        __m128 *t = tmp + (size_t)width*(iy - first);
+        int hkidx = 0, hiidx = 0;
+        for(int ox=0; ox<width; ox++)
+        {
+          const int hl = h->length[ox];
+          __m128 vhs = _mm_setzero_ps();
+          for(int ix=0; ix<hl; ix++)
+            vhs = _mm_add_ps(vhs, _mm_mul_ps(_mm_load_ps(i + 4*h->index[hiidx+ix]), _mm_set1_ps(h->kernel[hkidx+ix])));
+          t[ox] = vhs;
+          hkidx += hl;
+          hiidx += hl;
+        }
+      }
+
+      // vertical pass, one tap at a time over whole lines:
+      for(int oy=oy0; oy<oy1; oy++)
+      {
+        const int vl = v->length[v->meta[3*oy]];
+        const float *vkernel = v->kernel + v->meta[3*oy+1];
+        const int *vindex = v->index + v->meta[3*oy+2];
+        for(int ox=0; ox<width; ox++) acc[ox] = _mm_setzero_ps();
+        for(int iy=0; iy<vl; iy++)
+        {
+          const __m128 *t = tmp + (size_t)width*(vindex[iy] - first);
+          const __m128 vtap = _mm_set1_ps(vkernel[iy]);
+          for(int ox=0; ox<width; ox++) acc[ox] = _mm_add_ps(acc[ox], _mm_mul_ps(t[ox], vtap));
+        }
+        float *o = (float *)((char *)out + (size_t)out_stride*oy);
+        for(int ox=0; ox<width; ox++) _mm_stream_ps(o + 4*ox, acc[ox]);
+      }
+    }
+  }
+  _mm_sfence();
+  _mm_free(buf);
+  return 0;
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
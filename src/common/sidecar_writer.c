@@ -0,0 +1,221 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/darktable.h"
+#include "common/debug.h"
+#include "common/exif.h"
+#include "common/image.h"
+#include "common/sidecar_writer.h"
+#include "control/conf.h"
+
+#include <float.h>
+#include <sqlite3.h>
+#include <string.h>
+
+typedef struct _sidecar_t
+{
+  int imgid;
+  char *filename;
+}
+_sidecar_t;
+
+// writes the xmp files of all images in the list and frees it.
+// the file names of the whole batch are resolved with a single query.
+static void _write_batch(GList *imgs)
+{
+  if(!imgs) return;
+  if(!dt_conf_get_bool("write_sidecar_files"))
+  {
+    g_list_free(imgs);
+    return;
+  }
+
+  gchar *ids = NULL;
+  for(GList *l = imgs; l; l = g_list_next(l))
+    ids = dt_util_dstrcat(ids, "%s%d", ids ? "," : "", GPOINTER_TO_INT(l->data));
+  g_list_free(imgs);
+
+  gchar *query = dt_util_dstrcat(NULL,
+                                 "select images.id, film_rolls.folder || '/' || images.filename, "
+                                 "(select count(d.id) from images as d where d.filename = images.filename "
+                                 "and d.film_id = images.film_id and d.id < images.id) "
+                                 "from images, film_rolls where images.film_id = film_rolls.id "
+                                 "and images.id in (%s)", ids);
+  g_free(ids);
+
+  // collect everything first, so no statement stays open while the xmp writer queries the db.
+  GList *files = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    _sidecar_t *s = (_sidecar_t *)g_malloc(sizeof(_sidecar_t));
+    s->imgid = sqlite3_column_int(stmt, 0);
+    const char *path = (const char *)sqlite3_column_text(stmt, 1);
+    const int version = sqlite3_column_int(stmt, 2);
+    s->filename = NULL;
+    // images with only a local copy available go the slow way through dt_image_full_path().
+    if(path && g_file_test(path, G_FILE_TEST_EXISTS))
+    {
+      char filename[DT_MAX_PATH_LEN+8];
+      g_strlcpy(filename, path, DT_MAX_PATH_LEN);
+      dt_image_path_append_version_no_db(version, filename, DT_MAX_PATH_LEN);
+      g_strlcat(filename, ".xmp", sizeof(filename));
+      s->filename = g_strdup(filename);
+    }
+    files = g_list_prepend(files, s);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  for(GList *l = files; l; l = g_list_next(l))
+  {
+    _sidecar_t *s = (_sidecar_t *)l->data;
+    if(s->filename) dt_exif_xmp_write(s->imgid, s->filename);
+    else dt_image_write_sidecar_file(s->imgid);
+    g_free(s->filename);
+    g_free(s);
+  }
+  dt_print(DT_DEBUG_CACHE, "[sidecar_writer] wrote %d xmp files\n", g_list_length(files));
+  g_list_free(files);
+}
+
+typedef struct _collect_t
+{
+  GList *imgs;
+  double due;   // entries last touched before this are written
+  double next;  // earliest time the next entry becomes due
+}
+_collect_t;
+
+static gboolean _collect_due(gpointer key, gpointer value, gpointer user_data)
+{
+  _collect_t *c = (_collect_t *)user_data;
+  const double t = *(double *)value;
+  if(t <= c->due)
+  {
+    c->imgs = g_list_prepend(c->imgs, key);
+    return TRUE;
+  }
+  c->next = MIN(c->next, t + DT_SIDECAR_WRITER_DELAY);
+  return FALSE;
+}
+
+static void _collect_all(gpointer key, gpointer value, gpointer user_data)
+{
+  GList **imgs = (GList **)user_data;
+  *imgs = g_list_prepend(*imgs, key);
+}
+
+static void *_sidecar_writer_thread(void *data)
+{
+  dt_sidecar_writer_t *w = (dt_sidecar_writer_t *)data;
+  dt_pthread_mutex_lock(&w->mutex);
+  while(w->running)
+  {
+    if(g_hash_table_size(w->dirty) == 0)
+    {
+      dt_pthread_cond_wait(&w->cond, &w->mutex);
+      continue;
+    }
+    const double now = dt_get_wtime();
+    _collect_t c = { NULL, now - DT_SIDECAR_WRITER_DELAY, DBL_MAX };
+    g_hash_table_foreach_remove(w->dirty, _collect_due, &c);
+    if(!c.imgs)
+    {
+      // nothing settled yet, sleep until the oldest change is due:
+      dt_pthread_mutex_unlock(&w->mutex);
+      g_usleep(MAX(1000, (gulong)(1e6 * (c.next - now))));
+      dt_pthread_mutex_lock(&w->mutex);
+      continue;
+    }
+    w->busy = 1;
+    dt_pthread_mutex_unlock(&w->mutex);
+    _write_batch(c.imgs);
+    dt_pthread_mutex_lock(&w->mutex);
+    w->busy = 0;
+    pthread_cond_broadcast(&w->idle);
+  }
+  dt_pthread_mutex_unlock(&w->mutex);
+  return NULL;
+}
+
+void dt_sidecar_writer_init(dt_sidecar_writer_t *w)
+{
+  memset(w, 0, sizeof(dt_sidecar_writer_t));
+  dt_pthread_mutex_init(&w->mutex, NULL);
+  pthread_cond_init(&w->cond, NULL);
+  pthread_cond_init(&w->idle, NULL);
+  w->dirty = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  w->running = 1;
+  pthread_create(&w->thread, NULL, &_sidecar_writer_thread, w);
+}
+
+void dt_sidecar_writer_cleanup(dt_sidecar_writer_t *w)
+{
+  dt_pthread_mutex_lock(&w->mutex);
+  w->running = 0;
+  pthread_cond_broadcast(&w->cond);
+  dt_pthread_mutex_unlock(&w->mutex);
+  pthread_join(w->thread, NULL);
+
+  // write whatever is left over:
+  dt_sidecar_writer_flush(w);
+
+  g_hash_table_destroy(w->dirty);
+  pthread_cond_destroy(&w->idle);
+  pthread_cond_destroy(&w->cond);
+  dt_pthread_mutex_destroy(&w->mutex);
+}
+
+void dt_sidecar_writer_queue(dt_sidecar_writer_t *w, const int imgid)
+{
+  if(imgid <= 0) return;
+  double *t = (double *)g_malloc(sizeof(double));
+  *t = dt_get_wtime();
+  dt_pthread_mutex_lock(&w->mutex);
+  // replacing the entry pushes the write further back (debouncing):
+  g_hash_table_replace(w->dirty, GINT_TO_POINTER(imgid), t);
+  pthread_cond_signal(&w->cond);
+  dt_pthread_mutex_unlock(&w->mutex);
+}
+
+void dt_sidecar_writer_sync(dt_sidecar_writer_t *w, const int imgid)
+{
+  if(imgid <= 0) return;
+  dt_pthread_mutex_lock(&w->mutex);
+  const gboolean pending = g_hash_table_remove(w->dirty, GINT_TO_POINTER(imgid));
+  // the image might be part of the batch in flight:
+  while(w->busy) dt_pthread_cond_wait(&w->idle, &w->mutex);
+  dt_pthread_mutex_unlock(&w->mutex);
+  if(pending) dt_image_write_sidecar_file(imgid);
+}
+
+void dt_sidecar_writer_flush(dt_sidecar_writer_t *w)
+{
+  GList *imgs = NULL;
+  dt_pthread_mutex_lock(&w->mutex);
+  g_hash_table_foreach(w->dirty, _collect_all, &imgs);
+  g_hash_table_remove_all(w->dirty);
+  while(w->busy) dt_pthread_cond_wait(&w->idle, &w->mutex);
+  dt_pthread_mutex_unlock(&w->mutex);
+  _write_batch(imgs);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,62 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_SIDECAR_WRITER_H
+#define DT_SIDECAR_WRITER_H
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+
+/** seconds an image has to stay untouched before its xmp is written. */
+#define DT_SIDECAR_WRITER_DELAY 0.5
+
+/**
+ * background writer for .xmp sidecar files.
+ * images are only marked dirty from the calling thread (usually gtk),
+ * the actual serialization happens in a separate thread once an image
+ * has not been touched for DT_SIDECAR_WRITER_DELAY seconds. repeated
+ * changes to the same image thus only result in one write.
+ */
+typedef struct dt_sidecar_writer_t
+{
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond;  // new work or shutdown
+  pthread_cond_t idle;  // a batch has been written
+  pthread_t thread;
+  GHashTable *dirty;    // imgid -> time of the last change
+  int busy;             // a batch is being written right now
+  int running;
+}
+dt_sidecar_writer_t;
+
+/** starts the writer thread. */
+void dt_sidecar_writer_init(dt_sidecar_writer_t *w);
+/** stops the thread and writes out everything still pending. */
+void dt_sidecar_writer_cleanup(dt_sidecar_writer_t *w);
+
+/** marks the xmp of this image as outdated, it will be written some time later. */
+void dt_sidecar_writer_queue(dt_sidecar_writer_t *w, const int imgid);
+/** writes the xmp of this image now if it is pending, and waits until that's done. */
+void dt_sidecar_writer_sync(dt_sidecar_writer_t *w, const int imgid);
+/** writes all pending xmp files now and waits until that's done. */
+void dt_sidecar_writer_flush(dt_sidecar_writer_t *w);
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -23,6 +23,214 @@
 #include "control/conf.h"
 #include "control/control.h"
 
+/*
+ * in-memory dictionary of all tags, answers dt_tag_get_suggestions() without going
+ * through sqlite on every keystroke:
+ *
+ * * the lower case tag names with a trigram index (trigram -> sorted list of tag ids),
+ *   so substring searches only have to check the tags containing all trigrams of the
+ *   keyword.
+ * * the non-zero co-occurrence counts of tagxtag, per tag as an array sorted by id.
+ *   tagxtag holds one row per pair of tags, here both tags get the count.
+ *
+ * it is loaded on first use and kept up to date by dt_tag_new(), dt_tag_remove(),
+ * dt_tag_attach() and dt_tag_detach(). code changing tagxtag on its own calls
+ * dt_tag_index_invalidate() to have it reloaded.
+ */
+typedef struct dt_tag_index_pair_t
+{
+  guint id;
+  gint count;
+}
+dt_tag_index_pair_t;
+
+typedef struct dt_tag_index_entry_t
+{
+  guint id;
+  gchar *name;
+  gchar *lower; // what LIKE compares against: ascii characters case insensitive
+  GArray *pairs; // dt_tag_index_pair_t, sorted by id
+}
+dt_tag_index_entry_t;
+
+static struct
+{
+  gboolean loaded;
+  GHashTable *tags;     // id -> dt_tag_index_entry_t
+  GHashTable *trigrams; // trigram -> GArray of ids, sorted
+}
+tag_index = { FALSE, NULL, NULL };
+
+static GStaticMutex tag_index_mutex = G_STATIC_MUTEX_INIT;
+
+static inline guint _tag_index_trigram(const gchar *c)
+{
+  return ((guint)(guchar)c[0] << 16) | ((guint)(guchar)c[1] << 8) | (guint)(guchar)c[2];
+}
+
+// position of id in a sorted array of guint (or of structs of the given size starting with one),
+// or where it would have to be inserted.
+static guint _tag_index_find(const GArray *a, const size_t size, const guint id, gboolean *found)
+{
+  guint lo = 0, hi = a->len;
+  while(lo < hi)
+  {
+    const guint mid = (lo + hi) / 2;
+    if(*(const guint *)(a->data + size * mid) < id) lo = mid + 1;
+    else hi = mid;
+  }
+  *found = lo < a->len && *(const guint *)(a->data + size * lo) == id;
+  return lo;
+}
+
+static void _tag_index_free_entry(gpointer data)
+{
+  dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)data;
+  g_free(e->name);
+  g_free(e->lower);
+  g_array_free(e->pairs, TRUE);
+  g_free(e);
+}
+
+static void _tag_index_free_postings(gpointer data)
+{
+  g_array_free((GArray *)data, TRUE);
+}
+
+static void _tag_index_add_tag(const guint id, const gchar *name)
+{
+  if(g_hash_table_lookup(tag_index.tags, GUINT_TO_POINTER(id))) return;
+
+  dt_tag_index_entry_t *e = g_malloc(sizeof(dt_tag_index_entry_t));
+  e->id = id;
+  e->name = g_strdup(name);
+  e->lower = g_ascii_strdown(name, -1);
+  e->pairs = g_array_new(FALSE, FALSE, sizeof(dt_tag_index_pair_t));
+  g_hash_table_insert(tag_index.tags, GUINT_TO_POINTER(id), e);
+
+  const size_t len = strlen(e->lower);
+  for(size_t k = 0; k + 3 <= len; k++)
+  {
+    const guint t = _tag_index_trigram(e->lower + k);
+    GArray *ids = (GArray *)g_hash_table_lookup(tag_index.trigrams, GUINT_TO_POINTER(t));
+    if(!ids)
+    {
+      ids = g_array_new(FALSE, FALSE, sizeof(guint));
+      g_hash_table_insert(tag_index.trigrams, GUINT_TO_POINTER(t), ids);
+    }
+    gboolean found;
+    const guint pos = _tag_index_find(ids, sizeof(guint), id, &found);
+    if(!found) g_array_insert_val(ids, pos, id);
+  }
+}
+
+// adds delta to the co-occurrence count of a and b, pairs dropping to zero are removed.
+static void _tag_index_pair_add_one(const guint a, const guint b, const gint delta)
+{
+  dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_hash_table_lookup(tag_index.tags, GUINT_TO_POINTER(a));
+  if(!e) return;
+  gboolean found;
+  const guint pos = _tag_index_find(e->pairs, sizeof(dt_tag_index_pair_t), b, &found);
+  if(!found)
+  {
+    const dt_tag_index_pair_t p = { b, delta };
+    g_array_insert_val(e->pairs, pos, p);
+    return;
+  }
+  dt_tag_index_pair_t *p = &g_array_index(e->pairs, dt_tag_index_pair_t, pos);
+  p->count += delta;
+  if(p->count == 0) g_array_remove_index(e->pairs, pos);
+}
+
+static void _tag_index_pair_add(const guint a, const guint b, const gint delta)
+{
+  _tag_index_pair_add_one(a, b, delta);
+  if(a != b) _tag_index_pair_add_one(b, a, delta);
+}
+
+static void _tag_index_remove_tag(const guint id)
+{
+  dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_hash_table_lookup(tag_index.tags, GUINT_TO_POINTER(id));
+  if(!e) return;
+
+  for(guint k = 0; k < e->pairs->len; k++)
+  {
+    const guint other = g_array_index(e->pairs, dt_tag_index_pair_t, k).id;
+    if(other == id) continue;
+    dt_tag_index_entry_t *o = (dt_tag_index_entry_t *)g_hash_table_lookup(tag_index.tags, GUINT_TO_POINTER(other));
+    if(!o) continue;
+    gboolean found;
+    const guint pos = _tag_index_find(o->pairs, sizeof(dt_tag_index_pair_t), id, &found);
+    if(found) g_array_remove_index(o->pairs, pos);
+  }
+
+  const size_t len = strlen(e->lower);
+  for(size_t k = 0; k + 3 <= len; k++)
+  {
+    GArray *ids = (GArray *)g_hash_table_lookup(tag_index.trigrams, GUINT_TO_POINTER(_tag_index_trigram(e->lower + k)));
+    if(!ids) continue;
+    gboolean found;
+    const guint pos = _tag_index_find(ids, sizeof(guint), id, &found);
+    if(found) g_array_remove_index(ids, pos);
+  }
+
+  g_hash_table_remove(tag_index.tags, GUINT_TO_POINTER(id));
+}
+
+// needs tag_index_mutex.
+static void _tag_index_load()
+{
+  if(tag_index.loaded) return;
+  const double start = dt_get_wtime();
+
+  tag_index.tags = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _tag_index_free_entry);
+  tag_index.trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _tag_index_free_postings);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, name FROM tags", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    if(sqlite3_column_text(stmt, 1))
+      _tag_index_add_tag(sqlite3_column_int(stmt, 0), (const char *)sqlite3_column_text(stmt, 1));
+  sqlite3_finalize(stmt);
+
+  // counts that went negative are kept as well, so that later updates stay in sync with the table
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id1, id2, count FROM tagxtag WHERE count <> 0", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _tag_index_pair_add(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2));
+  sqlite3_finalize(stmt);
+
+  tag_index.loaded = TRUE;
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF, "[tags] loaded %u tags into the tag index in %.3f secs\n",
+           g_hash_table_size(tag_index.tags), dt_get_wtime() - start);
+}
+
+// applies an update of tagxtag to the index: the count of tagid and each tag returned by the
+// query (which is bound to imgid if that is > 0) changes by delta. needs tag_index_mutex.
+static void _tag_index_update_pairs(const guint tagid, const gint imgid, const char *query, const gint delta)
+{
+  if(!tag_index.loaded) return;
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db, query);
+  if(imgid > 0) DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _tag_index_pair_add(tagid, sqlite3_column_int(stmt, 0), delta);
+  sqlite3_reset(stmt);
+}
+
+void dt_tag_index_invalidate()
+{
+  g_static_mutex_lock(&tag_index_mutex);
+  if(tag_index.loaded)
+  {
+    g_hash_table_destroy(tag_index.tags);
+    g_hash_table_destroy(tag_index.trigrams);
+    tag_index.tags = tag_index.trigrams = NULL;
+    tag_index.loaded = FALSE;
+  }
+  g_static_mutex_unlock(&tag_index_mutex);
+}
+
 gboolean dt_tag_new(const char *name,guint *tagid)
 {
   int rt;
@@ -71,6 +279,14 @@ gboolean dt_tag_new(const char *name,guint *tagid)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  g_static_mutex_lock(&tag_index_mutex);
+  if(tag_index.loaded)
+  {
+    _tag_index_add_tag(id, name);
+    _tag_index_pair_add(id, id, 1000000);
+  }
+  g_static_mutex_unlock(&tag_index_mutex);
+
   if( tagid != NULL)
     *tagid=id;
 
@@ -118,6 +334,10 @@ guint dt_tag_remove(const guint tagid, gboolean final)
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    g_static_mutex_lock(&tag_index_mutex);
+    if(tag_index.loaded) _tag_index_remove_tag(tagid);
+    g_static_mutex_unlock(&tag_index_mutex);
+
     /* raise signal of tags change to refresh keywords module */
     dt_control_signal_raise(darktable.signals, DT_SIGNAL_TAG_CHANGED);
 
@@ -165,6 +385,9 @@ void dt_tag_reorganize(const gchar *source, const gchar *dest)
 
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
 
+  // the names changed, have the whole index reloaded:
+  dt_tag_index_invalidate();
+
   /* raise signal of tags change to refresh keywords module */
   //dt_control_signal_raise(darktable.signals, DT_SIGNAL_TAG_CHANGED);
 }
@@ -195,26 +418,30 @@ gboolean dt_tag_exists(const char *name,guint *tagid)
 void dt_tag_attach(guint tagid,gint imgid)
 {
   sqlite3_stmt *stmt;
+  // the transaction is always taken before the index lock:
+  dt_database_start_transaction(darktable.db);
+  g_static_mutex_lock(&tag_index_mutex);
   if(imgid > 0)
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT OR REPLACE INTO tagged_images (imgid, tagid) VALUES (?1, ?2)",
-                                -1, &stmt, NULL);
+    // this is called per image in loops (export), so use cached statements:
+    stmt = dt_database_prepare_cached(darktable.db,
+                                      "INSERT OR REPLACE INTO tagged_images (imgid, tagid) VALUES (?1, ?2)");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, tagid);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "UPDATE tagxtag SET count = count + 1 WHERE "
-                                "(id1 = ?1 AND id2 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2)) "
-                                "OR "
-                                "(id2 = ?1 AND id1 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2))",
-                                -1, &stmt, NULL);
+    stmt = dt_database_prepare_cached(darktable.db,
+                                      "UPDATE tagxtag SET count = count + 1 WHERE "
+                                      "(id1 = ?1 AND id2 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2)) "
+                                      "OR "
+                                      "(id2 = ?1 AND id1 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2))");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
+
+    _tag_index_update_pairs(tagid, imgid, "SELECT DISTINCT tagid FROM tagged_images WHERE imgid = ?1", 1);
   }
   else
   {
@@ -235,7 +462,11 @@ void dt_tag_attach(guint tagid,gint imgid)
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+
+    _tag_index_update_pairs(tagid, -1, "SELECT DISTINCT tagid FROM selected_images JOIN tagged_images", 1);
   }
+  g_static_mutex_unlock(&tag_index_mutex);
+  dt_database_release_transaction(darktable.db);
 }
 
 void dt_tag_attach_list(GList *tags,gint imgid)
@@ -278,31 +509,33 @@ void dt_tag_attach_string_list(const gchar *tags, gint imgid)
 void dt_tag_detach(guint tagid,gint imgid)
 {
   sqlite3_stmt *stmt;
+  dt_database_start_transaction(darktable.db);
+  g_static_mutex_lock(&tag_index_mutex);
   if(imgid > 0)
   {
-    // remove from specified image by id
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "UPDATE tagxtag SET count = count - 1 WHERE (id1 = ?1 AND id2 IN "
-                                "(SELECT tagid FROM tagged_images WHERE imgid = ?2)) OR (id2 = ?1 "
-                                "AND id1 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2))",
-                                -1, &stmt, NULL);
+    // remove from specified image by id, the index first as it needs the tags still attached:
+    _tag_index_update_pairs(tagid, imgid, "SELECT DISTINCT tagid FROM tagged_images WHERE imgid = ?1", -1);
+    stmt = dt_database_prepare_cached(darktable.db,
+                                      "UPDATE tagxtag SET count = count - 1 WHERE (id1 = ?1 AND id2 IN "
+                                      "(SELECT tagid FROM tagged_images WHERE imgid = ?2)) OR (id2 = ?1 "
+                                      "AND id1 IN (SELECT tagid FROM tagged_images WHERE imgid = ?2))");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
 
     // remove from tagged_images
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "DELETE FROM tagged_images WHERE tagid = ?1 AND imgid = ?2",
-                                -1, &stmt, NULL);
+    stmt = dt_database_prepare_cached(darktable.db,
+                                      "DELETE FROM tagged_images WHERE tagid = ?1 AND imgid = ?2");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
   }
   else
   {
     // remove from all selected images
+    _tag_index_update_pairs(tagid, -1, "SELECT DISTINCT tagid FROM selected_images JOIN tagged_images", -1);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 "update tagxtag set count = count - 1 where (id1 = ?1 and id2 in "
                                 "(select tagid from selected_images join tagged_images)) or (id2 = ?1 "
@@ -320,6 +553,8 @@ void dt_tag_detach(guint tagid,gint imgid)
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
   }
+  g_static_mutex_unlock(&tag_index_mutex);
+  dt_database_release_transaction(darktable.db);
 }
 
 void dt_tag_detach_by_string(const char *name, gint imgid)
@@ -445,108 +680,111 @@ gchar *dt_tag_get_hierarchical(gint imgid, const gchar *separator)
   return result;
 }
 
+static gint _tag_compare_id(gconstpointer a, gconstpointer b)
+{
+  const guint ia = ((const dt_tag_t *)a)->id, ib = ((const dt_tag_t *)b)->id;
+  return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
 /*
- * dt_tag_get_suggestions() takes a string (keyword) and searches the
- * tagxtags table for possibly-related tags. The list we construct at
- * the end of the function is made up as follows:
- *
- * * Tags which appear as tagxtag.id2, where (keyword's name = tagxtag.id1)
- *   are listed first, ordered by count of times seen already.
- * * Tags which appear as tagxtag.id1, where (keyword's name = tagxtag.id2)
- *   are listed second, ordered as before.
+ * dt_tag_get_suggestions() takes a string (keyword) and looks for
+ * possibly-related tags: all tags whose name contains the keyword
+ * (ascii case insensitive, like sql's LIKE '%keyword%'), and every tag
+ * that has been used together with one of them, i.e. has a non-zero count
+ * in tagxtag. as dt_tag_new() puts each tag into tagxtag together with
+ * itself, the matching tags are part of the result, too.
  *
  * We do not suggest tags which have not yet been matched up in tagxtag,
  * because it is up to the user to add new tags to the list and thereby
  * make the association.
  *
- * Expressing these as separate queries avoids making the sqlite3 engine
- * do a large number of operations and thus makes the user experience
- * snappy.
- *
- * SELECT T.id FROM tags T WHERE T.name LIKE '?1';  --> into temp table
- * SELECT TXT.id2 FROM tagxtag TXT WHERE TXT.id1 IN (temp table)
- *   AND TXT.count > 0 ORDER BY TXT.count DESC;
- * SELECT TXT.id1 FROM tagxtag TXT WHERE TXT.id2 IN (temp table)
- *   AND TXT.count > 0 ORDER BY TXT.count DESC;
- *
- * SELECT DISTINCT(T.name) FROM tags T JOIN memoryquery MQ on MQ.id = T.id;
- *
+ * This is called on every keystroke, so it is answered from the tag
+ * index above instead of sqlite: with a keyword of three or more bytes
+ * only the tags sharing its rarest trigram are compared against it.
+ * The result is sorted by tag id and leaves out the internal darktable|
+ * tags.
  */
 uint32_t dt_tag_get_suggestions(const gchar *keyword, GList **result)
 {
-  sqlite3_stmt *stmt;
-  char query[1024];
-  /*
-   * Earlier versions of this function used a large collation of selects
-   * and joins, resulting in multi-*second* timings for sqlite3_exec().
-   *
-   * Breaking the query into several smaller ones allows the sqlite3
-   * execution engine to work more effectively, which is very important
-   * for interactive response since we call this function several times
-   * in quick succession (on every keystroke).
-   */
-
   /* Quick sanity check - is keyword empty? If so .. return 0 */
   if (keyword == 0)
     return 0;
 
-  /* SELECT T.id FROM tags T WHERE T.name LIKE '%%%s%%';  --> into temp table */
-  memset(query, 0, sizeof(query));
-  snprintf(query, sizeof(query),
-           "INSERT INTO memory.tagq (id) SELECT id FROM tags T WHERE "
-           "T.name LIKE '%%%s%%' ", keyword);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query,
-                        NULL, NULL, NULL);
+  gchar *lower = g_ascii_strdown(keyword, -1);
+  const size_t len = strlen(lower);
 
-  /*
-   * SELECT TXT.id2 FROM tagxtag TXT WHERE TXT.id1 IN (temp table)
-   *   AND TXT.count > 0 ORDER BY TXT.count DESC;
-   */
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "INSERT INTO memory.taglist (id, count) "
-                        "SELECT DISTINCT(TXT.id2), TXT.count FROM tagxtag TXT "
-                        "WHERE TXT.id1 IN "
-                        "(SELECT id from memory.tagq) AND TXT.count > 0 "
-                        "ORDER BY TXT.count DESC",
-                        NULL, NULL, NULL);
+  g_static_mutex_lock(&tag_index_mutex);
+  _tag_index_load();
 
-  /*
-   * SELECT TXT.id1 FROM tagxtag TXT WHERE TXT.id2 IN (temp table)
-   *   AND TXT.count > 0 ORDER BY TXT.count DESC;
-   */
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "INSERT OR REPLACE INTO memory.taglist (id, count) "
-                        "SELECT DISTINCT(TXT.id1), TXT.count FROM tagxtag TXT "
-                        "WHERE TXT.id2 IN "
-                        "(SELECT id from memory.tagq) AND TXT.count > 0 "
-                        "ORDER BY TXT.count DESC",
-                        NULL, NULL, NULL);
+  // tags containing the keyword
+  GArray *matches = g_array_new(FALSE, FALSE, sizeof(dt_tag_index_entry_t *));
+  GArray *candidates = NULL;
+  gboolean none = FALSE;
+  for(size_t k = 0; k + 3 <= len; k++)
+  {
+    GArray *ids = (GArray *)g_hash_table_lookup(tag_index.trigrams, GUINT_TO_POINTER(_tag_index_trigram(lower + k)));
+    if(!ids || ids->len == 0)
+    {
+      none = TRUE;
+      break;
+    }
+    if(!candidates || ids->len < candidates->len) candidates = ids;
+  }
+  if(candidates)
+  {
+    for(guint k = 0; k < candidates->len; k++)
+    {
+      dt_tag_index_entry_t *e = (dt_tag_index_entry_t *)g_hash_table_lookup(tag_index.tags,
+                                GUINT_TO_POINTER(g_array_index(candidates, guint, k)));
+      if(e && strstr(e->lower, lower)) g_array_append_val(matches, e);
+    }
+  }
+  else if(!none)
+  {
+    // keyword too short for the trigrams, check all tags
+    GHashTableIter it;
+    gpointer value;
+    g_hash_table_iter_init(&it, tag_index.tags);
+    while(g_hash_table_iter_next(&it, NULL, &value))
+      if(strstr(((dt_tag_index_entry_t *)value)->lower, lower)) g_array_append_val(matches, value);
+  }
 
-  /* Now put all the bits together */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT T.name, T.id, MT.count FROM tags T JOIN memory.taglist MT ON "
-                              "MT.id = T.id WHERE T.id in "
-                              "(SELECT DISTINCT(MT.id) FROM memory.taglist MT) "
-                              "AND T.name NOT LIKE 'darktable|%%' ORDER BY T.id ASC",
-                              -1, &stmt, NULL);
+  // ... and everything used together with them
+  GHashTable *related = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for(guint m = 0; m < matches->len; m++)
+  {
+    const dt_tag_index_entry_t *e = g_array_index(matches, dt_tag_index_entry_t *, m);
+    for(guint k = 0; k < e->pairs->len; k++)
+    {
+      const dt_tag_index_pair_t *p = &g_array_index(e->pairs, dt_tag_index_pair_t, k);
+      if(p->count <= 0) continue;
+      dt_tag_index_entry_t *r = (dt_tag_index_entry_t *)g_hash_table_lookup(tag_index.tags, GUINT_TO_POINTER(p->id));
+      if(r && !g_str_has_prefix(r->lower, "darktable|"))
+        g_hash_table_insert(related, GUINT_TO_POINTER(p->id), r);
+    }
+  }
 
   /* ... and create the result list to send upwards */
-  uint32_t count=0;
-  dt_tag_t *t;
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  uint32_t count = 0;
+  GList *suggestions = NULL;
+  GList *found = g_hash_table_get_values(related);
+  for(GList *l = found; l; l = g_list_next(l))
   {
-    t = g_malloc(sizeof(dt_tag_t));
-    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 0));
-    t->id = sqlite3_column_int(stmt, 1);
-    *result = g_list_append((*result),t);
+    const dt_tag_index_entry_t *r = (const dt_tag_index_entry_t *)l->data;
+    dt_tag_t *t = g_malloc(sizeof(dt_tag_t));
+    t->tag = g_strdup(r->name);
+    t->id = r->id;
+    suggestions = g_list_prepend(suggestions, t);
     count++;
   }
+  g_static_mutex_unlock(&tag_index_mutex);
 
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE from memory.taglist", NULL, NULL, NULL);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE from memory.tagq", NULL, NULL, NULL);
+  *result = g_list_concat(*result, g_list_sort(suggestions, _tag_compare_id));
+
+  g_list_free(found);
+  g_hash_table_destroy(related);
+  g_array_free(matches, TRUE);
+  g_free(lower);
 
   return count;
 }
@@ -79,6 +79,9 @@ void dt_tag_free_result(GList **result);
 /** reorganize tags */
 void dt_tag_reorganize(const gchar *source, const gchar *dest);
 
+/** drops the in-memory tag index used for suggestions, it is reloaded from the database when needed. call this after changing tagxtag other than through the functions above. */
+void dt_tag_index_invalidate();
+
 
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
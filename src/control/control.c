@@ -62,6 +62,10 @@
 */
 static void * _control_worker_kicker(void *ptr);
 
+/* job telemetry of dt_control_add_job(), see below. */
+static void _control_telemetry_discarded(dt_control_t *s, const dt_job_t *job, const gboolean queue_full);
+static void _control_telemetry_queue_depth(dt_control_t *s, const int depth);
+
 /* redraw mutex to synchronize redraws */
 static dt_pthread_mutex_t _control_gdk_lock_threads_mutex;
 
@@ -176,14 +180,6 @@ static void dt_control_sanitize_database()
                         NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "CREATE TABLE memory.tmp_selection (imgid INTEGER)", NULL, NULL, NULL);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "CREATE TABLE memory.tagq (tmpid INTEGER PRIMARY KEY, id INTEGER)",
-                        NULL, NULL, NULL);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "CREATE TABLE memory.taglist "
-                        "(tmpid INTEGER PRIMARY KEY, id INTEGER UNIQUE ON CONFLICT REPLACE, "
-                        "count INTEGER)",
-                        NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "CREATE TABLE memory.history (imgid integer, num integer, module integer, "
                         "operation varchar(256) UNIQUE ON CONFLICT REPLACE, op_params blob, enabled integer, "
@@ -415,6 +411,8 @@ void dt_control_create_database_schema()
                         "latitude double, color_matrix blob, colorspace integer)", NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "create index if not exists group_id_index on images (group_id)", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                        "create index if not exists images_film_id_index on images (film_id)", NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "create table selected_images (imgid integer primary key)", NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
@@ -486,9 +484,10 @@ void dt_control_init(dt_control_t *s)
   dt_pthread_mutex_init(&s->queue_mutex, NULL);
   dt_pthread_mutex_init(&s->run_mutex, NULL);
   pthread_rwlock_init(&s->xprofile_lock, NULL);
+  dt_control_telemetry_init(s);
 
   // start threads
-  s->num_threads = CLAMP(dt_conf_get_int ("worker_threads"), 1, 8);
+  s->num_threads = CLAMP(dt_conf_get_int ("worker_threads"), 1, DT_CTL_WORKER_MAX);
   s->thread = (pthread_t *)malloc(sizeof(pthread_t)*s->num_threads);
   dt_pthread_mutex_lock(&s->run_mutex);
   s->running = 1;
@@ -617,9 +616,7 @@ void dt_control_init(dt_control_t *s)
       sqlite3_table_column_metadata(dt_database_get(darktable.db), NULL, "selected_images", "imgid", NULL, NULL, NULL, &is_in_primary_key, NULL);
       if(is_in_primary_key == 0)
       {
-        sqlite3_exec(dt_database_get(darktable.db),
-                     "begin transaction",
-                     NULL, NULL, NULL);
+        dt_database_start_transaction(darktable.db);
 
         sqlite3_exec(dt_database_get(darktable.db),
                      "create temporary table selected_images_backup(imgid integer)",
@@ -639,9 +636,7 @@ void dt_control_init(dt_control_t *s)
         sqlite3_exec(dt_database_get(darktable.db),
                      "drop table selected_images_backup",
                      NULL, NULL, NULL);
-        sqlite3_exec(dt_database_get(darktable.db),
-                     "commit",
-                     NULL, NULL, NULL);
+        dt_database_release_transaction(darktable.db);
       }
 
       // add columns where needed. will just fail otherwise:
@@ -676,6 +671,9 @@ void dt_control_init(dt_control_t *s)
       sqlite3_exec(dt_database_get(darktable.db),
                    "create index if not exists group_id_index on images (group_id)",
                    NULL, NULL, NULL);
+      sqlite3_exec(dt_database_get(darktable.db),
+                   "create index if not exists images_film_id_index on images (film_id)",
+                   NULL, NULL, NULL);
       sqlite3_exec(dt_database_get(darktable.db),
                    "create index if not exists imgid_index on history (imgid)",
                    NULL, NULL, NULL);
@@ -848,6 +846,12 @@ void dt_control_shutdown(dt_control_t *s)
     // pthread_kill(s->thread_res[k], 9);
     pthread_join(s->thread_res[k], NULL);
 
+  if(darktable.unmuted & DT_DEBUG_CONTROL)
+  {
+    gchar *telemetry = dt_control_telemetry_to_string(s);
+    dt_print(DT_DEBUG_CONTROL, "%s", telemetry);
+    g_free(telemetry);
+  }
 
   // gdk_threads_enter();
 }
@@ -867,6 +871,7 @@ void dt_control_cleanup(dt_control_t *s)
   dt_pthread_mutex_destroy(&s->log_mutex);
   dt_pthread_mutex_destroy(&s->run_mutex);
   pthread_rwlock_destroy(&s->xprofile_lock);
+  dt_control_telemetry_cleanup(s);
 //   g_slist_free_full(s->accelerator_list, g_free); // FIXME: requires glib >= 2.28
   if (s->accelerator_list)
   {
@@ -884,6 +889,7 @@ void dt_control_job_init(dt_job_t *j, const char *msg, ...)
   vsnprintf(j->description, DT_CONTROL_DESCRIPTION_LEN, msg, ap);
   va_end(ap);
 #endif
+  j->type = msg;
   j->state = DT_JOB_STATE_INITIALIZED;
   dt_pthread_mutex_init (&j->state_mutex,NULL);
   dt_pthread_mutex_init (&j->wait_mutex,NULL);
@@ -922,6 +928,15 @@ int dt_control_job_get_state(dt_job_t *j)
   return state;
 }
 
+/* compares two jobs, all but the time they were queued at. */
+static int _control_job_equal(const dt_job_t *a, const dt_job_t *b)
+{
+  dt_job_t tmp;
+  memcpy(&tmp, a, sizeof(dt_job_t));
+  tmp.ts_queued = b->ts_queued;
+  return !memcmp(&tmp, b, sizeof(dt_job_t));
+}
+
 void dt_control_job_cancel(dt_job_t *j)
 {
   _control_job_set_state (j,DT_JOB_STATE_CANCELLED);
@@ -961,7 +976,9 @@ int32_t dt_control_run_job_res(dt_control_t *s, int32_t res)
     _control_job_set_state (j,DT_JOB_STATE_RUNNING);
 
     /* execute job */
+    const double start = dt_get_wtime();
     j->result = j->execute (j);
+    dt_control_telemetry_add(s, j->type, start - j->ts_queued, dt_get_wtime() - start, DT_CTL_WORKER_MAX + res);
 
     _control_job_set_state (j,DT_JOB_STATE_FINISHED);
     dt_print(DT_DEBUG_CONTROL, "[run_job-] %02d %f ", res, dt_get_wtime());
@@ -1039,7 +1056,9 @@ int32_t dt_control_run_job(dt_control_t *s)
     _control_job_set_state (j,DT_JOB_STATE_RUNNING);
 
     /* execute job */
+    const double start = dt_get_wtime();
     j->result = j->execute (j);
+    dt_control_telemetry_add(s, j->type, start - j->ts_queued, dt_get_wtime() - start, dt_control_get_threadid());
 
     _control_job_set_state (j,DT_JOB_STATE_FINISHED);
 
@@ -1067,6 +1086,7 @@ int32_t dt_control_add_job_res(dt_control_t *s, dt_job_t *job, int32_t res)
   dt_print(DT_DEBUG_CONTROL, "\n");
   _control_job_set_state (job,DT_JOB_STATE_QUEUED);
   s->job_res[res] = *job;
+  s->job_res[res].ts_queued = dt_get_wtime();
   s->new_res[res] = 1;
   dt_pthread_mutex_unlock(&s->queue_mutex);
   dt_pthread_mutex_lock(&s->cond_mutex);
@@ -1103,9 +1123,10 @@ int32_t dt_control_add_job(dt_control_t *s, dt_job_t *job)
   if(jobitem)
     do
     {
-      if(!memcmp(job, jobitem->data, sizeof(dt_job_t)))
+      if(_control_job_equal(job, jobitem->data))
       {
         dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue\n");
+        _control_telemetry_discarded(s, job, FALSE);
         _control_job_set_state (job,DT_JOB_STATE_DISCARDED);
         dt_pthread_mutex_unlock(&s->queue_mutex);
         return -1;
@@ -1123,13 +1144,16 @@ int32_t dt_control_add_job(dt_control_t *s, dt_job_t *job)
     /* allocate storage for the job, and set job state */
     dt_job_t *thejob = g_malloc(sizeof(dt_job_t));
     memcpy(thejob,job,sizeof(dt_job_t));
+    thejob->ts_queued = dt_get_wtime();
     _control_job_set_state (thejob,DT_JOB_STATE_QUEUED);
     s->queue = g_list_append(s->queue, thejob);
+    _control_telemetry_queue_depth(s, g_list_length(s->queue));
     dt_pthread_mutex_unlock(&s->queue_mutex);
   }
   else
   {
     dt_print(DT_DEBUG_CONTROL, "[add_job] too many jobs in queue!\n");
+    _control_telemetry_discarded(s, job, TRUE);
     _control_job_set_state (job,DT_JOB_STATE_DISCARDED);
     dt_pthread_mutex_unlock(&s->queue_mutex);
     return -1;
@@ -1155,7 +1179,7 @@ int32_t dt_control_revive_job(dt_control_t *s, dt_job_t *job)
   if (jobitem)
     do
     {
-      if(!memcmp(job, jobitem->data, sizeof(dt_job_t)))
+      if(_control_job_equal(job, jobitem->data))
       {
         s->queue = g_list_remove_link(s->queue, jobitem);
         s->queue = g_list_insert(s->queue, jobitem->data, 0);
@@ -1249,6 +1273,186 @@ void *dt_control_work(void *ptr)
 }
 
 
+// ================================================================================
+//  job telemetry:
+// ================================================================================
+
+static const char *_control_reserved_worker_names[DT_CTL_WORKER_RESERVED] =
+{
+  "dev load raw", "dev zoom 1", "dev zoom fill", "dev zoom fit",
+  "dev small prev", "dev prefetch", "scheduled jobs", "unused"
+};
+
+static int _control_telemetry_bucket(const double seconds)
+{
+  const double ms = 1000.0*seconds;
+  int k = 0;
+  while(k < DT_CONTROL_TELEMETRY_BUCKETS-1 && ms >= (double)(1<<k)) k++;
+  return k;
+}
+
+static void _control_job_stats_free(gpointer data)
+{
+  dt_control_job_stats_t *st = (dt_control_job_stats_t *)data;
+  g_free(st->type);
+  g_free(st);
+}
+
+// the stats of the given job type, created on first use. needs the telemetry_mutex.
+static dt_control_job_stats_t *_control_job_stats(dt_control_t *s, const char *type)
+{
+  if(!type) type = "unknown";
+  dt_control_job_stats_t *st = (dt_control_job_stats_t *)g_hash_table_lookup(s->job_stats, type);
+  if(!st)
+  {
+    st = (dt_control_job_stats_t *)g_malloc0(sizeof(dt_control_job_stats_t));
+    st->type = g_strdup(type);
+    g_hash_table_insert(s->job_stats, st->type, st);
+  }
+  return st;
+}
+
+void dt_control_telemetry_init(dt_control_t *s)
+{
+  dt_pthread_mutex_init(&s->telemetry_mutex, NULL);
+  s->telemetry_start = dt_get_wtime();
+  s->job_stats = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _control_job_stats_free);
+  s->queue_depth_max = 0;
+  s->queue_full = 0;
+  memset(s->worker_busy, 0, sizeof(s->worker_busy));
+}
+
+void dt_control_telemetry_cleanup(dt_control_t *s)
+{
+  if(!s->job_stats) return;
+  g_hash_table_destroy(s->job_stats);
+  s->job_stats = NULL;
+  dt_pthread_mutex_destroy(&s->telemetry_mutex);
+}
+
+void dt_control_telemetry_add(dt_control_t *s, const char *type, const double wait, const double run, const int worker)
+{
+  if(!s->job_stats) return;
+  dt_pthread_mutex_lock(&s->telemetry_mutex);
+  dt_control_job_stats_t *st = _control_job_stats(s, type);
+  st->runs++;
+  st->wait_total += wait;
+  st->wait_max = MAX(st->wait_max, wait);
+  st->run_total += run;
+  st->run_max = MAX(st->run_max, run);
+  st->wait_histogram[_control_telemetry_bucket(wait)]++;
+  st->run_histogram[_control_telemetry_bucket(run)]++;
+  if(worker >= 0 && worker < DT_CTL_WORKER_MAX + DT_CTL_WORKER_RESERVED) s->worker_busy[worker] += run;
+  dt_pthread_mutex_unlock(&s->telemetry_mutex);
+}
+
+static void _control_telemetry_discarded(dt_control_t *s, const dt_job_t *job, const gboolean queue_full)
+{
+  if(!s->job_stats) return;
+  dt_pthread_mutex_lock(&s->telemetry_mutex);
+  _control_job_stats(s, job->type)->discarded++;
+  if(queue_full) s->queue_full++;
+  dt_pthread_mutex_unlock(&s->telemetry_mutex);
+}
+
+static void _control_telemetry_queue_depth(dt_control_t *s, const int depth)
+{
+  if(!s->job_stats) return;
+  dt_pthread_mutex_lock(&s->telemetry_mutex);
+  s->queue_depth_max = MAX(s->queue_depth_max, depth);
+  dt_pthread_mutex_unlock(&s->telemetry_mutex);
+}
+
+static gint _control_job_stats_compare(gconstpointer a, gconstpointer b)
+{
+  return strcmp(((const dt_control_job_stats_t *)a)->type, ((const dt_control_job_stats_t *)b)->type);
+}
+
+void dt_control_telemetry_get(dt_control_t *s, dt_control_telemetry_t *t)
+{
+  memset(t, 0, sizeof(dt_control_telemetry_t));
+  if(!s->job_stats) return;
+  // without gui there are no workers, and no queue either:
+  if(s->num_threads)
+  {
+    dt_pthread_mutex_lock(&s->queue_mutex);
+    t->queue_depth = g_list_length(s->queue);
+    dt_pthread_mutex_unlock(&s->queue_mutex);
+  }
+  dt_pthread_mutex_lock(&s->telemetry_mutex);
+  t->uptime = dt_get_wtime() - s->telemetry_start;
+  t->queue_depth_max = s->queue_depth_max;
+  t->queue_full = s->queue_full;
+  t->num_workers = s->num_threads;
+  memcpy(t->busy, s->worker_busy, sizeof(t->busy));
+  GHashTableIter it;
+  gpointer value;
+  g_hash_table_iter_init(&it, s->job_stats);
+  while(g_hash_table_iter_next(&it, NULL, &value))
+  {
+    dt_control_job_stats_t *st = (dt_control_job_stats_t *)g_memdup(value, sizeof(dt_control_job_stats_t));
+    st->type = g_strdup(st->type);
+    t->jobs = g_list_prepend(t->jobs, st);
+  }
+  dt_pthread_mutex_unlock(&s->telemetry_mutex);
+  t->jobs = g_list_sort(t->jobs, _control_job_stats_compare);
+}
+
+void dt_control_telemetry_free(dt_control_telemetry_t *t)
+{
+  for(GList *l = t->jobs; l; l = g_list_next(l)) _control_job_stats_free(l->data);
+  g_list_free(t->jobs);
+  t->jobs = NULL;
+}
+
+static void _control_telemetry_histogram(GString *str, const char *what, const uint32_t *histogram)
+{
+  g_string_append_printf(str, "[telemetry]     %s", what);
+  for(int k=0; k<DT_CONTROL_TELEMETRY_BUCKETS; k++)
+  {
+    if(!histogram[k]) continue;
+    if(k < DT_CONTROL_TELEMETRY_BUCKETS-1)
+      g_string_append_printf(str, " <%dms:%u", 1<<k, histogram[k]);
+    else
+      g_string_append_printf(str, " >=%dms:%u", 1<<(k-1), histogram[k]);
+  }
+  g_string_append(str, "\n");
+}
+
+gchar *dt_control_telemetry_to_string(dt_control_t *s)
+{
+  dt_control_telemetry_t t;
+  dt_control_telemetry_get(s, &t);
+  GString *str = g_string_new(NULL);
+  const double uptime = MAX(t.uptime, 1e-6);
+  g_string_append_printf(str, "[telemetry] jobs after %.1fs: queue depth %d, at most %d, %u discarded because the queue was full\n",
+                         t.uptime, t.queue_depth, t.queue_depth_max, t.queue_full);
+  for(int k=0; k<t.num_workers; k++)
+    g_string_append_printf(str, "[telemetry]   worker %d: busy %.1fs (%.1f%%)\n",
+                           k, t.busy[k], 100.0*t.busy[k]/uptime);
+  for(int k=0; k<DT_CTL_WORKER_RESERVED; k++)
+  {
+    const double busy = t.busy[DT_CTL_WORKER_MAX + k];
+    if(busy > 0.0)
+      g_string_append_printf(str, "[telemetry]   reserved worker %d (%s): busy %.1fs (%.1f%%)\n",
+                             k, _control_reserved_worker_names[k], busy, 100.0*busy/uptime);
+  }
+  for(GList *l = t.jobs; l; l = g_list_next(l))
+  {
+    const dt_control_job_stats_t *st = (const dt_control_job_stats_t *)l->data;
+    const double runs = MAX(st->runs, 1);
+    g_string_append_printf(str, "[telemetry]   %s: %u runs, %u discarded, wait avg %.1fms max %.1fms, run avg %.1fms max %.1fms\n",
+                           st->type, st->runs, st->discarded, 1000.0*st->wait_total/runs, 1000.0*st->wait_max,
+                           1000.0*st->run_total/runs, 1000.0*st->run_max);
+    if(!st->runs) continue;
+    _control_telemetry_histogram(str, "wait", st->wait_histogram);
+    _control_telemetry_histogram(str, "run ", st->run_histogram);
+  }
+  dt_control_telemetry_free(&t);
+  return g_string_free(str, FALSE);
+}
+
+
 // ================================================================================
 //  gui functions:
 // ================================================================================
@@ -1826,6 +2030,12 @@ void dt_control_backgroundjobs_progress(const struct dt_control_t *s, const guin
     s->proxy.backgroundjobs.progress(s->proxy.backgroundjobs.module, key, progress);
 }
 
+void dt_control_backgroundjobs_set_message(const struct dt_control_t *s, const guint *key, const gchar *message)
+{
+  if (s->proxy.backgroundjobs.module)
+    s->proxy.backgroundjobs.set_message(s->proxy.backgroundjobs.module, key, message);
+}
+
 void dt_control_backgroundjobs_set_cancellable(const struct dt_control_t *s, const guint *key, dt_job_t *job)
 {
   if (s->proxy.backgroundjobs.module)
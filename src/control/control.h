@@ -45,6 +45,10 @@
 #define DT_CTL_WORKER_5 4 // dev small prev
 #define DT_CTL_WORKER_6 5 // dev prefetch
 #define DT_CTL_WORKER_7 6 // scheduled jobs nice level
+// most regular workers, see worker_threads
+#define DT_CTL_WORKER_MAX 8
+// telemetry histogram buckets, bucket k counts times below 2^k ms, the last one all longer times
+#define DT_CONTROL_TELEMETRY_BUCKETS 16
 
 // A mask to strip out the Ctrl, Shift, and Alt mod keys for shortcuts
 #define KEY_STATE_MASK (GDK_CONTROL_MASK | GDK_SHIFT_MASK | GDK_MOD1_MASK)
@@ -124,6 +128,8 @@ const guint *dt_control_backgroundjobs_create(const struct dt_control_t *s,guint
 void dt_control_backgroundjobs_destroy(const struct dt_control_t *s, const guint *key);
 /** sets the progress of a backgroundjob using hash id reference */
 void dt_control_backgroundjobs_progress(const struct dt_control_t *s, const guint *key, double progress);
+/** replaces the label of a backgroundjob using hash id reference */
+void dt_control_backgroundjobs_set_message(const struct dt_control_t *s, const guint *key, const gchar *message);
 /** assign a dt_job_t to a bgjob which makes it cancellable thru ui interaction */
 void dt_control_backgroundjobs_set_cancellable(const struct dt_control_t *s, const guint *key,struct dt_job_t *job);
 
@@ -158,6 +164,10 @@ typedef struct dt_job_t
   /* if job is a delayed job it will be run as a backgroundjob
       and ts_execute will be the timestamp of when to start job */
   time_t ts_execute;
+  /* wall time the job entered the queue or a reserved slot, for the telemetry */
+  double ts_queued;
+  /* the message given to dt_control_job_init(), before formatting. groups jobs in the telemetry */
+  const char *type;
 
   dt_pthread_mutex_t state_mutex;
   dt_pthread_mutex_t wait_mutex;
@@ -184,6 +194,44 @@ int dt_control_job_get_state(dt_job_t *j);
 /** wait for a job to finish execution. */
 void dt_control_job_wait(dt_job_t *j);
 
+/** accumulated timings of all jobs of one type. */
+typedef struct dt_control_job_stats_t
+{
+  gchar *type;
+  uint32_t runs;      // jobs executed
+  uint32_t discarded; // jobs not queued, because an equal one was queued already or the queue was full
+  double wait_total, wait_max; // seconds from queueing to execution
+  double run_total, run_max;   // seconds of execution
+  uint32_t wait_histogram[DT_CONTROL_TELEMETRY_BUCKETS];
+  uint32_t run_histogram[DT_CONTROL_TELEMETRY_BUCKETS];
+}
+dt_control_job_stats_t;
+
+/** a snapshot of the job telemetry, see dt_control_telemetry_get(). */
+typedef struct dt_control_telemetry_t
+{
+  double uptime;            // seconds since the telemetry was started
+  int queue_depth;          // jobs waiting in the queue right now
+  int queue_depth_max;
+  uint32_t queue_full;      // jobs discarded because the queue was full
+  int num_workers;          // regular workers
+  // seconds spent executing jobs, by regular worker k in busy[k], by reserved worker k in busy[DT_CTL_WORKER_MAX + k]
+  double busy[DT_CTL_WORKER_MAX + DT_CTL_WORKER_RESERVED];
+  GList *jobs;              // dt_control_job_stats_t, sorted by type
+}
+dt_control_telemetry_t;
+
+/** starts recording job timings, done by dt_control_init() and for darktable without gui. */
+void dt_control_telemetry_init(struct dt_control_t *s);
+void dt_control_telemetry_cleanup(struct dt_control_t *s);
+/** accounts a job of the given type which waited and ran for the given seconds on worker (-1 for none). */
+void dt_control_telemetry_add(struct dt_control_t *s, const char *type, double wait, double run, int worker);
+/** fills t with the current numbers, free with dt_control_telemetry_free(). */
+void dt_control_telemetry_get(struct dt_control_t *s, dt_control_telemetry_t *t);
+void dt_control_telemetry_free(dt_control_telemetry_t *t);
+/** human readable table of the telemetry, to be freed with g_free(). */
+gchar *dt_control_telemetry_to_string(struct dt_control_t *s);
+
 //z All the accelerator keys for the key_pressed style shortcuts
 typedef struct dt_control_accels_t
 {
@@ -260,6 +308,14 @@ typedef struct dt_control_t
   uint8_t new_res[DT_CTL_WORKER_RESERVED];
   pthread_t thread_res[DT_CTL_WORKER_RESERVED];
 
+  // job telemetry, protected by telemetry_mutex
+  dt_pthread_mutex_t telemetry_mutex;
+  double telemetry_start;
+  GHashTable *job_stats; // type -> dt_control_job_stats_t
+  int queue_depth_max;
+  uint32_t queue_full;
+  double worker_busy[DT_CTL_WORKER_MAX + DT_CTL_WORKER_RESERVED];
+
   /* proxy */
   struct
   {
@@ -270,6 +326,7 @@ typedef struct dt_control_t
       const guint *(*create)(dt_lib_module_t *self, int type, const gchar *message);
       void (*destroy)(dt_lib_module_t *self, const guint *key);
       void (*progress)(dt_lib_module_t *self, const guint *key, double progress);
+      void (*set_message)(dt_lib_module_t *self, const guint *key, const gchar *message);
       void (*set_cancellable)(dt_lib_module_t *self, const guint *key, dt_job_t *job);
     } backgroundjobs;
 
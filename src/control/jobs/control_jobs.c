@@ -27,6 +27,8 @@
 #include "common/film.h"
 #include "common/history.h"
 #include "common/imageio_module.h"
+#include "common/sidecar_writer.h"
+#include "develop/pixelpipe_shared.h"
 #include "common/debug.h"
 #include "common/tags.h"
 #include "common/debug.h"
@@ -39,6 +41,9 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 
+/** images removed per database transaction by dt_control_remove_images_job_run(). */
+#define DT_CONTROL_REMOVE_BATCH 64
+
 #if GLIB_CHECK_VERSION (2, 26, 0)
 typedef struct dt_control_time_offset_t
 {
@@ -47,7 +52,7 @@ typedef struct dt_control_time_offset_t
 
 typedef struct dt_control_gpx_apply_t
 {
-  gchar *filename;
+  GSList *filenames;
   gchar *tz;
 } dt_control_gpx_apply_t;
 #endif
@@ -361,12 +366,19 @@ int32_t dt_control_remove_images_job_run(dt_job_t *job)
   }
   sqlite3_finalize(stmt);
 
+  // one transaction per batch of images. the progress is reported in between, it takes
+  // the gdk lock, and the gui thread might hold that one while waiting for a transaction.
   while(t)
   {
-    imgid = (long int)t->data;
-    dt_image_remove(imgid);
-    t = g_list_delete_link(t, t);
-    fraction=1.0/total;
+    dt_database_start_transaction(darktable.db);
+    for(int k=0; k<DT_CONTROL_REMOVE_BATCH && t; k++)
+    {
+      imgid = (long int)t->data;
+      dt_image_remove(imgid);
+      t = g_list_delete_link(t, t);
+      fraction+=1.0/total;
+    }
+    dt_database_release_transaction(darktable.db);
     dt_control_backgroundjobs_progress(darktable.control, jid, fraction);
   }
 
@@ -467,19 +479,21 @@ int32_t dt_control_gpx_apply_job_run(dt_job_t *job)
   struct dt_gpx_t *gpx = NULL;
   uint32_t cntr = 0;
   const dt_control_gpx_apply_t *d = t1->data;
-  const gchar *filename = d->filename;
   const gchar *tz = d->tz;
 
   /* do we have any selected images */
-  if (!t)
+  if (!t || !d->filenames)
     goto bail_out;
 
-  /* try parse the gpx data */
-  gpx = dt_gpx_new(filename);
-  if (!gpx)
+  /* try parse the gpx data, all files are merged into one track */
+  for (GSList *f = d->filenames; f; f = g_slist_next(f))
   {
-    dt_control_log(_("failed to parse gpx file"));
-    goto bail_out;
+    const gchar *filename = (const gchar *)f->data;
+    if (gpx ? !dt_gpx_add(gpx, filename) : !(gpx = dt_gpx_new(filename)))
+    {
+      dt_control_log(_("failed to parse gpx file"));
+      goto bail_out;
+    }
   }
 
   GTimeZone *tz_camera = (tz == NULL)?g_time_zone_new_utc():g_time_zone_new(tz);
@@ -487,6 +501,10 @@ int32_t dt_control_gpx_apply_job_run(dt_job_t *job)
     goto bail_out;
   GTimeZone *tz_utc = g_time_zone_new_utc();
 
+  /* all images are updated in one transaction, the xmp files are
+     written later on by the sidecar writer */
+  dt_database_start_transaction(darktable.db);
+
   /* go thru each selected image and lookup location in gpx */
   do
   {
@@ -545,12 +563,14 @@ int32_t dt_control_gpx_apply_job_run(dt_job_t *job)
   }
   while((t = g_list_next(t)) != NULL);
 
+  dt_database_release_transaction(darktable.db);
+
   dt_control_log(_("applied matched gpx location onto %d image(s)"), cntr);
 
   g_time_zone_unref(tz_camera);
   g_time_zone_unref(tz_utc);
   dt_gpx_destroy(gpx);
-  g_free(d->filename);
+  g_slist_free_full(d->filenames, g_free);
   g_free(d->tz);
   g_free(t1->data);
   return 0;
@@ -559,7 +579,7 @@ bail_out:
   if (gpx)
     dt_gpx_destroy(gpx);
 
-  g_free(d->filename);
+  g_slist_free_full(d->filenames, g_free);
   g_free(d->tz);
   g_free(t1->data);
   return 1;
@@ -579,9 +599,10 @@ void dt_control_image_enumerator_job_film_init(dt_control_image_enumerator_t *t,
   while (sqlite3_step(stmt) == SQLITE_ROW)
   {
     long int imgid = sqlite3_column_int(stmt, 0);
-    t->index = g_list_append(t->index, (gpointer)imgid);
+    t->index = g_list_prepend(t->index, (gpointer)imgid);
   }
   sqlite3_finalize(stmt);
+  t->index = g_list_reverse(t->index);
 }
 
 /* enumerator of selected images */
@@ -643,7 +664,7 @@ void dt_control_delete_images_job_init(dt_job_t *job)
 }
 
 #if GLIB_CHECK_VERSION (2, 26, 0)
-void dt_control_gpx_apply_job_init(dt_job_t *job, const gchar *filename, int32_t filmid, const gchar *tz)
+void dt_control_gpx_apply_job_init(dt_job_t *job, const GSList *filenames, int32_t filmid, const gchar *tz)
 {
   dt_control_job_init(job, "gpx apply");
   job->execute = &dt_control_gpx_apply_job_run;
@@ -654,7 +675,9 @@ void dt_control_gpx_apply_job_init(dt_job_t *job, const gchar *filename, int32_t
     dt_control_image_enumerator_job_selected_init(t);
 
   dt_control_gpx_apply_t *data = (dt_control_gpx_apply_t*)malloc(sizeof(dt_control_gpx_apply_t));
-  data->filename = g_strdup(filename);
+  data->filenames = NULL;
+  for (const GSList *f = filenames; f; f = g_slist_next(f))
+    data->filenames = g_slist_append(data->filenames, g_strdup((const gchar *)f->data));
   data->tz = g_strdup(tz);
   t->data = data;
 }
@@ -668,10 +691,10 @@ void dt_control_merge_hdr()
 }
 
 #if GLIB_CHECK_VERSION (2, 26, 0)
-void dt_control_gpx_apply(const gchar *filename, int32_t filmid, const gchar *tz)
+void dt_control_gpx_apply(const GSList *filenames, int32_t filmid, const gchar *tz)
 {
   dt_job_t j;
-  dt_control_gpx_apply_job_init(&j, filename, filmid, tz);
+  dt_control_gpx_apply_job_init(&j, filenames, filmid, tz);
   dt_control_add_job(darktable.control, &j);
 }
 #endif
@@ -977,6 +1000,97 @@ int32_t dt_control_local_copy_images_job_run(dt_job_t *job)
   return 0;
 }
 
+/** decode stage of the export: loads the full buffers of the next images into
+ *  the mipmap cache while the export threads are busy processing, encoding and
+ *  writing the current ones. runs at most `budget' images ahead of them. */
+typedef struct _export_prefetch_t
+{
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int32_t *imgs;
+  int total;
+  int next;         // next image to be decoded
+  int consumed;     // images taken by the export threads
+  int budget;       // max images decoded ahead
+  int running;
+  int num_threads;
+  pthread_t *threads;
+  double decode_time;
+  int decoded;
+}
+_export_prefetch_t;
+
+static void *_export_prefetch_thread(void *data)
+{
+  _export_prefetch_t *p = (_export_prefetch_t *)data;
+  dt_pthread_mutex_lock(&p->mutex);
+  while(p->running && p->next < p->total)
+  {
+    // the export threads overtook us, no use decoding those:
+    if(p->next < p->consumed) p->next = p->consumed;
+    if(p->next >= p->total) break;
+    if(p->next >= p->consumed + p->budget)
+    {
+      dt_pthread_cond_wait(&p->cond, &p->mutex);
+      continue;
+    }
+    const int32_t imgid = p->imgs[p->next++];
+    dt_pthread_mutex_unlock(&p->mutex);
+
+    const double start = dt_get_wtime();
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_read_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING);
+    dt_mipmap_cache_read_release(darktable.mipmap_cache, &buf);
+    const double end = dt_get_wtime();
+
+    dt_pthread_mutex_lock(&p->mutex);
+    p->decode_time += end - start;
+    p->decoded++;
+  }
+  dt_pthread_mutex_unlock(&p->mutex);
+  return NULL;
+}
+
+static void _export_prefetch_start(_export_prefetch_t *p, GList *imgs)
+{
+  memset(p, 0, sizeof(_export_prefetch_t));
+  dt_pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  p->total = g_list_length(imgs);
+  p->imgs = (int32_t *)g_malloc(sizeof(int32_t)*MAX(1, p->total));
+  for(int k=0; imgs; imgs = g_list_next(imgs)) p->imgs[k++] = (long int)imgs->data;
+  p->budget = MAX(0, dt_conf_get_int("parallel_export_prefetch"));
+  p->running = 1;
+  // nothing to overlap with for a single image:
+  p->num_threads = (p->budget > 0 && p->total > 1) ? CLAMP(dt_conf_get_int("parallel_export_decoders"), 1, 4) : 0;
+  p->threads = (pthread_t *)g_malloc(sizeof(pthread_t)*MAX(1, p->num_threads));
+  for(int k=0; k<p->num_threads; k++)
+    pthread_create(&p->threads[k], NULL, &_export_prefetch_thread, p);
+}
+
+/** called by the export threads when they pick the next image. */
+static void _export_prefetch_consume(_export_prefetch_t *p)
+{
+  dt_pthread_mutex_lock(&p->mutex);
+  p->consumed++;
+  pthread_cond_broadcast(&p->cond);
+  dt_pthread_mutex_unlock(&p->mutex);
+}
+
+static void _export_prefetch_stop(_export_prefetch_t *p)
+{
+  dt_pthread_mutex_lock(&p->mutex);
+  p->running = 0;
+  pthread_cond_broadcast(&p->cond);
+  dt_pthread_mutex_unlock(&p->mutex);
+  for(int k=0; k<p->num_threads; k++)
+    pthread_join(p->threads[k], NULL);
+  g_free(p->threads);
+  g_free(p->imgs);
+  pthread_cond_destroy(&p->cond);
+  dt_pthread_mutex_destroy(&p->mutex);
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
   long int imgid = -1;
@@ -1018,6 +1132,14 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   dt_control_backgroundjobs_set_cancellable(darktable.control, jid, job);
   const dt_control_t *control = darktable.control;
 
+  // decode ahead in separate threads, so the cores stay busy while the export threads wait for i/o:
+  _export_prefetch_t prefetch;
+  _export_prefetch_start(&prefetch, t);
+  // keep demosaiced images around for other export jobs running on the same images:
+  dt_dev_pixelpipe_shared_begin(darktable.pipe_shared);
+  const double start = dt_get_wtime();
+  int done = 0;
+
   double fraction=0;
 #ifdef _OPENMP
   // limit this to num threads = num full buffers - 1 (keep one for darkroom mode)
@@ -1027,9 +1149,9 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   // it set but not used, which makes for instance Fedora break.
   const __attribute__((__unused__)) int num_threads = MAX(1, MIN(full_entries, 8));
 #if !defined(__SUNOS__) && !defined(__NetBSD__)
-  #pragma omp parallel default(none) private(imgid) shared(control, fraction, w, h, stderr, mformat, mstorage, t, sdata, job, jid, darktable, settings) num_threads(num_threads) if(num_threads > 1)
+  #pragma omp parallel default(none) private(imgid) shared(control, fraction, done, w, h, stderr, mformat, mstorage, t, sdata, job, jid, darktable, settings, prefetch, message) num_threads(num_threads) if(num_threads > 1)
 #else
-  #pragma omp parallel private(imgid) shared(control, fraction, w, h, mformat, mstorage, t, sdata, job, jid, darktable, settings) num_threads(num_threads) if(num_threads > 1)
+  #pragma omp parallel private(imgid) shared(control, fraction, done, w, h, mformat, mstorage, t, sdata, job, jid, darktable, settings, prefetch, message) num_threads(num_threads) if(num_threads > 1)
 #endif
   {
 #endif
@@ -1062,6 +1184,7 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
           num = total - g_list_length(t);
         }
       }
+      if(imgid) _export_prefetch_consume(&prefetch);
       // remove 'changed' tag from image
       dt_tag_detach(tagid, imgid);
       // make sure the 'exported' tag is set on the image
@@ -1083,7 +1206,9 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
         else
         {
           dt_image_cache_read_release(darktable.image_cache, image);
-          mstorage->store(mstorage,sdata, imgid, mformat, fdata, num, total, settings->high_quality);
+          // storages may copy the sidecar along, make sure it's up to date:
+          dt_sidecar_writer_sync(darktable.sidecar_writer, imgid);
+          mstorage->store(mstorage,sdata, imgid, mformat, fdata, num, total, settings->high_quality, settings->demosaic_half_size);
         }
       }
 #ifdef _OPENMP
@@ -1091,6 +1216,12 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
 #endif
       {
         fraction+=1.0/total;
+        done++;
+        // throughput so far, the first image also pays for the pipe and kernel setup:
+        char stats[512];
+        const double elapsed = dt_get_wtime() - start;
+        snprintf(stats, 512, _("%s\n%d/%d done, %.1f images/min"), message, done, total, 60.0*done/MAX(elapsed, 1e-3));
+        dt_control_backgroundjobs_set_message(control, jid, stats);
         dt_control_backgroundjobs_progress(control, jid, fraction);
       }
     }
@@ -1108,12 +1239,16 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
 #ifdef _OPENMP
   }
 #endif
+  _export_prefetch_stop(&prefetch);
+  dt_dev_pixelpipe_shared_end(darktable.pipe_shared);
+  dt_print(DT_DEBUG_PERF, "[export] %d images in %.3f secs, %d decoded ahead by %d threads in %.3f secs\n",
+           done, dt_get_wtime() - start, prefetch.decoded, prefetch.num_threads, prefetch.decode_time);
   g_free(t1->data);
   return 0;
 }
 
 
-void dt_control_export(GList *imgid_list,int max_width, int max_height, int format_index, int storage_index, gboolean high_quality,char *style)
+void dt_control_export(GList *imgid_list,int max_width, int max_height, int format_index, int storage_index, gboolean high_quality, gboolean demosaic_half_size, char *style)
 {
   dt_job_t job;
   dt_control_job_init(&job, "export");
@@ -1126,6 +1261,7 @@ void dt_control_export(GList *imgid_list,int max_width, int max_height, int form
   data->format_index = format_index;
   data->storage_index = storage_index;
   data->high_quality = high_quality;
+  data->demosaic_half_size = demosaic_half_size;
   strncpy(data->style,style,128);
   t->data = data;
   dt_control_signal_raise(darktable.signals,DT_SIGNAL_IMAGE_EXPORT_MULTIPLE,t);
@@ -25,6 +25,7 @@ typedef struct dt_control_export_t
 {
   int max_width, max_height, format_index, storage_index;
   gboolean high_quality;
+  gboolean demosaic_half_size;
   char style[128];
 } dt_control_export_t;
 
@@ -66,8 +67,9 @@ int32_t dt_control_delete_images_job_run(dt_job_t *job);
 
 
 #if GLIB_CHECK_VERSION (2, 26, 0)
-void dt_control_gpx_apply(const gchar *filename, int32_t filmid, const gchar *tz);
-void dt_control_gpx_apply_job_init(dt_job_t *job, const gchar *filename, int32_t filmid, const gchar *tz);
+/** geotags the images of film roll filmid (or the selected ones if -1) from the merged tracks of one or more gpx files. */
+void dt_control_gpx_apply(const GSList *filenames, int32_t filmid, const gchar *tz);
+void dt_control_gpx_apply_job_init(dt_job_t *job, const GSList *filenames, int32_t filmid, const gchar *tz);
 int32_t dt_control_gpx_apply_job_run(dt_job_t *job);
 
 void dt_control_time_offset(const long int offset, long int imgid);
@@ -84,10 +86,10 @@ void dt_control_move_images();
 void dt_control_copy_images();
 void dt_control_set_local_copy_images();
 void dt_control_reset_local_copy_images();
-void dt_control_export(GList *imgid_list,int max_width, int max_height, int format_index, int storage_index, gboolean high_quality,char *style);
+void dt_control_export(GList *imgid_list,int max_width, int max_height, int format_index, int storage_index, gboolean high_quality, gboolean demosaic_half_size, char *style);
 void dt_control_merge_hdr();
 
-void dt_control_gpx_apply(const gchar *filename, int32_t filmid, const gchar *tz);
+void dt_control_gpx_apply(const GSList *filenames, int32_t filmid, const gchar *tz);
 void dt_control_time_offset(const long int offset, long int imgid);
 
 void dt_control_seed_denoise();
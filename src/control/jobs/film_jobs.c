@@ -16,8 +16,10 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "common/darktable.h"
+#include "common/debug.h"
 #include "common/film.h"
 #include "control/jobs/film_jobs.h"
+#include <sqlite3.h>
 #include <stdlib.h>
 
 void dt_film_import1_init(dt_job_t *job, dt_film_t *film)
@@ -45,6 +47,93 @@ int32_t dt_film_import1_run(dt_job_t *job)
   }
   return 0;
 }
+
+// the thumbnail job which is running right now, if any, and the film roll thumbnails are wanted for.
+// jobs are copied into the queue, so the running one registers itself here.
+static GStaticMutex _film_mipmaps_mutex = G_STATIC_MUTEX_INIT;
+static dt_job_t *_film_mipmaps_job = NULL;
+static int32_t _film_mipmaps_film = -1;
+
+void dt_film_mipmaps_init(dt_job_t *job, const int32_t film_id, const dt_mipmap_size_t mip)
+{
+  dt_control_job_init(job, "generate thumbnails for film roll %d", film_id);
+  job->execute = &dt_film_mipmaps_run;
+  dt_film_mipmaps_t *t = (dt_film_mipmaps_t *)job->param;
+  t->film_id = film_id;
+  t->mip = mip;
+  g_static_mutex_lock(&_film_mipmaps_mutex);
+  _film_mipmaps_film = film_id;
+  g_static_mutex_unlock(&_film_mipmaps_mutex);
+}
+
+void dt_film_mipmaps_cancel()
+{
+  g_static_mutex_lock(&_film_mipmaps_mutex);
+  // jobs still in the queue see this when they start:
+  _film_mipmaps_film = -1;
+  if(_film_mipmaps_job) dt_control_job_cancel(_film_mipmaps_job);
+  g_static_mutex_unlock(&_film_mipmaps_mutex);
+}
+
+int32_t dt_film_mipmaps_run(dt_job_t *job)
+{
+  dt_film_mipmaps_t *t = (dt_film_mipmaps_t *)job->param;
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+
+  g_static_mutex_lock(&_film_mipmaps_mutex);
+  if(t->film_id != _film_mipmaps_film)
+  {
+    // another roll has been opened since this one was queued.
+    g_static_mutex_unlock(&_film_mipmaps_mutex);
+    return 0;
+  }
+  _film_mipmaps_job = job;
+  g_static_mutex_unlock(&_film_mipmaps_mutex);
+
+  // there's no point in generating more thumbnails than the cache can hold,
+  // they would only push out each other again. also leave room for the ones
+  // the user is actually looking at.
+  const int max_images = dt_cache_capacity(&cache->mip[t->mip].cache)/2;
+
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "select id from images where film_id = ?1 order by filename, version limit ?2",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, t->film_id);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_images);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  imgs = g_list_reverse(imgs);
+
+  // one image after the other in this job only, so the worker threads stay
+  // available for the thumbnails that are requested interactively.
+  int generated = 0;
+  for(GList *l = imgs; l; l = g_list_next(l))
+  {
+    if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) break;
+    const int imgid = GPOINTER_TO_INT(l->data);
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_read_get(cache, &buf, imgid, t->mip, DT_MIPMAP_TESTLOCK);
+    if(buf.buf)
+    {
+      dt_mipmap_cache_read_release(cache, &buf);
+      continue;
+    }
+    // generating this one also fills all smaller sizes:
+    dt_mipmap_cache_read_get(cache, &buf, imgid, t->mip, DT_MIPMAP_BLOCKING);
+    if(buf.buf) dt_mipmap_cache_read_release(cache, &buf);
+    generated++;
+  }
+  dt_print(DT_DEBUG_CACHE, "[film_mipmaps] generated %d of %d thumbnails for film roll %d\n",
+           generated, g_list_length(imgs), t->film_id);
+  g_list_free(imgs);
+  g_static_mutex_lock(&_film_mipmaps_mutex);
+  if(_film_mipmaps_job == job) _film_mipmaps_job = NULL;
+  g_static_mutex_unlock(&_film_mipmaps_mutex);
+  return 0;
+}
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -20,6 +20,7 @@
 
 #include <inttypes.h>
 #include "control/control.h"
+#include "common/mipmap_cache.h"
 
 typedef struct dt_film_import1_t
 {
@@ -30,6 +31,20 @@ dt_film_import1_t;
 int32_t dt_film_import1_run(dt_job_t *job);
 void dt_film_import1_init(dt_job_t *job, dt_film_t *film);
 
+typedef struct dt_film_mipmaps_t
+{
+  int32_t film_id;
+  dt_mipmap_size_t mip;
+}
+dt_film_mipmaps_t;
+
+/** fills the mipmap cache with thumbnails of this size (and all smaller ones) for a whole film roll. */
+int32_t dt_film_mipmaps_run(dt_job_t *job);
+/** only the thumbnails of the film roll initialized last are generated, earlier jobs stop. */
+void dt_film_mipmaps_init(dt_job_t *job, const int32_t film_id, const dt_mipmap_size_t mip);
+/** cancels the running thumbnail job, and the queued ones once they start. */
+void dt_film_mipmaps_cancel();
+
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -1939,7 +1939,7 @@ void dt_develop_blend_process (struct dt_iop_module_t *self, struct dt_dev_pixel
         const float mmax[] = { 1.0f };
         const float mmin[] = { 0.0f };
 
-        dt_gaussian_t *g = dt_gaussian_init(roi_out->width, roi_out->height, 1, mmax, mmin, sigma, 0);
+        dt_gaussian_t *g = dt_gaussian_init(piece->pipe, roi_out->width, roi_out->height, 1, mmax, mmin, sigma, 0);
         if(g)
         {
           dt_gaussian_blur(g, mask, mask);
@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
+#include <limits.h>
 #include <string.h>
 #include <strings.h>
 #include <assert.h>
@@ -43,6 +44,7 @@
 #define DT_DEV_AVERAGE_DELAY_START            250
 #define DT_DEV_PREVIEW_AVERAGE_DELAY_START     50
 #define DT_DEV_AVERAGE_DELAY_COUNT              5
+#define DT_DEV_SETTLE_DELAY                   500
 
 
 const gchar* dt_dev_histogram_type_names[DT_DEV_HISTOGRAM_N] = { "logarithmic", "linear", "waveform" };
@@ -60,6 +62,8 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
   dt_pthread_mutex_init(&dev->history_mutex, NULL);
   dev->history_end = 0;
   dev->history = NULL; // empty list
+  dev->history_db.imgid = 0;
+  dev->history_db.hash = g_array_new(FALSE, FALSE, sizeof(uint64_t));
 
   dev->gui_attached = gui_attached;
   dev->width = -1;
@@ -70,6 +74,8 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
   dev->image_loading = dev->preview_loading = 0;
   dev->image_force_reload = 0;
   dev->preview_input_changed = 0;
+  dev->image_damaged = 0;
+  dev->image_settle = 0;
 
   dev->pipe = dev->preview_pipe = NULL;
   dt_pthread_mutex_init(&dev->pipe_mutex, NULL);
@@ -116,6 +122,7 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
 void dt_dev_cleanup(dt_develop_t *dev)
 {
   if(!dev) return;
+  if(dev->image_settle) g_source_remove(dev->image_settle);
   // image_cache does not have to be unref'd, this is done outside develop module.
   dt_pthread_mutex_destroy(&dev->pipe_mutex);
   dt_pthread_mutex_destroy(&dev->preview_pipe_mutex);
@@ -144,6 +151,10 @@ void dt_dev_cleanup(dt_develop_t *dev)
     dev->iop = g_list_delete_link(dev->iop, dev->iop);
   }
   dt_pthread_mutex_destroy(&dev->history_mutex);
+  g_array_free(dev->history_db.hash, TRUE);
+  sqlite3_finalize(dev->history_db.update);
+  sqlite3_finalize(dev->history_db.insert);
+  sqlite3_finalize(dev->history_db.truncate);
   free(dev->histogram);
   free(dev->histogram_pre_tonecurve);
   free(dev->histogram_pre_levels);
@@ -184,6 +195,87 @@ void dt_dev_invalidate_all(dt_develop_t *dev)
   dev->timestamp++;
 }
 
+// adds box to the damage of the full pipe, from the module of the given priority on.
+static void _dev_damage(dt_develop_t *dev, const float *box, const int priority)
+{
+  dt_pthread_mutex_lock(&dev->history_mutex);
+  if(!dev->image_damaged)
+  {
+    dev->damage[0] = dev->damage[1] = 1.0f;
+    dev->damage[2] = dev->damage[3] = 0.0f;
+    dev->damage_priority = priority;
+  }
+  dev->damage_priority = MIN(dev->damage_priority, priority);
+  dev->damage[0] = fminf(dev->damage[0], fmaxf(box[0], 0.0f));
+  dev->damage[1] = fminf(dev->damage[1], fmaxf(box[1], 0.0f));
+  dev->damage[2] = fmaxf(dev->damage[2], fminf(box[2], 1.0f));
+  dev->damage[3] = fmaxf(dev->damage[3], fminf(box[3], 1.0f));
+  dev->image_damaged = 1;
+  dt_pthread_mutex_unlock(&dev->history_mutex);
+}
+
+void dt_dev_invalidate_region(dt_develop_t *dev, const float *box)
+{
+  // the module being edited, everything before it is unchanged:
+  dt_iop_module_t *module = dev->gui_module;
+  const int priority = module ? module->priority : 0;
+  // the box holds the border of the shape, so its feather is in already. a blurred mask
+  // spreads the change by about three sigma. how far the module itself and the ones after
+  // it look around each pixel goes into the margin of the region, see dt_dev_pixelpipe_region_margin().
+  float pad = 0.0f;
+  if(module && module->blend_params && (module->blend_params->mask_mode & DEVELOP_MASK_ENABLED)
+     && module->blend_params->radius > 0.1f)
+    pad = 3.0f*module->blend_params->radius;
+  const float wd = dev->pipe->processed_width  > 0 ? dev->pipe->processed_width  : dev->image_storage.width;
+  const float ht = dev->pipe->processed_height > 0 ? dev->pipe->processed_height : dev->image_storage.height;
+  const float padx = wd > 0.0f ? pad/wd : 1.0f, pady = ht > 0.0f ? pad/ht : 1.0f;
+  const float padded[4] = { box[0] - padx, box[1] - pady, box[2] + padx, box[3] + pady };
+  _dev_damage(dev, padded, priority);
+  // the image has changed, like in dt_dev_invalidate_all(). the preview is cheap enough to be
+  // processed as a whole, the full pipe catches up on the damaged region only.
+  dev->preview_dirty = 1;
+  dev->timestamp++;
+}
+
+// the part of the roi x, y, capwidth x capheight at scale covered by the normalized damage box, grown by
+// margin pixels for modules looking at neighbouring pixels and aligned to tiles. returns the fraction of the roi covered.
+static float _dev_damage_region(const dt_develop_t *dev, const float *damage, const int x, const int y, const float scale,
+                                const int margin, int *region)
+{
+  const int tile = 64;
+  const float wd = scale*dev->pipe->processed_width, ht = scale*dev->pipe->processed_height;
+  int x0 = MAX(0, (int)floorf(damage[0]*wd) - x - margin), y0 = MAX(0, (int)floorf(damage[1]*ht) - y - margin);
+  int x1 = MAX(0, (int)ceilf(damage[2]*wd) - x + margin), y1 = MAX(0, (int)ceilf(damage[3]*ht) - y + margin);
+  x0 -= x0 % tile;
+  y0 -= y0 % tile;
+  x1 = MIN(dev->capwidth,  ((x1 + tile - 1)/tile)*tile);
+  y1 = MIN(dev->capheight, ((y1 + tile - 1)/tile)*tile);
+  if(x1 <= x0 || y1 <= y0 || damage[2] <= damage[0] || damage[3] <= damage[1])
+  {
+    region[0] = region[1] = region[2] = region[3] = 0;
+    return 0.0f;
+  }
+  region[0] = x0;
+  region[1] = y0;
+  region[2] = x1;
+  region[3] = y1;
+  return (x1 - x0)*(y1 - y0)/(float)MAX(1, dev->capwidth*dev->capheight);
+}
+
+// the regions pasted into the last output only approximate modules which look further than their
+// tiling overlap. once no more edits come in, process the whole image again, keeping that output up.
+static gboolean _dev_settle(gpointer user_data)
+{
+  dt_develop_t *dev = (dt_develop_t *)user_data;
+  dev->image_settle = 0;
+  if(!dev->gui_attached || dev->gui_leaving) return FALSE;
+  // nothing changed, so the timestamp stays and the patched output stays up until this is done.
+  const float box[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+  _dev_damage(dev, box, 0);
+  dt_control_queue_redraw_center();
+  return FALSE;
+}
+
 void dt_dev_process_preview_job(dt_develop_t *dev)
 {
   dt_mipmap_buffer_t buf;
@@ -265,8 +357,9 @@ void dt_dev_process_image_job(dt_develop_t *dev)
 {
   dt_pthread_mutex_lock(&dev->pipe_mutex);
   dt_control_log_busy_enter();
-  // let gui know to draw preview instead of us, if it's there:
-  dev->image_dirty = 1;
+  // let gui know to draw preview instead of us, if it's there. if only a part
+  // of the image changed, our last output stays up while that part is redone.
+  if(!dev->image_damaged) dev->image_dirty = 1;
 
   dt_mipmap_buffer_t buf;
   dt_times_t start;
@@ -313,6 +406,9 @@ void dt_dev_process_image_job(dt_develop_t *dev)
   dt_dev_zoom_t zoom;
   float zoom_x, zoom_y, scale;
   int x, y;
+  // damage collected over all restarts of this run:
+  int damaged = 0, damage_priority = INT_MAX, region[4];
+  float damage[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
 
   // adjust pipeline according to changed flag set by {add,pop}_history_item.
 restart:
@@ -324,6 +420,18 @@ restart:
     return;
   }
   dev->pipe->input_timestamp = dev->timestamp;
+  dt_pthread_mutex_lock(&dev->history_mutex);
+  if(dev->image_damaged)
+  {
+    damaged = 1;
+    damage[0] = fminf(damage[0], dev->damage[0]);
+    damage[1] = fminf(damage[1], dev->damage[1]);
+    damage[2] = fmaxf(damage[2], dev->damage[2]);
+    damage[3] = fmaxf(damage[3], dev->damage[3]);
+    damage_priority = MIN(damage_priority, dev->damage_priority);
+    dev->image_damaged = 0;
+  }
+  dt_pthread_mutex_unlock(&dev->history_mutex);
   // this locks dev->history_mutex.
   dt_dev_pixelpipe_change(dev->pipe, dev);
   // determine scale according to new dimensions
@@ -337,8 +445,22 @@ restart:
   x = MAX(0, scale*dev->pipe->processed_width *(.5+zoom_x)-dev->capwidth/2);
   y = MAX(0, scale*dev->pipe->processed_height*(.5+zoom_y)-dev->capheight/2);
 
+  // only process what changed, if that is a small part of what is on screen and
+  // none of the modules after the edited one needs the whole image:
+  float covered = 1.0f;
+  if(damaged && !dev->image_dirty)
+  {
+    const int margin = dt_dev_pixelpipe_region_margin(dev->pipe, dev, damage_priority, scale);
+    if(margin >= 0) covered = _dev_damage_region(dev, damage, x, y, scale, margin, region);
+  }
+
   dt_get_times(&start);
-  if(dt_dev_pixelpipe_process(dev->pipe, dev, x, y, dev->capwidth, dev->capheight, scale))
+  int err = 0;
+  if(covered >= 0.5f)
+    err = dt_dev_pixelpipe_process(dev->pipe, dev, x, y, dev->capwidth, dev->capheight, scale);
+  else if(covered > 0.0f)
+    err = dt_dev_pixelpipe_process_region(dev->pipe, dev, x, y, dev->capwidth, dev->capheight, scale, region);
+  if(err)
   {
     // interrupted because image changed?
     if(dev->image_force_reload)
@@ -361,6 +483,12 @@ restart:
   dev->image_dirty = 0;
   dev->image_loading = 0;
 
+  // only a region of it? then the whole one follows once the edits settle.
+  if(dev->image_settle) g_source_remove(dev->image_settle);
+  dev->image_settle = 0;
+  if(covered < 0.5f && dev->gui_attached)
+    dev->image_settle = g_timeout_add(MAX(DT_DEV_SETTLE_DELAY, 2*dev->average_delay), _dev_settle, dev);
+
   dt_mipmap_cache_read_release(darktable.mipmap_cache, &buf);
   // redraw the whole thing, to also update color picker values and histograms etc.
   if(dev->gui_attached)
@@ -708,32 +836,124 @@ void dt_dev_pop_history_items(dt_develop_t *dev, int32_t cnt)
   dt_control_queue_redraw_center();
 }
 
+// fnv-1a, to detect history items which differ from what is in the db.
+static inline uint64_t _dev_hash(uint64_t hash, const void *data, size_t size)
+{
+  const unsigned char *c = (const unsigned char *)data;
+  for(size_t k=0; k<size; k++) hash = (hash ^ c[k]) * 1099511628211ull;
+  return hash;
+}
+
+static uint64_t _dev_history_item_hash(const dt_dev_history_item_t *h)
+{
+  const int version = h->module->version();
+  uint64_t hash = 14695981039346656037ull;
+  hash = _dev_hash(hash, h->module->op, strlen(h->module->op));
+  hash = _dev_hash(hash, &version, sizeof(version));
+  hash = _dev_hash(hash, &h->enabled, sizeof(h->enabled));
+  hash = _dev_hash(hash, &h->multi_priority, sizeof(h->multi_priority));
+  hash = _dev_hash(hash, h->multi_name, strlen(h->multi_name));
+  hash = _dev_hash(hash, h->params, h->module->params_size);
+  hash = _dev_hash(hash, h->blend_params, sizeof(dt_develop_blend_params_t));
+  return hash;
+}
+
+// upserts one history item through the statements cached in dev.
+static void _dev_write_history_item_cached(dt_develop_t *dev, dt_dev_history_item_t *h, int32_t num)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  const int imgid = dev->image_storage.id;
+  if(!dev->history_db.update)
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "update history set operation = ?1, op_params = ?2, module = ?3, enabled = ?4, blendop_params = ?7, blendop_version = ?8, multi_priority = ?9, multi_name = ?10 where imgid = ?5 and num = ?6", -1, &dev->history_db.update, NULL);
+  if(!dev->history_db.insert)
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "insert into history (operation, op_params, module, enabled, imgid, num, blendop_params, blendop_version, multi_priority, multi_name) values (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)", -1, &dev->history_db.insert, NULL);
+
+  // both statements take the same arguments:
+  sqlite3_stmt *stmt = dev->history_db.update;
+  for(int k=0; k<2; k++)
+  {
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, h->module->op, strlen(h->module->op), SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, h->params, h->module->params_size, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, h->module->version());
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 4, h->enabled);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 5, imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 6, num);
+    DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 7, h->blend_params, sizeof(dt_develop_blend_params_t), SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 8, dt_develop_blend_version());
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 9, h->multi_priority);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 10, h->multi_name, strlen(h->multi_name), SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    // the row was there, no need to insert it:
+    if(stmt == dev->history_db.insert || sqlite3_changes(db) > 0) break;
+    stmt = dev->history_db.insert;
+  }
+}
+
 void dt_dev_write_history(dt_develop_t *dev)
 {
-  sqlite3_stmt *stmt;
+  const int imgid = dev->image_storage.id;
+  if(imgid <= 0) return;
+  sqlite3 *db = dt_database_get(darktable.db);
 
-  gboolean changed = FALSE;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from history where imgid = ?1", -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
-  sqlite3_step(stmt);
-  sqlite3_finalize (stmt);
+  // don't know what's in the db? start from scratch, as before.
+  const gboolean full = dev->history_db.imgid != imgid;
+  GArray *written = dev->history_db.hash;
+  const int32_t written_end = full ? -1 : written->len;
+  if(full) g_array_set_size(written, 0);
+
+  int changed_items = 0;
+  dt_database_start_transaction(darktable.db);
+  if(full)
+  {
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "delete from history where imgid = ?1", -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
   GList *history = dev->history;
-  for(int i=0; i<dev->history_end && history; i++)
+  int32_t end = 0;
+  for(; end<dev->history_end && history; end++)
   {
     dt_dev_history_item_t *hist = (dt_dev_history_item_t *)(history->data);
-    (void)dt_dev_write_history_item(&dev->image_storage, hist, i);
+    const uint64_t hash = _dev_history_item_hash(hist);
+    if(end >= written->len || g_array_index(written, uint64_t, end) != hash)
+    {
+      _dev_write_history_item_cached(dev, hist, end);
+      if(end >= written->len) g_array_append_val(written, hash);
+      else g_array_index(written, uint64_t, end) = hash;
+      changed_items++;
+    }
     history = g_list_next(history);
-    changed = TRUE;
   }
+  // drop everything which got truncated with one statement:
+  if(written->len > end)
+  {
+    if(!dev->history_db.truncate)
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "delete from history where imgid = ?1 and num >= ?2", -1, &dev->history_db.truncate, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(dev->history_db.truncate, 1, imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(dev->history_db.truncate, 2, end);
+    sqlite3_step(dev->history_db.truncate);
+    sqlite3_reset(dev->history_db.truncate);
+    g_array_set_size(written, end);
+  }
+  dt_database_release_transaction(darktable.db);
+  dev->history_db.imgid = imgid;
+  dt_print(DT_DEBUG_DEV, "[dev_write_history] image %d: %d of %d items written\n", imgid, changed_items, end);
 
-  /* attach / detach changed tag reflecting actual change */
-  guint tagid = 0;
-  dt_tag_new("darktable|changed",&tagid);
-  if(changed)
-    dt_tag_attach(tagid, dev->image_storage.id);
-  else
-    dt_tag_detach(tagid, dev->image_storage.id);
-
+  /* attach / detach changed tag reflecting actual change, only if that did change */
+  const gboolean changed = end > 0;
+  if(written_end < 0 || (written_end > 0) != changed)
+  {
+    guint tagid = 0;
+    dt_tag_new("darktable|changed",&tagid);
+    if(changed)
+      dt_tag_attach(tagid, imgid);
+    else
+      dt_tag_detach(tagid, imgid);
+  }
 }
 
 static void
@@ -854,6 +1074,9 @@ void dt_dev_read_history(dt_develop_t *dev)
                               "select imgid, num, module, operation, op_params, enabled, blendop_params, blendop_version, multi_priority, multi_name from history where imgid = ?1 order by num", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
   dev->history_end = 0;
+  // what's in memory now may differ from the db (legacy params, skipped items),
+  // so the next write has to start over:
+  dev->history_db.imgid = 0;
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     // db record:
@@ -68,6 +68,13 @@ typedef struct dt_develop_t
   int32_t image_loading, image_dirty, first_load;
   int32_t image_force_reload;
   int32_t preview_loading, preview_dirty, preview_input_changed;
+  // set by dt_dev_invalidate_region(): only damage (x0, y0, x1, y1 normalized to the
+  // processed image) has changed since the last output of the full pipe, from the module
+  // of priority damage_priority on. protected by history_mutex.
+  int32_t image_damaged, damage_priority;
+  float damage[4];
+  // timeout source which processes the whole image once edits of single regions have settled.
+  guint image_settle;
   uint32_t timestamp;
   uint32_t average_delay;
   uint32_t preview_average_delay;
@@ -95,6 +102,16 @@ typedef struct dt_develop_t
   int32_t history_end;
   GList *history;
 
+  // state of the history stack as last written to the db, so
+  // dt_dev_write_history() only has to touch items that changed.
+  struct
+  {
+    int32_t imgid;      // image the hashes belong to, 0 if the db state is unknown
+    GArray *hash;       // one uint64_t per item in the db
+    sqlite3_stmt *update, *insert, *truncate;
+  }
+  history_db;
+
   // operations pipeline
   int32_t iop_instance;
   GList *iop;
@@ -205,6 +222,9 @@ void dt_dev_read_history(dt_develop_t *dev);
 void dt_dev_invalidate(dt_develop_t *dev);
 // also invalidates preview (which is unaffected by resize/zoom/pan)
 void dt_dev_invalidate_all(dt_develop_t *dev);
+// like dt_dev_invalidate_all(), but the full pipe only needs to process box (x0, y0, x1, y1,
+// normalized to the processed image) again, grown by the mask blur of the module being edited.
+void dt_dev_invalidate_region(dt_develop_t *dev, const float *box);
 void dt_dev_set_histogram(dt_develop_t *dev);
 void dt_dev_set_histogram_pre(dt_develop_t *dev);
 void dt_dev_get_history_item_label(dt_dev_history_item_t *hist, char *label, const int cnt);
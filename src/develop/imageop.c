@@ -21,6 +21,7 @@
 #include "common/opencl.h"
 #include "common/dtpthread.h"
 #include "common/debug.h"
+#include "common/hash.h"
 #include "common/interpolation.h"
 #include "bauhaus/bauhaus.h"
 #include "control/control.h"
@@ -55,6 +56,9 @@ typedef struct dt_iop_gui_simple_callback_t
   int index;
 } dt_iop_gui_simple_callback_t;
 
+/** serializes the lazy init_global() calls. */
+static dt_pthread_mutex_t _global_data_mutex;
+
 static dt_develop_blend_params_t _default_blendop_params= {DEVELOP_MASK_DISABLED, DEVELOP_BLEND_NORMAL2, 100.0f, DEVELOP_COMBINE_NORM_EXCL, 0, 0, 0.0f,
   { 0, 0, 0, 0 },
   {
@@ -670,7 +674,8 @@ int dt_iop_load_module_so(dt_iop_module_so_t *module, const char *libname, const
   if(!g_module_symbol(module->module, "modify_roi_in",          (gpointer)&(module->modify_roi_in)))          module->modify_roi_in = dt_iop_modify_roi_in;
   if(!g_module_symbol(module->module, "modify_roi_out",         (gpointer)&(module->modify_roi_out)))         module->modify_roi_out = dt_iop_modify_roi_out;
   if(!g_module_symbol(module->module, "legacy_params",          (gpointer)&(module->legacy_params)))          module->legacy_params = NULL;
-  if(module->init_global) module->init_global(module);
+  // init_global() is deferred until an instance is first enabled in a pipe, see dt_iop_load_module_global().
+  module->global_inited = 0;
   return 0;
 error:
   fprintf(stderr, "[iop_load_module] failed to open operation `%s': %s\n", op, g_module_error());
@@ -800,6 +805,23 @@ dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt_dev
   return 0;
 }
 
+void dt_iop_load_module_global(dt_iop_module_t *module)
+{
+  dt_iop_module_so_t *so = module->so;
+  if(!so) return;
+  // pipes of the darkroom, the thumbnails and the export may all get here at the same time.
+  dt_pthread_mutex_lock(&_global_data_mutex);
+  if(!so->global_inited)
+  {
+    const double start = dt_get_wtime();
+    if(so->init_global) so->init_global(so);
+    so->global_inited = 1;
+    dt_print(DT_DEBUG_PERF, "[iop_load_module_global] init of `%s' took %.3f secs\n", so->op, dt_get_wtime() - start);
+  }
+  dt_pthread_mutex_unlock(&_global_data_mutex);
+  module->data = so->data;
+}
+
 void dt_iop_init_pipe(struct dt_iop_module_t *module, struct dt_dev_pixelpipe_t *pipe, struct dt_dev_pixelpipe_iop_t *piece)
 {
   module->init_pipe(module, pipe, piece);
@@ -1453,6 +1475,7 @@ void dt_iop_load_modules_so()
   GList *res = NULL;
   dt_iop_module_so_t *module;
   darktable.iop = NULL;
+  dt_pthread_mutex_init(&_global_data_mutex, NULL);
   char plugindir[1024], op[20];
   const gchar *d_name;
   dt_loc_get_plugindir(plugindir, 1024);
@@ -1577,16 +1600,16 @@ void dt_iop_unload_modules_so()
   while(darktable.iop)
   {
     dt_iop_module_so_t *module = (dt_iop_module_so_t *)darktable.iop->data;
-    if(module->cleanup_global) module->cleanup_global(module);
+    if(module->global_inited && module->cleanup_global) module->cleanup_global(module);
     if(module->module) g_module_close(module->module);
     free(darktable.iop->data);
     darktable.iop = g_list_delete_link(darktable.iop, darktable.iop);
   }
+  dt_pthread_mutex_destroy(&_global_data_mutex);
 }
 
 void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params, dt_develop_blend_params_t * blendop_params, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  uint64_t hash = 5381;
   piece->hash = 0;
   if(piece->enabled)
   {
@@ -1611,11 +1634,13 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params, dt_d
     /* and we add masks */
     dt_masks_group_get_hash_buffer(grp,str+pos);
 
+    // only modules that are actually processed need their global data:
+    dt_iop_load_module_global(module);
     // assume process_cl is ready, commit_params can overwrite this.
     if(module->process_cl) piece->process_cl_ready = 1;
     module->commit_params(module, params, pipe, piece);
-    for(int i=0; i<length; i++) hash = ((hash << 5) + hash) ^ str[i];
-    piece->hash = hash;
+    uint64_t hash = dt_hash64_add_data(DT_HASH64_INIT, module->op, strlen(module->op));
+    piece->hash = dt_hash64_finish(dt_hash64_add_data(hash, str, length));
 
     free(str);
   }
@@ -94,6 +94,8 @@ typedef struct dt_iop_module_so_t
   dt_dev_operation_t op;
   /** other stuff that may be needed by the module, not only in gui mode. inited only once, has to be read-only then. */
   dt_iop_global_data_t *data;
+  /** set once init_global() has been called. */
+  int global_inited;
   /** gui is also only inited once at startup. */
   dt_iop_gui_data_t *gui_data;
   /** which results in this widget here, too. */
@@ -101,7 +103,7 @@ typedef struct dt_iop_module_so_t
 
   /** this initializes static, hardcoded presets for this module and is called only once per run of dt. */
   void (*init_presets)    (struct dt_iop_module_so_t *self);
-  /** called once per module, at startup. */
+  /** called once per module, the first time an instance of it needs its global data (see dt_iop_load_module_global()). */
   void (*init_global)     (struct dt_iop_module_so_t *self);
   /** called once per module, at shutdown. */
   void (*cleanup_global)  (struct dt_iop_module_so_t *self);
@@ -339,6 +341,10 @@ int dt_iop_load_module(dt_iop_module_t *module, dt_iop_module_so_t *module_so, s
 gint sort_plugins(gconstpointer a, gconstpointer b);
 /** calls module->cleanup and closes the dl connection. */
 void dt_iop_cleanup_module(dt_iop_module_t *module);
+/** runs init_global() of the module's so if that did not happen yet and points module->data to the result.
+ *  called by dt_iop_commit_params() for enabled pieces only, so sessions only pay for the modules they
+ *  actually process with. code using the global data outside of a pipe has to call it itself. */
+void dt_iop_load_module_global(dt_iop_module_t *module);
 /** initialize pipe. */
 void dt_iop_init_pipe(struct dt_iop_module_t *module, struct dt_dev_pixelpipe_t *pipe, struct dt_dev_pixelpipe_iop_t *piece);
 /** checks if iop do have an ui */
@@ -171,6 +171,9 @@ typedef struct dt_masks_form_gui_t
   //ids
   int formid;
   uint64_t pipe_hash;
+
+  //part of the preview covered by forms whose points have been removed since the image was last updated (x0,y0,x1,y1)
+  float damage[4];
 }
 dt_masks_form_gui_t;
 
@@ -198,6 +201,9 @@ void dt_masks_write_form(dt_masks_form_t *form, dt_develop_t *dev);
 void dt_masks_write_forms(dt_develop_t *dev);
 void dt_masks_free_form(dt_masks_form_t *form);
 void dt_masks_update_image(dt_develop_t *dev);
+/** same as dt_masks_update_image() once the gui points of the changed form at index have been recreated,
+    but only the part of the image covered by the form before and after the change has to be processed again */
+void dt_masks_update_image_form(dt_develop_t *dev, dt_masks_form_t *form, dt_masks_form_gui_t *gui, int index);
 void dt_masks_cleanup_unused(dt_develop_t *dev);
 
 /** function used to manipulate forms for masks */
@@ -138,7 +138,7 @@ static int dt_circle_events_mouse_scrolled(struct dt_iop_module_t *module, float
       {
         return 0;
       }
-      dt_masks_update_image(darktable.develop);
+      dt_masks_update_image_form(darktable.develop,form,gui,index);
     }
     return 1;
   }
@@ -310,7 +310,7 @@ static int dt_circle_events_button_released(struct dt_iop_module_t *module,float
     dt_masks_gui_form_create(form,gui,index);
 
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -344,7 +344,7 @@ static int dt_circle_events_button_released(struct dt_iop_module_t *module,float
     dt_masks_gui_form_create(form,gui,index);
 
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
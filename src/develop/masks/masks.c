@@ -62,9 +62,38 @@ void dt_masks_gui_form_create(dt_masks_form_t *form, dt_masks_form_gui_t *gui, i
     gui->formid = form->formid;
   }
 }
+static void _gui_damage_reset(dt_masks_form_gui_t *gui)
+{
+  gui->damage[0] = gui->damage[1] = FLT_MAX;
+  gui->damage[2] = gui->damage[3] = -FLT_MAX;
+}
+
+//grows the damage by the points and the border of the form at index
+static void _gui_damage_add(dt_masks_form_gui_t *gui, int index)
+{
+  dt_masks_form_gui_points_t *gpt = (dt_masks_form_gui_points_t *) g_list_nth_data(gui->points,index);
+  if (!gpt) return;
+  for (int i=0; i<gpt->points_count; i++)
+  {
+    gui->damage[0] = fminf(gui->damage[0],gpt->points[i*2]);
+    gui->damage[1] = fminf(gui->damage[1],gpt->points[i*2+1]);
+    gui->damage[2] = fmaxf(gui->damage[2],gpt->points[i*2]);
+    gui->damage[3] = fmaxf(gui->damage[3],gpt->points[i*2+1]);
+  }
+  for (int i=0; i<gpt->border_count; i++)
+  {
+    gui->damage[0] = fminf(gui->damage[0],gpt->border[i*2]);
+    gui->damage[1] = fminf(gui->damage[1],gpt->border[i*2+1]);
+    gui->damage[2] = fmaxf(gui->damage[2],gpt->border[i*2]);
+    gui->damage[3] = fmaxf(gui->damage[3],gpt->border[i*2+1]);
+  }
+}
+
 void dt_masks_gui_form_remove(dt_masks_form_t *form, dt_masks_form_gui_t *gui, int index)
 {
   dt_masks_form_gui_points_t *gpt = (dt_masks_form_gui_points_t *) g_list_nth_data(gui->points,index);
+  //the image has to be updated where the form was, too
+  _gui_damage_add(gui,index);
   gui->pipe_hash = gui->formid = gpt->points_count = gpt->border_count = gpt->source_count = 0;
   free(gpt->points);
   gpt->points = NULL;
@@ -673,6 +702,7 @@ void dt_masks_init_formgui(dt_develop_t *dev)
   dev->form_gui->group_edited = -1;
   dev->form_gui->group_selected = -1;
   dev->form_gui->edit_mode = DT_MASKS_EDIT_OFF;
+  _gui_damage_reset(dev->form_gui);
 }
 
 void dt_masks_change_form_gui(dt_masks_form_t *newform)
@@ -1354,6 +1384,35 @@ void dt_masks_update_image(dt_develop_t *dev)
   dev->pipe->changed |= DT_DEV_PIPE_SYNCH;
   dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH;
   dt_dev_invalidate_all(dev);
+  if (dev->form_gui) _gui_damage_reset(dev->form_gui);
+
+  dt_mipmap_cache_remove(darktable.mipmap_cache, dev->image_storage.id);
+}
+
+void dt_masks_update_image_form(dt_develop_t *dev, dt_masks_form_t *form, dt_masks_form_gui_t *gui, int index)
+{
+  //gradients fade over the whole image, their points only show the line
+  const float wd = dev->preview_pipe->backbuf_width;
+  const float ht = dev->preview_pipe->backbuf_height;
+  if ((form->type & DT_MASKS_GRADIENT) || wd < 1.0f || ht < 1.0f)
+  {
+    dt_masks_update_image(dev);
+    return;
+  }
+
+  //where the form was is in the damage already, add where it is now
+  _gui_damage_add(gui,index);
+  if (gui->damage[0] > gui->damage[2] || gui->damage[1] > gui->damage[3])
+  {
+    dt_masks_update_image(dev);
+    return;
+  }
+  const float box[4] = {gui->damage[0]/wd, gui->damage[1]/ht, gui->damage[2]/wd, gui->damage[3]/ht};
+  _gui_damage_reset(gui);
+
+  dev->pipe->changed |= DT_DEV_PIPE_SYNCH;
+  dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH;
+  dt_dev_invalidate_region(dev, box);
 
   dt_mipmap_cache_remove(darktable.mipmap_cache, dev->image_storage.id);
 }
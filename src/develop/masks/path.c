@@ -908,7 +908,7 @@ static int dt_path_events_mouse_scrolled(struct dt_iop_module_t *module, float p
       dt_masks_gui_form_create(form,gui,index);
 
       //we save the move
-      dt_masks_update_image(darktable.develop);
+      dt_masks_update_image_form(darktable.develop,form,gui,index);
     }
     return 1;
   }
@@ -1069,7 +1069,7 @@ static int dt_path_events_button_pressed(struct dt_iop_module_t *module,float pz
         dt_masks_gui_form_create(form,gui,index);
         gpt->clockwise = _path_is_clockwise(form);
         //we save the move
-        dt_masks_update_image(darktable.develop);
+        dt_masks_update_image_form(darktable.develop,form,gui,index);
         return 1;
       }
       //we register the current position to avoid accidental move
@@ -1207,7 +1207,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     dt_masks_gui_form_create(form,gui,index);
 
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -1230,7 +1230,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     dt_masks_gui_form_create(form,gui,index);
 
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -1239,7 +1239,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     gui->seg_dragging = -1;
     gpt->clockwise = _path_is_clockwise(form);
     dt_masks_write_form(form,darktable.develop);
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
     return 1;
   }
   else if (gui->point_dragging >= 0)
@@ -1275,7 +1275,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     dt_masks_gui_form_create(form,gui,index);
     gpt->clockwise = _path_is_clockwise(form);
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -1307,7 +1307,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     dt_masks_gui_form_create(form,gui,index);
     gpt->clockwise = _path_is_clockwise(form);
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -1317,7 +1317,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
 
     //we save the move
     dt_masks_write_form(form,darktable.develop);
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
     dt_control_queue_redraw_center();
     return 1;
   }
@@ -1362,7 +1362,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
     dt_masks_gui_form_create(form,gui,index);
     gpt->clockwise = _path_is_clockwise(form);
     //we save the move
-    dt_masks_update_image(darktable.develop);
+    dt_masks_update_image_form(darktable.develop,form,gui,index);
 
     return 1;
   }
@@ -1381,7 +1381,7 @@ static int dt_path_events_button_released(struct dt_iop_module_t *module,float p
       dt_masks_gui_form_create(form,gui,index);
       gpt->clockwise = _path_is_clockwise(form);
       //we save the move
-      dt_masks_update_image(darktable.develop);
+      dt_masks_update_image_form(darktable.develop,form,gui,index);
     }
     return 1;
   }
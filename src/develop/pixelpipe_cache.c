@@ -18,6 +18,7 @@
 
 #include "develop/pixelpipe_cache.h"
 #include "develop/pixelpipe_hb.h"
+#include "common/hash.h"
 #include "libs/lib.h"
 #include <stdlib.h>
 
@@ -79,39 +80,56 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
   free(cache->size);
 }
 
-uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const dt_iop_roi_t *roi, dt_dev_pixelpipe_t *pipe, int module)
+// what the piece adds to the hash of everything up to it, 0 if it is skipped.
+static uint64_t _cache_piece_key(const dt_dev_pixelpipe_iop_t *piece)
 {
-  // bernstein hash (djb2)
-  uint64_t hash = 5381 + imgid;
-  // go through all modules up to module and compute a weird hash using the operation and params.
-  GList *pieces = pipe->nodes;
-  for(int k=0; k<module&&pieces; k++)
+  const dt_develop_t *dev = piece->module->dev;
+  if(dev->gui_module && (dev->gui_module->operation_tags_filter() & piece->module->operation_tags())) return 0;
+  uint64_t key = dt_hash64_add(DT_HASH64_INIT, piece->hash);
+  if(piece->module->request_color_pick)
   {
-    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
-    dt_develop_t *dev = piece->module->dev;
-    if(!(dev->gui_module && (dev->gui_module->operation_tags_filter() &  piece->module->operation_tags())))
-    {
-      hash = ((hash << 5) + hash) ^ piece->hash;
-      if(piece->module->request_color_pick)
-      {
-        if(darktable.lib->proxy.colorpicker.size)
-        {
-          const char *str = (const char *)piece->module->color_picker_box;
-          for(size_t i=0; i<sizeof(float)*4; i++) hash = ((hash << 5) + hash) ^ str[i];
-        }
-        else
-        {
-          const char *str = (const char *)piece->module->color_picker_point;
-          for(size_t i=0; i<sizeof(float)*2; i++) hash = ((hash << 5) + hash) ^ str[i];
-        }
-      }
-    }
-    pieces = g_list_next(pieces);
+    if(darktable.lib->proxy.colorpicker.size)
+      key = dt_hash64_add_data(key, piece->module->color_picker_box, sizeof(float)*4);
+    else
+      key = dt_hash64_add_data(key, piece->module->color_picker_point, sizeof(float)*2);
+  }
+  key = dt_hash64_finish(key);
+  return key ? key : 1;
+}
+
+void dt_dev_pixelpipe_cache_update_chain(dt_dev_pixelpipe_t *pipe)
+{
+  const int length = g_list_length(pipe->nodes);
+  int changed = 0;
+  if(!pipe->hash_chain || length != pipe->hash_chain_length)
+  {
+    pipe->hash_chain = (uint64_t *)realloc(pipe->hash_chain, sizeof(uint64_t)*(length+1));
+    pipe->hash_key = (uint64_t *)realloc(pipe->hash_key, sizeof(uint64_t)*(length+1));
+    pipe->hash_chain[0] = DT_HASH64_INIT;
+    changed = 1;
+  }
+  // everything before the first piece whose contribution changed can stay:
+  int k = 0;
+  for(GList *pieces = pipe->nodes; pieces; pieces = g_list_next(pieces), k++)
+  {
+    const uint64_t key = _cache_piece_key((dt_dev_pixelpipe_iop_t *)pieces->data);
+    if(!changed && key == pipe->hash_key[k]) continue;
+    changed = 1;
+    pipe->hash_key[k] = key;
+    pipe->hash_chain[k+1] = key ? dt_hash64_add(pipe->hash_chain[k], key) : pipe->hash_chain[k];
   }
-  // also add scale, x and y:
-  const char *str = (const char *)roi;
-  for(size_t i=0; i<sizeof(dt_iop_roi_t); i++) hash = ((hash << 5) + hash) ^ str[i];
-  return hash;
+  pipe->hash_chain_length = length;
+}
+
+uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const dt_iop_roi_t *roi, dt_dev_pixelpipe_t *pipe, int module)
+{
+  if(module > pipe->hash_chain_length) dt_dev_pixelpipe_cache_update_chain(pipe);
+  module = CLAMPS(module, 0, pipe->hash_chain_length);
+  // all modules up to module, then image, scale, x and y:
+  uint64_t hash = pipe->hash_chain ? pipe->hash_chain[module] : DT_HASH64_INIT;
+  hash = dt_hash64_add(hash, imgid);
+  hash = dt_hash64_add_data(hash, roi, sizeof(dt_iop_roi_t));
+  return dt_hash64_finish(hash);
 }
 
 int dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash)
@@ -48,9 +48,14 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, in
 void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache);
 
 struct dt_iop_roi_t;
-/** creates a hopefully unique hash from the complete module stack up to the module-th. */
+/** creates a hopefully unique hash from the complete module stack up to the module-th.
+  * uses the prefix hashes of the last dt_dev_pixelpipe_cache_update_chain(). */
 uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const struct dt_iop_roi_t *roi, struct dt_dev_pixelpipe_t *pipe, int module);
 
+/** brings the prefix hashes of the pipe's nodes up to date, from the first one whose params, color picker
+  * or filtering by the focused module changed on. called once per run of the pipe. */
+void dt_dev_pixelpipe_cache_update_chain(struct dt_dev_pixelpipe_t *pipe);
+
 /** returns the float data buffer for the given hash from the cache. if the hash does not match any
   * cache line, the least recently used cache line will be cleared and an empty buffer is returned
   * together with a non-zero return value. */
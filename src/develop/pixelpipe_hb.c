@@ -24,6 +24,7 @@
 #include "control/signal.h"
 #include "common/opencl.h"
 #include "common/imageio.h"
+#include "common/histogram.h"
 #include "libs/lib.h"
 #include "libs/colorpicker.h"
 #include "iop/colorout.h"
@@ -37,6 +38,8 @@
 
 // this is to ensure compatibility with pixelpipe_gegl.c, which does not need to build the other module:
 #include "develop/pixelpipe_cache.c"
+#include "develop/pixelpipe_scratch.c"
+#include "develop/pixelpipe_shared.c"
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 
@@ -100,11 +103,20 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, int32_t size, int32_t
   pipe->processed_width  = pipe->backbuf_width  = pipe->iwidth = 0;
   pipe->processed_height = pipe->backbuf_height = pipe->iheight = 0;
   pipe->nodes = NULL;
+  pipe->hash_chain = pipe->hash_key = NULL;
+  pipe->hash_chain_length = 0;
   pipe->backbuf_size = size;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size))
     return 0;
   pipe->cache_obsolete = 0;
+  dt_pipe_scratch_init(&pipe->scratch);
   pipe->backbuf = NULL;
+  pipe->backbuf_roi = (dt_iop_roi_t)
+  {
+    0, 0, 0, 0, 0.0f
+  };
+  pipe->backbuf_copy = NULL;
+  pipe->backbuf_copy_size = 0;
   pipe->processing = 0;
   pipe->shutdown = 0;
   pipe->opencl_error = 0;
@@ -112,6 +124,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, int32_t size, int32_t
   pipe->mask_display = 0;
   pipe->input_timestamp = 0;
   pipe->levels = IMAGEIO_RGB | IMAGEIO_INT8;
+  pipe->demosaic_half_size = 0;
   dt_pthread_mutex_init(&(pipe->backbuf_mutex), NULL);
   dt_pthread_mutex_init(&(pipe->busy_mutex), NULL);
   return 1;
@@ -135,6 +148,14 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  dt_pipe_scratch_cleanup(&pipe->scratch);
+  free(pipe->backbuf_copy);
+  pipe->backbuf_copy = NULL;
+  pipe->backbuf_copy_size = 0;
+  free(pipe->hash_chain);
+  free(pipe->hash_key);
+  pipe->hash_chain = pipe->hash_key = NULL;
+  pipe->hash_chain_length = 0;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
@@ -159,6 +180,7 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
   }
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  pipe->hash_chain_length = 0;
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
@@ -306,60 +328,39 @@ histogram_collect(dt_iop_module_t *module, const float *pixel, const dt_iop_roi_
   float *hist = *histogram;
 
   histogram_max[0] = histogram_max[1] = histogram_max[2] = histogram_max[3] = 0;
-  memset (hist, 0, 64*4*sizeof(float));
 
   switch(cst)
   {
     case iop_cs_RAW:
-      for(int j=0; j<roi->height; j+=3) for(int i=0; i<roi->width; i+=3)  // sample one out of 9 pixels, un-locked with bayer pattern
-        {
-          uint8_t V = CLAMP(64.0f*pixel[4*(j*roi->width+i)], 0, 63);
-          hist[4*V] ++;
-        }
-      for(int k=0; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
+    {
+      const float offset[3] = { 0.0f, 0.0f, 0.0f }, scale[3] = { 1.0f, 1.0f, 1.0f };
+      dt_histogram_collect_f(hist, 64, pixel, roi->width, roi->height, 4*roi->width, offset, scale, DT_HISTOGRAM_FIRST);
+      histogram_max[0] = dt_histogram_max(hist, 0, 0, 64);
       break;
+    }
 
     case iop_cs_rgb:
-      for(int j=0; j<roi->height; j+=4) for(int i=0; i<roi->width; i+=4)  // sample one out of 16 pixels
-        {
-          float Rv = pixel[4*(j*roi->width+i)];
-          float Gv = pixel[4*(j*roi->width+i)+1];
-          float Bv = pixel[4*(j*roi->width+i)+2];
-          float gv = fmaxf(Rv, fmaxf(Gv, Bv));
-          uint8_t R = CLAMP(64.0f*Rv, 0, 63);
-          uint8_t G = CLAMP(64.0f*Gv, 0, 63);
-          uint8_t B = CLAMP(64.0f*Bv, 0, 63);
-          uint8_t g = CLAMP(64.0f*gv, 0, 63);
-          hist[4*R] ++;
-          hist[4*G + 1] ++;
-          hist[4*B + 2] ++;
-          hist[4*g + 3] ++;
-        }
+    {
+      const float offset[3] = { 0.0f, 0.0f, 0.0f }, scale[3] = { 1.0f, 1.0f, 1.0f };
+      dt_histogram_collect_f(hist, 64, pixel, roi->width, roi->height, 4*roi->width, offset, scale, DT_HISTOGRAM_RGB_MAX);
       // don't count <= 0 pixels
-      for(int k=4; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
-      for(int k=5; k<4*64; k+=4) histogram_max[1] = histogram_max[1] > hist[k] ? histogram_max[1] : hist[k];
-      for(int k=6; k<4*64; k+=4) histogram_max[2] = histogram_max[2] > hist[k] ? histogram_max[2] : hist[k];
-      for(int k=7; k<4*64; k+=4) histogram_max[3] = histogram_max[3] > hist[k] ? histogram_max[3] : hist[k];
+      for(int c=0; c<4; c++) histogram_max[c] = dt_histogram_max(hist, c, 1, 64);
       break;
+    }
 
     case iop_cs_Lab:
     default:
-      for(int j=0; j<roi->height; j+=4) for(int i=0; i<roi->width; i+=4)   // sample one out of 16 pixels
-        {
-          uint8_t L = CLAMP(64.0f/100.0f*(pixel[4*(j*roi->width+i)]), 0, 63);
-          uint8_t a = CLAMP(64.0f/256.0f*(pixel[4*(j*roi->width+i)+1]+128.0f), 0, 63);
-          uint8_t b = CLAMP(64.0f/256.0f*(pixel[4*(j*roi->width+i)+2]+128.0f), 0, 63);
-          hist[4*L] ++;
-          hist[4*a + 1] ++;
-          hist[4*b + 2] ++;
-        }
+    {
+      const float offset[3] = { 0.0f, 128.0f, 128.0f }, scale[3] = { 1.0f/100.0f, 1.0f/256.0f, 1.0f/256.0f };
+      dt_histogram_collect_f(hist, 64, pixel, roi->width, roi->height, 4*roi->width, offset, scale, DT_HISTOGRAM_RGB);
       // don't count <= 0 pixels in L
-      for(int k=4; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
+      histogram_max[0] = dt_histogram_max(hist, 0, 1, 64);
 
       // don't count <= -128 and >= +128 pixels in a and b
-      for(int k=5; k<4*63; k+=4) histogram_max[1] = histogram_max[1] > hist[k] ? histogram_max[1] : hist[k];
-      for(int k=6; k<4*63; k+=4) histogram_max[2] = histogram_max[2] > hist[k] ? histogram_max[2] : hist[k];
+      histogram_max[1] = dt_histogram_max(hist, 1, 1, 63);
+      histogram_max[2] = dt_histogram_max(hist, 2, 1, 63);
       break;
+    }
   }
 }
 
@@ -385,67 +386,7 @@ histogram_collect_cl(int devid, dt_iop_module_t *module, cl_mem img, const dt_io
     return;
   }
 
-  const dt_iop_colorspace_type_t cst = dt_iop_module_colorspace(module);
-
-  float *hist = *histogram;
-
-  histogram_max[0] = histogram_max[1] = histogram_max[2] = histogram_max[3] = 0;
-  memset (hist, 0, 64*4*sizeof(float));
-
-
-  switch(cst)
-  {
-    case iop_cs_RAW:
-      for(int j=0; j<roi->height; j+=3) for(int i=0; i<roi->width; i+=3)  // sample one out of 9 pixels, un-locked with bayer pattern
-        {
-          uint8_t V = CLAMP(64.0f*pixel[4*(j*roi->width+i)], 0, 63);
-          hist[4*V] ++;
-        }
-      for(int k=0; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
-      break;
-
-    case iop_cs_rgb:
-      for(int j=0; j<roi->height; j+=4) for(int i=0; i<roi->width; i+=4)  // sample one out of 16 pixels
-        {
-          float Rv = pixel[4*(j*roi->width+i)];
-          float Gv = pixel[4*(j*roi->width+i)+1];
-          float Bv = pixel[4*(j*roi->width+i)+2];
-          float gv = fmaxf(Rv, fmaxf(Gv, Bv));
-          uint8_t R = CLAMP(64.0f*Rv, 0, 63);
-          uint8_t G = CLAMP(64.0f*Gv, 0, 63);
-          uint8_t B = CLAMP(64.0f*Bv, 0, 63);
-          uint8_t g = CLAMP(64.0f*gv, 0, 63);
-          hist[4*R] ++;
-          hist[4*G + 1] ++;
-          hist[4*B + 2] ++;
-          hist[4*g + 3] ++;
-        }
-      // don't count <= 0 pixels
-      for(int k=4; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
-      for(int k=5; k<4*64; k+=4) histogram_max[1] = histogram_max[1] > hist[k] ? histogram_max[1] : hist[k];
-      for(int k=6; k<4*64; k+=4) histogram_max[2] = histogram_max[2] > hist[k] ? histogram_max[2] : hist[k];
-      for(int k=7; k<4*64; k+=4) histogram_max[3] = histogram_max[3] > hist[k] ? histogram_max[3] : hist[k];
-      break;
-
-    case iop_cs_Lab:
-    default:
-      for(int j=0; j<roi->height; j+=4) for(int i=0; i<roi->width; i+=4)   // sample one out of 16 pixels
-        {
-          uint8_t L = CLAMP(64.0f/100.0f*(pixel[4*(j*roi->width+i)]), 0, 63);
-          uint8_t a = CLAMP(64.0f/256.0f*(pixel[4*(j*roi->width+i)+1]+128.0f), 0, 63);
-          uint8_t b = CLAMP(64.0f/256.0f*(pixel[4*(j*roi->width+i)+2]+128.0f), 0, 63);
-          hist[4*L] ++;
-          hist[4*a + 1] ++;
-          hist[4*b + 2] ++;
-        }
-      // don't count <= 0 pixels in L
-      for(int k=4; k<4*64; k+=4) histogram_max[0] = histogram_max[0] > hist[k] ? histogram_max[0] : hist[k];
-
-      // don't count <= -128 and >= +128 pixels in a and b
-      for(int k=5; k<4*63; k+=4) histogram_max[1] = histogram_max[1] > hist[k] ? histogram_max[1] : hist[k];
-      for(int k=6; k<4*63; k+=4) histogram_max[2] = histogram_max[2] > hist[k] ? histogram_max[2] : hist[k];
-      break;
-  }
+  histogram_collect(module, pixel, roi, histogram, histogram_max);
 
   free(pixel);
 }
@@ -638,6 +579,57 @@ pixelpipe_picker_cl(int devid, dt_iop_module_t *module, cl_mem img, const dt_iop
 #endif
 
 
+// concurrent exports of the same image: fills the output of demosaic from the demosaiced
+// image another export pipe left in darktable.pipe_shared, cropped and zoomed the same way
+// demosaic's process() does. saves running all raw stages. returns 1 if output was filled.
+static int
+_dev_pixelpipe_shared_demosaic(dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *roi_in,
+                               const dt_iop_roi_t *roi_out, const uint64_t hash, const size_t bufsize, void **output)
+{
+  // exports asking for speed sample the raw at half size instead:
+  if(roi_out->scale <= .5f && pipe->demosaic_half_size) return 0;
+
+  const int width = piece->buf_in.width, height = piece->buf_in.height;
+  float processed_maximum[3];
+  const float *done = dt_dev_pixelpipe_shared_get(darktable.pipe_shared, dt_dev_pixelpipe_shared_hash(pipe, piece),
+                                                  width, height, processed_maximum);
+  if(!done) return 0;
+
+  const int zoom = !(roi_out->scale > .99999f && roi_out->scale < 1.00001f);
+  dt_iop_roi_t roi = *roi_out, roo = *roi_out;
+  roi.x = roi.y = roo.x = roo.y = 0;
+  if(zoom)
+  {
+    roo.width  = roi_out->width / roi_out->scale;
+    roo.height = roi_out->height / roi_out->scale;
+    roo.scale = 1.0f;
+  }
+  if(roi_in->x < 0 || roi_in->y < 0 || roi_in->x + roo.width > width || roi_in->y + roo.height > height)
+  {
+    dt_dev_pixelpipe_shared_release(darktable.pipe_shared, done);
+    return 0;
+  }
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    dt_dev_pixelpipe_shared_release(darktable.pipe_shared, done);
+    return 0;
+  }
+  (void) dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output);
+  const float *in = done + 4*((size_t)roi_in->y*width + roi_in->x);
+  if(zoom)
+    dt_iop_clip_and_zoom((float *)*output, in, &roi, &roo, roi.width, width);
+  else
+    for(int j=0; j<roo.height; j++)
+      memcpy(((float *)*output) + (size_t)4*roo.width*j, in + (size_t)4*width*j, sizeof(float)*4*roo.width);
+  for(int k=0; k<3; k++) pipe->processed_maximum[k] = piece->processed_maximum[k] = processed_maximum[k];
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  dt_dev_pixelpipe_shared_release(darktable.pipe_shared, done);
+  return 1;
+}
+
 // recursive helper for process:
 static int
 dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output, void **cl_mem_output, int *out_bpp,
@@ -780,6 +772,11 @@ dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void *
     module->modify_roi_in(module, piece, roi_out, &roi_in);
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
 
+    // another export of this image might have demosaiced it already:
+    if(pipe->type == DT_DEV_PIXELPIPE_EXPORT && darktable.pipe_shared && !strcmp(module->op, "demosaic")
+       && _dev_pixelpipe_shared_demosaic(pipe, piece, &roi_in, roi_out, hash, bufsize, output))
+      goto post_process_collect_info;
+
     // recurse to get actual data of input buffer
     int in_bpp;
     if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &in_bpp, &roi_in, g_list_previous(modules), g_list_previous(pieces), pos-1)) return 1;
@@ -1876,22 +1873,11 @@ post_process_collect_info:
         box[2] = roi_out->width-1;
         box[3] = roi_out->height-1;
       }
-      dev->histogram_max = 0;
-      memset(dev->histogram, 0, sizeof(float)*4*64);
-      for(int j=box[1]; j<=box[3]; j+=4) for(int i=box[0]; i<=box[2]; i+=4)
-        {
-          uint8_t rgb[3];
-          for(int k=0; k<3; k++)
-            rgb[k] = pixel[4*j*roi_out->width+4*i+2-k]>>2;
-
-          for(int k=0; k<3; k++)
-            dev->histogram[4*rgb[k]+k] ++;
-          uint8_t lum = MAX(MAX(rgb[0], rgb[1]), rgb[2]);
-          dev->histogram[4*lum+3] ++;
-        }
+      const int ibox[4] = { box[0], box[1], box[2], box[3] };
+      dt_histogram_collect_8(dev->histogram, 64, pixel, roi_out->width, ibox);
 
       // don't count <= 0 pixels
-      for(int k=19; k<4*64; k+=4) dev->histogram_max = dev->histogram_max > dev->histogram[k] ? dev->histogram_max : dev->histogram[k];
+      dev->histogram_max = dt_histogram_max(dev->histogram, 3, 4, 64);
 
       // calculate the waveform histogram. since this is drawn pixel by pixel we have to do it in the correct size (thus the weird gui stuff :().
       // this HAS to be done on the float input data, otherwise we get really ugly artefacts due to rounding issues when putting colors into the bins.
@@ -2074,7 +2060,8 @@ dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, dt_develop_t
 }
 
 
-int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height, float scale)
+// runs the pipe for roi, the output is left in the cache. returns 1 if pipe was altered during processing.
+static int _dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_iop_roi_t *roi, void **output)
 {
   pipe->processing = 1;
   pipe->opencl_enabled = dt_opencl_update_enabled(); // update enabled flag from preferences
@@ -2090,10 +2077,6 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 
   if(pipe->devid >= 0) dt_opencl_events_reset(pipe->devid);
 
-  dt_iop_roi_t roi = (dt_iop_roi_t)
-  {
-    x, y, width, height, scale
-  };
   // printf("pixelpipe homebrew process start\n");
   if(darktable.unmuted & DT_DEBUG_DEV)
     dt_dev_pixelpipe_cache_print(&pipe->cache);
@@ -2113,6 +2096,9 @@ restart:
   if(pipe->cache_obsolete) dt_dev_pixelpipe_cache_flush(&(pipe->cache));
   pipe->cache_obsolete = 0;
 
+  // hash the params of all nodes once for this run:
+  dt_dev_pixelpipe_cache_update_chain(pipe);
+
   // mask display off as a starting point
   pipe->mask_display = 0;
 
@@ -2121,7 +2107,7 @@ restart:
   int out_bpp;
 
   // run pixelpipe recursively and get error status
-  int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_bpp, &roi, modules, pieces, pos);
+  int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_bpp, roi, modules, pieces, pos);
 
   // get status summary of opencl queue by checking the eventlist
   int oclerr = (pipe->devid >= 0) ? (dt_opencl_events_flush(pipe->devid, 1) != 0) : 0;
@@ -2160,6 +2146,9 @@ restart:
     dt_opencl_unlock_device(pipe->devid);
     pipe->devid = -1;
   }
+  // temporary buffers which haven't been needed this time can go:
+  dt_pipe_scratch_reset(&pipe->scratch, _pipe_type_to_str(pipe->type));
+
   // ... and in case of other errors ...
   if (err)
   {
@@ -2167,16 +2156,78 @@ restart:
     return 1;
   }
 
+  *output = buf;
+  // printf("pixelpipe homebrew process end\n");
+  pipe->processing = 0;
+  return 0;
+}
+
+int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height, float scale)
+{
+  dt_iop_roi_t roi = (dt_iop_roi_t)
+  {
+    x, y, width, height, scale
+  };
+  void *buf = NULL;
+  if(_dev_pixelpipe_process(pipe, dev, &roi, &buf)) return 1;
+
   // terminate
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
   pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
   pipe->backbuf = buf;
+  pipe->backbuf_roi = roi;
   pipe->backbuf_width  = width;
   pipe->backbuf_height = height;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  return 0;
+}
 
-  // printf("pixelpipe homebrew process end\n");
-  pipe->processing = 0;
+int dt_dev_pixelpipe_process_region(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height, float scale, const int *region)
+{
+  dt_iop_roi_t roi = (dt_iop_roi_t)
+  {
+    x, y, width, height, scale
+  };
+  const int rx = region[0], ry = region[1], rwd = region[2] - region[0], rht = region[3] - region[1];
+
+  // the backbuffer lives in the cache, which the region is about to go through. paste into a copy:
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  int valid = pipe->backbuf && !memcmp(&pipe->backbuf_roi, &roi, sizeof(dt_iop_roi_t))
+              && rx >= 0 && ry >= 0 && rwd > 0 && rht > 0 && rx + rwd <= width && ry + rht <= height;
+  if(valid && pipe->backbuf != pipe->backbuf_copy)
+  {
+    const size_t size = (size_t)4*width*height;
+    if(pipe->backbuf_copy_size < size)
+    {
+      free(pipe->backbuf_copy);
+      pipe->backbuf_copy = (uint8_t *)dt_alloc_align(16, size);
+      pipe->backbuf_copy_size = pipe->backbuf_copy ? size : 0;
+    }
+    if(pipe->backbuf_copy)
+    {
+      memcpy(pipe->backbuf_copy, pipe->backbuf, size);
+      pipe->backbuf = pipe->backbuf_copy;
+    }
+    else valid = 0;
+  }
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  if(!valid) return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+
+  dt_iop_roi_t roi_region = (dt_iop_roi_t)
+  {
+    x + rx, y + ry, rwd, rht, scale
+  };
+  void *buf = NULL;
+  if(_dev_pixelpipe_process(pipe, dev, &roi_region, &buf)) return 1;
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  if(pipe->backbuf == pipe->backbuf_copy)
+  {
+    for(int j=0; j<rht; j++)
+      memcpy(pipe->backbuf_copy + 4*((size_t)(ry+j)*width + rx), (uint8_t *)buf + 4*(size_t)j*rwd, 4*rwd);
+    pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
+  }
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   return 0;
 }
 
@@ -2185,6 +2236,40 @@ void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cache_flush(&pipe->cache);
 }
 
+int dt_dev_pixelpipe_region_margin(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, const int priority, const float scale)
+{
+  int margin = 0;
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  GList *modules = dev->iop;
+  GList *pieces  = pipe->nodes;
+  while(modules && pieces)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    if(piece->enabled && module->priority >= priority)
+    {
+      // modules which can't be tiled may need the whole image, there is no margin large enough.
+      // the hidden display conversion in the end works per pixel.
+      if(!(module->flags() & (IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_HIDDEN)))
+      {
+        margin = -1;
+        break;
+      }
+      // the overlap the module asks for between tiles is what it reads around each pixel.
+      // modules before demosaic see full resolution, so only ever scale it up.
+      dt_iop_roi_t roi = piece->buf_in;
+      roi.scale = scale;
+      dt_develop_tiling_t tiling = { 0 };
+      module->tiling_callback(module, piece, &roi, &roi, &tiling);
+      margin += ceilf(tiling.overlap * fmaxf(1.0f, scale));
+    }
+    modules = g_list_next(modules);
+    pieces = g_list_next(pieces);
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  return margin;
+}
+
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int width_in, int height_in, int *width, int *height)
 {
   dt_pthread_mutex_lock(&pipe->busy_mutex);
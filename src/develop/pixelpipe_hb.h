@@ -24,6 +24,7 @@
 #include "develop/imageop.h"
 #include "develop/develop.h"
 #include "develop/pixelpipe_cache.h"
+#include "develop/pixelpipe_scratch.h"
 
 /**
  * struct used by iop modules to connect to pixelpipe.
@@ -90,6 +91,8 @@ typedef struct dt_dev_pixelpipe_t
   dt_dev_pixelpipe_cache_t cache;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
+  // temporary buffers of the modules
+  dt_pipe_scratch_t scratch;
   // input buffer
   float *input;
   // width and height of input buffer
@@ -106,11 +109,20 @@ typedef struct dt_dev_pixelpipe_t
   GList *nodes;
   // event flag
   dt_dev_pixelpipe_change_t changed;
+  // hash_chain[k] hashes the first k nodes for the cache, node k contributed hash_key[k] to it.
+  // see dt_dev_pixelpipe_cache_update_chain().
+  uint64_t *hash_chain, *hash_key;
+  int hash_chain_length;
   // backbuffer (output)
   uint8_t *backbuf;
   int backbuf_size;
   int backbuf_width, backbuf_height;
   uint64_t backbuf_hash;
+  // region of interest the backbuffer has been processed for, and a copy of it owned
+  // by the pipe, into which dt_dev_pixelpipe_process_region() pastes the parts it updates.
+  dt_iop_roi_t backbuf_roi;
+  uint8_t *backbuf_copy;
+  size_t backbuf_copy_size;
   dt_pthread_mutex_t backbuf_mutex, busy_mutex;
   // working?
   int processing;
@@ -129,6 +141,8 @@ typedef struct dt_dev_pixelpipe_t
   dt_dev_pixelpipe_type_t type;
   // the final output pixel format this pixelpipe will be converted to
   dt_imageio_levels_t levels;
+  // downscaled exports may demosaic at half size, set per export before the nodes are created.
+  int demosaic_half_size;
   // opencl device that has been locked for this pipe.
   int devid;
   // image struct as it was when the pixelpipe was initialized. copied to avoid race conditions.
@@ -173,6 +187,12 @@ void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width, int height, float scale);
+// process only region (x0, y0, x1, y1, relative to the roi) and paste it into the backbuffer of the same roi.
+// processes the whole roi if the backbuffer is of a different one. returns 1 if pipe was altered during processing.
+int dt_dev_pixelpipe_process_region(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width, int height, float scale, const int *region);
+// margin in pixels at scale that modules from priority on need around a region processed on its own,
+// summed up from their tiling overlaps. -1 if one of them works on the whole image.
+int dt_dev_pixelpipe_region_margin(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, const int priority, const float scale);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width, int height, float scale);
 
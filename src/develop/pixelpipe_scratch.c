@@ -0,0 +1,181 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/darktable.h"
+#include "control/conf.h"
+#include "develop/pixelpipe_hb.h"
+#include "develop/pixelpipe_scratch.h"
+
+#include <stdlib.h>
+
+typedef struct dt_pipe_scratch_block_t
+{
+  void *mem;
+  size_t size;
+  int in_use;
+  int used;   // handed out during the current run
+}
+dt_pipe_scratch_block_t;
+
+// rounds up to one of four size classes per power of two,
+// so at most a quarter of a block is wasted.
+static size_t _size_class(const size_t size)
+{
+  size_t step = 64;
+  while((step<<3) <= size) step <<= 1;
+  return (size + step - 1) & ~(step - 1);
+}
+
+void dt_pipe_scratch_init(dt_pipe_scratch_t *scratch)
+{
+  memset(scratch, 0, sizeof(dt_pipe_scratch_t));
+  dt_pthread_mutex_init(&scratch->lock, NULL);
+  // keep at most a quarter of what the host memory limit allows around, 0 means no limit.
+  const int limit = dt_conf_get_int("host_memory_limit");
+  scratch->limit = limit > 0 ? (size_t)limit*1024*1024/4 : 0;
+}
+
+// frees unused blocks until no more than the limit is kept around. needs scratch->lock.
+static void _trim(dt_pipe_scratch_t *scratch)
+{
+  if(!scratch->limit) return;
+  GList *l = scratch->blocks;
+  while(l && scratch->reserved - scratch->in_use > scratch->limit)
+  {
+    GList *next = g_list_next(l);
+    dt_pipe_scratch_block_t *b = (dt_pipe_scratch_block_t *)l->data;
+    if(!b->in_use)
+    {
+      scratch->reserved -= b->size;
+      free(b->mem);
+      free(b);
+      scratch->blocks = g_list_delete_link(scratch->blocks, l);
+    }
+    l = next;
+  }
+}
+
+void dt_pipe_scratch_cleanup(dt_pipe_scratch_t *scratch)
+{
+  for(GList *l = scratch->blocks; l; l = g_list_next(l))
+  {
+    dt_pipe_scratch_block_t *b = (dt_pipe_scratch_block_t *)l->data;
+    free(b->mem);
+    free(b);
+  }
+  g_list_free(scratch->blocks);
+  scratch->blocks = NULL;
+  dt_pthread_mutex_destroy(&scratch->lock);
+}
+
+void dt_pipe_scratch_reset(dt_pipe_scratch_t *scratch, const char *name)
+{
+  dt_pthread_mutex_lock(&scratch->lock);
+  GList *l = scratch->blocks;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_pipe_scratch_block_t *b = (dt_pipe_scratch_block_t *)l->data;
+    if(!b->in_use && !b->used)
+    {
+      scratch->reserved -= b->size;
+      free(b->mem);
+      free(b);
+      scratch->blocks = g_list_delete_link(scratch->blocks, l);
+    }
+    else b->used = 0;
+    l = next;
+  }
+  if(scratch->allocs)
+    dt_print(DT_DEBUG_MEMORY, "[pixelpipe_scratch] [%s] high water mark %.2f MB, %.2f MB kept, %d allocations (%d reused)\n",
+             name, scratch->peak/(1024.0*1024.0), scratch->reserved/(1024.0*1024.0), scratch->allocs, scratch->reused);
+  scratch->peak = scratch->in_use;
+  scratch->allocs = scratch->reused = 0;
+  dt_pthread_mutex_unlock(&scratch->lock);
+}
+
+void *dt_pipe_scratch_alloc(dt_dev_pixelpipe_t *pipe, const size_t size)
+{
+  if(!pipe) return dt_alloc_align(64, size);
+  dt_pipe_scratch_t *scratch = &pipe->scratch;
+  const size_t csize = _size_class(size);
+  dt_pipe_scratch_block_t *block = NULL;
+
+  dt_pthread_mutex_lock(&scratch->lock);
+  // the smallest free block which fits, wasting at most half of it:
+  for(GList *l = scratch->blocks; l; l = g_list_next(l))
+  {
+    dt_pipe_scratch_block_t *b = (dt_pipe_scratch_block_t *)l->data;
+    if(!b->in_use && b->size >= csize && b->size <= 2*csize && (!block || b->size < block->size))
+    {
+      block = b;
+      if(b->size == csize) break;
+    }
+  }
+  if(block) scratch->reused++;
+  else
+  {
+    void *mem = dt_alloc_align(64, csize);
+    if(!mem)
+    {
+      dt_pthread_mutex_unlock(&scratch->lock);
+      return NULL;
+    }
+    block = (dt_pipe_scratch_block_t *)malloc(sizeof(dt_pipe_scratch_block_t));
+    block->mem = mem;
+    block->size = csize;
+    scratch->blocks = g_list_prepend(scratch->blocks, block);
+    scratch->reserved += csize;
+  }
+  block->in_use = block->used = 1;
+  scratch->allocs++;
+  scratch->in_use += csize;
+  scratch->peak = MAX(scratch->peak, scratch->in_use);
+  dt_pthread_mutex_unlock(&scratch->lock);
+  return block->mem;
+}
+
+void dt_pipe_scratch_free(dt_dev_pixelpipe_t *pipe, void *mem)
+{
+  if(!mem) return;
+  if(!pipe)
+  {
+    free(mem);
+    return;
+  }
+  dt_pipe_scratch_t *scratch = &pipe->scratch;
+  dt_pthread_mutex_lock(&scratch->lock);
+  for(GList *l = scratch->blocks; l; l = g_list_next(l))
+  {
+    dt_pipe_scratch_block_t *b = (dt_pipe_scratch_block_t *)l->data;
+    if(b->mem == mem)
+    {
+      b->in_use = 0;
+      scratch->in_use -= b->size;
+      _trim(scratch);
+      dt_pthread_mutex_unlock(&scratch->lock);
+      return;
+    }
+  }
+  dt_pthread_mutex_unlock(&scratch->lock);
+  // not ours:
+  free(mem);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
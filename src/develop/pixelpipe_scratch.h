@@ -0,0 +1,61 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_PIXELPIPE_SCRATCH_H
+#define DT_PIXELPIPE_SCRATCH_H
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <stddef.h>
+
+/**
+ * scratch memory for temporary buffers of the modules in a pixelpipe.
+ * freed buffers are kept around and handed out again for requests of the
+ * same or a somewhat smaller size class, so repeated runs of the pipe don't
+ * mmap and page fault fresh memory for every temporary. free buffers beyond
+ * a quarter of the host memory limit, and after each run of the pipe the ones
+ * which haven't been used during that run, are given back to the system.
+ */
+struct dt_dev_pixelpipe_t;
+typedef struct dt_pipe_scratch_t
+{
+  dt_pthread_mutex_t lock;
+  GList *blocks;    // all blocks, free or in use
+  size_t in_use;    // bytes currently handed out
+  size_t peak;      // high water mark of in_use during this run
+  size_t reserved;  // bytes allocated from the system
+  size_t limit;     // most bytes kept in free blocks, 0 for no limit
+  int allocs;       // number of allocations during this run
+  int reused;       // how many of these didn't need new memory
+}
+dt_pipe_scratch_t;
+
+void dt_pipe_scratch_init(dt_pipe_scratch_t *scratch);
+void dt_pipe_scratch_cleanup(dt_pipe_scratch_t *scratch);
+/** to be called after a run of the pipe: releases unused memory and prints stats. */
+void dt_pipe_scratch_reset(dt_pipe_scratch_t *scratch, const char *name);
+
+/** 64-byte aligned temporary memory, pipe may be NULL to fall back to dt_alloc_align(). */
+void *dt_pipe_scratch_alloc(struct dt_dev_pixelpipe_t *pipe, const size_t size);
+/** gives memory from dt_pipe_scratch_alloc() back to the pipe. */
+void dt_pipe_scratch_free(struct dt_dev_pixelpipe_t *pipe, void *mem);
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,185 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/darktable.h"
+#include "control/conf.h"
+#include "develop/pixelpipe_hb.h"
+#include "develop/pixelpipe_shared.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct dt_dev_pixelpipe_shared_entry_t
+{
+  uint64_t hash;
+  int width, height;
+  float processed_maximum[3];
+  int users;
+  size_t size;
+  float *buf;
+}
+dt_dev_pixelpipe_shared_entry_t;
+
+static void _entry_free(dt_dev_pixelpipe_shared_entry_t *e)
+{
+  free(e->buf);
+  free(e);
+}
+
+// drops unused entries, least recently used first, until `size' more bytes fit into max.
+static void _make_room(dt_dev_pixelpipe_shared_t *s, const size_t size, const size_t max)
+{
+  GList *l = g_list_last(s->entries);
+  while(l && s->size + size > max)
+  {
+    GList *prev = g_list_previous(l);
+    dt_dev_pixelpipe_shared_entry_t *e = (dt_dev_pixelpipe_shared_entry_t *)l->data;
+    if(!e->users)
+    {
+      s->size -= e->size;
+      _entry_free(e);
+      s->entries = g_list_delete_link(s->entries, l);
+    }
+    l = prev;
+  }
+}
+
+void dt_dev_pixelpipe_shared_init(dt_dev_pixelpipe_shared_t *s)
+{
+  memset(s, 0, sizeof(dt_dev_pixelpipe_shared_t));
+  dt_pthread_mutex_init(&s->lock, NULL);
+}
+
+void dt_dev_pixelpipe_shared_cleanup(dt_dev_pixelpipe_shared_t *s)
+{
+  for(GList *l = s->entries; l; l = g_list_next(l))
+    _entry_free((dt_dev_pixelpipe_shared_entry_t *)l->data);
+  g_list_free(s->entries);
+  s->entries = NULL;
+  dt_pthread_mutex_destroy(&s->lock);
+}
+
+void dt_dev_pixelpipe_shared_begin(dt_dev_pixelpipe_shared_t *s)
+{
+  dt_pthread_mutex_lock(&s->lock);
+  s->active++;
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+void dt_dev_pixelpipe_shared_end(dt_dev_pixelpipe_shared_t *s)
+{
+  dt_pthread_mutex_lock(&s->lock);
+  if(--s->active == 0)
+  {
+    _make_room(s, 0, 0);
+    dt_print(DT_DEBUG_CACHE, "[pixelpipe_shared] exports done, %" PRIu64 " hits, %" PRIu64 " misses\n", s->hits, s->misses);
+    s->hits = s->misses = 0;
+  }
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+uint64_t dt_dev_pixelpipe_shared_hash(dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_roi_t full = { 0, 0, piece->buf_in.width, piece->buf_in.height, 1.0f };
+  return dt_dev_pixelpipe_cache_hash(pipe->image.id, &full, pipe, g_list_index(pipe->nodes, piece) + 1);
+}
+
+const float *dt_dev_pixelpipe_shared_get(dt_dev_pixelpipe_shared_t *s, const uint64_t hash, const int width, const int height,
+                                         float *processed_maximum)
+{
+  const float *buf = NULL;
+  dt_pthread_mutex_lock(&s->lock);
+  for(GList *l = s->entries; l; l = g_list_next(l))
+  {
+    dt_dev_pixelpipe_shared_entry_t *e = (dt_dev_pixelpipe_shared_entry_t *)l->data;
+    if(e->hash == hash && e->width == width && e->height == height)
+    {
+      e->users++;
+      buf = e->buf;
+      for(int k=0; k<3; k++) processed_maximum[k] = e->processed_maximum[k];
+      // move to front:
+      s->entries = g_list_remove_link(s->entries, l);
+      s->entries = g_list_concat(l, s->entries);
+      break;
+    }
+  }
+  if(buf) s->hits++;
+  else s->misses++;
+  dt_pthread_mutex_unlock(&s->lock);
+  return buf;
+}
+
+void dt_dev_pixelpipe_shared_release(dt_dev_pixelpipe_shared_t *s, const float *buf)
+{
+  dt_pthread_mutex_lock(&s->lock);
+  for(GList *l = s->entries; l; l = g_list_next(l))
+  {
+    dt_dev_pixelpipe_shared_entry_t *e = (dt_dev_pixelpipe_shared_entry_t *)l->data;
+    if(e->buf == buf)
+    {
+      e->users--;
+      break;
+    }
+  }
+  // exports might have ended while we were reading:
+  if(!s->active) _make_room(s, 0, 0);
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+void dt_dev_pixelpipe_shared_put(dt_dev_pixelpipe_shared_t *s, const uint64_t hash, const float *buf, const int width, const int height,
+                                 const float *processed_maximum)
+{
+  const size_t size = sizeof(float)*4*width*height;
+  const size_t max = (size_t)MAX(0, dt_conf_get_int("plugins/lighttable/export/shared_demosaic_cache"))*1024*1024;
+  if(size > max) return;
+
+  dt_pthread_mutex_lock(&s->lock);
+  if(!s->active) goto done;
+  for(GList *l = s->entries; l; l = g_list_next(l))
+  {
+    dt_dev_pixelpipe_shared_entry_t *e = (dt_dev_pixelpipe_shared_entry_t *)l->data;
+    // another pipe was faster:
+    if(e->hash == hash && e->width == width && e->height == height) goto done;
+  }
+  _make_room(s, size, max);
+  if(s->size + size > max) goto done;
+
+  dt_dev_pixelpipe_shared_entry_t *e = (dt_dev_pixelpipe_shared_entry_t *)malloc(sizeof(dt_dev_pixelpipe_shared_entry_t));
+  e->buf = (float *)dt_alloc_align(64, size);
+  if(!e->buf)
+  {
+    free(e);
+    goto done;
+  }
+  e->hash = hash;
+  e->width = width;
+  e->height = height;
+  for(int k=0; k<3; k++) e->processed_maximum[k] = processed_maximum[k];
+  e->users = 0;
+  e->size = size;
+  // the copy is done under the lock, so nobody finds the entry half written.
+  memcpy(e->buf, buf, size);
+  s->entries = g_list_prepend(s->entries, e);
+  s->size += size;
+
+done:
+  dt_pthread_mutex_unlock(&s->lock);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,72 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_PIXELPIPE_SHARED_H
+#define DT_PIXELPIPE_SHARED_H
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <inttypes.h>
+
+/**
+ * buffers shared between the export pipes of concurrent export jobs.
+ * exporting the same image in several sizes/formats at once runs the
+ * raw stages with identical history in every pipe, so the demosaiced
+ * image of the whole input at scale 1 is kept here, keyed by the hash of
+ * the history up to and including demosaic. dt_dev_pixelpipe_process_rec()
+ * looks it up before recursing into the input of demosaic, and crops and
+ * zooms it to what the pipe asks for.
+ * only used while exports are running, and limited in size by the conf
+ * entry plugins/lighttable/export/shared_demosaic_cache (MB).
+ */
+typedef struct dt_dev_pixelpipe_shared_t
+{
+  dt_pthread_mutex_t lock;
+  GList *entries;   // most recently used first
+  size_t size;      // bytes held by all entries
+  int active;       // running export jobs
+  uint64_t hits, misses;
+}
+dt_dev_pixelpipe_shared_t;
+
+struct dt_dev_pixelpipe_t;
+struct dt_dev_pixelpipe_iop_t;
+
+void dt_dev_pixelpipe_shared_init(dt_dev_pixelpipe_shared_t *s);
+void dt_dev_pixelpipe_shared_cleanup(dt_dev_pixelpipe_shared_t *s);
+
+/** an export job starts, buffers will be kept from now on. */
+void dt_dev_pixelpipe_shared_begin(dt_dev_pixelpipe_shared_t *s);
+/** an export job is done, the buffers go away with the last one. */
+void dt_dev_pixelpipe_shared_end(dt_dev_pixelpipe_shared_t *s);
+
+/** hash of the output of this piece for its whole input (piece->buf_in) at scale 1. */
+uint64_t dt_dev_pixelpipe_shared_hash(struct dt_dev_pixelpipe_t *pipe, struct dt_dev_pixelpipe_iop_t *piece);
+/** returns the rgba float buffer stored for this hash and size, or NULL. has to be released again.
+ *  processed_maximum gets the pipe's sensor saturation as it was for this buffer. */
+const float *dt_dev_pixelpipe_shared_get(dt_dev_pixelpipe_shared_t *s, const uint64_t hash, const int width, const int height,
+                                         float *processed_maximum);
+void dt_dev_pixelpipe_shared_release(dt_dev_pixelpipe_shared_t *s, const float *buf);
+/** keeps a copy of the buffer under this hash, if exports are running and it fits. */
+void dt_dev_pixelpipe_shared_put(dt_dev_pixelpipe_shared_t *s, const uint64_t hash, const float *buf, const int width, const int height,
+                                 const float *processed_maximum);
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -698,13 +698,13 @@ _default_process_tiling_ptp (struct dt_iop_module_t *self, struct dt_dev_pixelpi
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n", tiles_x, tiles_y, width, height, overlap);
 
   /* reserve input and output buffers for tiles */
-  input = dt_alloc_align(64, width*height*in_bpp);
+  input = dt_pipe_scratch_alloc(piece->pipe, width*height*in_bpp);
   if(input == NULL)
   {
     dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc input buffer for module '%s'\n", self->op);
     goto error;
   }
-  output = dt_alloc_align(64, width*height*out_bpp);
+  output = dt_pipe_scratch_alloc(piece->pipe, width*height*out_bpp);
   if(output == NULL)
   {
     dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc output buffer for module '%s'\n", self->op);
@@ -796,8 +796,8 @@ _default_process_tiling_ptp (struct dt_iop_module_t *self, struct dt_dev_pixelpi
   for(int k=0; k<3; k++)
     piece->pipe->processed_maximum[k] = processed_maximum_new[k];
 
-  if(input != NULL) free(input);
-  if(output != NULL) free(output);
+  dt_pipe_scratch_free(piece->pipe, input);
+  dt_pipe_scratch_free(piece->pipe, output);
   piece->pipe->tiling = 0;
   return;
 
@@ -806,8 +806,8 @@ error:
   // fall through
 
 fallback:
-  if(input != NULL) free(input);
-  if(output != NULL) free(output);
+  dt_pipe_scratch_free(piece->pipe, input);
+  dt_pipe_scratch_free(piece->pipe, output);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] fall back to standard processing for module '%s'\n", self->op);
   self->process(self, piece, ivoid, ovoid, roi_in, roi_out);
@@ -1038,13 +1038,13 @@ _default_process_tiling_roi (struct dt_iop_module_t *self, struct dt_dev_pixelpi
 
 
       /* prepare input tile buffer */
-      input = dt_alloc_align(64, iroi_full.width*iroi_full.height*in_bpp);
+      input = dt_pipe_scratch_alloc(piece->pipe, iroi_full.width*iroi_full.height*in_bpp);
       if(input == NULL)
       {
         dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc input buffer for module '%s'\n", self->op);
         goto error;
       }
-      output = dt_alloc_align(64, oroi_full.width*oroi_full.height*out_bpp);
+      output = dt_pipe_scratch_alloc(piece->pipe, oroi_full.width*oroi_full.height*out_bpp);
       if(output == NULL)
       {
         dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc output buffer for module '%s'\n", self->op);
@@ -1083,8 +1083,8 @@ _default_process_tiling_roi (struct dt_iop_module_t *self, struct dt_dev_pixelpi
       for(int j=0; j<oroi_good.height; j++)
         memcpy((char *)ovoid+ooffs+j*opitch, (char *)output+((j+origin_y)*oroi_full.width+origin_x)*out_bpp, oroi_good.width*out_bpp);
 
-      free(input);
-      free(output);
+      dt_pipe_scratch_free(piece->pipe, input);
+      dt_pipe_scratch_free(piece->pipe, output);
       input = output = NULL;
     }
 
@@ -1092,8 +1092,8 @@ _default_process_tiling_roi (struct dt_iop_module_t *self, struct dt_dev_pixelpi
   for(int k=0; k<3; k++)
     piece->pipe->processed_maximum[k] = processed_maximum_new[k];
 
-  if(input != NULL) free(input);
-  if(output != NULL) free(output);
+  dt_pipe_scratch_free(piece->pipe, input);
+  dt_pipe_scratch_free(piece->pipe, output);
   piece->pipe->tiling = 0;
   return;
 
@@ -1102,8 +1102,8 @@ error:
   // fall through
 
 fallback:
-  if(input != NULL) free(input);
-  if(output != NULL) free(output);
+  dt_pipe_scratch_free(piece->pipe, input);
+  dt_pipe_scratch_free(piece->pipe, output);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] fall back to standard processing for module '%s'\n", self->op);
   self->process(self, piece, ivoid, ovoid, roi_in, roi_out);
@@ -0,0 +1,228 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * generates the thumbnails of a library without gui, so the lighttable finds
+ * them in the mipmap cache file when it starts up. walks all images, one film
+ * roll or the current collection, newest images first, on a few threads.
+ *
+ * the cache file is written every few images. thumbnails which are in it
+ * already are skipped, so an interrupted run just has to be started again.
+ */
+
+#include "common/darktable.h"
+#include "common/debug.h"
+#include "common/collection.h"
+#include "common/database.h"
+#include "common/mipmap_cache.h"
+
+#include <libintl.h>
+#include <sqlite3.h>
+
+static void
+usage(const char* progname)
+{
+  fprintf(stderr, "usage: %s [--film <film roll id>|--collection] [-m|--max-mip <0-2>] [--threads <n>] [--checkpoint <images>] [--core <darktable options>]\n", progname);
+}
+
+// 1 if the thumbnail has been generated, 0 if it was in the cache already, -1 if the image couldn't be loaded.
+static int
+generate(const int imgid, const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_read_get(cache, &buf, imgid, mip, DT_MIPMAP_TESTLOCK);
+  if(buf.buf)
+  {
+    dt_mipmap_cache_read_release(cache, &buf);
+    return 0;
+  }
+  // generating this one also fills all smaller sizes:
+  dt_mipmap_cache_read_get(cache, &buf, imgid, mip, DT_MIPMAP_BLOCKING);
+  if(!buf.buf) return -1;
+  // the 8x8 dead image stands in for images which failed to load, it's not written to the cache file:
+  const int ok = buf.width > 8 || buf.height > 8;
+  dt_mipmap_cache_read_release(cache, &buf);
+  return ok ? 1 : -1;
+}
+
+int main(int argc, char *arg[])
+{
+  bindtextdomain (GETTEXT_PACKAGE, DARKTABLE_LOCALEDIR);
+  bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+  textdomain (GETTEXT_PACKAGE);
+
+  gtk_init (&argc, &arg);
+
+  // parse command line arguments
+  int film_id = -1;
+  gboolean collection = FALSE;
+  int max_mip = DT_MIPMAP_2;
+  int threads = MIN(dt_get_num_threads(), 8);
+  int checkpoint = 100;
+
+  int k;
+  for(k=1; k<argc; k++)
+  {
+    if(!strcmp(arg[k], "-h") || !strcmp(arg[k], "--help"))
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+    else if(!strcmp(arg[k], "--version"))
+    {
+      printf("this is darktable-generate-cache\ncopyright (c) 2014 the darktable developers\n");
+      exit(1);
+    }
+    else if(!strcmp(arg[k], "--film") && k+1 < argc)
+    {
+      k++;
+      film_id = atoi(arg[k]);
+    }
+    else if(!strcmp(arg[k], "--collection"))
+    {
+      collection = TRUE;
+    }
+    else if((!strcmp(arg[k], "-m") || !strcmp(arg[k], "--max-mip")) && k+1 < argc)
+    {
+      k++;
+      // the cache file only holds the small thumbnails:
+      max_mip = CLAMP(atoi(arg[k]), DT_MIPMAP_0, DT_MIPMAP_2);
+    }
+    else if(!strcmp(arg[k], "--threads") && k+1 < argc)
+    {
+      k++;
+      // the mipmap cache keeps temporary buffers for at most 8 threads:
+      threads = CLAMP(atoi(arg[k]), 1, 8);
+    }
+    else if(!strcmp(arg[k], "--checkpoint") && k+1 < argc)
+    {
+      k++;
+      checkpoint = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--core"))
+    {
+      // everything from here on should be passed to the core
+      k++;
+      break;
+    }
+    else
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+  }
+
+  // size the caches for our threads, and use the library given by --core --library, or the default one:
+  char worker_threads[64];
+  snprintf(worker_threads, sizeof(worker_threads), "worker_threads=%d", threads);
+  int m_argc = 0;
+  char *m_arg[6 + argc - k];
+  m_arg[m_argc++] = "darktable-generate-cache";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = worker_threads;
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "parallel_export=1";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  // init dt without gui:
+  if(dt_init(m_argc, m_arg, 0)) exit(1);
+
+  if(!strcmp(dt_database_get_path(darktable.db), ":memory:"))
+  {
+    fprintf(stderr, "[generate-cache] the library is in memory, there is no cache to generate\n");
+    dt_cleanup();
+    exit(1);
+  }
+
+  // the images, newest imports first, since these are the ones about to be looked at:
+  GArray *images = g_array_new(FALSE, FALSE, sizeof(int));
+  sqlite3_stmt *stmt;
+  if(collection)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), dt_collection_get_query(darktable.collection), -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+  }
+  else if(film_id >= 0)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select id from images where film_id = ?1 order by id desc", -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
+  }
+  else
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select id from images order by id desc", -1, &stmt, NULL);
+  }
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(images, imgid);
+  }
+  sqlite3_finalize(stmt);
+
+  // more thumbnails than the cache can hold would only push out each other again:
+  const dt_mipmap_size_t mip = (dt_mipmap_size_t)max_mip;
+  const int capacity = dt_cache_capacity(&darktable.mipmap_cache->mip[mip].cache);
+  const int total = MIN((int)images->len, capacity);
+  if(total < (int)images->len)
+    fprintf(stderr, "[generate-cache] only %d of %d thumbnails of mip %d fit into the cache, "
+            "raise cache_memory (--core --conf cache_memory=<bytes>) for more\n", capacity, images->len, max_mip);
+  printf("[generate-cache] generating mip %d thumbnails for %d images on %d threads\n", max_mip, total, threads);
+
+  const int *ids = (const int *)images->data;
+  const double start = dt_get_wtime();
+  int done = 0, generated = 0, skipped = 0, failed = 0;
+  for(int first = 0; first < total; first += checkpoint)
+  {
+    const int last = MIN(total, first + checkpoint);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(threads) shared(done, generated, skipped, failed)
+#endif
+    for(int i = first; i < last; i++)
+    {
+      const int res = generate(ids[i], mip);
+#ifdef _OPENMP
+      #pragma omp critical
+#endif
+      {
+        done++;
+        if(res > 0) generated++;
+        else if(res == 0) skipped++;
+        else failed++;
+        const double elapsed = dt_get_wtime() - start;
+        printf("[generate-cache] %d/%d (%.1f%%) image %d %s, %.0fs left\n", done, total, 100.0*done/total, ids[i],
+               res > 0 ? "generated" : (res == 0 ? "was cached" : "failed"), elapsed*(total - done)/done);
+        fflush(stdout);
+      }
+    }
+    // write what we have, this is where an interrupted run picks up again:
+    dt_mipmap_cache_serialize(darktable.mipmap_cache);
+  }
+
+  printf("[generate-cache] %d thumbnails generated, %d were cached already, %d images failed to load, took %.1fs\n",
+         generated, skipped, failed, dt_get_wtime() - start);
+
+  g_array_free(images, TRUE);
+  dt_cleanup();
+  return failed ? 1 : 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
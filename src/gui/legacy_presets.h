@@ -23,7 +23,6 @@
 static const char *sql_lines[] =
 {
   "PRAGMA foreign_keys=OFF;"
-  , "BEGIN TRANSACTION;"
   , "drop table if exists legacy_presets" // fails first time, but doesn't hurt.
   , "CREATE TABLE legacy_presets (name varchar, description varchar, operation varchar, op_version integer, op_params blob, enabled integer, blendop_params blob, blendop_version integer, multi_priority integer, multi_name varchar, model varchar, maker varchar, lens varchar, iso_min real, iso_max real, exposure_min real, exposure_max real, aperture_min real, aperture_max real, focal_length_min real, focal_length_max real, writeprotect integer, autoapply integer, filter integer, def integer, isldr integer);"
   , "INSERT INTO legacy_presets VALUES('red filter','','monochrome',2,X'000000420000804233331340A97F0000',1,X'000000000000C842000000000000000000000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F',3,0,' ','%','%','%',0.0,51200.0,0.0,10000000.0,0.0,100000000.0,0.0,1000.0,1,0,0,0,0);"
@@ -121,15 +120,18 @@ static const char *sql_lines[] =
   , "INSERT INTO legacy_presets VALUES('CC-by-nc-nd','','metadata',1,X'0000437265617469766520436F6D6D6F6E73204174747269627574696F6E2D4E6F6E436F6D6D65726369616C2D4E6F446572697673202843432D42592D4E432D4E4429000000',1,NULL,0,0,' ','%','%','%',0.0,51200.0,0.0,10000000.0,0.0,100000000.0,0.0,1000.0,1,0,0,0,0);"
   , "INSERT INTO legacy_presets VALUES('all rights reserved','','metadata',1,X'0000416C6C207269676874732072657365727665642E000000',1,NULL,0,0,' ','%','%','%',0.0,51200.0,0.0,10000000.0,0.0,100000000.0,0.0,1000.0,1,0,0,0,0);"
   , "INSERT INTO legacy_presets VALUES('sharpen','','sharpen',1,X'000000400000003F0000003F',1,X'000000000000C84200000000000000000000000000000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F00000000000000000000803F0000803F',4,0,' ','%','%','%',0.0,51200.0,0.0,10000000.0,0.0,100000000.0,0.0,1000.0,1,1,0,0,2);"
-  , "COMMIT;"
 };
-static const int num_sql_lines = 100;
+static const int num_sql_lines = 98;
 
 void dt_legacy_presets_create()
 {
   // a bit stupid, deletes and re-inserts every time :(
-  for(int i=0; i<num_sql_lines; i++)
+  // the pragma is a no-op inside a transaction:
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), sql_lines[0], NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
+  for(int i=1; i<num_sql_lines; i++)
     DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), sql_lines[i], NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 }
 
 #endif
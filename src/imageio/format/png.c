@@ -27,6 +27,7 @@
 #include "control/conf.h"
 #include "dtgtk/slider.h"
 #include "common/imageio_format.h"
+#include "common/imageio_deflate.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <png.h>
@@ -169,39 +170,75 @@ write_image (dt_imageio_module_data_t *p_tmp, const char *filename, const void *
                p->bpp, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
+  // the exif goes in front of the image data, we write the rest of the file ourselves:
+  PNGwriteRawProfile(png_ptr, info_ptr, "exif", exif, exif_len);
+
+  // TODO: embed icc profile!
+
   png_write_info(png_ptr, info_ptr);
 
-  // png_bytep row_pointer = (png_bytep) in;
-  png_byte row[6*width];
-  // unsigned long rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+  // pack and filter the rows, and deflate them on all cores into one idat stream.
+  // libpng only compresses serially, so it is left with writing the chunks.
+  const int bpp = p->bpp > 8 ? 6 : 3;
+  const size_t rowbytes = (size_t)bpp*width;
+  uint8_t *rows = (uint8_t *)malloc(rowbytes*height);
+  uint8_t *filtered = (uint8_t *)malloc((rowbytes+1)*height);
+  if(!rows || !filtered)
+  {
+    free(rows);
+    free(filtered);
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 1;
+  }
 
   if(p->bpp > 8)
   {
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
     for (int y = 0; y < height; y++)
     {
+      uint8_t *row = rows + rowbytes*y;
       for(int x=0; x<width; x++) for(int k=0; k<3; k++)
         {
-          uint16_t pix = ((uint16_t *)in)[4*width*y + 4*x + k];
-          uint16_t swapped = (0xff00 & (pix<<8)) | (pix>>8);
-          ((uint16_t *)row)[3*x+k] = swapped;
+          // png wants big endian
+          const uint16_t pix = ((uint16_t *)in)[4*width*y + 4*x + k];
+          row[6*x+2*k]   = pix >> 8;
+          row[6*x+2*k+1] = pix & 0xff;
         }
-      png_write_row(png_ptr, row);
     }
   }
   else
   {
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
     for (int y = 0; y < height; y++)
     {
+      uint8_t *row = rows + rowbytes*y;
       for(int x=0; x<width; x++) for(int k=0; k<3; k++) row[3*x+k] = in[4*width*y + 4*x + k];
-      png_write_row(png_ptr, row);
     }
   }
 
-  PNGwriteRawProfile(png_ptr, info_ptr, "exif", exif, exif_len);
-
-  // TODO: embed icc profile!
+  dt_imageio_png_filter(rows, filtered, height, rowbytes, bpp);
+  free(rows);
+  size_t length = 0;
+  uint8_t *idat = dt_imageio_deflate(filtered, (rowbytes+1)*height, Z_BEST_COMPRESSION, &length);
+  free(filtered);
+  if(!idat)
+  {
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 1;
+  }
+  for(size_t pos = 0; pos < length; pos += DT_IMAGEIO_DEFLATE_BLOCK)
+    png_write_chunk(png_ptr, (png_bytep)"IDAT", idat + pos, MIN(length - pos, DT_IMAGEIO_DEFLATE_BLOCK));
+  free(idat);
+  // png_write_end() would insist on having written the idat itself:
+  png_write_chunk(png_ptr, (png_bytep)"IEND", NULL, 0);
+  png_write_flush(png_ptr);
 
-  png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   fclose(f);
   return 0;
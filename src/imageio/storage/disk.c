@@ -144,7 +144,7 @@ gui_reset (dt_imageio_module_storage_t *self)
 
 int
 store (dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata,
-       const int num, const int total, const gboolean high_quality)
+       const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   dt_imageio_disk_t *d = (dt_imageio_disk_t *)sdata;
 
@@ -235,7 +235,7 @@ failed:
   if(fail) return 1;
 
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
@@ -82,7 +82,7 @@ gui_reset (dt_imageio_module_storage_t *self)
 
 int
 store (dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata,
-       const int num, const int total, const gboolean high_quality)
+       const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   dt_imageio_email_t *d = (dt_imageio_email_t *)sdata;
 
@@ -102,7 +102,7 @@ store (dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const
 
   attachment->file = g_build_filename( tmpdir, filename, (char *)NULL );
 
-  if(dt_imageio_export(imgid, attachment->file, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, attachment->file, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     fprintf(stderr, "[imageio_storage_email] could not export to file: `%s'!\n", attachment->file);
     dt_control_log(_("could not export to file `%s'!"), attachment->file);
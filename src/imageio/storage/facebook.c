@@ -1139,7 +1139,7 @@ int supported(struct dt_imageio_module_storage_t *self, struct dt_imageio_module
 }
 
 /* this actually does the work */
-int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality)
+int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   gint result = 1;
   dt_storage_facebook_param_t *p = (dt_storage_facebook_param_t*)sdata;
@@ -1185,7 +1185,7 @@ int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sd
   if (fdata->max_width == 0 || fdata->max_width > FB_IMAGE_MAX_SIZE)
     fdata->max_width = FB_IMAGE_MAX_SIZE;
 
-  if(dt_imageio_export(imgid, fname, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, fname, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     g_printerr("[facebook] could not export to file: `%s'!\n", fname);
     dt_control_log(_("could not export to file `%s'!"), fname);
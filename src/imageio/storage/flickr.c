@@ -614,7 +614,7 @@ gui_reset (dt_imageio_module_storage_t *self)
 
 int
 store (dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata,
-       const int num, const int total, const gboolean high_quality)
+       const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   gint result=1;
   dt_storage_flickr_params_t *p=(dt_storage_flickr_params_t *)sdata;
@@ -664,7 +664,7 @@ store (dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const
   }
   dt_image_cache_read_release(darktable.image_cache, img);
 
-  if(dt_imageio_export(imgid, fname, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, fname, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     fprintf(stderr, "[imageio_storage_flickr] could not export to file: `%s'!\n", fname);
     dt_control_log(_("could not export to file `%s'!"), fname);
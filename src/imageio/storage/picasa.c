@@ -1429,7 +1429,7 @@ int supported(struct dt_imageio_module_storage_t *self, struct dt_imageio_module
 }
 
 /* this actually does the work */
-int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality)
+int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sdata, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   gint result = 1;
   PicasaContext *ctx = (PicasaContext*)sdata;
@@ -1478,7 +1478,7 @@ int store(dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *sd
 
   dt_image_cache_read_release(darktable.image_cache, img);
 
-  if(dt_imageio_export(imgid, fname, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, fname, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     g_printerr("[picasa] could not export to file: `%s'!\n", fname);
     dt_control_log(_("could not export to file `%s'!"), fname);
@@ -19,6 +19,7 @@
 #include "develop/tiling.h"
 #include "common/opencl.h"
 #include "common/debug.h"
+#include "common/eaw.h"
 #include "control/conf.h"
 #include "gui/accelerators.h"
 #include "gui/draw.h"
@@ -138,244 +139,6 @@ void connect_key_accels(dt_iop_module_t *self)
 }
 
 
-#define ALIGNED(a) __attribute__((aligned(a)))
-#define VEC4(a) {(a), (a), (a), (a)}
-
-static const __m128 fone ALIGNED(16) = VEC4(0x3f800000u);
-static const __m128 femo ALIGNED(16) = VEC4(0x00adf880u);
-static const __m128 ooo1 ALIGNED(16) = {0.f, 0.f, 0.f, 1.f};
-
-/* SSE intrinsics version of dt_fast_expf defined in darktable.h */
-static __m128  inline
-dt_fast_expf_sse(const __m128 x)
-{
-  __m128  f = _mm_add_ps(fone, _mm_mul_ps(x, femo)); // f(n) = i1 + x(n)*(i2-i1)
-  __m128i i = _mm_cvtps_epi32(f);                    // i(n) = int(f(n))
-  __m128i mask = _mm_srai_epi32(i, 31);              // mask(n) = 0xffffffff if i(n) < 0
-  i = _mm_andnot_si128(mask, i);                     // i(n) = 0 if i(n) < 0
-  return _mm_castsi128_ps(i);                        // return *(float*)&i
-}
-
-/* Computes the vector
- * (wl, wc, wc, 1)
- *
- * where:
- * wl = exp(-sharpen*SQR(c1[0] - c2[0]))
- *    = exp(-s*d1) (as noted in code comments below)
- * wc = exp(-sharpen*(SQR(c1[1] - c2[1]) + SQR(c1[2] - c2[2]))
- *    = exp(-s*(d2+d3)) (as noted in code comments below)
- */
-static __m128  inline
-weight_sse(const __m128 *c1, const __m128 *c2, const float sharpen)
-{
-  const __m128 vsharpen = _mm_set1_ps(-sharpen);  // (-s, -s, -s, -s)
-  __m128 diff = _mm_sub_ps(*c1, *c2);
-  __m128 square = _mm_mul_ps(diff, diff);         // (?, d3, d2, d1)
-  __m128 square2 = _mm_shuffle_ps(square, square, _MM_SHUFFLE(3, 1, 2, 0)); // (?, d2, d3, d1)
-  __m128 added = _mm_add_ps(square, square2);     // (?, d2+d3, d2+d3, 2*d1)
-  added = _mm_sub_ss(added, square);              // (?, d2+d3, d2+d3, d1)
-  __m128 sharpened = _mm_mul_ps(added, vsharpen); // (?, -s*(d2+d3), -s*(d2+d3), -s*d1)
-  __m128 exp = dt_fast_expf_sse(sharpened);       // (?, wc, wc, wl)
-  exp = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(exp), 4)); // (wc, wc, wl, 0)
-  exp = _mm_castsi128_ps(_mm_srli_si128(_mm_castps_si128(exp), 4)); // (0, wc, wc, wl)
-  exp = _mm_or_ps(exp, ooo1); // (1, wc, wc, wl)
-  return exp;
-}
-
-#define SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj) \
-  do { \
-    const __m128 f = _mm_set1_ps(filter[(ii)]*filter[(jj)]); \
-    const __m128 wp = weight_sse(px, px2, sharpen); \
-    const __m128 w = _mm_mul_ps(f, wp); \
-    const __m128 pd = _mm_mul_ps(w, *px2); \
-    sum = _mm_add_ps(sum, pd); \
-    wgt = _mm_add_ps(wgt, w); \
-  } while (0)
-
-#define SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj) \
-  do { \
-    const int iii = (ii)-2; \
-    const int jjj = (jj)-2; \
-    int x = i + mult*iii; \
-    int y = j + mult*jjj; \
-    \
-    if(x < 0)       x = 0; \
-    if(x >= width)  x = width  - 1; \
-    if(y < 0)       y = 0; \
-    if(y >= height) y = height - 1; \
-    \
-    px2 = ((__m128 *)in) + x + y*width; \
-    \
-    SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj); \
-  } while (0)
-
-#define ROW_PROLOGUE \
-  const __m128 *px = ((__m128 *)in) + j*width; \
-  const __m128 *px2; \
-  float *pdetail = detail + 4*j*width; \
-  float *pcoarse = out + 4*j*width;
-
-#define SUM_PIXEL_PROLOGUE \
-  __m128 sum = _mm_setzero_ps(); \
-  __m128 wgt = _mm_setzero_ps();
-
-#define SUM_PIXEL_EPILOGUE \
-  sum = _mm_mul_ps(sum, _mm_rcp_ps(wgt)); \
-  \
-  _mm_stream_ps(pdetail, _mm_sub_ps(*px, sum)); \
-  _mm_stream_ps(pcoarse, sum); \
-  px++; \
-  pdetail+=4; \
-  pcoarse+=4;
-
-static void
-eaw_decompose (float *const out, const float *const in, float *const detail, const int scale,
-               const float sharpen, const int32_t width, const int32_t height)
-{
-  const int mult = 1<<scale;
-  static const float filter[5] = {1.0f/16.0f, 4.0f/16.0f, 6.0f/16.0f, 4.0f/16.0f, 1.0f/16.0f};
-
-  /* The first "2*mult" lines use the macro with tests because the 5x5 kernel
-   * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for (int j=0; j<2*mult; j++)
-  {
-    ROW_PROLOGUE
-
-    for(int i=0; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for(int j=2*mult; j<height-2*mult; j++)
-  {
-    ROW_PROLOGUE
-
-    /* The first "2*mult" pixels use the macro with tests because the 5x5 kernel
-     * requires nearest pixel interpolation for at least a pixel in the sum */
-    for (int i=0; i<2*mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-
-    /* For pixels [2*mult, width-2*mult], we can safely use macro w/o tests
-     * to avoid unneeded branching in the inner loops */
-    for(int i=2*mult; i<width-2*mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      px2 = ((__m128*)in) + i-2*mult + (j-2*mult)*width;
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj);
-          px2 += mult;
-        }
-        px2 += (width-5)*mult;
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-
-    /* Last two pixels in the row require a slow variant... blablabla */
-    for (int i=width-2*mult; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-  /* The last "2*mult" lines use the macro with tests because the 5x5 kernel
-   * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for (int j=height-2*mult; j<height; j++)
-  {
-    ROW_PROLOGUE
-
-    for(int i=0; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-  _mm_sfence();
-}
-
-#undef SUM_PIXEL_CONTRIBUTION_COMMON
-#undef SUM_PIXEL_CONTRIBUTION_WITH_TEST
-#undef ROW_PROLOGUE
-#undef SUM_PIXEL_PROLOGUE
-#undef SUM_PIXEL_EPILOGUE
-
-static void
-eaw_synthesize (float *const out, const float *const in, const float *const detail,
-                const float *thrsf, const float *boostf, const int32_t width, const int32_t height)
-{
-  const __m128 threshold = _mm_set_ps(thrsf[3], thrsf[2], thrsf[1], thrsf[0]);
-  const __m128 boost     = _mm_set_ps(boostf[3], boostf[2], boostf[1], boostf[0]);
-
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for(int j=0; j<height; j++)
-  {
-    // TODO: prefetch? _mm_prefetch()
-    const __m128 *pin = (__m128 *)in + j*width;
-    __m128 *pdetail = (__m128 *)detail + j*width;
-    float *pout = out + 4*j*width;
-    for(int i=0; i<width; i++)
-    {
-      const __m128i maski = _mm_set1_epi32(0x80000000u);
-      const __m128 *mask = (__m128*)&maski;
-      const __m128 absamt = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_andnot_ps(*mask, *pdetail), threshold));
-      const __m128 amount = _mm_or_ps(_mm_and_ps(*pdetail, *mask), absamt);
-      _mm_stream_ps(pout, _mm_add_ps(*pin, _mm_mul_ps(boost, amount)));
-      pdetail ++;
-      pin ++;
-      pout += 4;
-    }
-  }
-  _mm_sfence();
-}
-
 static int
 get_samples (float *t, const dt_iop_atrous_data_t *const d, const dt_iop_roi_t *roi_in, const dt_dev_pixelpipe_iop_t *const piece)
 {
@@ -453,64 +216,49 @@ process (struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, voi
     // dt_control_queue_draw(GTK_WIDGET(g->area));
   }
 
-  float *detail[MAX_NUM_SCALES] = { NULL };
-  float *tmp = NULL;
-  float *buf2 = NULL;
-  float *buf1 = NULL;
-
   const int width = roi_out->width;
   const int height = roi_out->height;
 
-  tmp = (float *)dt_alloc_align(64, sizeof(float)*4*width*height);
-  if(tmp == NULL)
+  if(max_scale == 0)
   {
-    fprintf(stderr, "[atrous] failed to allocate coarse buffer!\n");
-    goto error;
+    memcpy(o, i, sizeof(float)*4*width*height);
+    return;
   }
 
-  for(int k=0; k<max_scale; k++)
+  // the detail coefficients of each level are shrunk and summed up into acc right away,
+  // so no per level buffers are needed and memory use no longer grows with max_scale.
+  float *tmp = (float *)dt_alloc_align(64, sizeof(float)*4*width*height);
+  float *acc = (float *)dt_alloc_align(64, sizeof(float)*4*width*height);
+  if(tmp == NULL || acc == NULL)
   {
-    detail[k] = (float *)dt_alloc_align(64, sizeof(float)*4*width*height);
-    if(detail[k] == NULL)
-    {
-      fprintf(stderr, "[atrous] failed to allocate one of the detail buffers!\n");
-      goto error;
-    }
+    fprintf(stderr, "[atrous] failed to allocate coarse buffers!\n");
+    free(tmp);
+    free(acc);
+    return;
   }
 
-  buf1 = (float *)i;
-  buf2 = tmp;
+  float *buf1 = (float *)i;
+  float *buf2 = tmp;
 
   for(int scale=0; scale<max_scale; scale++)
   {
-    eaw_decompose (buf2, buf1, detail[scale], scale, sharp[scale], width, height);
+    dt_eaw_decompose_and_synthesize(buf2, buf1, acc, scale == 0, thrs[scale], boost[scale],
+                                    scale, DT_EAW_WEIGHT_SHARPEN, sharp[scale], width, height);
     if(scale == 0) buf1 = (float *)o;  // now switch to (float *)o for buffer ping-pong between buf1 and buf2
     float *buf3 = buf2;
     buf2 = buf1;
     buf1 = buf3;
   }
 
-  for(int scale=max_scale-1; scale>=0; scale--)
-  {
-    eaw_synthesize (buf2, buf1, detail[scale], thrs[scale], boost[scale], width, height);
-    float *buf3 = buf2;
-    buf2 = buf1;
-    buf1 = buf3;
-  }
-  /* due to symmetric processing, output will be left in (float *)o */
+  // coarsest level plus all the shrunk details. buf1 holds the coarse image, which is either
+  // tmp or o itself, both fine for the pointwise add.
+  dt_eaw_add((float *)o, buf1, acc, width, height);
 
-  for(int k=0; k<max_scale; k++) free(detail[k]);
+  free(acc);
   free(tmp);
 
   if(piece->pipe->mask_display)
     dt_iop_alpha_copy(i, o, width, height);
-
-  return;
-
-error:
-  for(int k=0; k<max_scale; k++) if(detail[k] != NULL) free(detail[k]);
-  if(tmp != NULL) free(tmp);
-  return;
 }
 
 #ifdef HAVE_OPENCL
@@ -661,7 +409,8 @@ void tiling_callback (struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_
   const int max_scale = get_scales(thrs, boost, sharp, d, roi_in, piece);
   const int max_filter_radius = (1<<max_scale); // 2 * 2^max_scale
 
-  tiling->factor = 3.0f + max_scale;  // in + out + tmp + scale buffers
+  // the opencl path still keeps one detail buffer per scale, the cpu path only needs tmp + acc.
+  tiling->factor = piece->pipe->devid >= 0 ? 3.0f + max_scale : 4.0f;  // in + out + tmp + scale buffers / acc
   tiling->maxbuf = 1.0f;
   tiling->overhead = 0;
   tiling->overlap = max_filter_radius;
@@ -764,7 +513,7 @@ void cleanup_pipe  (struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_d
 
 void init_presets (dt_iop_module_so_t *self)
 {
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "begin", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
   dt_iop_atrous_params_t p;
   p.octaves = 7;
 
@@ -939,7 +688,7 @@ void init_presets (dt_iop_module_so_t *self)
     p.y[atrous_ct][k] = 0.0f;
   }
   dt_gui_presets_add_generic(_("clarity"), self->op, self->version(), &p, sizeof(p), 1);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "commit", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 }
 
 static void
@@ -205,7 +205,7 @@ void init_presets (dt_iop_module_so_t *self)
 {
   // transform presets above to db entries.
   // sql begin
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "begin", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
   for(int k=0; k<basecurve_presets_cnt; k++)
   {
     // add the preset.
@@ -218,7 +218,7 @@ void init_presets (dt_iop_module_so_t *self)
     dt_gui_presets_update_autoapply(_(basecurve_presets[k].name), self->op, self->version(), basecurve_presets[k].autoapply);
   }
   // sql commit
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "commit", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 }
 
 #ifdef HAVE_OPENCL
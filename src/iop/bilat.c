@@ -180,7 +180,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *
   const float sigma_s = d->sigma_s / scale;
 
   // TODO: better memory management.
-  dt_bilateral_t *b = dt_bilateral_init(roi_in->width, roi_in->height, sigma_s, sigma_r);
+  dt_bilateral_t *b = dt_bilateral_init(piece->pipe, roi_in->width, roi_in->height, sigma_s, sigma_r);
   dt_bilateral_splat(b, (float *)i);
   dt_bilateral_blur(b);
   dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
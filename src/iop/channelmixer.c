@@ -478,7 +478,7 @@ void gui_init(struct dt_iop_module_t *self)
 
 void init_presets (dt_iop_module_so_t *self)
 {
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "begin", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
 
   dt_gui_presets_add_generic(_("swap R and B"), self->op, self->version(), &(dt_iop_channelmixer_params_t)
   {
@@ -534,7 +534,7 @@ void init_presets (dt_iop_module_so_t *self)
       0,0,0,0,0,0,0.4
     }, {0,0,0,0,0,0,0.750}, {0,0,0,0,0,0,-0.15}
   } , sizeof(dt_iop_channelmixer_params_t), 1);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "commit", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 }
 
 void gui_cleanup(struct dt_iop_module_t *self)
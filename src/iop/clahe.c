@@ -26,6 +26,7 @@
 #include "dtgtk/slider.h"
 #include "dtgtk/resetlabel.h"
 #include "gui/gtk.h"
+#include "iop/clahe.h"
 #include <gtk/gtk.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -35,14 +36,20 @@
 
 #define CLIP(x) ((x<0)?0.0:(x>1.0)?1.0:x)
 
-#define ROUND_POSISTIVE(f) ((unsigned int)((f)+0.5))
+DT_MODULE(2)
 
-DT_MODULE(1)
+typedef struct dt_iop_rlce_params1_t
+{
+  double radius;
+  double slope;
+}
+dt_iop_rlce_params1_t;
 
 typedef struct dt_iop_rlce_params_t
 {
   double radius;
   double slope;
+  int tiles;  // interpolate between tiles instead of a window per pixel
 }
 dt_iop_rlce_params_t;
 
@@ -51,6 +58,7 @@ typedef struct dt_iop_rlce_gui_data_t
   GtkVBox   *vbox1,  *vbox2;
   GtkWidget  *label1,*label2;
   GtkDarktableSlider *scale1,*scale2;       // radie pixels, slope
+  GtkToggleButton *tiles;
 }
 dt_iop_rlce_gui_data_t;
 
@@ -58,6 +66,7 @@ typedef struct dt_iop_rlce_data_t
 {
   double radius;
   double slope;
+  int tiles;
 }
 dt_iop_rlce_data_t;
 
@@ -77,13 +86,28 @@ int flags()
   return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_DEPRECATED;
 }
 
+int
+legacy_params (dt_iop_module_t *self, const void *const old_params, const int old_version, void *new_params, const int new_version)
+{
+  if(old_version == 1 && new_version == 2)
+  {
+    const dt_iop_rlce_params1_t *o = (dt_iop_rlce_params1_t *)old_params;
+    dt_iop_rlce_params_t *n = (dt_iop_rlce_params_t *)new_params;
+    n->radius = o->radius;
+    n->slope = o->slope;
+    n->tiles = 0;
+    return 0;
+  }
+  return 1;
+}
+
 void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
 {
   dt_iop_rlce_data_t *data = (dt_iop_rlce_data_t *)piece->data;
   const int ch = piece->colors;
 
   // PASS1: Get a luminance map of image...
-  float *luminance=(float *)malloc((roi_out->width*roi_out->height)*sizeof(float));
+  float *luminance=(float *)dt_pipe_scratch_alloc(piece->pipe, (roi_out->width*roi_out->height)*sizeof(float));
   //double lsmax=0.0,lsmin=1.0;
 #ifdef _OPENMP
   #pragma omp parallel for default(none) schedule(static) shared(luminance,roi_in,roi_out,ivoid)
@@ -105,134 +129,35 @@ void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void
 
   // Params
   const int rad=data->radius*roi_in->scale/piece->iscale;
-
-  const int bins=256;
   const float slope=data->slope;
 
   // CLAHE
+  float *dest=(float *)dt_pipe_scratch_alloc(piece->pipe, (roi_out->width*roi_out->height)*sizeof(float));
+  dt_iop_clahe(luminance, dest, roi_out->width, roi_out->height, rad, slope, data->tiles);
+
+  // Apply
 #ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static) shared(luminance,roi_in,roi_out,ivoid,ovoid)
+  #pragma omp parallel for default(none) schedule(static) shared(dest,roi_out,ivoid,ovoid)
 #endif
   for(int j=0; j<roi_out->height; j++)
   {
-    int yMin = fmax( 0, j - rad );
-    int yMax = fmin( roi_in->height, j + rad + 1 );
-    int h = yMax - yMin;
-
-    int xMin0 = fmax( 0, 0-rad );
-    int xMax0 = fmin( roi_in->width - 1, rad );
-
-    int hist[bins+1];
-    int clippedhist[bins+1];
-    float dest[roi_out->width];
-
-    /* initially fill histogram */
-    memset(hist,0,(bins+1)*sizeof(int));
-    for ( int yi = yMin; yi < yMax; ++yi )
-      for ( int xi = xMin0; xi < xMax0; ++xi )
-        ++hist[ ROUND_POSISTIVE(luminance[yi*roi_in->width+xi] * (float)bins) ];
-
-    // Destination row
-    memset(dest,0,roi_out->width*sizeof(float));
-    float *ld=dest;
-
-    for(int i=0; i<roi_out->width; i++)
-    {
-
-      int v = ROUND_POSISTIVE(luminance[j*roi_in->width+i] * (float)bins);
-
-      int xMin = fmax( 0, i - rad );
-      int xMax = i + rad + 1;
-      int w = fmin( roi_in->width, xMax ) - xMin;
-      int n = h * w;
-
-      int limit = ( int )( slope * n /  bins + 0.5f );
-
-      /* remove left behind values from histogram */
-      if ( xMin > 0 )
-      {
-        int xMin1 = xMin - 1;
-        for ( int yi = yMin; yi < yMax; ++yi )
-          --hist[  ROUND_POSISTIVE(luminance[yi*roi_in->width+xMin1] * (float)bins) ];
-      }
-
-      /* add newly included values to histogram */
-      if ( xMax <= roi_in->width )
-      {
-        int xMax1 = xMax - 1;
-        for ( int yi = yMin; yi < yMax; ++yi )
-          ++hist[  ROUND_POSISTIVE(luminance[yi*roi_in->width+xMax1] * (float)bins) ];
-      }
-
-      /* clip histogram and redistribute clipped entries */
-      memcpy(clippedhist,hist,(bins+1)*sizeof(int));
-      int ce = 0, ceb=0;
-      do
-      {
-        ceb = ce;
-        ce = 0;
-        for ( int b = 0; b <= bins; b++ )
-        {
-          int d = clippedhist[ b ] - limit;
-          if ( d > 0 )
-          {
-            ce += d;
-            clippedhist[ b ] = limit;
-          }
-        }
-
-        int d = (ce / (float) ( bins + 1 ));
-        int m = ce % ( bins + 1 );
-        for ( int h = 0; h <= bins; h++)
-          clippedhist[ h ] += d;
-
-        if ( m != 0 )
-        {
-          int s = bins / (float)m;
-          for ( int h = 0; h <= bins; h += s )
-            ++clippedhist[ h ];
-        }
-      }
-      while ( ce != ceb);
-
-      /* build cdf of clipped histogram */
-      int hMin = bins;
-      for ( int h = 0; h < hMin; h++ )
-        if ( clippedhist[ h ] != 0 ) hMin = h;
-
-      int cdf = 0;
-      for ( int h = hMin; h <= v; h++ )
-        cdf += clippedhist[ h ];
-
-      int cdfMax = cdf;
-      for ( int h = v + 1; h <= bins; h++ )
-        cdfMax += clippedhist[ h ];
-
-      int cdfMin = clippedhist[ hMin ];
-
-      *ld=( cdf - cdfMin ) / ( float )( cdfMax - cdfMin );
-
-      ld++;
-    }
-
-    // Apply row
     float *in = ((float *)ivoid) + j*roi_out->width*ch;
     float *out = ((float *)ovoid) + j*roi_out->width*ch;
+    const float *ld = dest + j*roi_out->width;
     for(int r=0; r<roi_out->width; r++)
     {
       float H, S, L;
       rgb2hsl(in,&H,&S,&L);
       //hsl2rgb(out,H,S,( L / dest[r] ) * (L-lsmin) + lsmin );
-      hsl2rgb(out,H,S,dest[r] );
+      hsl2rgb(out,H,S,ld[r] );
       out += ch;
       in += ch;
-      ld++;
     }
-
   }
 
   // Cleanup
-  free(luminance);
+  dt_pipe_scratch_free(piece->pipe, dest);
+  dt_pipe_scratch_free(piece->pipe, luminance);
 
 }
 
@@ -256,6 +181,16 @@ slope_callback (GtkDarktableSlider *slider, gpointer user_data)
   dt_dev_add_history_item(darktable.develop, self, TRUE);
 }
 
+static void
+tiles_callback (GtkToggleButton *button, gpointer user_data)
+{
+  dt_iop_module_t *self = (dt_iop_module_t *)user_data;
+  if(self->dt->gui->reset) return;
+  dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)self->params;
+  p->tiles = gtk_toggle_button_get_active(button);
+  dt_dev_add_history_item(darktable.develop, self, TRUE);
+}
+
 
 
 void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
@@ -268,6 +203,7 @@ void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pi
   dt_iop_rlce_data_t *d = (dt_iop_rlce_data_t *)piece->data;
   d->radius = p->radius;
   d->slope = p->slope;
+  d->tiles = p->tiles;
 #endif
 }
 
@@ -301,6 +237,7 @@ void gui_update(struct dt_iop_module_t *self)
   dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)module->params;
   dtgtk_slider_set_value(g->scale1, p->radius);
   dtgtk_slider_set_value(g->scale2, p->slope);
+  gtk_toggle_button_set_active(g->tiles, p->tiles);
 }
 
 void init(dt_iop_module_t *module)
@@ -313,7 +250,7 @@ void init(dt_iop_module_t *module)
   module->gui_data = NULL;
   dt_iop_rlce_params_t tmp = (dt_iop_rlce_params_t)
   {
-    64,1.25
+    64,1.25,0
   };
   memcpy(module->params, &tmp, sizeof(dt_iop_rlce_params_t));
   memcpy(module->default_params, &tmp, sizeof(dt_iop_rlce_params_t));
@@ -357,6 +294,13 @@ void gui_init(struct dt_iop_module_t *self)
                     G_CALLBACK (radius_callback), self);
   g_signal_connect (G_OBJECT (g->scale2), "value-changed",
                     G_CALLBACK (slope_callback), self);
+
+  g->tiles = GTK_TOGGLE_BUTTON(gtk_check_button_new_with_label(_("fast")));
+  gtk_toggle_button_set_active(g->tiles, p->tiles);
+  g_object_set(G_OBJECT(g->tiles), "tooltip-text", _("interpolate between tiles instead of looking at the surroundings of every pixel. much faster for large radii, but slightly less accurate."), (char *)NULL);
+  gtk_box_pack_start(GTK_BOX(g->vbox2), GTK_WIDGET(g->tiles), TRUE, TRUE, 0);
+  g_signal_connect (G_OBJECT (g->tiles), "toggled",
+                    G_CALLBACK (tiles_callback), self);
 }
 
 void gui_cleanup(struct dt_iop_module_t *self)
@@ -0,0 +1,363 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_IOP_CLAHE_H
+#define DT_IOP_CLAHE_H
+
+// contrast limited adaptive histogram equalization on a luminance map.
+// kept free of gui dependencies, so src/tests/clahe.c can benchmark it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define DT_IOP_CLAHE_BINS 256
+
+// above this radius, sliding column histograms beat walking the window's columns.
+// see src/tests/clahe.c for the benchmark this is based on.
+#define DT_IOP_CLAHE_FAST_RADIUS 64
+
+// smallest tile spacing of dt_iop_clahe_tiles(), so tiny radii don't need a lut per pixel.
+#define DT_IOP_CLAHE_MIN_TILE 32
+
+static inline int
+dt_iop_clahe_bin(const float l)
+{
+  return (int)(l*(float)DT_IOP_CLAHE_BINS + 0.5f);
+}
+
+// clips the histogram of a window with n pixels and redistributes the clipped entries.
+static inline void
+dt_iop_clahe_clip(const int *hist, const int n, const float slope, int *clippedhist)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  const int limit = ( int )( slope * n /  bins + 0.5f );
+
+  /* clip histogram and redistribute clipped entries */
+  memcpy(clippedhist,hist,(bins+1)*sizeof(int));
+  int ce = 0, ceb=0;
+  do
+  {
+    ceb = ce;
+    ce = 0;
+    // branch free, so this vectorizes:
+    for ( int b = 0; b <= bins; b++ )
+    {
+      const int d = clippedhist[ b ] - limit;
+      ce += d > 0 ? d : 0;
+      clippedhist[ b ] = d > 0 ? limit : clippedhist[ b ];
+    }
+
+    int d = (ce / (float) ( bins + 1 ));
+    int m = ce % ( bins + 1 );
+    for ( int h = 0; h <= bins; h++)
+      clippedhist[ h ] += d;
+
+    if ( m != 0 )
+    {
+      int s = bins / (float)m;
+      for ( int h = 0; h <= bins; h += s )
+        ++clippedhist[ h ];
+    }
+  }
+  while ( ce != ceb);
+}
+
+// returns the normalized cdf of the clipped histogram at bin v.
+static inline float
+dt_iop_clahe_map(const int *hist, const int v, const int n, const float slope)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  int clippedhist[DT_IOP_CLAHE_BINS+1];
+  dt_iop_clahe_clip(hist, n, slope, clippedhist);
+
+  /* build cdf of clipped histogram */
+  int hMin = bins;
+  for ( int h = 0; h < hMin; h++ )
+    if ( clippedhist[ h ] != 0 ) hMin = h;
+
+  int cdf = 0;
+  for ( int h = hMin; h <= v; h++ )
+    cdf += clippedhist[ h ];
+
+  int cdfMax = cdf;
+  for ( int h = v + 1; h <= bins; h++ )
+    cdfMax += clippedhist[ h ];
+
+  int cdfMin = clippedhist[ hMin ];
+
+  return ( cdf - cdfMin ) / ( float )( cdfMax - cdfMin );
+}
+
+// same as dt_iop_clahe_map(), but for all bins at once.
+static inline void
+dt_iop_clahe_lut(const int *hist, const int n, const float slope, float *lut)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  int clippedhist[DT_IOP_CLAHE_BINS+1];
+  dt_iop_clahe_clip(hist, n, slope, clippedhist);
+
+  int hMin = bins;
+  for ( int h = 0; h < hMin; h++ )
+    if ( clippedhist[ h ] != 0 ) hMin = h;
+  int cdfMax = 0;
+  for ( int h = hMin; h <= bins; h++ )
+    cdfMax += clippedhist[ h ];
+  const int cdfMin = clippedhist[ hMin ];
+
+  int cdf = 0;
+  for ( int v = 0; v <= bins; v++ )
+  {
+    if ( v >= hMin ) cdf += clippedhist[ v ];
+    lut[ v ] = ( cdf - cdfMin ) / ( float )( cdfMax - cdfMin );
+  }
+}
+
+// one row of dt_iop_clahe_columns().
+static inline void
+dt_iop_clahe_columns_row(const float *const luminance, float *const dest, const int width, const int height, const int rad, const float slope, const int j)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  int yMin = j - rad < 0 ? 0 : j - rad;
+  int yMax = j + rad + 1 > height ? height : j + rad + 1;
+  int h = yMax - yMin;
+
+  int xMin0 = 0;
+  int xMax0 = rad < width - 1 ? rad : width - 1;
+
+  int hist[DT_IOP_CLAHE_BINS+1];
+
+  /* initially fill histogram */
+  memset(hist,0,(bins+1)*sizeof(int));
+  for ( int yi = yMin; yi < yMax; ++yi )
+    for ( int xi = xMin0; xi < xMax0; ++xi )
+      ++hist[ dt_iop_clahe_bin(luminance[yi*width+xi]) ];
+
+  for(int i=0; i<width; i++)
+  {
+    int v = dt_iop_clahe_bin(luminance[j*width+i]);
+
+    int xMin = i - rad < 0 ? 0 : i - rad;
+    int xMax = i + rad + 1;
+    int w = (xMax > width ? width : xMax) - xMin;
+
+    /* remove left behind values from histogram */
+    if ( xMin > 0 )
+    {
+      int xMin1 = xMin - 1;
+      for ( int yi = yMin; yi < yMax; ++yi )
+        --hist[ dt_iop_clahe_bin(luminance[yi*width+xMin1]) ];
+    }
+
+    /* add newly included values to histogram */
+    if ( xMax <= width )
+    {
+      int xMax1 = xMax - 1;
+      for ( int yi = yMin; yi < yMax; ++yi )
+        ++hist[ dt_iop_clahe_bin(luminance[yi*width+xMax1]) ];
+    }
+
+    dest[j*width+i] = dt_iop_clahe_map(hist, v, h*w, slope);
+  }
+}
+
+// reference implementation: slides the window histogram along each row,
+// walking a whole column of the window for every pixel. O(rad) per pixel.
+static void
+dt_iop_clahe_columns(const float *const luminance, float *const dest, const int width, const int height, const int rad, const float slope)
+{
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+    dt_iop_clahe_columns_row(luminance, dest, width, height, rad, slope, j);
+}
+
+// same result, but keeps one histogram per column of the window (perreault & hebert).
+// moving down a row touches one pixel per column, moving right adds and subtracts
+// one column histogram, so the cost no longer depends on the radius.
+// every thread works on its own band of rows with its own column histograms.
+static void
+dt_iop_clahe_histograms(const float *const luminance, float *const dest, const int width, const int height, const int rad, const float slope)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  // bin indices, computed once instead of for every window they are part of:
+  uint16_t *const bin = (uint16_t *)malloc((size_t)width*height*sizeof(uint16_t));
+  if(!bin)
+  {
+    dt_iop_clahe_columns(luminance, dest, width, height, rad, slope);
+    return;
+  }
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int k=0; k<width*height; k++) bin[k] = dt_iop_clahe_bin(luminance[k]);
+
+#ifdef _OPENMP
+  #pragma omp parallel
+#endif
+  {
+#ifdef _OPENMP
+    const int nthreads = omp_get_num_threads(), tid = omp_get_thread_num();
+#else
+    const int nthreads = 1, tid = 0;
+#endif
+    const int j0 = (int)((int64_t)height*tid/nthreads), j1 = (int)((int64_t)height*(tid+1)/nthreads);
+    // a column holds at most 2*rad+1 pixels, radius is limited to 256 * scale.
+    uint16_t *col = (uint16_t *)calloc((size_t)width*(bins+1), sizeof(uint16_t));
+    int hist[DT_IOP_CLAHE_BINS+1];
+
+    // no memory for the column histograms, this band takes the slow path:
+    if(!col)
+      for(int j=j0; j<j1; j++) dt_iop_clahe_columns_row(luminance, dest, width, height, rad, slope, j);
+
+    if(col && j0 < j1)
+    {
+      int yMin = j0 - rad < 0 ? 0 : j0 - rad;
+      int yMax = j0 + rad + 1 > height ? height : j0 + rad + 1;
+      for(int yi=yMin; yi<yMax; yi++)
+        for(int xi=0; xi<width; xi++) col[xi*(bins+1) + bin[yi*width+xi]]++;
+    }
+
+    for(int j=j0; col && j<j1; j++)
+    {
+      if(j > j0)
+      {
+        // slide all column histograms down by one row:
+        if(j - rad - 1 >= 0)
+          for(int xi=0; xi<width; xi++) col[xi*(bins+1) + bin[(j-rad-1)*width+xi]]--;
+        if(j + rad < height)
+          for(int xi=0; xi<width; xi++) col[xi*(bins+1) + bin[(j+rad)*width+xi]]++;
+      }
+      int yMin = j - rad < 0 ? 0 : j - rad;
+      int yMax = j + rad + 1 > height ? height : j + rad + 1;
+      int h = yMax - yMin;
+
+      int xMax0 = rad < width - 1 ? rad : width - 1;
+      memset(hist,0,(bins+1)*sizeof(int));
+      for(int xi=0; xi<xMax0; xi++)
+      {
+        const uint16_t *c = col + xi*(bins+1);
+        for(int b=0; b<=bins; b++) hist[b] += c[b];
+      }
+
+      for(int i=0; i<width; i++)
+      {
+        int v = bin[j*width+i];
+
+        int xMin = i - rad < 0 ? 0 : i - rad;
+        int xMax = i + rad + 1;
+        int w = (xMax > width ? width : xMax) - xMin;
+
+        if(xMin > 0)
+        {
+          const uint16_t *c = col + (xMin-1)*(bins+1);
+          for(int b=0; b<=bins; b++) hist[b] -= c[b];
+        }
+        if(xMax <= width)
+        {
+          const uint16_t *c = col + (xMax-1)*(bins+1);
+          for(int b=0; b<=bins; b++) hist[b] += c[b];
+        }
+
+        dest[j*width+i] = dt_iop_clahe_map(hist, v, h*w, slope);
+      }
+    }
+    free(col);
+  }
+  free(bin);
+}
+
+// classic clahe: only computes the mapping for the windows centered on a coarse
+// grid of tiles (a quarter window apart), and interpolates the mappings of the four
+// closest tiles bilinearly for every pixel. this is O(1) per pixel, independent
+// of the radius, but only approximates the per pixel windows.
+static void
+dt_iop_clahe_tiles(const float *const luminance, float *const dest, const int width, const int height, const int radius, const float slope)
+{
+  const int bins = DT_IOP_CLAHE_BINS;
+  // windows are at least one minimal tile wide, also when the radius asks for less:
+  const int size = 2*radius+1 < DT_IOP_CLAHE_MIN_TILE ? DT_IOP_CLAHE_MIN_TILE : 2*radius+1;
+  const int rad = size/2;
+  // tiles a quarter window apart: a grid one window wide is off by 0.025 on average at radius 128.
+  const int step = size/4 < DT_IOP_CLAHE_MIN_TILE ? DT_IOP_CLAHE_MIN_TILE : size/4;
+  const int nx = (width  + step - 1) / step, ny = (height + step - 1) / step;
+  const float tw = width/(float)nx, th = height/(float)ny;
+  float *const lut = (float *)malloc(sizeof(float)*nx*ny*(bins+1));
+  if(!lut)
+  {
+    dt_iop_clahe_columns(luminance, dest, width, height, radius, slope);
+    return;
+  }
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int t=0; t<nx*ny; t++)
+  {
+    const int cx = (int)(((t % nx) + 0.5f)*tw), cy = (int)(((t / nx) + 0.5f)*th);
+    const int xMin = cx - rad < 0 ? 0 : cx - rad, xMax = cx + rad + 1 > width  ? width  : cx + rad + 1;
+    const int yMin = cy - rad < 0 ? 0 : cy - rad, yMax = cy + rad + 1 > height ? height : cy + rad + 1;
+    int hist[DT_IOP_CLAHE_BINS+1];
+    memset(hist,0,(bins+1)*sizeof(int));
+    for(int yi=yMin; yi<yMax; yi++)
+      for(int xi=xMin; xi<xMax; xi++) ++hist[ dt_iop_clahe_bin(luminance[yi*width+xi]) ];
+    dt_iop_clahe_lut(hist, (yMax-yMin)*(xMax-xMin), slope, lut + t*(bins+1));
+  }
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    const float fy = (j + 0.5f)/th - 0.5f;
+    const int y0 = fy < 0.0f ? 0 : (int)fy, y1 = y0 + 1 < ny ? y0 + 1 : ny - 1;
+    const float wy = fy < 0.0f ? 0.0f : (fy - y0 > 1.0f ? 1.0f : fy - y0);
+    for(int i=0; i<width; i++)
+    {
+      const float fx = (i + 0.5f)/tw - 0.5f;
+      const int x0 = fx < 0.0f ? 0 : (int)fx, x1 = x0 + 1 < nx ? x0 + 1 : nx - 1;
+      const float wx = fx < 0.0f ? 0.0f : (fx - x0 > 1.0f ? 1.0f : fx - x0);
+      const int v = dt_iop_clahe_bin(luminance[j*width+i]);
+      const float l00 = lut[(y0*nx + x0)*(bins+1) + v], l01 = lut[(y0*nx + x1)*(bins+1) + v];
+      const float l10 = lut[(y1*nx + x0)*(bins+1) + v], l11 = lut[(y1*nx + x1)*(bins+1) + v];
+      dest[j*width+i] = (1.0f-wy)*((1.0f-wx)*l00 + wx*l01) + wy*((1.0f-wx)*l10 + wx*l11);
+    }
+  }
+  free(lut);
+}
+
+// computes the equalized luminance for every pixel. exact per pixel windows
+// pick the faster method for this radius, or use interpolated tiles.
+static inline void
+dt_iop_clahe(const float *const luminance, float *const dest, const int width, const int height, const int rad, const float slope, const int tiles)
+{
+  if(tiles)
+    dt_iop_clahe_tiles(luminance, dest, width, height, rad, slope);
+  else if(rad > DT_IOP_CLAHE_FAST_RADIUS)
+    dt_iop_clahe_histograms(luminance, dest, width, height, rad, slope);
+  else
+    dt_iop_clahe_columns(luminance, dest, width, height, rad, slope);
+}
+
+#endif
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -24,6 +24,7 @@
 #include "common/interpolation.h"
 #include "control/control.h"
 #include "develop/develop.h"
+#include "develop/pixelpipe_shared.h"
 #include "develop/tiling.h"
 #include <memory.h>
 #include <stdlib.h>
@@ -79,6 +80,7 @@ typedef struct dt_iop_demosaic_data_t
   uint32_t demosaicing_method;
   uint32_t yet_unused_data_specific_to_demosaicing_method;
   float median_thrs;
+  int export_half_size;   // downscaled exports sample the raw at half size, too
 }
 dt_iop_demosaic_data_t;
 
@@ -652,6 +654,48 @@ static int get_quality()
   return qual;
 }
 
+// green equilibration (if requested) and full resolution demosaicing of roi into out.
+static void
+demosaic_full(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const pixels, float *out,
+              const dt_iop_roi_t *const roi, dt_iop_roi_t *roo, const int demosaicing_method, const float threshold)
+{
+  dt_iop_demosaic_data_t *data = (dt_iop_demosaic_data_t *)piece->data;
+  if(data->green_eq != DT_IOP_GREEN_EQ_NO)
+  {
+    float *in = (float *)dt_pipe_scratch_alloc(piece->pipe, roi->height*roi->width*sizeof(float));
+    switch(data->green_eq)
+    {
+      case DT_IOP_GREEN_EQ_FULL:
+        green_equilibration_favg(in, pixels, roi->width, roi->height,
+                                 data->filters,  roi->x, roi->y);
+        break;
+      case DT_IOP_GREEN_EQ_LOCAL:
+        green_equilibration_lavg(in, pixels, roi->width, roi->height,
+                                 data->filters, roi->x, roi->y, 0, threshold);
+        break;
+      case DT_IOP_GREEN_EQ_BOTH:
+        green_equilibration_favg(in, pixels, roi->width, roi->height,
+                                 data->filters,  roi->x, roi->y);
+        green_equilibration_lavg(in, in, roi->width, roi->height,
+                                 data->filters, roi->x, roi->y, 1, threshold);
+        break;
+    }
+    // wanted ppg or zoomed out a lot and quality is limited to 1
+    if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
+      demosaic_ppg(out, in, roo, roi, data->filters, data->median_thrs);
+    else
+      amaze_demosaic_RT(self, piece, in, out, roi, roo, data->filters);
+    dt_pipe_scratch_free(piece->pipe, in);
+  }
+  else
+  {
+    if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
+      demosaic_ppg(out, pixels, roo, roi, data->filters, data->median_thrs);
+    else
+      amaze_demosaic_RT(self, piece, pixels, out, roi, roo, data->filters);
+  }
+}
+
 void
 process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *i, void *o, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
 {
@@ -672,47 +716,23 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *i, v
     demosaicing_method = DT_IOP_DEMOSAIC_PPG;
 
   const float *const pixels = (float *)i;
+  // concurrent exports of the same image start from the full resolution result, see
+  // dt_dev_pixelpipe_process_rec(). only untiled runs over the whole input are kept,
+  // and only without color smoothing, which is applied after zooming.
+  const int shared = piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT && darktable.pipe_shared && !piece->pipe->tiling
+                     && !data->color_smoothing && roi_in->x == 0 && roi_in->y == 0
+                     && roi_in->width == piece->buf_in.width && roi_in->height == piece->buf_in.height;
   if(roi_out->scale > .99999f && roi_out->scale < 1.00001f)
   {
     // output 1:1
-    // green eq:
-    if(data->green_eq != DT_IOP_GREEN_EQ_NO)
-    {
-      float *in = (float *)dt_alloc_align(16, roi_in->height*roi_in->width*sizeof(float));
-      switch(data->green_eq)
-      {
-        case DT_IOP_GREEN_EQ_FULL:
-          green_equilibration_favg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters,  roi_in->x, roi_in->y);
-          break;
-        case DT_IOP_GREEN_EQ_LOCAL:
-          green_equilibration_lavg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters, roi_in->x, roi_in->y, 0, threshold);
-          break;
-        case DT_IOP_GREEN_EQ_BOTH:
-          green_equilibration_favg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters,  roi_in->x, roi_in->y);
-          green_equilibration_lavg(in, in, roi_in->width, roi_in->height,
-                                   data->filters, roi_in->x, roi_in->y, 1, threshold);
-          break;
-      }
-      if (demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
-        demosaic_ppg((float *)o, in, &roo, &roi, data->filters, data->median_thrs);
-      else
-        amaze_demosaic_RT(self, piece, in, (float *)o, &roi, &roo, data->filters);
-      free(in);
-    }
-    else
-    {
-      if (demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
-        demosaic_ppg((float *)o, pixels, &roo, &roi, data->filters, data->median_thrs);
-      else
-        amaze_demosaic_RT(self, piece, pixels, (float *)o, &roi, &roo, data->filters);
-    }
+    demosaic_full(self, piece, pixels, (float *)o, &roi, &roo, demosaicing_method, threshold);
+    if(shared && roo.width == roi_in->width && roo.height == roi_in->height)
+      dt_dev_pixelpipe_shared_put(darktable.pipe_shared, dt_dev_pixelpipe_shared_hash(piece->pipe, piece),
+                                  (float *)o, roo.width, roo.height, piece->pipe->processed_maximum);
   }
   else if(roi_out->scale > .5f ||                                      // also covers roi_out->scale >1
           (piece->pipe->type == DT_DEV_PIXELPIPE_FULL && qual > 0) ||  // or in darkroom mode and quality requested by user settings
-          (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT))              // we assume you always want that for exports.
+          (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT && !data->export_half_size)) // we assume you want that for exports, unless asked for speed.
   {
     // demosaic and then clip and zoom
     // roo.x = roi_out->x / global_scale;
@@ -721,46 +741,16 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *i, v
     roo.height = roi_out->height / roi_out->scale;
     roo.scale = 1.0f;
 
-    float *tmp = (float *)dt_alloc_align(16, roo.width*roo.height*4*sizeof(float));
-    if(data->green_eq != DT_IOP_GREEN_EQ_NO)
-    {
-      float *in = (float *)dt_alloc_align(16, roi_in->height*roi_in->width*sizeof(float));
-      switch(data->green_eq)
-      {
-        case DT_IOP_GREEN_EQ_FULL:
-          green_equilibration_favg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters,  roi_in->x, roi_in->y);
-          break;
-        case DT_IOP_GREEN_EQ_LOCAL:
-          green_equilibration_lavg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters, roi_in->x, roi_in->y, 0, threshold);
-          break;
-        case DT_IOP_GREEN_EQ_BOTH:
-          green_equilibration_favg(in, pixels, roi_in->width, roi_in->height,
-                                   data->filters,  roi_in->x, roi_in->y);
-          green_equilibration_lavg(in, in, roi_in->width, roi_in->height,
-                                   data->filters, roi_in->x, roi_in->y, 1, threshold);
-          break;
-      }
-      // wanted ppg or zoomed out a lot and quality is limited to 1
-      if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
-        demosaic_ppg(tmp, in, &roo, &roi, data->filters, data->median_thrs);
-      else
-        amaze_demosaic_RT(self, piece, in, tmp, &roi, &roo, data->filters);
-      free(in);
-    }
-    else
-    {
-      if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
-        demosaic_ppg(tmp, pixels, &roo, &roi, data->filters, data->median_thrs);
-      else
-        amaze_demosaic_RT(self, piece, pixels, tmp, &roi, &roo, data->filters);
-    }
+    float *tmp = (float *)dt_pipe_scratch_alloc(piece->pipe, roo.width*roo.height*4*sizeof(float));
+    demosaic_full(self, piece, pixels, tmp, &roi, &roo, demosaicing_method, threshold);
+    if(shared && roo.width == roi_in->width && roo.height == roi_in->height)
+      dt_dev_pixelpipe_shared_put(darktable.pipe_shared, dt_dev_pixelpipe_shared_hash(piece->pipe, piece),
+                                  tmp, roo.width, roo.height, piece->pipe->processed_maximum);
     roi = *roi_out;
     roi.x = roi.y = 0;
     roi.scale = roi_out->scale;
     dt_iop_clip_and_zoom((float *)o, tmp, &roi, &roo, roi.width, roo.width);
-    free(tmp);
+    dt_pipe_scratch_free(piece->pipe, tmp);
   }
   else
   {
@@ -768,10 +758,10 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *i, v
     const float clip = fminf(piece->pipe->processed_maximum[0], fminf(piece->pipe->processed_maximum[1], piece->pipe->processed_maximum[2]));
     if(piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT && data->median_thrs > 0.0f)
     {
-      float *tmp = (float *)dt_alloc_align(16, sizeof(float)*roi_in->width*roi_in->height);
+      float *tmp = (float *)dt_pipe_scratch_alloc(piece->pipe, sizeof(float)*roi_in->width*roi_in->height);
       pre_median_b(tmp, pixels, roi_in, data->filters, 1, data->median_thrs);
       dt_iop_clip_and_zoom_demosaic_half_size_f((float *)o, tmp, &roo, &roi, roo.width, roi.width, data->filters, clip);
-      free(tmp);
+      dt_pipe_scratch_free(piece->pipe, tmp);
     }
     else
       dt_iop_clip_and_zoom_demosaic_half_size_f((float *)o, pixels, &roo, &roi, roo.width, roi.width, data->filters, clip);
@@ -884,7 +874,7 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
   }
   else if(roi_out->scale > .5f ||  // full needed because zoomed in enough
           (piece->pipe->type == DT_DEV_PIXELPIPE_FULL && qual > 0) ||  // or in darkroom mode and quality requested by user settings
-          (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT))              // we assume you always want that for exports.
+          (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT && !data->export_half_size)) // we assume you want that for exports, unless asked for speed.
   {
     // need to scale to right res
     dev_tmp = dt_opencl_alloc_device(devid, roi_in->width, roi_in->height, 4*sizeof(float));
@@ -1125,7 +1115,8 @@ void tiling_callback  (struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop
   if(roi_out->scale > 0.99999f && roi_out->scale < 1.00001f)
     tiling->factor += fmax(0.25f, smooth);
   else if(roi_out->scale > 0.5f ||
-          (piece->pipe->type == DT_DEV_PIXELPIPE_FULL && qual > 0) || (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT))
+          (piece->pipe->type == DT_DEV_PIXELPIPE_FULL && qual > 0) ||
+          (piece->pipe->type == DT_DEV_PIXELPIPE_EXPORT && !data->export_half_size))
     tiling->factor += fmax(1.25f, smooth);
   else
     tiling->factor += fmax(0.25f, smooth);
@@ -1206,6 +1197,8 @@ void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *params, dt_de
   d->color_smoothing = p->color_smoothing;
   d->median_thrs = p->median_thrs;
   d->demosaicing_method = p->demosaicing_method;
+  // exports to less than half the size don't need to demosaic every pixel, if the user prefers speed:
+  d->export_half_size = pipe->type == DT_DEV_PIXELPIPE_EXPORT && pipe->demosaic_half_size;
 
   piece->process_cl_ready = 1;
 
@@ -24,6 +24,7 @@
 #include "control/control.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
+#include "common/eaw.h"
 #include "gui/accelerators.h"
 #include "gui/presets.h"
 #include "gui/gtk.h"
@@ -289,218 +290,8 @@ backtransform(
 // begin wavelet code:
 // =====================================================================================
 
-static __m128  inline
-weight_sse(const __m128 *c1, const __m128 *c2, const float inv_sigma2)
-{
-  // return _mm_set1_ps(1.0f);
-#if 1
-  // 3d distance based on color
-  __m128 diff = _mm_sub_ps(*c1, *c2);
-  __m128 sqr  = _mm_mul_ps(diff, diff);
-  float *fsqr = (float *)&sqr;
-  const float dot = (fsqr[0] + fsqr[1] + fsqr[2])*inv_sigma2;
-  const float var = 0.02f; // FIXME: this should ideally depend on the image before noise stabilizing transforms!
-  const float off2 = 9.0f;// (3 sigma)^2
-  return _mm_set1_ps(fast_mexp2f(MAX(0, dot*var - off2)));
-#endif
-}
-
-#define SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj) \
-  do { \
-    const __m128 f = _mm_set1_ps(filter[(ii)]*filter[(jj)]); \
-    const __m128 wp = weight_sse(px, px2, inv_sigma2); \
-    const __m128 w = _mm_mul_ps(f, wp); \
-    const __m128 pd = _mm_mul_ps(w, *px2); \
-    sum = _mm_add_ps(sum, pd); \
-    wgt = _mm_add_ps(wgt, w); \
-  } while (0)
-
-#define SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj) \
-  do { \
-    const int iii = (ii)-2; \
-    const int jjj = (jj)-2; \
-    int x = i + mult*iii; \
-    int y = j + mult*jjj; \
-    \
-    if(x < 0)       x = 0; \
-    if(x >= width)  x = width  - 1; \
-    if(y < 0)       y = 0; \
-    if(y >= height) y = height - 1; \
-    \
-    px2 = ((__m128 *)in) + x + y*width; \
-    \
-    SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj); \
-  } while (0)
-
-#define ROW_PROLOGUE \
-  const __m128 *px = ((__m128 *)in) + j*width; \
-  const __m128 *px2; \
-  float *pdetail = detail + 4*j*width; \
-  float *pcoarse = out + 4*j*width;
-
-#define SUM_PIXEL_PROLOGUE \
-  __m128 sum = _mm_setzero_ps(); \
-  __m128 wgt = _mm_setzero_ps();
-
-#define SUM_PIXEL_EPILOGUE \
-  sum = _mm_div_ps(sum, wgt); \
-  \
-  _mm_stream_ps(pdetail, _mm_sub_ps(*px, sum)); \
-  _mm_stream_ps(pcoarse, sum); \
-  px++; \
-  pdetail+=4; \
-  pcoarse+=4;
+// the edge avoiding wavelet transform itself is shared with the equalizer, see common/eaw.h.
 
-static void
-eaw_decompose (float *const out, const float *const in, float *const detail, const int scale,
-               const float inv_sigma2, const int32_t width, const int32_t height)
-{
-  const int mult = 1<<scale;
-  static const float filter[5] = {1.0f/16.0f, 4.0f/16.0f, 6.0f/16.0f, 4.0f/16.0f, 1.0f/16.0f};
-
-  /* The first "2*mult" lines use the macro with tests because the 5x5 kernel
-   * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for (int j=0; j<2*mult; j++)
-  {
-    ROW_PROLOGUE
-
-    for(int i=0; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for(int j=2*mult; j<height-2*mult; j++)
-  {
-    ROW_PROLOGUE
-
-    /* The first "2*mult" pixels use the macro with tests because the 5x5 kernel
-     * requires nearest pixel interpolation for at least a pixel in the sum */
-    for (int i=0; i<2*mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-
-    /* For pixels [2*mult, width-2*mult], we can safely use macro w/o tests
-     * to avoid unneeded branching in the inner loops */
-    for(int i=2*mult; i<width-2*mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      px2 = ((__m128*)in) + i-2*mult + (j-2*mult)*width;
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj);
-          px2 += mult;
-        }
-        px2 += (width-5)*mult;
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-
-    /* Last two pixels in the row require a slow variant... blablabla */
-    for (int i=width-2*mult; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-  /* The last "2*mult" lines use the macro with tests because the 5x5 kernel
-   * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for (int j=height-2*mult; j<height; j++)
-  {
-    ROW_PROLOGUE
-
-    for(int i=0; i<width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for (int jj=0; jj<5; jj++)
-      {
-        for (int ii=0; ii<5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-  _mm_sfence();
-}
-
-#undef SUM_PIXEL_CONTRIBUTION_COMMON
-#undef SUM_PIXEL_CONTRIBUTION_WITH_TEST
-#undef ROW_PROLOGUE
-#undef SUM_PIXEL_PROLOGUE
-#undef SUM_PIXEL_EPILOGUE
-
-static void
-eaw_synthesize (float *const out, const float *const in, const float *const detail,
-                const float *thrsf, const float *boostf, const int32_t width, const int32_t height)
-{
-  const __m128 threshold = _mm_set_ps(thrsf[3], thrsf[2], thrsf[1], thrsf[0]);
-  const __m128 boost     = _mm_set_ps(boostf[3], boostf[2], boostf[1], boostf[0]);
-
-#ifdef _OPENMP
-  #pragma omp parallel for default(none) schedule(static)
-#endif
-  for(int j=0; j<height; j++)
-  {
-    // TODO: prefetch? _mm_prefetch()
-    const __m128 *pin = (__m128 *)in + j*width;
-    __m128 *pdetail = (__m128 *)detail + j*width;
-    float *pout = out + 4*j*width;
-    for(int i=0; i<width; i++)
-    {
-#if 1
-      const __m128i maski = _mm_set1_epi32(0x80000000u);
-      const __m128 *mask = (__m128*)&maski;
-      const __m128 absamt = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_andnot_ps(*mask, *pdetail), threshold));
-      const __m128 amount = _mm_or_ps(_mm_and_ps(*pdetail, *mask), absamt);
-      _mm_stream_ps(pout, _mm_add_ps(*pin, _mm_mul_ps(boost, amount)));
-#endif
-      // _mm_stream_ps(pout, _mm_add_ps(*pin, *pdetail));
-      pdetail ++;
-      pin ++;
-      pout += 4;
-    }
-  }
-  _mm_sfence();
-}
 // =====================================================================================
 
 void process_wavelets(
@@ -582,7 +373,7 @@ void process_wavelets(
     const float sigma = 1.0f;
     const float varf = sqrtf(2.0f + 2.0f * 4.0f*4.0f + 6.0f*6.0f)/16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) *sigma;
-    eaw_decompose (buf2, buf1, buf[scale], scale, 1.0f/(sigma_band*sigma_band), width, height);
+    dt_eaw_decompose(buf2, buf1, buf[scale], scale, DT_EAW_WEIGHT_DENOISE, 1.0f/(sigma_band*sigma_band), width, height);
     // DEBUG: clean out temporary memory:
     // memset(buf1, 0, sizeof(float)*4*width*height);
 # if 0 // DEBUG: print wavelet scales:
@@ -648,7 +439,7 @@ void process_wavelets(
 #endif
     const float boost[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
     // const float thrs[4] = { 0.0, 0.0, 0.0, 0.0 };
-    eaw_synthesize (buf2, buf1, buf[scale], thrs, boost, width, height);
+    dt_eaw_synthesize(buf2, buf1, buf[scale], thrs, boost, width, height);
     // DEBUG: clean out temporary memory:
     // memset(buf1, 0, sizeof(float)*4*width*height);
 
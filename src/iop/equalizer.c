@@ -244,7 +244,7 @@ void cleanup(dt_iop_module_t *module)
 #if 0
 void init_presets (dt_iop_module_so_t *self)
 {
-  DT_DEBUG_SQLITE3_EXEC(darktable.db, "begin", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
   dt_iop_equalizer_params_t p;
 
   for(int k=0; k<DT_IOP_EQUALIZER_BANDS; k++)
@@ -293,7 +293,7 @@ void init_presets (dt_iop_module_so_t *self)
     p.equalizer_y[DT_IOP_EQUALIZER_b][k] = fmaxf(0.0f, .5f-.6f*k/(float)DT_IOP_EQUALIZER_BANDS);
   }
   dt_gui_presets_add_generic(_("denoise (strong)"), self->op, self->version(), &p, sizeof(p), 1);
-  DT_DEBUG_SQLITE3_EXEC(darktable.db, "commit", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 }
 #endif
 
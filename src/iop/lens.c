@@ -136,16 +136,232 @@ _lens_sanitize(const char *orig_lens)
 }
 
 
+/** coarsest grid tried for the coordinate maps, in pixels. */
+#define LENS_MAP_STEP 16
+/** max deviation of the interpolated coordinates from lensfun's, in pixels. */
+#define LENS_MAP_TOLERANCE 0.05f
+/** number of coordinate maps kept around. */
+#define LENS_MAP_CACHE 8
+
+static lfModifier *
+_modifier_new(const dt_iop_lensfun_data_t *d, const float orig_w, const float orig_h, int *modflags)
+{
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  lfModifier *modifier = lf_modifier_new(d->lens, d->crop, orig_w, orig_h);
+  *modflags = lf_modifier_initialize(
+                modifier, d->lens, LF_PF_F32,
+                d->focal, d->aperture,
+                d->distance, d->scale,
+                d->target_geom, d->modify_flags, d->inverse);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  return modifier;
+}
+
+static inline int
+_map_matches(const dt_iop_lensfun_map_t *m, const dt_iop_lensfun_data_t *d, const dt_iop_roi_t *roi,
+             const float orig_w, const float orig_h)
+{
+  // the hash only tells maps apart, equal ones need the same params:
+  return m->hash == d->hash && m->orig_w == orig_w && m->orig_h == orig_h
+         && m->x == roi->x && m->y == roi->y && m->width == roi->width && m->height == roi->height
+         && !memcmp(&m->params, &d->params, sizeof(dt_iop_lensfun_params_t));
+}
+
+// coordinates at output pixel (x, y) relative to the map origin, interpolated from the grid.
+static inline void
+_map_sample(const dt_iop_lensfun_map_t *m, const int x, const int y, float *pi)
+{
+  const int i = x / m->step, j = y / m->step;
+  const float fx = (x - i*m->step)/(float)m->step, fy = (y - j*m->step)/(float)m->step;
+  const float *g0 = m->grid + 6*(m->nx*j + i), *g1 = g0 + 6*m->nx;
+  for(int c=0; c<6; c++)
+  {
+    const float t = g0[c] + fx*(g0[6+c] - g0[c]);
+    const float b = g1[c] + fx*(g1[6+c] - g1[c]);
+    pi[c] = t + fy*(b - t);
+  }
+}
+
+/** fills pi with the source coordinates of row y of the map, what lf_modifier_apply_subpixel_geometry_distortion() would. */
+static void
+_map_row(const dt_iop_lensfun_map_t *m, const int y, float *pi)
+{
+  for(int x=0; x<m->width; x++, pi+=6) _map_sample(m, x, y, pi);
+}
+
+/** returns the coordinate map for this roi from the cache, or NULL. */
+static dt_iop_lensfun_map_t *
+_map_get(dt_iop_lensfun_global_data_t *gd, const dt_iop_lensfun_data_t *d, const dt_iop_roi_t *roi,
+         const float orig_w, const float orig_h)
+{
+  dt_iop_lensfun_map_t *map = NULL;
+  dt_pthread_mutex_lock(&gd->map_lock);
+  for(GList *l = gd->maps; l; l = g_list_next(l))
+  {
+    dt_iop_lensfun_map_t *m = (dt_iop_lensfun_map_t *)l->data;
+    if(_map_matches(m, d, roi, orig_w, orig_h))
+    {
+      m->users++;
+      map = m;
+      gd->maps = g_list_remove_link(gd->maps, l);
+      gd->maps = g_list_concat(l, gd->maps);
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->map_lock);
+  return map;
+}
+
+static void
+_map_free(dt_iop_lensfun_map_t *m)
+{
+  free(m->grid);
+  free(m);
+}
+
+static void
+_map_release(dt_iop_lensfun_global_data_t *gd, dt_iop_lensfun_map_t *map)
+{
+  if(!map) return;
+  dt_pthread_mutex_lock(&gd->map_lock);
+  map->users--;
+  dt_pthread_mutex_unlock(&gd->map_lock);
+}
+
+/**
+ * computes the coordinate map for this roi and puts it into the cache. the grid is
+ * refined until the interpolated coordinates are within LENS_MAP_TOLERANCE of what
+ * lensfun computes, checked at the cell centers. returns NULL if that takes a finer
+ * grid than 2 pixels, lensfun has to be asked per pixel then.
+ */
+static dt_iop_lensfun_map_t *
+_map_new(dt_iop_lensfun_global_data_t *gd, const dt_iop_lensfun_data_t *d, lfModifier *modifier, const int modflags,
+         const dt_iop_roi_t *roi, const float orig_w, const float orig_h)
+{
+  dt_iop_lensfun_map_t *m = (dt_iop_lensfun_map_t *)malloc(sizeof(dt_iop_lensfun_map_t));
+  m->hash = d->hash;
+  m->params = d->params;
+  m->orig_w = orig_w;
+  m->orig_h = orig_h;
+  m->x = roi->x;
+  m->y = roi->y;
+  m->width = roi->width;
+  m->height = roi->height;
+  m->modflags = modflags;
+  m->users = 1;
+  m->grid = NULL;
+
+  for(m->step = LENS_MAP_STEP; m->step >= 2; m->step /= 2)
+  {
+    // one node more than needed on the right and bottom, so every pixel has four:
+    m->nx = (m->width - 1)/m->step + 2;
+    m->ny = (m->height - 1)/m->step + 2;
+    free(m->grid);
+    m->grid = (float *)dt_alloc_align(16, sizeof(float)*6*m->nx*m->ny);
+    if(!m->grid) break;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for(int j=0; j<m->ny; j++)
+      for(int i=0; i<m->nx; i++)
+        lf_modifier_apply_subpixel_geometry_distortion(
+          modifier, m->x + i*m->step, m->y + j*m->step, 1, 1, m->grid + 6*(m->nx*j + i));
+
+    // check the middle of the cells, where bilinear interpolation is worst:
+    const int half = m->step/2;
+    float err = 0.0f;
+    for(int j=0; j<m->ny-1; j++)
+    {
+      if(j*m->step + half >= m->height) continue;
+      for(int i=0; i<m->nx-1; i++)
+      {
+        if(i*m->step + half >= m->width) continue;
+        float exact[6], approx[6];
+        lf_modifier_apply_subpixel_geometry_distortion(
+          modifier, m->x + i*m->step + half, m->y + j*m->step + half, 1, 1, exact);
+        _map_sample(m, i*m->step + half, j*m->step + half, approx);
+        for(int c=0; c<6; c++) err = fmaxf(err, fabsf(exact[c] - approx[c]));
+      }
+    }
+    if(err <= LENS_MAP_TOLERANCE)
+    {
+      dt_print(DT_DEBUG_PERF, "[lens] %dx%d coordinate map on a %d pixel grid, max error %g pixels\n",
+               m->width, m->height, m->step, err);
+      break;
+    }
+  }
+  if(!m->grid || m->step < 2)
+  {
+    _map_free(m);
+    return NULL;
+  }
+
+  dt_pthread_mutex_lock(&gd->map_lock);
+  gd->maps = g_list_prepend(gd->maps, m);
+  // drop the least recently used ones nobody is reading right now:
+  GList *l = g_list_last(gd->maps);
+  for(int n = g_list_length(gd->maps); l && n > LENS_MAP_CACHE; n--)
+  {
+    GList *prev = g_list_previous(l);
+    dt_iop_lensfun_map_t *old = (dt_iop_lensfun_map_t *)l->data;
+    if(!old->users)
+    {
+      _map_free(old);
+      gd->maps = g_list_delete_link(gd->maps, l);
+    }
+    l = prev;
+  }
+  dt_pthread_mutex_unlock(&gd->map_lock);
+  return m;
+}
+
+/** remaps one row of width pixels, pi holds the source coordinates as lensfun returns them. */
+static inline void
+_remap_row(const struct dt_interpolation *interpolation, const float *in, float *out, const float *pi,
+           const int width, const dt_iop_roi_t *roi_in, const int ch, const int mask_display, const int tca)
+{
+  const int ch_width = ch*roi_in->width;
+  for (int x = 0; x < width; x++, out+=ch, pi+=6)
+  {
+    if(ch == 4)
+    {
+      // all four channels at the green coordinates in one go, the alpha channel
+      // follows green for the mask display. without tca that's all there is.
+      dt_interpolation_compute_pixel4c(interpolation, in, out, pi[2] - roi_in->x, pi[3] - roi_in->y,
+                                       roi_in->width, roi_in->height, ch_width);
+      if(!tca) continue;
+      for(int c=0; c<3; c+=2)
+        out[c] = dt_interpolation_compute_sample(interpolation, in+c, pi[c*2] - roi_in->x, pi[c*2+1] - roi_in->y,
+                                                 roi_in->width, roi_in->height, ch, ch_width);
+      continue;
+    }
+    for(int c=0; c<3; c++)
+    {
+      const float pi0 = pi[c*2] - roi_in->x;
+      const float pi1 = pi[c*2+1] - roi_in->y;
+      out[c] = dt_interpolation_compute_sample(interpolation, in+c, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
+    }
+
+    if(mask_display)
+    {
+      // take green channel distortion also for alpha channel
+      const float pi0 = pi[2] - roi_in->x;
+      const float pi1 = pi[3] - roi_in->y;
+      out[3] = dt_interpolation_compute_sample(interpolation, in+3, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
+    }
+  }
+}
+
 void
 process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
 {
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
 
   float *in  = (float *)ivoid;
   float *out = (float *)ovoid;
   const int ch = piece->colors;
-  const int ch_width = ch*roi_in->width;
   const int mask_display = piece->pipe->mask_display;
 
   const unsigned int pixelformat = ch == 3 ? LF_CR_3 (RED, GREEN, BLUE) : LF_CR_4 (RED, GREEN, BLUE, UNKNOWN);
@@ -158,21 +374,22 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoi
 
   const float orig_w = roi_in->scale*piece->iwidth,
               orig_h = roi_in->scale*piece->iheight;
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  lfModifier *modifier = lf_modifier_new(d->lens, d->crop, orig_w, orig_h);
 
-  int modflags = lf_modifier_initialize(
-                   modifier, d->lens, LF_PF_F32,
-                   d->focal, d->aperture,
-                   d->distance, d->scale,
-                   d->target_geom, d->modify_flags, d->inverse);
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  // the coordinate map is usually there already, lensfun is only needed to build it and for vignetting:
+  dt_iop_lensfun_map_t *map = _map_get(gd, d, roi_out, orig_w, orig_h);
+  lfModifier *modifier = NULL;
+  int modflags = map ? map->modflags : 0;
+  if(!map || (modflags & LF_MODIFY_VIGNETTING))
+    modifier = _modifier_new(d, orig_w, orig_h, &modflags);
+  const int distort = modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE);
+  if(!map && distort)
+    map = _map_new(gd, d, modifier, modflags, roi_out, orig_w, orig_h);
+  const int tca = modflags & LF_MODIFY_TCA;
 
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
-    if (modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION |
-                    LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    if (distort)
     {
       // acquire temp memory for distorted pixel coords
       const size_t req2 = roi_out->width*2*3*sizeof(float);
@@ -186,32 +403,17 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoi
       const struct  dt_interpolation* interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
 #ifdef _OPENMP
-      #pragma omp parallel for default(none) shared(roi_out, roi_in, in, d, ovoid, modifier, interpolation) schedule(static)
+      #pragma omp parallel for default(none) shared(roi_out, roi_in, in, d, ovoid, modifier, interpolation, map) schedule(static)
 #endif
       for (int y = 0; y < roi_out->height; y++)
       {
         float *pi = (float *)(((char *)d->tmpbuf2) + req2*dt_get_thread_num());
-        lf_modifier_apply_subpixel_geometry_distortion (
-          modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
+        if(map) _map_row(map, y, pi);
+        else lf_modifier_apply_subpixel_geometry_distortion (
+            modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
         // reverse transform the global coords from lf to our buffer
         float *buf = ((float *)ovoid) + y*roi_out->width*ch;
-        for (int x = 0; x < roi_out->width; x++,buf+=ch,pi+=6)
-        {
-          for(int c=0; c<3; c++)
-          {
-            const float pi0 = pi[c*2] - roi_in->x;
-            const float pi1 = pi[c*2+1] - roi_in->y;
-            buf[c] = dt_interpolation_compute_sample(interpolation, in+c, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
-          }
-
-          if(mask_display)
-          {
-            // take green channel distortion also for alpha channel
-            const float pi0 = pi[2] - roi_in->x;
-            const float pi1 = pi[3] - roi_in->y;
-            buf[3] = dt_interpolation_compute_sample(interpolation, in+3, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
-          }
-        }
+        _remap_row(interpolation, in, buf, pi, roi_out->width, roi_in, ch, mask_display, tca);
       }
     }
     else
@@ -267,8 +469,7 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoi
     }
 
     const size_t req2 = roi_out->width*2*3*sizeof(float);
-    if (modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION |
-                    LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    if (distort)
     {
       // acquire temp memory for distorted pixel coords
       if(req2 > 0 && d->tmpbuf2_len < req2*dt_get_num_threads())
@@ -281,33 +482,17 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoi
       const struct dt_interpolation* interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
 #ifdef _OPENMP
-      #pragma omp parallel for default(none) shared(roi_in, roi_out, d, ovoid, modifier, interpolation) schedule(static)
+      #pragma omp parallel for default(none) shared(roi_in, roi_out, d, ovoid, modifier, interpolation, map) schedule(static)
 #endif
       for (int y = 0; y < roi_out->height; y++)
       {
         float *pi = (float *)(((char *)d->tmpbuf2) + dt_get_thread_num()*req2);
-        lf_modifier_apply_subpixel_geometry_distortion (
-          modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
+        if(map) _map_row(map, y, pi);
+        else lf_modifier_apply_subpixel_geometry_distortion (
+            modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + y*roi_out->width*ch;
-        for (int x = 0; x < roi_out->width; x++,pi+=6)
-        {
-          for(int c=0; c<3; c++)
-          {
-            const float pi0 = pi[c*2] - roi_in->x;
-            const float pi1 = pi[c*2+1] - roi_in->y;
-            out[c] = dt_interpolation_compute_sample(interpolation, d->tmpbuf+c, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
-          }
-
-          if(mask_display)
-          {
-            // take green channel distortion also for alpha channel
-            const float pi0 = pi[2] - roi_in->x;
-            const float pi1 = pi[3] - roi_in->y;
-            out[3] = dt_interpolation_compute_sample(interpolation, d->tmpbuf+3, pi0, pi1, roi_in->width, roi_in->height, ch, ch_width);
-          }
-          out += ch;
-        }
+        _remap_row(interpolation, d->tmpbuf, out, pi, roi_out->width, roi_in, ch, mask_display, tca);
       }
     }
     else
@@ -321,7 +506,8 @@ process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoi
         memcpy(out+ch*y*roi_out->width, input+ch*y*roi_out->width, ch*sizeof(float)*roi_out->width);
     }
   }
-  lf_modifier_destroy(modifier);
+  if(modifier) lf_modifier_destroy(modifier);
+  _map_release(gd, map);
 
   if(g != NULL && self->dev->gui_attached && piece->pipe->type == DT_DEV_PIXELPIPE_PREVIEW)
   {
@@ -344,6 +530,7 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
 
   float *tmpbuf = NULL;
   lfModifier *modifier = NULL;
+  dt_iop_lensfun_map_t *map = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -408,15 +595,13 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
   if(dev_tmpbuf == NULL) goto error;
 
 
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  modifier = lf_modifier_new(d->lens, d->crop, orig_w, orig_h);
-
-  int modflags = lf_modifier_initialize(
-                   modifier, d->lens, LF_PF_F32,
-                   d->focal, d->aperture,
-                   d->distance, d->scale,
-                   d->target_geom, d->modify_flags, d->inverse);
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  int modflags;
+  modifier = _modifier_new(d, orig_w, orig_h, &modflags);
+  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  {
+    map = _map_get(gd, d, roi_out, orig_w, orig_h);
+    if(!map) map = _map_new(gd, d, modifier, modflags, roi_out, orig_w, orig_h);
+  }
 
   if(d->inverse)
   {
@@ -425,13 +610,14 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
                    LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
 #ifdef _OPENMP
-      #pragma omp parallel for default(none) shared(roi_out, roi_in, tmpbuf, d, modifier) schedule(static)
+      #pragma omp parallel for default(none) shared(roi_out, roi_in, tmpbuf, d, modifier, map) schedule(static)
 #endif
       for (int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + y * tmpbufwidth;
-        lf_modifier_apply_subpixel_geometry_distortion (
-          modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
+        if(map) _map_row(map, y, pi);
+        else lf_modifier_apply_subpixel_geometry_distortion (
+            modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -534,13 +720,14 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
                    LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
 #ifdef _OPENMP
-      #pragma omp parallel for default(none) shared(roi_out, roi_in, tmpbuf, d, modifier) schedule(static)
+      #pragma omp parallel for default(none) shared(roi_out, roi_in, tmpbuf, d, modifier, map) schedule(static)
 #endif
       for (int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + y * tmpbufwidth;
-        lf_modifier_apply_subpixel_geometry_distortion (
-          modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
+        if(map) _map_row(map, y, pi);
+        else lf_modifier_apply_subpixel_geometry_distortion (
+            modifier, roi_out->x, roi_out->y+y, roi_out->width, 1, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -576,6 +763,7 @@ process_cl (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem
   dt_opencl_release_mem_object(dev_tmp);
   if (tmpbuf != NULL) free(tmpbuf);
   if (modifier != NULL) lf_modifier_destroy(modifier);
+  _map_release(gd, map);
   return TRUE;
 
 error:
@@ -583,6 +771,7 @@ error:
   if (dev_tmpbuf != NULL) dt_opencl_release_mem_object(dev_tmpbuf);
   if (tmpbuf != NULL) free(tmpbuf);
   if (modifier != NULL) lf_modifier_destroy(modifier);
+  _map_release(gd, map);
   dt_print(DT_DEBUG_OPENCL, "[opencl_lens] couldn't enqueue kernel! %d\n", err);
   return FALSE;
 }
@@ -722,6 +911,38 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
   lf_modifier_destroy(modifier);
 }
 
+// the lensfun database is by far the most expensive part of the global data. it is only
+// loaded once the pipe, the gui or the defaults of a darkroom image need it.
+static lfDatabase *_lens_db(dt_iop_module_t *self)
+{
+  dt_iop_load_module_global(self);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
+  dt_pthread_mutex_lock(&gd->db_lock);
+  if(!gd->db)
+  {
+    const double start = dt_get_wtime();
+    lfDatabase *dt_iop_lensfun_db = lf_db_new();
+#if defined(__MACH__) || defined(__APPLE__)
+#else
+    if(lf_db_load(dt_iop_lensfun_db) != LF_NO_ERROR)
+#endif
+    {
+      char path[1024];
+      dt_loc_get_datadir(path, 1024);
+      char *c = path + strlen(path);
+      for(; c>path && *c != '/'; c--);
+      sprintf(c, "/lensfun");
+      dt_iop_lensfun_db->HomeDataDir = g_strdup(path);
+      if(lf_db_load(dt_iop_lensfun_db) != LF_NO_ERROR)
+        fprintf(stderr, "[iop_lens]: could not load lensfun database in `%s'!\n", path);
+    }
+    gd->db = dt_iop_lensfun_db;
+    dt_print(DT_DEBUG_PERF, "[iop_lens] loading the lensfun database took %.3f secs\n", dt_get_wtime() - start);
+  }
+  dt_pthread_mutex_unlock(&gd->db_lock);
+  return gd->db;
+}
+
 void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_lensfun_params_t *p = (dt_iop_lensfun_params_t *)p1;
@@ -731,8 +952,7 @@ void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pi
 #else
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
 
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   const lfCamera *camera = NULL;
   const lfCamera **cam = NULL;
 
@@ -786,6 +1006,12 @@ void commit_params (struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pi
   d->aperture     = p->aperture;
   d->distance     = p->distance;
   d->target_geom  = p->target_geom;
+
+  // the coordinate maps depend on all of the above, including the crop factor from the camera:
+  d->hash = 5381;
+  for(size_t k=0; k<sizeof(dt_iop_lensfun_params_t); k++)
+    d->hash = ((d->hash << 5) + d->hash) ^ ((const char *)p)[k];
+  memcpy(&d->params, p, sizeof(dt_iop_lensfun_params_t));
 #endif
 }
 
@@ -801,8 +1027,11 @@ void init_pipe (struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_p
   d->tmpbuf2 = NULL;
   d->tmpbuf_len = 0;
   d->tmpbuf = NULL;
+  d->hash = 0;
+  memset(&d->params, 0, sizeof(dt_iop_lensfun_params_t));
   d->lens = lf_lens_new();
-  self->commit_params(self, self->default_params, pipe, piece);
+  // no commit_params() here, that would load the database for disabled pieces as well.
+  // dt_iop_commit_params() calls it once the piece is enabled.
 #endif
 }
 
@@ -829,30 +1058,17 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_lens_distort_lanczos2 = dt_opencl_create_kernel(program, "lens_distort_lanczos2");
   gd->kernel_lens_distort_lanczos3 = dt_opencl_create_kernel(program, "lens_distort_lanczos3");
   gd->kernel_lens_vignette = dt_opencl_create_kernel(program, "lens_vignette");
+  dt_pthread_mutex_init(&gd->map_lock, NULL);
+  gd->maps = NULL;
 
-  lfDatabase *dt_iop_lensfun_db = lf_db_new();
-  gd->db = (void *)dt_iop_lensfun_db;
-#if defined(__MACH__) || defined(__APPLE__)
-#else
-  if(lf_db_load(dt_iop_lensfun_db) != LF_NO_ERROR)
-#endif
-  {
-    char path[1024];
-    dt_loc_get_datadir(path, 1024);
-    char *c = path + strlen(path);
-    for(; c>path && *c != '/'; c--);
-    sprintf(c, "/lensfun");
-    dt_iop_lensfun_db->HomeDataDir = g_strdup(path);
-    if(lf_db_load(dt_iop_lensfun_db) != LF_NO_ERROR)
-      fprintf(stderr, "[iop_lens]: could not load lensfun database in `%s'!\n", path);
-  }
+  dt_pthread_mutex_init(&gd->db_lock, NULL);
+  // the lensfun database takes a while to load, see _lens_db().
+  gd->db = NULL;
 }
 
 
 void reload_defaults(dt_iop_module_t *module)
 {
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)module->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
   const dt_image_t *img = &module->dev->image_storage;
   // reload image specific stuff
   // get all we can from exif:
@@ -876,8 +1092,11 @@ void reload_defaults(dt_iop_module_t *module)
   char model[100];  // truncate often complex descriptions.
   g_strlcpy(model, img->exif_model, 100);
   for(char cnt = 0, *c = model; c < model+100 && *c != '\0'; c++) if(*c == ' ') if(++cnt == 2) *c = '\0';
-  if(img->exif_maker[0] || model[0])
+  // the defaults only end up in the history when the module is switched on in the darkroom.
+  // elsewhere the history brings its own params, and loading the database is not worth it.
+  if(module->dev->gui_attached && (img->exif_maker[0] || model[0]))
   {
+    lfDatabase *dt_iop_lensfun_db = _lens_db(module);
     dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
     const lfCamera **cam = lf_db_find_cameras_ext(dt_iop_lensfun_db,
                            img->exif_maker, img->exif_model, 0);
@@ -915,14 +1134,17 @@ void cleanup(dt_iop_module_t *module)
 void cleanup_global(dt_iop_module_so_t *module)
 {
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)module->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
-  lf_db_destroy(dt_iop_lensfun_db);
+  if(gd->db) lf_db_destroy(gd->db);
+  dt_pthread_mutex_destroy(&gd->db_lock);
 
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos3);
   dt_opencl_free_kernel(gd->kernel_lens_vignette);
+  for(GList *l = gd->maps; l; l = g_list_next(l)) _map_free((dt_iop_lensfun_map_t *)l->data);
+  g_list_free(gd->maps);
+  dt_pthread_mutex_destroy(&gd->map_lock);
   free(module->data);
   module->data = NULL;
 }
@@ -1201,8 +1423,7 @@ static void camera_menusearch_clicked(
   GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
 
   (void)button;
@@ -1221,8 +1442,7 @@ static void camera_autosearch_clicked(
   GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   char make [200], model [200];
   const gchar *txt = ((dt_iop_lensfun_params_t*)self->default_params)->camera;
@@ -1541,8 +1761,7 @@ static void lens_menusearch_clicked(
   GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   const lfLens **lenslist;
 
@@ -1563,8 +1782,7 @@ static void lens_autosearch_clicked(
   GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   const lfLens **lenslist;
   char make [200], model [200];
@@ -1651,8 +1869,7 @@ static float get_autoscale(dt_iop_module_t *self)
 {
   dt_iop_lensfun_params_t   *p = (dt_iop_lensfun_params_t   *)self->params;
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   float scale = 1.0;
   if(p->lens[0] != '\0')
   {
@@ -1940,8 +2157,7 @@ void gui_update(struct dt_iop_module_t *self)
   // let gui elements reflect params
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   dt_iop_lensfun_params_t *p = (dt_iop_lensfun_params_t *)self->params;
-  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lens_db(self);
   gtk_button_set_label(g->camera_model, p->camera);
   gtk_button_set_label(g->lens_model, p->lens);
   gtk_label_set_ellipsize(GTK_LABEL(gtk_bin_get_child(GTK_BIN(g->camera_model))), PANGO_ELLIPSIZE_END);
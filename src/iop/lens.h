@@ -82,9 +82,28 @@ typedef struct dt_iop_lensfun_gui_data_t
 }
 dt_iop_lensfun_gui_data_t;
 
+/** source coordinates of the output pixels, sampled on a coarse grid of step x step
+ * pixels and bilinearly interpolated in between. shared between all pipes. */
+typedef struct dt_iop_lensfun_map_t
+{
+  uint64_t hash;          // of params, to skip most comparisons
+  dt_iop_lensfun_params_t params; // the map was computed for
+  float orig_w, orig_h;   // size of the full image at this scale
+  int x, y, width, height;// output region
+  int modflags;
+  int step;               // grid spacing in pixels
+  int nx, ny;             // number of grid nodes
+  int users;
+  float *grid;            // nx*ny nodes of 6 floats: r, g, b source coordinates
+}
+dt_iop_lensfun_map_t;
+
 typedef struct dt_iop_lensfun_global_data_t
 {
-  lfDatabase *db;
+  lfDatabase *db;          // loaded on first use, see _lens_db()
+  dt_pthread_mutex_t db_lock;
+  dt_pthread_mutex_t map_lock;
+  GList *maps;            // dt_iop_lensfun_map_t, most recently used first
   int kernel_lens_distort_bilinear;
   int kernel_lens_distort_bicubic;
   int kernel_lens_distort_lanczos2;
@@ -96,6 +115,8 @@ dt_iop_lensfun_global_data_t;
 typedef struct dt_iop_lensfun_data_t
 {
   lfLens *lens;
+  uint64_t hash;          // of the committed params, to look up the coordinate maps
+  dt_iop_lensfun_params_t params; // committed, a map is only reused for the same ones
   float *tmpbuf;
   float *tmpbuf2;
   size_t tmpbuf_len;
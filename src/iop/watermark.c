@@ -34,6 +34,7 @@
 #include "gui/gtk.h"
 #include <gtk/gtk.h>
 #include <inttypes.h>
+#include <glib/gstdio.h>
 
 #include <librsvg/rsvg.h>
 // ugh, ugly hack. why do people break stuff all the time?
@@ -48,6 +49,12 @@
 #define CLIP(x) ((x<0)?0.0:(x>1.0)?1.0:x)
 DT_MODULE(2)
 
+// number of rendered watermarks kept around, and how much memory they may use in total
+#define DT_IOP_WATERMARK_CACHE_ENTRIES 4
+#define DT_IOP_WATERMARK_CACHE_BYTES (64*1024*1024)
+// number of parameters describing where and how large a watermark is rendered
+#define DT_IOP_WATERMARK_GEOMETRY 12
+
 // gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_MD5,data,length);
 
 typedef enum dt_iop_watermark_base_scale_t
@@ -97,6 +104,32 @@ typedef struct dt_iop_watermark_gui_data_t
 }
 dt_iop_watermark_gui_data_t;
 
+/** a rendered watermark, cropped to the part that is not fully transparent. */
+typedef struct dt_iop_watermark_raster_t
+{
+  uint64_t hash;              // of svgdoc and geometry, to skip most comparisons
+  gchar *svgdoc;              // svg document this has been rendered from
+  float geometry[DT_IOP_WATERMARK_GEOMETRY]; // and the geometry it has been rendered for
+  int users;                  // the cache itself holds one reference
+  int x, y, width, height;    // position in roi_out
+  float *buf;                 // premultiplied rgba
+}
+dt_iop_watermark_raster_t;
+
+typedef struct dt_iop_watermark_global_data_t
+{
+  dt_pthread_mutex_t lock;
+  // last svg file read from disk
+  gchar *svgfile;
+  time_t svgmtime;
+  gchar *svgdata;
+  gsize svglength;
+  // most recently used first
+  dt_iop_watermark_raster_t *raster[DT_IOP_WATERMARK_CACHE_ENTRIES];
+  size_t raster_bytes;
+}
+dt_iop_watermark_global_data_t;
+
 int
 legacy_params (dt_iop_module_t *self, const void *const old_params, const int old_version, void *new_params, const int new_version)
 {
@@ -226,6 +259,33 @@ static gchar *_string_substitute(gchar *string,const gchar *search,const gchar *
   return result;
 }
 
+// reads the svg file, or takes it from memory if it didn't change on disk since last time.
+static gboolean _watermark_read_file(dt_iop_watermark_global_data_t *gd, const gchar *filename, gchar **contents, gsize *length)
+{
+  struct stat st;
+  if(g_stat(filename, &st)) return FALSE;
+
+  dt_pthread_mutex_lock(&gd->lock);
+  if(!gd->svgfile || strcmp(gd->svgfile, filename) || gd->svgmtime != st.st_mtime || gd->svglength != st.st_size)
+  {
+    g_free(gd->svgfile);
+    g_free(gd->svgdata);
+    gd->svgfile = NULL;
+    gd->svgdata = NULL;
+    if(!g_file_get_contents(filename, &gd->svgdata, &gd->svglength, NULL))
+    {
+      dt_pthread_mutex_unlock(&gd->lock);
+      return FALSE;
+    }
+    gd->svgfile = g_strdup(filename);
+    gd->svgmtime = st.st_mtime;
+  }
+  *contents = g_strndup(gd->svgdata, gd->svglength);
+  *length = gd->svglength;
+  dt_pthread_mutex_unlock(&gd->lock);
+  return TRUE;
+}
+
 static gchar * _watermark_get_svgdoc( dt_iop_module_t *self, dt_iop_watermark_data_t *data, const dt_image_t *image)
 {
   gsize length;
@@ -271,7 +331,7 @@ static gchar * _watermark_get_svgdoc( dt_iop_module_t *self, dt_iop_watermark_da
   time_t t = time(NULL);
   (void)localtime_r(&t, &tt_cur);
 
-  if( g_file_get_contents( filename, &svgdata, &length, NULL) )
+  if( _watermark_read_file( (dt_iop_watermark_global_data_t *)self->data, filename, &svgdata, &length) )
   {
     // File is loaded lets substitute strings if found...
 
@@ -585,30 +645,90 @@ static gchar * _watermark_get_svgdoc( dt_iop_module_t *self, dt_iop_watermark_da
 }
 
 
-void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
+static inline uint64_t _watermark_hash(uint64_t hash, const void *data, const size_t size)
 {
-  dt_iop_watermark_data_t *data = (dt_iop_watermark_data_t *)piece->data;
-  float *in  = (float *)ivoid;
-  float *out = (float *)ovoid;
-  const int ch = piece->colors;
+  const char *str = (const char *)data;
+  for(size_t i=0; i<size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
 
-  /* Load svg if not loaded */
-  gchar *svgdoc = _watermark_get_svgdoc (self, data, &piece->pipe->image);
-  if (!svgdoc)
+static void _watermark_raster_release(dt_iop_watermark_global_data_t *gd, dt_iop_watermark_raster_t *raster)
+{
+  dt_pthread_mutex_lock(&gd->lock);
+  const int users = --raster->users;
+  dt_pthread_mutex_unlock(&gd->lock);
+  if(users) return;
+  g_free(raster->svgdoc);
+  free(raster->buf);
+  free(raster);
+}
+
+// the hash only tells the rasters apart, it doesn't prove they are the same.
+static inline int _watermark_raster_matches(const dt_iop_watermark_raster_t *raster, const uint64_t hash, const gchar *svgdoc, const float *geometry)
+{
+  return raster->hash == hash
+         && !memcmp(raster->geometry, geometry, sizeof(raster->geometry))
+         && !strcmp(raster->svgdoc, svgdoc);
+}
+
+// returns a reference to the cached raster, or NULL. has to be released after use.
+static dt_iop_watermark_raster_t *_watermark_raster_get(dt_iop_watermark_global_data_t *gd, const uint64_t hash, const gchar *svgdoc, const float *geometry)
+{
+  dt_iop_watermark_raster_t *raster = NULL;
+  dt_pthread_mutex_lock(&gd->lock);
+  for(int k=0; k<DT_IOP_WATERMARK_CACHE_ENTRIES; k++)
   {
-    memcpy(ovoid, ivoid, sizeof(float)*ch*roi_out->width*roi_out->height);
-    return;
+    if(!gd->raster[k] || !_watermark_raster_matches(gd->raster[k], hash, svgdoc, geometry)) continue;
+    raster = gd->raster[k];
+    raster->users++;
+    // move to front
+    memmove(gd->raster + 1, gd->raster, sizeof(dt_iop_watermark_raster_t *)*k);
+    gd->raster[0] = raster;
+    break;
   }
+  dt_pthread_mutex_unlock(&gd->lock);
+  return raster;
+}
+
+static void _watermark_raster_insert(dt_iop_watermark_global_data_t *gd, dt_iop_watermark_raster_t *raster)
+{
+  const size_t bytes = sizeof(float)*4*raster->width*raster->height;
+  if(bytes > DT_IOP_WATERMARK_CACHE_BYTES) return;
+  dt_iop_watermark_raster_t *evicted[DT_IOP_WATERMARK_CACHE_ENTRIES] = { NULL };
+  int num_evicted = 0;
+  dt_pthread_mutex_lock(&gd->lock);
+  // another pipe might have been faster:
+  for(int k=0; k<DT_IOP_WATERMARK_CACHE_ENTRIES; k++)
+    if(gd->raster[k] && _watermark_raster_matches(gd->raster[k], raster->hash, raster->svgdoc, raster->geometry))
+    {
+      dt_pthread_mutex_unlock(&gd->lock);
+      return;
+    }
+  // drop least recently used entries until there is a free slot and enough room:
+  for(int k=DT_IOP_WATERMARK_CACHE_ENTRIES-1; k>=0; k--)
+  {
+    if(!gd->raster[k]) continue;
+    if(k < DT_IOP_WATERMARK_CACHE_ENTRIES-1 && gd->raster_bytes + bytes <= DT_IOP_WATERMARK_CACHE_BYTES) break;
+    gd->raster_bytes -= sizeof(float)*4*gd->raster[k]->width*gd->raster[k]->height;
+    evicted[num_evicted++] = gd->raster[k];
+    gd->raster[k] = NULL;
+  }
+  memmove(gd->raster + 1, gd->raster, sizeof(dt_iop_watermark_raster_t *)*(DT_IOP_WATERMARK_CACHE_ENTRIES-1));
+  gd->raster[0] = raster;
+  gd->raster_bytes += bytes;
+  raster->users++;
+  dt_pthread_mutex_unlock(&gd->lock);
+  for(int k=0; k<num_evicted; k++) _watermark_raster_release(gd, evicted[k]);
+}
 
+// renders the svg document for the given roi. returns NULL on failure.
+static dt_iop_watermark_raster_t *_watermark_render(dt_iop_watermark_data_t *data, const gchar *svgdoc, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
+{
   /* create the rsvghandle from parsed svg data */
   GError *error = NULL;
   RsvgHandle *svg = rsvg_handle_new_from_data ((const guint8 *)svgdoc,strlen (svgdoc),&error);
-  g_free (svgdoc);
   if (!svg || error)
-  {
-    memcpy(ovoid, ivoid, sizeof(float)*ch*roi_out->width*roi_out->height);
-    return;
-  }
+    return NULL;
 
   /* setup stride for performance */
   int stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32,roi_out->width);
@@ -621,8 +741,8 @@ void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void
   {
 //   fprintf(stderr,"Cairo surface error: %s\n",cairo_status_to_string(cairo_surface_status(surface)));
     g_free (image);
-    memcpy(ovoid, ivoid, sizeof(float)*ch*roi_out->width*roi_out->height);
-    return;
+    g_object_unref (svg);
+    return NULL;
   }
 
   /* create cairo context and setup transformation/scale */
@@ -749,34 +869,137 @@ void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void
   /* ensure that all operations on surface finishing up */
   cairo_surface_flush (surface);
 
-  /* render surface on output */
-  guint8 *sd = image;
-  float opacity = data->opacity/100.0;
-  /*
-  #ifdef _OPENMP
-  	#pragma omp parallel for default(none) shared(roi_out, in, out,sd,opacity) schedule(static)
-  #endif
-  */
-  for(int j=0; j<roi_out->height; j++) for(int i=0; i<roi_out->width; i++)
+  /* only keep the part that is actually covered by the watermark */
+  int x0 = roi_out->width, y0 = roi_out->height, x1 = -1, y1 = -1;
+  for(int j=0; j<roi_out->height; j++)
+  {
+    const guint8 *sd = image + j*stride;
+    for(int i=0; i<roi_out->width; i++)
+      if(sd[4*i+3])
+      {
+        x0 = MIN(x0, i);
+        x1 = MAX(x1, i);
+        y0 = MIN(y0, j);
+        y1 = MAX(y1, j);
+      }
+  }
+
+  dt_iop_watermark_raster_t *raster = (dt_iop_watermark_raster_t *)malloc(sizeof(dt_iop_watermark_raster_t));
+  if(raster)
+  {
+    raster->hash = 0;
+    raster->svgdoc = NULL;
+    raster->users = 1;
+    raster->x = x0;
+    raster->y = y0;
+    raster->width = MAX(0, x1 - x0 + 1);
+    raster->height = MAX(0, y1 - y0 + 1);
+    raster->buf = NULL;
+  }
+  if(raster && raster->width > 0 && raster->height > 0)
+  {
+    raster->buf = (float *)dt_alloc_align(64, sizeof(float)*4*raster->width*raster->height);
+    if(!raster->buf)
     {
-      float alpha = (sd[3]/255.0)*opacity;
+      free(raster);
+      raster = NULL;
+    }
+  }
+  if(raster && raster->buf)
+  {
+    for(int j=0; j<raster->height; j++)
+    {
+      const guint8 *sd = image + (y0+j)*stride + 4*x0;
+      float *buf = raster->buf + 4*j*raster->width;
+      for(int i=0; i<raster->width; i++)
+      {
+        /* svg uses a premultiplied alpha */
+        buf[0] = sd[2]/255.0f;
+        buf[1] = sd[1]/255.0f;
+        buf[2] = sd[0]/255.0f;
+        buf[3] = sd[3]/255.0f;
+        buf += 4;
+        sd += 4;
+      }
+    }
+  }
+
+  /* clean up */
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+  g_object_unref (svg);
+  g_free (image);
+
+  return raster;
+}
+
+void process (struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
+{
+  dt_iop_watermark_data_t *data = (dt_iop_watermark_data_t *)piece->data;
+  dt_iop_watermark_global_data_t *gd = (dt_iop_watermark_global_data_t *)self->data;
+  const int ch = piece->colors;
+
+  /* the watermark is blended on top of the input */
+  memcpy(ovoid, ivoid, sizeof(float)*ch*roi_out->width*roi_out->height);
+
+  /* Load svg if not loaded */
+  gchar *svgdoc = _watermark_get_svgdoc (self, data, &piece->pipe->image);
+  if (!svgdoc)
+    return;
+
+  /* everything the rendering depends on, the substituted variables are part of the document */
+  uint64_t hash = _watermark_hash(5381, svgdoc, strlen(svgdoc));
+  const float geometry[DT_IOP_WATERMARK_GEOMETRY] =
+  {
+    data->scale, data->xoffset, data->yoffset, data->alignment, data->sizeto,
+    piece->buf_in.width, piece->buf_in.height,
+    roi_in->x, roi_in->y, roi_out->width, roi_out->height, roi_out->scale
+  };
+  hash = _watermark_hash(hash, geometry, sizeof(geometry));
+
+  dt_iop_watermark_raster_t *raster = _watermark_raster_get(gd, hash, svgdoc, geometry);
+  if(!raster)
+  {
+    raster = _watermark_render(data, svgdoc, piece, roi_in, roi_out);
+    if(raster)
+    {
+      raster->hash = hash;
+      raster->svgdoc = g_strdup(svgdoc);
+      memcpy(raster->geometry, geometry, sizeof(raster->geometry));
+      _watermark_raster_insert(gd, raster);
+    }
+  }
+  g_free (svgdoc);
+  if(!raster)
+    return;
+
+  /* render watermark on output */
+  const float opacity = data->opacity/100.0;
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static) shared(raster, roi_out, ivoid, ovoid)
+#endif
+  for(int j=0; j<raster->height; j++)
+  {
+    const size_t offs = (size_t)ch*((raster->y+j)*roi_out->width + raster->x);
+    const float *in = (const float *)ivoid + offs;
+    float *out = (float *)ovoid + offs;
+    const float *sd = raster->buf + 4*j*raster->width;
+    for(int i=0; i<raster->width; i++)
+    {
+      const float alpha = sd[3]*opacity;
       /* svg uses a premultiplied alpha, so only use opacity for the blending */
-      out[0] = ((1.0-alpha)*in[0]) + (opacity*(sd[2]/255.0));
-      out[1] = ((1.0-alpha)*in[1]) + (opacity*(sd[1]/255.0));
-      out[2] = ((1.0-alpha)*in[2]) + (opacity*(sd[0]/255.0));
+      out[0] = ((1.0f-alpha)*in[0]) + (opacity*sd[0]);
+      out[1] = ((1.0f-alpha)*in[1]) + (opacity*sd[1]);
+      out[2] = ((1.0f-alpha)*in[2]) + (opacity*sd[2]);
       out[3] = in[3];
 
       out+=ch;
       in+=ch;
       sd+=4;
     }
+  }
 
-
-  /* clean up */
-  cairo_surface_destroy (surface);
-  g_object_unref (svg);
-  g_free (image);
-
+  _watermark_raster_release(gd, raster);
 }
 
 static void
@@ -1021,6 +1244,26 @@ void cleanup(dt_iop_module_t *module)
   module->params = NULL;
 }
 
+void init_global(dt_iop_module_so_t *module)
+{
+  dt_iop_watermark_global_data_t *gd = (dt_iop_watermark_global_data_t *)malloc(sizeof(dt_iop_watermark_global_data_t));
+  memset(gd, 0, sizeof(dt_iop_watermark_global_data_t));
+  dt_pthread_mutex_init(&gd->lock, NULL);
+  module->data = gd;
+}
+
+void cleanup_global(dt_iop_module_so_t *module)
+{
+  dt_iop_watermark_global_data_t *gd = (dt_iop_watermark_global_data_t *)module->data;
+  for(int k=0; k<DT_IOP_WATERMARK_CACHE_ENTRIES; k++)
+    if(gd->raster[k]) _watermark_raster_release(gd, gd->raster[k]);
+  g_free(gd->svgfile);
+  g_free(gd->svgdata);
+  dt_pthread_mutex_destroy(&gd->lock);
+  free(module->data);
+  module->data = NULL;
+}
+
 void gui_init(struct dt_iop_module_t *self)
 {
   self->gui_data = malloc(sizeof(dt_iop_watermark_gui_data_t));
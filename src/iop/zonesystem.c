@@ -57,12 +57,12 @@ typedef struct dt_iop_zonesystem_params_t dt_iop_zonesystem_data_t;
 /*
 void init_presets (dt_iop_module_so_t *self)
 {
-//   DT_DEBUG_SQLITE3_EXEC(darktable.db, "begin", NULL, NULL, NULL);
+//   dt_database_start_transaction(darktable.db);
 
   dt_gui_presets_add_generic(_("Fill-light 0.25EV with 4 zones"), self->op, self->version(), &(dt_iop_zonesystem_params_t){0.25,0.25,4.0} , sizeof(dt_iop_zonesystem_params_t), 1);
   dt_gui_presets_add_generic(_("Fill-shadow -0.25EV with 4 zones"), self->op, self->version(), &(dt_iop_zonesystem_params_t){-0.25,0.25,4.0} , sizeof(dt_iop_zonesystem_params_t), 1);
 
-//   DT_DEBUG_SQLITE3_EXEC(darktable.db, "commit", NULL, NULL, NULL);
+//   dt_database_release_transaction(darktable.db);
 }
 */
 
@@ -64,6 +64,8 @@ static void _lib_backgroundjobs_destroy(dt_lib_module_t *self, const guint *key)
 static void _lib_backgroundjobs_set_cancellable(dt_lib_module_t *self, const guint *key, struct dt_job_t *job);
 /* proxy function for setting the progress of a ui bgjob plate */
 static void _lib_backgroundjobs_progress(dt_lib_module_t *self, const guint *key, double progress);
+/* proxy function for changing the label of a ui bgjob plate */
+static void _lib_backgroundjobs_set_message(dt_lib_module_t *self, const guint *key, const gchar *message);
 /* callback when cancel job button is pushed  */
 static void _lib_backgroundjobs_cancel_callback(GtkWidget *w, gpointer user_data);
 
@@ -111,6 +113,7 @@ void gui_init(dt_lib_module_t *self)
   darktable.control->proxy.backgroundjobs.create = _lib_backgroundjobs_create;
   darktable.control->proxy.backgroundjobs.destroy = _lib_backgroundjobs_destroy;
   darktable.control->proxy.backgroundjobs.progress = _lib_backgroundjobs_progress;
+  darktable.control->proxy.backgroundjobs.set_message = _lib_backgroundjobs_set_message;
   darktable.control->proxy.backgroundjobs.set_cancellable = _lib_backgroundjobs_set_cancellable;
 }
 
@@ -203,6 +206,19 @@ static void _lib_backgroundjobs_destroy(dt_lib_module_t *self, const guint *key)
   if(i_own_lock) dt_control_gdk_unlock();
 }
 
+static void _lib_backgroundjobs_set_message(dt_lib_module_t *self, const guint *key, const gchar *message)
+{
+  if(!darktable.control->running) return;
+  dt_lib_backgroundjobs_t *d = (dt_lib_backgroundjobs_t*)self->data;
+  gboolean i_own_lock = dt_control_gdk_lock();
+
+  dt_bgjob_t *j = (dt_bgjob_t*)g_hash_table_lookup(d->jobs, key);
+  if(j && GTK_IS_LABEL(j->label))
+    gtk_label_set_text(GTK_LABEL(j->label), message);
+
+  if(i_own_lock) dt_control_gdk_unlock();
+}
+
 static void _lib_backgroundjobs_cancel_callback(GtkWidget *w, gpointer user_data)
 {
   dt_job_t *job=(dt_job_t *)user_data;
@@ -18,6 +18,7 @@
 */
 #include "common/darktable.h"
 #include "common/film.h"
+#include "common/folders.h"
 #include "common/collection.h"
 #include "common/debug.h"
 #include "control/conf.h"
@@ -483,6 +484,9 @@ void view_popup_menu_onSearchFilmroll (GtkWidget *menuitem, gpointer userdata)
       }
       g_free(query);
 
+      /* the film roll folders changed under the folder tree */
+      dt_folders_invalidate();
+
       /* reset filter to display all images, otherwise view may remain empty */
       dt_view_filter_reset_to_show_all(darktable.view_manager);
 
@@ -609,32 +613,6 @@ view_onPopupMenu (GtkWidget *treeview, gpointer userdata)
   return TRUE; /* we handled this */
 }
 
-static int
-_count_images(const char *path)
-{
-  // FIXME: this function is a major performance problem
-  //        if many folders are counted. until it's cached somehow, it's switched off:
-  return 0;
-#if 0
-  sqlite3_stmt *stmt = NULL;
-  gchar query[1024] = {0};
-  int count = 0;
-
-  gchar *escaped_text = NULL;
-  escaped_text = dt_util_str_replace(path, "'", "''");
-
-  snprintf (query, 1024, "select count(id) from images where film_id in (select id from film_rolls where folder like '%s%%')", escaped_text);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if (sqlite3_step(stmt) == SQLITE_ROW)
-    count = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-
-  g_free(escaped_text);
-
-  return count;
-#endif
-}
-
 static gboolean
 _filmroll_is_present(const gchar *path)
 {
@@ -662,112 +640,41 @@ _show_filmroll_present(GtkTreeViewColumn *column,
 }
 
 
+static void
+_folder_tree_add (GtkTreeStore *store, GtkTreeIter *parent, const dt_folder_t *folder)
+{
+  for(const GList *l = folder->children; l; l = g_list_next(l))
+  {
+    const dt_folder_t *child = (const dt_folder_t *)l->data;
+    GtkTreeIter iter;
+    gtk_tree_store_append(store, &iter, parent);
+    gtk_tree_store_set(store, &iter, DT_LIB_COLLECT_COL_TEXT, child->name,
+                       DT_LIB_COLLECT_COL_PATH, child->path,
+                       DT_LIB_COLLECT_COL_COUNT, (gint)child->total,
+                       DT_LIB_COLLECT_COL_VISIBLE, TRUE, -1);
+    _folder_tree_add(store, &iter, child);
+  }
+}
+
 static GtkTreeStore *
 _folder_tree ()
 {
-  /* initialize the tree store */
-  sqlite3_stmt *stmt;
-//  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select folder,external_drive from film_rolls order by folder desc", -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select folder from film_rolls order by folder desc", -1, &stmt, NULL);
+  /* initialize the tree store with the folders of all film rolls and their image counts */
   GtkTreeStore *store = gtk_tree_store_new(DT_LIB_COLLECT_NUM_COLS, G_TYPE_STRING, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_BOOLEAN);
-
-  // initialize the model with the paths
-
-  while (sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    int level = 0;
-    char *value;
-    GtkTreeIter current, iter;
-    GtkTreePath *root;
-    char **pch = g_strsplit((char *)sqlite3_column_text(stmt, 0), "/", -1);
-#if 0
-    char *external = g_strdup((char *)sqlite3_column_text(stmt, 1));
-
-    if (external == NULL)
-      external = g_strdup("Local");
-#endif
-    gboolean found=FALSE;
-
-    root = gtk_tree_path_new_first();
-    gtk_tree_model_get_iter (GTK_TREE_MODEL(store), &iter, root);
-    //current = iter; // This needs to be deleted if the following code is enabled
-#if 0
-    int children = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store),NULL);
-    for (int k=0; k<children; k++)
-    {
-      if (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(store), &iter, NULL, k))
-      {
-        gtk_tree_model_get (GTK_TREE_MODEL(store), &iter, 0, &value, -1);
-
-        if (strcmp(value, external)==0)
-        {
-          found = TRUE;
-          current = iter;
-          break;
-        }
-      }
-    }
-
-    if (!found)
-    {
-      gtk_tree_store_insert(store, &iter, NULL, 0);
-      gtk_tree_store_set(store, &iter, 0, external, -1);
-      current = iter;
-    }
-
-    level=1;
-#endif
-
-    // g_strsplit returns pch[0] always as an empty string ""
-    while (pch[level] != NULL)
-    {
-      found = FALSE;
-      int children = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store),level>0?&current:NULL);
-      /* find child with name, if not found create and continue */
-      for (int k=0; k<children; k++)
-      {
-        if (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(store), &iter, level>0?&current:NULL, k))
-        {
-          gtk_tree_model_get (GTK_TREE_MODEL(store), &iter, 0, &value, -1);
-
-          if (strcmp(value, pch[level])==0)
-          {
-            current = iter;
-            found = TRUE;
-            break;
-          }
-        }
-      }
-
-      /* lets add new path and assign current */
-      if (!found)
-      {
-        gchar *pth2 = NULL;
-        pth2 = dt_util_dstrcat(pth2, "/");
-
-        for (int i=0; i <= level; i++)
-        {
-          if (level > 0 && i != 0)
-            pth2 = dt_util_dstrcat(pth2, "%s/", pch[i]);
-        }
-
-        snprintf(pth2+strlen(pth2)-1, 1, "%s", "\0");
-
-        int count = _count_images(pth2);
-        gtk_tree_store_insert(store, &iter, level>0?&current:NULL,0);
-        gtk_tree_store_set(store, &iter, DT_LIB_COLLECT_COL_TEXT, pch[level],
-                           DT_LIB_COLLECT_COL_PATH, pth2,
-                           DT_LIB_COLLECT_COL_COUNT, count,
-                           DT_LIB_COLLECT_COL_VISIBLE, TRUE, -1);
-        current = iter;
-      }
-
-      level++;
-    }
-  }
+  dt_folder_t *root = dt_folders_get_tree();
+  _folder_tree_add(store, NULL, root);
+  dt_folders_free_tree(root);
   return store;
 }
 
+static void
+_lib_collect_update_tree (dt_lib_collect_t *d)
+{
+  if(d->treemodel) g_object_unref(d->treemodel);
+  d->treemodel = GTK_TREE_MODEL(_folder_tree());
+  d->tree_new = TRUE;
+}
+
 static gboolean
 match_string (GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
 {
@@ -876,9 +783,7 @@ _create_filtered_model (GtkTreeModel *model, GtkTreeIter iter, dt_lib_collect_ru
   GtkTreePath *path;
   GtkTreeIter child;
 
-  sqlite3_stmt *stmt = NULL;
-  gchar *pth, *query = NULL;
-  int id = -1;
+  gchar *pth;
 
 
   /* Filter level */
@@ -889,16 +794,8 @@ _create_filtered_model (GtkTreeModel *model, GtkTreeIter iter, dt_lib_collect_ru
     {
       /* Check if this path also matches a filmroll */
       gtk_tree_model_get (model, &iter, DT_LIB_COLLECT_COL_PATH, &pth, -1);
-
-      query = dt_util_dstrcat(query, "select id from film_rolls where folder like '%s'", pth);
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-      if (sqlite3_step(stmt) == SQLITE_ROW)
-        id = sqlite3_column_int(stmt, 0);
-      sqlite3_finalize(stmt);
-
+      const int id = dt_folders_get_film_id(pth);
       g_free(pth);
-      g_free(query);
-      query = NULL;
 
       if (id != -1)
       {
@@ -957,14 +854,12 @@ _create_treeview_display (GtkTreeModel *model)
 
   gtk_tree_view_column_set_cell_data_func(col1, renderer, _show_filmroll_present, NULL, NULL);
 
-#if 0 // FIXME: count switched off for now, as it is a performance regression (see #8981).
   GtkTreeViewColumn *col2 = gtk_tree_view_column_new();
   gtk_tree_view_append_column(tree,col2);
 
   GtkCellRenderer *renderer2 = gtk_cell_renderer_text_new();
   gtk_tree_view_column_pack_start(col2, renderer2, TRUE);
   gtk_tree_view_column_add_attribute(col2, renderer2, "text", DT_LIB_COLLECT_COL_COUNT);
-#endif
 
   gtk_tree_view_set_model(tree, GTK_TREE_MODEL(model));
 
@@ -1286,11 +1181,8 @@ create_folders_gui (dt_lib_collect_rule_t *dr)
 
     if (d->trees != NULL)
     {
-      for (guint i=0; i<d->trees->len; i++)
-      {
-        tree = GTK_TREE_VIEW(g_ptr_array_index (d->trees, i));
-        g_ptr_array_free(d->trees, TRUE);
-      }
+      // destroys the tree views as well
+      g_ptr_array_free(d->trees, TRUE);
       d->trees = NULL;
     }
 
@@ -1701,12 +1593,11 @@ collection_updated(gpointer instance, gpointer self)
 static void
 filmrolls_updated(gpointer instance, gpointer self)
 {
-//  dt_lib_module_t *dm = (dt_lib_module_t *)self;
-
-//  dt_lib_collect_t *d = (dt_lib_collect_t *)dm->data;
-//  int active = d->active_rule;
+  dt_lib_module_t *dm = (dt_lib_module_t *)self;
+  dt_lib_collect_t *d = (dt_lib_collect_t *)dm->data;
 
-  //TODO: We should update the count of images here
+  // film rolls or their image counts changed, the folder tree is cheap to rebuild:
+  _lib_collect_update_tree(d);
   _lib_collect_gui_update(self);
 }
 
@@ -1720,8 +1611,7 @@ filmrolls_imported(gpointer instance, gpointer self)
   d->active_rule = active;
 
   // update tree
-  d->treemodel = GTK_TREE_MODEL(_folder_tree());
-  d->tree_new = TRUE;
+  _lib_collect_update_tree(d);
   d->rule[active].typing = FALSE;
 
   // reset active rules
@@ -1740,8 +1630,7 @@ filmrolls_removed(gpointer instance, gpointer self)
   d->active_rule = active;
 
   // update tree
-  d->treemodel = GTK_TREE_MODEL(_folder_tree());
-  d->tree_new = TRUE;
+  _lib_collect_update_tree(d);
   d->rule[active].typing = FALSE;
 
   // reset active rules
@@ -1945,8 +1834,7 @@ gui_init (dt_lib_module_t *self)
 //  g_signal_connect(G_OBJECT(d->gv_monitor), "mount-changed", G_CALLBACK(mount_changed), self);
 
   // TODO: This should be done in a more generic place, not gui_init
-  d->treemodel = GTK_TREE_MODEL(_folder_tree());
-  d->tree_new = TRUE;
+  _lib_collect_update_tree(d);
   _lib_collect_gui_update(self);
 
   dt_control_signal_connect(darktable.signals,
@@ -1988,6 +1876,8 @@ gui_cleanup (dt_lib_module_t *self)
   //g_ptr_array_free(d->labels, TRUE);
   if (d->trees != NULL)
     g_ptr_array_free(d->trees, TRUE);
+  if (d->treemodel != NULL)
+    g_object_unref(d->treemodel);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
@@ -98,6 +98,7 @@ export_button_clicked (GtkWidget *widget, gpointer user_data)
   g_free(format_name);
   g_free(storage_name);
   gboolean high_quality = dt_conf_get_bool("plugins/lighttable/export/high_quality_processing");
+  gboolean demosaic_half_size = dt_conf_get_bool("plugins/lighttable/export/demosaic_half_size");
   char* tmp = dt_conf_get_string("plugins/lighttable/export/style");
   if (tmp)
   {
@@ -113,7 +114,7 @@ export_button_clicked (GtkWidget *widget, gpointer user_data)
   else
     list = dt_collection_get_selected(darktable.collection); 
 
-  dt_control_export(list,max_width, max_height, format_index, storage_index, high_quality,style);
+  dt_control_export(list,max_width, max_height, format_index, storage_index, high_quality, demosaic_half_size, style);
 }
 
 static void
@@ -431,6 +431,9 @@ _lib_geotagging_gpx_callback(GtkWidget *widget, dt_lib_module_t *self)
                            GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT,
                            (char *)NULL);
 
+  // several files (e.g. one per day) are merged into one track
+  gtk_file_chooser_set_select_multiple(GTK_FILE_CHOOSER(filechooser), TRUE);
+
   char *last_directory = dt_conf_get_string("ui_last/gpx_last_directory");
   if(last_directory != NULL)
     gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER (filechooser), last_directory);
@@ -479,9 +482,9 @@ _lib_geotagging_gpx_callback(GtkWidget *widget, dt_lib_module_t *self)
     dt_conf_set_string("ui_last/gpx_last_directory", gtk_file_chooser_get_current_folder(GTK_FILE_CHOOSER (filechooser)));
     gchar *tz = gtk_combo_box_get_active_text(GTK_COMBO_BOX(tz_selection));
     dt_conf_set_string("plugins/lighttable/geotagging/tz", tz);
-    gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER (filechooser));
-    dt_control_gpx_apply(filename, -1, tz);
-    g_free(filename);
+    GSList *filenames = gtk_file_chooser_get_filenames(GTK_FILE_CHOOSER (filechooser));
+    dt_control_gpx_apply(filenames, -1, tz);
+    g_slist_free_full(filenames, g_free);
     g_free(tz);
   }
 
@@ -17,6 +17,7 @@
 */
 #include "common/darktable.h"
 #include "common/collection.h"
+#include "common/folders.h"
 #include "control/conf.h"
 #include "control/signal.h"
 #include "gui/accelerators.h"
@@ -98,9 +99,11 @@ void connect_key_accels(dt_lib_module_t *self)
 }
 
 
+// also returns the number of images in the folder, if the collection is a single film roll or folder.
 static void
-pretty_print(char *buf, char *out)
+pretty_print(char *buf, char *out, guint *count)
 {
+  *count = 0;
   if(!buf || buf[0] == '\0') return;
   int num_rules = 0;
   char str[400] = {0};
@@ -130,6 +133,10 @@ pretty_print(char *buf, char *out)
     str[i] = '\0';
 
     out += sprintf(out, "%s %s", _(dt_lib_collect_string[item]), item == 0 ? dt_image_film_roll_name(str) : str);
+    if(num_rules == 1 && item == DT_COLLECTION_PROP_FILMROLL)
+      *count = dt_folders_count_film_images(str);
+    else if(num_rules == 1 && item == DT_COLLECTION_PROP_FOLDERS)
+      *count = dt_folders_count_images(str);
     while(buf[0] != '$' && buf[0] != '\0') buf++;
     buf++;
   }
@@ -247,15 +254,23 @@ static void _lib_recentcollection_updated(gpointer instance, gpointer user_data)
     char str[200] = {0};
     char str_cut[200] = {0};
     char str_pretty[200] = {0};
+    guint count = 0;
 
     snprintf(confname, 200, "plugins/lighttable/recentcollect/line%1d", k);
     gchar *buf = dt_conf_get_string(confname);
     if(buf && buf[0] != '\0')
     {
-      pretty_print(buf, str);
+      pretty_print(buf, str, &count);
       g_free(buf);
     }
-    g_object_set(G_OBJECT(d->item[k].button), "tooltip-text", str, (char *)NULL);
+    if(count > 0)
+    {
+      gchar *tooltip = g_strdup_printf(ngettext("%s\n%u image", "%s\n%u images", count), str, count);
+      g_object_set(G_OBJECT(d->item[k].button), "tooltip-text", tooltip, (char *)NULL);
+      g_free(tooltip);
+    }
+    else
+      g_object_set(G_OBJECT(d->item[k].button), "tooltip-text", str, (char *)NULL);
     const int cut = 45;
     if (g_utf8_strlen(str, -1) > cut)
     {
@@ -23,6 +23,7 @@
 #include "lua/glist.h"
 #include "lua/gui.h"
 #include "lua/image.h"
+#include "lua/jobs.h"
 #include "lua/preferences.h"
 #include "lua/print.h"
 #include "lua/types.h"
@@ -62,6 +63,7 @@ static lua_CFunction init_funcs[] =
   dt_lua_init_storages,
   dt_lua_init_tags,
   dt_lua_init_events,
+  dt_lua_init_jobs,
   NULL
 };
 
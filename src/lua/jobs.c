@@ -0,0 +1,113 @@
+/*
+   This file is part of darktable,
+   copyright (c) 2014 the darktable developers.
+
+   darktable is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   darktable is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/jobs.h"
+#include "common/darktable.h"
+#include "control/control.h"
+
+static void push_number_field(lua_State *L, const char *key, const double value)
+{
+  lua_pushstring(L, key);
+  lua_pushnumber(L, value);
+  lua_settable(L, -3);
+}
+
+// histograms are arrays, entry k counts the times below 2^(k-1) ms, the last one all longer times
+static void push_histogram_field(lua_State *L, const char *key, const uint32_t *histogram)
+{
+  lua_pushstring(L, key);
+  lua_newtable(L);
+  for(int k=0; k<DT_CONTROL_TELEMETRY_BUCKETS; k++)
+  {
+    lua_pushnumber(L, histogram[k]);
+    lua_rawseti(L, -2, k+1);
+  }
+  lua_settable(L, -3);
+}
+
+static void push_workers_field(lua_State *L, const char *key, const double *busy, const int num, const double uptime)
+{
+  lua_pushstring(L, key);
+  lua_newtable(L);
+  for(int k=0; k<num; k++)
+  {
+    lua_newtable(L);
+    push_number_field(L, "busy", busy[k]);
+    push_number_field(L, "utilization", uptime > 0.0 ? busy[k]/uptime : 0.0);
+    lua_rawseti(L, -2, k+1);
+  }
+  lua_settable(L, -3);
+}
+
+/*
+ * returns a table with the job timings of the control layer, times in seconds:
+ * { uptime, queue_depth, queue_depth_max, queue_full,
+ *   workers = { { busy, utilization }, .. }, reserved_workers = { .. },
+ *   jobs = { [type] = { runs, discarded, wait_total, wait_max, run_total, run_max,
+ *                       wait_histogram = { .. }, run_histogram = { .. } }, .. } }
+ */
+static int job_telemetry(lua_State *L)
+{
+  dt_control_telemetry_t t;
+  dt_control_telemetry_get(darktable.control, &t);
+
+  lua_newtable(L);
+  push_number_field(L, "uptime", t.uptime);
+  push_number_field(L, "queue_depth", t.queue_depth);
+  push_number_field(L, "queue_depth_max", t.queue_depth_max);
+  push_number_field(L, "queue_full", t.queue_full);
+  push_workers_field(L, "workers", t.busy, t.num_workers, t.uptime);
+  push_workers_field(L, "reserved_workers", t.busy + DT_CTL_WORKER_MAX, DT_CTL_WORKER_RESERVED, t.uptime);
+
+  lua_pushstring(L, "jobs");
+  lua_newtable(L);
+  for(GList *l = t.jobs; l; l = g_list_next(l))
+  {
+    const dt_control_job_stats_t *st = (const dt_control_job_stats_t *)l->data;
+    lua_pushstring(L, st->type);
+    lua_newtable(L);
+    push_number_field(L, "runs", st->runs);
+    push_number_field(L, "discarded", st->discarded);
+    push_number_field(L, "wait_total", st->wait_total);
+    push_number_field(L, "wait_max", st->wait_max);
+    push_number_field(L, "run_total", st->run_total);
+    push_number_field(L, "run_max", st->run_max);
+    push_histogram_field(L, "wait_histogram", st->wait_histogram);
+    push_histogram_field(L, "run_histogram", st->run_histogram);
+    lua_settable(L, -3);
+  }
+  lua_settable(L, -3);
+
+  dt_control_telemetry_free(&t);
+  return 1;
+}
+
+int dt_lua_init_jobs(lua_State *L)
+{
+  dt_lua_push_darktable_lib(L);
+
+  lua_pushstring(L, "job_telemetry");
+  lua_pushcfunction(L, &job_telemetry);
+  lua_settable(L, -3);
+
+  lua_pop(L, 1);
+  return 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
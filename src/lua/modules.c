@@ -116,7 +116,7 @@ static int write_image(lua_State *L)
   const char * filename = luaL_checkstring(L,3);
 
   gboolean high_quality = dt_conf_get_bool("plugins/lighttable/export/high_quality_processing");
-  lua_pushboolean(L,dt_imageio_export(imgid,filename,format,fdata,high_quality));
+  lua_pushboolean(L,dt_imageio_export(imgid,filename,format,fdata,high_quality,FALSE));
   format->free_params(format,fdata);
   return 1;
 }
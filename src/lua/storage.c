@@ -69,7 +69,7 @@ static int default_dimension_wrapper    (struct dt_imageio_module_storage_t *sel
   return 0;
 };
 
-static int store_wrapper(struct dt_imageio_module_storage_t *self,struct dt_imageio_module_data_t *self_data, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality)
+static int store_wrapper(struct dt_imageio_module_storage_t *self,struct dt_imageio_module_data_t *self_data, const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total, const gboolean high_quality, const gboolean demosaic_half_size)
 {
   /* construct a temporary file name */
   char tmpdir[DT_MAX_PATH_LEN]= {0};
@@ -84,7 +84,7 @@ static int store_wrapper(struct dt_imageio_module_storage_t *self,struct dt_imag
 
   gchar* complete_name = g_build_filename( tmpdir, filename, (char *)NULL );
 
-  if(dt_imageio_export(imgid, complete_name, format, fdata, high_quality) != 0)
+  if(dt_imageio_export(imgid, complete_name, format, fdata, high_quality, demosaic_half_size) != 0)
   {
     fprintf(stderr, "[%s] could not export to file: `%s'!\n", self->name(self),complete_name);
     g_free(complete_name);
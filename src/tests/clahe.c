@@ -0,0 +1,213 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for the local contrast (clahe) module: compares walking the
+// window columns per pixel and sliding column histograms against the loop
+// process() ran before they were factored out, and checks that all three
+// produce the same result. also times the interpolated tiles and reports
+// how far they are off.
+#include "iop/clahe.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+
+// largest mean difference of the interpolated tiles to the per pixel windows
+// seen on the test image, for any of the radii below (radius 128: 0.0023).
+#define DT_IOP_CLAHE_TILES_MEAN_DIFF 0.005
+#include <sys/time.h>
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+#define ROUND_POSISTIVE(f) ((unsigned int)((f)+0.5))
+
+// the equalization loop of process() in src/iop/clahe.c as it was before
+// src/iop/clahe.h, writing the luminance instead of applying it.
+static void clahe_baseline(const float *const luminance, float *const out, const int width, const int height, const int rad, const float slope)
+{
+  const int bins=256;
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int j=0; j<height; j++)
+  {
+    int yMin = fmax( 0, j - rad );
+    int yMax = fmin( height, j + rad + 1 );
+    int h = yMax - yMin;
+
+    int xMin0 = fmax( 0, 0-rad );
+    int xMax0 = fmin( width - 1, rad );
+
+    int hist[bins+1];
+    int clippedhist[bins+1];
+    float *ld = out + j*width;
+
+    /* initially fill histogram */
+    memset(hist,0,(bins+1)*sizeof(int));
+    for ( int yi = yMin; yi < yMax; ++yi )
+      for ( int xi = xMin0; xi < xMax0; ++xi )
+        ++hist[ ROUND_POSISTIVE(luminance[yi*width+xi] * (float)bins) ];
+
+    for(int i=0; i<width; i++)
+    {
+
+      int v = ROUND_POSISTIVE(luminance[j*width+i] * (float)bins);
+
+      int xMin = fmax( 0, i - rad );
+      int xMax = i + rad + 1;
+      int w = fmin( width, xMax ) - xMin;
+      int n = h * w;
+
+      int limit = ( int )( slope * n /  bins + 0.5f );
+
+      /* remove left behind values from histogram */
+      if ( xMin > 0 )
+      {
+        int xMin1 = xMin - 1;
+        for ( int yi = yMin; yi < yMax; ++yi )
+          --hist[  ROUND_POSISTIVE(luminance[yi*width+xMin1] * (float)bins) ];
+      }
+
+      /* add newly included values to histogram */
+      if ( xMax <= width )
+      {
+        int xMax1 = xMax - 1;
+        for ( int yi = yMin; yi < yMax; ++yi )
+          ++hist[  ROUND_POSISTIVE(luminance[yi*width+xMax1] * (float)bins) ];
+      }
+
+      /* clip histogram and redistribute clipped entries */
+      memcpy(clippedhist,hist,(bins+1)*sizeof(int));
+      int ce = 0, ceb=0;
+      do
+      {
+        ceb = ce;
+        ce = 0;
+        for ( int b = 0; b <= bins; b++ )
+        {
+          int d = clippedhist[ b ] - limit;
+          if ( d > 0 )
+          {
+            ce += d;
+            clippedhist[ b ] = limit;
+          }
+        }
+
+        int d = (ce / (float) ( bins + 1 ));
+        int m = ce % ( bins + 1 );
+        for ( int h = 0; h <= bins; h++)
+          clippedhist[ h ] += d;
+
+        if ( m != 0 )
+        {
+          int s = bins / (float)m;
+          for ( int h = 0; h <= bins; h += s )
+            ++clippedhist[ h ];
+        }
+      }
+      while ( ce != ceb);
+
+      /* build cdf of clipped histogram */
+      int hMin = bins;
+      for ( int h = 0; h < hMin; h++ )
+        if ( clippedhist[ h ] != 0 ) hMin = h;
+
+      int cdf = 0;
+      for ( int h = hMin; h <= v; h++ )
+        cdf += clippedhist[ h ];
+
+      int cdfMax = cdf;
+      for ( int h = v + 1; h <= bins; h++ )
+        cdfMax += clippedhist[ h ];
+
+      int cdfMin = clippedhist[ hMin ];
+
+      *ld=( cdf - cdfMin ) / ( float )( cdfMax - cdfMin );
+
+      ld++;
+    }
+  }
+}
+
+int main(int argc, char *arg[])
+{
+  const int width  = argc > 1 ? atoi(arg[1]) : 1500;
+  const int height = argc > 2 ? atoi(arg[2]) : 1000;
+  const float slope = 1.25f;
+
+  float *lum  = (float *)malloc(sizeof(float)*width*height);
+  float *base = (float *)malloc(sizeof(float)*width*height);
+  float *ref  = (float *)malloc(sizeof(float)*width*height);
+  float *fast = (float *)malloc(sizeof(float)*width*height);
+  float *tile = (float *)malloc(sizeof(float)*width*height);
+  // some smooth structure plus noise:
+  srand(1);
+  for(int j=0; j<height; j++) for(int i=0; i<width; i++)
+    lum[j*width+i] = fminf(1.0f, fmaxf(0.0f,
+        0.5f + 0.3f*sinf(i*0.01f)*cosf(j*0.013f) + 0.1f*(rand()/(float)RAND_MAX - 0.5f)));
+
+  const int radii[] = { 8, 16, 24, 32, 64, 128, 256 };
+  fprintf(stderr, "[clahe] %dx%d pixels\n", width, height);
+  const int nradii = sizeof(radii)/sizeof(radii[0]);
+  for(int r=0; r<nradii; r++)
+  {
+    const int rad = radii[r];
+    double t0 = get_time();
+    clahe_baseline(lum, base, width, height, rad, slope);
+    double t1 = get_time();
+    dt_iop_clahe_columns(lum, ref, width, height, rad, slope);
+    double t2 = get_time();
+    dt_iop_clahe_histograms(lum, fast, width, height, rad, slope);
+    double t3 = get_time();
+    dt_iop_clahe_tiles(lum, tile, width, height, rad, slope);
+    double t4 = get_time();
+    float maxdiff = 0.0f;
+    double tilediff = 0.0;
+    for(int k=0; k<width*height; k++)
+    {
+      maxdiff = fmaxf(maxdiff, fmaxf(fabsf(base[k] - ref[k]), fabsf(base[k] - fast[k])));
+      tilediff += fabsf(base[k] - tile[k]);
+    }
+    tilediff /= width*height;
+    fprintf(stderr, "[clahe] radius %3d: baseline %7.3fs columns %7.3fs (%.1fx) histograms %7.3fs (%.1fx), max difference %g\n",
+            rad, t1-t0, t2-t1, (t1-t0)/(t2-t1), t3-t2, (t1-t0)/(t3-t2), maxdiff);
+    fprintf(stderr, "[clahe]             tiles    %7.3fs (%.1fx), mean difference %g\n",
+            t4-t3, (t1-t0)/(t4-t3), tilediff);
+    assert(maxdiff == 0.0f);
+    // the tiles only approximate the per pixel windows:
+    assert(tilediff < DT_IOP_CLAHE_TILES_MEAN_DIFF);
+  }
+  fprintf(stderr, "[passed] clahe fast path matches reference\n");
+
+  free(lum);
+  free(base);
+  free(ref);
+  free(fast);
+  free(tile);
+  exit(0);
+}
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
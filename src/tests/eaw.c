@@ -0,0 +1,131 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// test for common/eaw.h: runs the equalizer's wavelet transform once the way it
+// used to be done (one detail buffer per level, then the reconstruction level by
+// level) and once with the reconstruction folded into the decomposition, checks
+// that the results agree and reports time and memory of both.
+#include "common/eaw.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+int main(int argc, char *arg[])
+{
+  const int width  = argc > 1 ? atoi(arg[1]) : 3000;
+  const int height = argc > 2 ? atoi(arg[2]) : 2000;
+  const int scales = argc > 3 ? atoi(arg[3]) : 6;
+  const size_t size = sizeof(float)*4*width*height;
+
+  float thrs[scales][4], boost[scales][4], sharp[scales];
+  for(int s=0; s<scales; s++)
+  {
+    for(int c=0; c<4; c++)
+    {
+      thrs[s][c] = 0.002f*(c ? 2 : 1)/(s+1);
+      boost[s][c] = 1.0f + 0.3f*(s%3) - 0.1f*c;
+    }
+    sharp[s] = 0.0025f*(s+1);
+  }
+
+  // Lab-ish values, smooth structure with edges and noise:
+  float *in = (float *)_mm_malloc(size, 16);
+  srand(1);
+  for(int j=0; j<height; j++) for(int i=0; i<width; i++)
+  {
+    float *p = in + 4*((size_t)j*width+i);
+    p[0] = 50.0f + 30.0f*sinf(i*0.01f)*cosf(j*0.013f) + (((i/64) + (j/64)) & 1 ? 10.0f : 0.0f) + 2.0f*(rand()/(float)RAND_MAX - 0.5f);
+    p[1] = 20.0f*sinf(j*0.004f) + (rand()/(float)RAND_MAX - 0.5f);
+    p[2] = -15.0f*cosf(i*0.006f) + (rand()/(float)RAND_MAX - 0.5f);
+    p[3] = 0.0f;
+  }
+
+  // reference: one detail buffer per level.
+  float *ref = (float *)_mm_malloc(size, 16);
+  float *tmp = (float *)_mm_malloc(size, 16);
+  float *detail[scales];
+  for(int s=0; s<scales; s++) detail[s] = (float *)_mm_malloc(size, 16);
+  double t0 = get_time();
+  float *buf1 = in, *buf2 = tmp;
+  for(int s=0; s<scales; s++)
+  {
+    dt_eaw_decompose(buf2, buf1, detail[s], s, DT_EAW_WEIGHT_SHARPEN, sharp[s], width, height);
+    if(s == 0) buf1 = ref;
+    float *buf3 = buf2;
+    buf2 = buf1;
+    buf1 = buf3;
+  }
+  for(int s=scales-1; s>=0; s--)
+  {
+    dt_eaw_synthesize(buf2, buf1, detail[s], thrs[s], boost[s], width, height);
+    float *buf3 = buf2;
+    buf2 = buf1;
+    buf1 = buf3;
+  }
+  double t1 = get_time();
+  // due to symmetric processing, the result is in ref.
+  for(int s=0; s<scales; s++) _mm_free(detail[s]);
+
+  // fused: the reconstruction is summed up while decomposing.
+  float *out = (float *)_mm_malloc(size, 16);
+  float *acc = (float *)_mm_malloc(size, 16);
+  double t2 = get_time();
+  buf1 = in;
+  buf2 = tmp;
+  for(int s=0; s<scales; s++)
+  {
+    dt_eaw_decompose_and_synthesize(buf2, buf1, acc, s == 0, thrs[s], boost[s], s, DT_EAW_WEIGHT_SHARPEN, sharp[s], width, height);
+    if(s == 0) buf1 = out;
+    float *buf3 = buf2;
+    buf2 = buf1;
+    buf1 = buf3;
+  }
+  dt_eaw_add(out, buf1, acc, width, height);
+  double t3 = get_time();
+
+  double maxerr = 0.0;
+  for(size_t k=0; k<(size_t)width*height; k++) for(int c=0; c<3; c++)
+      maxerr = fmax(maxerr, fabs(ref[4*k+c] - out[4*k+c]));
+  fprintf(stderr, "[eaw] %dx%d, %d scales: per level %7.3fs %zu MB, fused %7.3fs %zu MB (%.2fx), max error %g\n",
+          width, height, scales, t1-t0, ((3+scales)*size)>>20, t3-t2, (4*size)>>20, (t1-t0)/(t3-t2), maxerr);
+  // only the order of the additions differs:
+  assert(maxerr < 1e-3);
+
+  _mm_free(acc);
+  _mm_free(out);
+  _mm_free(tmp);
+  _mm_free(ref);
+  _mm_free(in);
+  fprintf(stderr, "[passed] fused wavelet reconstruction matches\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,213 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for the export encoders: times the float to 8/16 bit conversion
+// against the plain loops, the png idat stream (filtering and deflate) and the
+// tiff strips serially and on all threads, and checks that the results decode
+// to the same data. the tiffs are read back through libtiff, in both byte orders.
+#define _XOPEN_SOURCE 500
+#include "common/imageio_deflate.h"
+#include "common/imageio_tiff_strips.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#define CLAMP(a, mn, mx) ((a) < (mn) ? (mn) : ((a) > (mx) ? (mx) : (a)))
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+// writes a 16 bit tiff the way the tiff format does, in the given byte order ("wb" or "wl").
+static int _tiff_write(const char *filename, const char *mode, const uint16_t *in, const int width, const int height)
+{
+  TIFF *tif = TIFFOpen(filename, mode);
+  if(!tif) return 1;
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_DEFLATE);
+  TIFFSetField(tif, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB);
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_PREDICTOR, 1);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 64);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+  const int err = dt_imageio_tiff_write_strips(tif, in, width, height, 16, 64, 9);
+  TIFFClose(tif);
+  return err;
+}
+
+// reads the tiff back through libtiff and compares every sample.
+static void _tiff_check(const char *filename, const uint16_t *in, const int width, const int height)
+{
+  TIFF *tif = TIFFOpen(filename, "r");
+  assert(tif);
+  uint32_t wd = 0, ht = 0;
+  uint16_t bps = 0, spp = 0;
+  TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &wd);
+  TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &ht);
+  TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  assert(wd == (uint32_t)width && ht == (uint32_t)height && bps == 16 && spp == 3);
+  uint16_t *row = (uint16_t *)malloc(TIFFScanlineSize(tif));
+  for(int y=0; y<height; y++)
+  {
+    int res = TIFFReadScanline(tif, row, y, 0);
+    assert(res == 1);
+    (void)res;
+    for(int x=0; x<width; x++) for(int k=0; k<3; k++)
+        if(row[3*x+k] != in[4*((size_t)width*y+x)+k])
+        {
+          fprintf(stderr, "[encode] %s: pixel %d %d channel %d is %d, should be %d\n", filename, x, y, k,
+                  row[3*x+k], in[4*((size_t)width*y+x)+k]);
+          assert(0);
+        }
+  }
+  free(row);
+  TIFFClose(tif);
+}
+
+int main(int argc, char *arg[])
+{
+  const int width  = argc > 1 ? atoi(arg[1]) : 3000;
+  const int height = argc > 2 ? atoi(arg[2]) : 2000;
+  const size_t n = (size_t)width*height;
+#ifdef _OPENMP
+  const int threads = omp_get_max_threads();
+#else
+  const int threads = 1;
+#endif
+  fprintf(stderr, "[encode] %dx%d pixels, %d threads\n", width, height, threads);
+
+  // smooth gradients plus some noise, roughly like a photograph:
+  float *img = (float *)malloc(sizeof(float)*4*n);
+  srand(1);
+  for(int j=0; j<height; j++) for(int i=0; i<width; i++) for(int c=0; c<4; c++)
+        img[4*((size_t)j*width+i)+c] = 0.5f + 0.45f*sinf(i*0.003f*(c+1))*cosf(j*0.002f)
+                                     + 0.02f*(rand()/(float)RAND_MAX - 0.5f) + (c == 1 ? 0.1f : 0.0f);
+
+  // conversion to 8 and 16 bits:
+  float *buf = (float *)malloc(sizeof(float)*4*n);
+  uint8_t *ref8 = (uint8_t *)malloc(4*n);
+  uint16_t *ref16 = (uint16_t *)malloc(sizeof(uint16_t)*4*n);
+  double t0 = get_time();
+  for(size_t k=0; k<n; k++) for(int c=0; c<3; c++) ref8[4*k+c] = CLAMP(img[4*k+c]*0xff, 0, 0xff);
+  double t1 = get_time();
+  memcpy(buf, img, sizeof(float)*4*n);
+  double t2 = get_time();
+  dt_imageio_float_to_8(buf, (uint8_t *)buf, n);
+  double t3 = get_time();
+  for(size_t k=0; k<n; k++) for(int c=0; c<3; c++) assert(((uint8_t *)buf)[4*k+c] == ref8[4*k+c]);
+  fprintf(stderr, "[encode] float to  8 bit: plain %7.3fs sse in place %7.3fs (%.1fx)\n", t1-t0, t3-t2, (t1-t0)/(t3-t2));
+
+  t0 = get_time();
+  for(size_t k=0; k<n; k++) for(int c=0; c<3; c++) ref16[4*k+c] = CLAMP(img[4*k+c]*0x10000, 0, 0xffff);
+  t1 = get_time();
+  memcpy(buf, img, sizeof(float)*4*n);
+  t2 = get_time();
+  dt_imageio_float_to_16(buf, (uint16_t *)buf, n);
+  t3 = get_time();
+  for(size_t k=0; k<n; k++) for(int c=0; c<3; c++) assert(((uint16_t *)buf)[4*k+c] == ref16[4*k+c]);
+  fprintf(stderr, "[encode] float to 16 bit: plain %7.3fs sse in place %7.3fs (%.1fx)\n", t1-t0, t3-t2, (t1-t0)/(t3-t2));
+
+  // png: 8 bit rgb rows, filtered, one zlib stream.
+  const size_t rowbytes = 3*(size_t)width;
+  uint8_t *rows = (uint8_t *)malloc(rowbytes*height);
+  for(size_t k=0; k<n; k++) for(int c=0; c<3; c++) rows[3*k+c] = ref8[4*k+c];
+  uint8_t *filtered = (uint8_t *)malloc((rowbytes+1)*height);
+  const size_t flen = (rowbytes+1)*height;
+  t0 = get_time();
+  dt_imageio_png_filter(rows, filtered, height, rowbytes, 3);
+  t1 = get_time();
+  uLongf slen = compressBound(flen);
+  uint8_t *serial = (uint8_t *)malloc(slen);
+  int res = compress2(serial, &slen, filtered, flen, Z_BEST_COMPRESSION);
+  assert(res == Z_OK);
+  t2 = get_time();
+  size_t plen = 0;
+  uint8_t *parallel = dt_imageio_deflate(filtered, flen, Z_BEST_COMPRESSION, &plen);
+  t3 = get_time();
+  assert(parallel);
+  // must inflate to the very same bytes, checksum included:
+  uint8_t *check = (uint8_t *)malloc(flen);
+  uLongf clen = flen;
+  res = uncompress(check, &clen, parallel, plen);
+  assert(res == Z_OK && clen == flen && !memcmp(check, filtered, flen));
+  (void)res;
+  fprintf(stderr, "[encode] png filter %7.3fs, deflate: serial %7.3fs %zu bytes, parallel %7.3fs %zu bytes (%.1fx, %+.2f%% size)\n",
+          t1-t0, t2-t1, (size_t)slen, t3-t2, plen, (t2-t1)/(t3-t2), 100.0*((double)plen/slen - 1.0));
+
+  // tiff: 16 bit strips of 64 rows, deflated independently. big endian like the tiff format
+  // writes them, which has to swap the samples on little endian hosts, and native byte order:
+  char filename[] = "/tmp/dt_encode_XXXXXX";
+  const int fd = mkstemp(filename);
+  assert(fd >= 0);
+  close(fd);
+#ifdef _OPENMP
+  omp_set_num_threads(1);
+#endif
+  t0 = get_time();
+  res = _tiff_write(filename, "wb", ref16, width, height);
+  t1 = get_time();
+  assert(!res);
+  _tiff_check(filename, ref16, width, height);
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  t2 = get_time();
+  res = _tiff_write(filename, "wb", ref16, width, height);
+  t3 = get_time();
+  assert(!res);
+  _tiff_check(filename, ref16, width, height);
+  res = _tiff_write(filename, "wl", ref16, width, height);
+  assert(!res);
+  _tiff_check(filename, ref16, width, height);
+  unlink(filename);
+  fprintf(stderr, "[encode] tiff 16 bit strips: serial %7.3fs parallel %7.3fs (%.1fx), read back through libtiff\n",
+          t1-t0, t3-t2, (t1-t0)/(t3-t2));
+
+  free(check);
+  free(parallel);
+  free(serial);
+  free(filtered);
+  free(rows);
+  free(ref16);
+  free(ref8);
+  free(buf);
+  free(img);
+  fprintf(stderr, "[passed] encoders produce the same data\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
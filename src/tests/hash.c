@@ -0,0 +1,228 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// test for the pixelpipe cache keys built with common/hash.h: random walks through
+// histories of a long pipe with multi-instances, one slider step at a time. the
+// prefix hashes are updated from the changed node on, the way
+// dt_dev_pixelpipe_cache_update_chain() does, and checked against hashing all
+// prefixes from scratch. all cache keys of distinct pipe states are checked for
+// collisions, and the time is compared to the djb2 walk over all nodes per key.
+#include "common/hash.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#define NODES 48
+#define PARAMS 24
+#define ROIS 3
+
+typedef struct roi_t
+{
+  int x, y, width, height;
+  float scale;
+}
+roi_t;
+
+typedef struct key_t
+{
+  uint64_t hash;
+  uint64_t state; // distinct for distinct pipe prefix and roi
+}
+key_t;
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+// exact map (prefix state, node params) -> prefix state, so that equal pipe prefixes get the same id.
+static uint64_t *trie_key;
+static uint32_t *trie_val;
+static uint32_t trie_mask, trie_size;
+
+static uint32_t trie_get(const uint32_t parent, const uint32_t sym)
+{
+  const uint64_t key = ((uint64_t)parent << 32) | sym;
+  for(uint32_t b = dt_hash64_finish(key) & trie_mask;; b = (b + 1) & trie_mask)
+  {
+    if(!trie_val[b])
+    {
+      trie_key[b] = key;
+      trie_val[b] = ++trie_size;
+      assert(trie_size < trie_mask/2);
+      return trie_val[b];
+    }
+    if(trie_key[b] == key) return trie_val[b];
+  }
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+  const key_t *ka = (const key_t *)a, *kb = (const key_t *)b;
+  if(ka->hash != kb->hash) return ka->hash < kb->hash ? -1 : 1;
+  return (ka->state > kb->state) - (ka->state < kb->state);
+}
+
+// what dt_iop_commit_params() stores in piece->hash, and what the piece adds to the chain:
+static uint64_t piece_key(const char *op, const float *params)
+{
+  uint64_t hash = dt_hash64_add_data(DT_HASH64_INIT, op, strlen(op));
+  hash = dt_hash64_finish(dt_hash64_add_data(hash, params, sizeof(float)*PARAMS));
+  return dt_hash64_finish(dt_hash64_add(DT_HASH64_INIT, hash));
+}
+
+static uint64_t cache_key(const uint64_t chain, const int imgid, const roi_t *roi)
+{
+  return dt_hash64_finish(dt_hash64_add_data(dt_hash64_add(chain, imgid), roi, sizeof(roi_t)));
+}
+
+// the old way: djb2 over the params, and for every key over all nodes before it and the roi bytes.
+static uint64_t djb2_piece(const float *params)
+{
+  uint64_t hash = 5381;
+  const char *str = (const char *)params;
+  for(size_t i=0; i<sizeof(float)*PARAMS; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+static uint64_t djb2_key(const uint64_t *piece, const int module, const int imgid, const roi_t *roi)
+{
+  uint64_t hash = 5381 + imgid;
+  for(int k=0; k<module; k++) hash = ((hash << 5) + hash) ^ piece[k];
+  const char *str = (const char *)roi;
+  for(size_t i=0; i<sizeof(roi_t); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+int main(int argc, char *arg[])
+{
+  const int steps = argc > 1 ? atoi(arg[1]) : 20000;
+  const char *ops[] = { "rawprepare", "temperature", "highlights", "demosaic", "exposure", "colorin", "basecurve",
+                        "tonecurve", "levels", "shadhi", "colorzones", "atrous", "bilat", "spots", "lens", "clipping",
+                        "sharpen", "colorout", "gamma" };
+  const int num_ops = sizeof(ops)/sizeof(ops[0]);
+  const roi_t rois[ROIS] = { { 0, 0, 1000, 667, 0.16f }, { 0, 0, 1000, 667, 0.1666f }, { 1200, 800, 1000, 667, 1.0f } };
+
+  trie_mask = (1u << 24) - 1;
+  trie_key = (uint64_t *)calloc(trie_mask + 1, sizeof(uint64_t));
+  trie_val = (uint32_t *)calloc(trie_mask + 1, sizeof(uint32_t));
+
+  // a long pipe with some modules instanced several times, all params starting out the same:
+  const char *op[NODES];
+  float params[NODES][PARAMS];
+  uint32_t sym[NODES];
+  uint32_t syms = 0;
+  srand(1);
+  for(int k=0; k<NODES; k++)
+  {
+    op[k] = ops[k < num_ops ? k : rand() % num_ops];
+    for(int i=0; i<PARAMS; i++) params[k][i] = 0.5f;
+    sym[k] = ++syms;
+  }
+
+  uint64_t chain[NODES+1], key[NODES], state[NODES+1], djb2[NODES];
+  const size_t max_keys = (size_t)(steps + 1)*NODES*ROIS;
+  key_t *keys = (key_t *)malloc(sizeof(key_t)*max_keys);
+  size_t num_keys = 0;
+
+  chain[0] = DT_HASH64_INIT;
+  state[0] = 0;
+  int first = 0;
+  double t_chain = 0.0, t_djb2 = 0.0;
+  uint64_t sink = 0;
+  for(int s=0; s<=steps; s++)
+  {
+    if(s)
+    {
+      // move one slider one step. the counter makes every state distinct, but only by a little:
+      first = rand() % NODES;
+      params[first][rand() % PARAMS] = 0.5f + ((s % 2048) - 1024)/1024.0f;
+      params[first][0] = s/1048576.0f;
+      sym[first] = ++syms;
+    }
+
+    // incremental, from the first changed node on:
+    double t0 = get_time();
+    for(int k=first; k<NODES; k++)
+    {
+      key[k] = piece_key(op[k], params[k]);
+      chain[k+1] = dt_hash64_add(chain[k], key[k]);
+    }
+    for(int k=1; k<=NODES; k++) for(int r=0; r<ROIS; r++) sink ^= cache_key(chain[k], 42, rois + r);
+    double t1 = get_time();
+    t_chain += t1 - t0;
+
+    // the old way, every key walks all nodes before it:
+    for(int k=first; k<NODES; k++) djb2[k] = djb2_piece(params[k]);
+    for(int k=1; k<=NODES; k++) for(int r=0; r<ROIS; r++) sink ^= djb2_key(djb2, k, 42, rois + r);
+    t_djb2 += get_time() - t1;
+
+    // from scratch, to check the incremental update:
+    if(s % 97 == 0)
+    {
+      uint64_t full = DT_HASH64_INIT;
+      for(int k=0; k<NODES; k++)
+      {
+        full = dt_hash64_add(full, piece_key(op[k], params[k]));
+        assert(full == chain[k+1]);
+      }
+    }
+
+    // keys of the prefixes which are new in this state:
+    for(int k=first; k<NODES; k++)
+    {
+      state[k+1] = trie_get(state[k], sym[k]);
+      for(int r=0; r<ROIS; r++)
+      {
+        keys[num_keys].hash = cache_key(chain[k+1], 42, rois + r);
+        keys[num_keys].state = state[k+1]*ROIS + r;
+        num_keys++;
+      }
+    }
+  }
+
+  qsort(keys, num_keys, sizeof(key_t), compare_keys);
+  size_t distinct = 0, collisions = 0;
+  for(size_t k=0; k<num_keys; k++)
+  {
+    if(k && keys[k].state == keys[k-1].state) continue; // same pipe state seen again
+    distinct++;
+    if(k && keys[k].hash == keys[k-1].hash) collisions++;
+  }
+
+  fprintf(stderr, "[hash] %d steps through a pipe of %d nodes: %zu distinct cache keys, %zu collisions\n",
+          steps, NODES, distinct, collisions);
+  fprintf(stderr, "[hash] djb2 over all nodes per key %7.3fs, prefix chain %7.3fs (%.1fx) [%"PRIx64"]\n",
+          t_djb2, t_chain, t_djb2/t_chain, sink);
+  assert(collisions == 0);
+
+  free(keys);
+  free(trie_val);
+  free(trie_key);
+  fprintf(stderr, "[passed] incremental prefix hashes match, no collisions\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,164 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// test for common/histogram.h: bins an rgb and a Lab buffer and an 8-bit display
+// buffer at full resolution, checks every bin against a plain scalar loop and
+// compares the time to the loops sampling one out of 16 pixels the pixelpipe used.
+#include "common/histogram.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#define BINS 64
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+static int bin(const float v, const float offset, const float scale)
+{
+  const float b = (v + offset)*(scale*BINS);
+  return b > 0.0f ? (b < BINS - 1 ? (int)b : BINS - 1) : 0;
+}
+
+// every pixel, one at a time:
+static void reference_f(float *hist, const float *in, const int width, const int height,
+                        const float *offset, const float *scale, const int max)
+{
+  memset(hist, 0, sizeof(float)*4*BINS);
+  for(size_t k=0; k<(size_t)width*height; k++)
+  {
+    int b[3];
+    for(int c=0; c<3; c++)
+    {
+      b[c] = bin(in[4*k+c], offset[c], scale[c]);
+      hist[4*b[c] + c]++;
+    }
+    if(max) hist[4*(b[0] > b[1] ? (b[0] > b[2] ? b[0] : b[2]) : (b[1] > b[2] ? b[1] : b[2])) + 3]++;
+  }
+}
+
+// what histogram_collect() in pixelpipe_hb.c used to do for rgb:
+static void sampled_rgb(float *hist, const float *pixel, const int width, const int height)
+{
+  memset(hist, 0, sizeof(float)*4*BINS);
+  for(int j=0; j<height; j+=4) for(int i=0; i<width; i+=4)
+    {
+      const float *p = pixel + 4*((size_t)j*width+i);
+      const float g = fmaxf(p[0], fmaxf(p[1], p[2]));
+      hist[4*bin(p[0], 0.0f, 1.0f)]++;
+      hist[4*bin(p[1], 0.0f, 1.0f) + 1]++;
+      hist[4*bin(p[2], 0.0f, 1.0f) + 2]++;
+      hist[4*bin(g, 0.0f, 1.0f) + 3]++;
+    }
+}
+
+static void check(const float *a, const float *b, const char *what)
+{
+  for(int k=0; k<4*BINS; k++)
+    if(a[k] != b[k])
+    {
+      fprintf(stderr, "[histogram] %s: bin %d channel %d is %g, should be %g\n", what, k/4, k%4, a[k], b[k]);
+      assert(0);
+    }
+}
+
+int main(int argc, char *arg[])
+{
+  const int width  = argc > 1 ? atoi(arg[1]) : 1500;
+  const int height = argc > 2 ? atoi(arg[2]) : 1000;
+  const int runs = 20;
+
+  float *rgb = (float *)malloc(sizeof(float)*4*width*height);
+  float *lab = (float *)malloc(sizeof(float)*4*width*height);
+  uint8_t *bgra = (uint8_t *)malloc(4*width*height);
+  srand(1);
+  for(size_t k=0; k<(size_t)width*height; k++)
+  {
+    // some values out of range, on bin edges and nan, to check the clamping:
+    for(int c=0; c<3; c++) rgb[4*k+c] = 1.2f*rand()/(float)RAND_MAX - 0.1f;
+    if(k % 1001 == 0) rgb[4*k] = NAN;
+    if(k % 777 == 0) rgb[4*k+1] = 17.0f/BINS;
+    rgb[4*k+3] = 0.0f;
+    lab[4*k+0] = 110.0f*rand()/(float)RAND_MAX - 5.0f;
+    lab[4*k+1] = 300.0f*rand()/(float)RAND_MAX - 150.0f;
+    lab[4*k+2] = 80.0f*rand()/(float)RAND_MAX - 40.0f;
+    lab[4*k+3] = 0.0f;
+    for(int c=0; c<4; c++) bgra[4*k+c] = rand() & 0xff;
+  }
+
+  float hist[4*BINS], ref[4*BINS];
+  const float zero[3] = { 0.0f, 0.0f, 0.0f }, one[3] = { 1.0f, 1.0f, 1.0f };
+  const float lab_offset[3] = { 0.0f, 128.0f, 128.0f }, lab_scale[3] = { 1.0f/100.0f, 1.0f/256.0f, 1.0f/256.0f };
+
+  dt_histogram_collect_f(hist, BINS, rgb, width, height, 4*width, zero, one, DT_HISTOGRAM_RGB_MAX);
+  reference_f(ref, rgb, width, height, zero, one, 1);
+  check(hist, ref, "rgb");
+
+  dt_histogram_collect_f(hist, BINS, lab, width, height, 4*width, lab_offset, lab_scale, DT_HISTOGRAM_RGB);
+  reference_f(ref, lab, width, height, lab_offset, lab_scale, 0);
+  for(int k=0; k<BINS; k++) ref[4*k+3] = 0.0f;
+  check(hist, ref, "Lab");
+
+  // the first channel alone, of a window into the buffer:
+  dt_histogram_collect_f(hist, BINS, rgb + 4*(10*width + 20), width/2, height/2, 4*width, zero, one, DT_HISTOGRAM_FIRST);
+  memset(ref, 0, sizeof(ref));
+  for(int j=10; j<10+height/2; j++) for(int i=20; i<20+width/2; i++) ref[4*bin(rgb[4*((size_t)j*width+i)], 0.0f, 1.0f)]++;
+  check(hist, ref, "raw window");
+
+  const int box[4] = { 3, 5, width-7, height-2 };
+  dt_histogram_collect_8(hist, BINS, bgra, width, box);
+  memset(ref, 0, sizeof(ref));
+  for(int j=box[1]; j<=box[3]; j++) for(int i=box[0]; i<=box[2]; i++)
+    {
+      const uint8_t *p = bgra + 4*((size_t)j*width+i);
+      const int r = p[2] >> 2, g = p[1] >> 2, b = p[0] >> 2;
+      ref[4*r]++;
+      ref[4*g+1]++;
+      ref[4*b+2]++;
+      ref[4*(r > g ? (r > b ? r : b) : (g > b ? g : b))+3]++;
+    }
+  check(hist, ref, "8-bit");
+
+  double t0 = get_time();
+  for(int r=0; r<runs; r++) sampled_rgb(ref, rgb, width, height);
+  double t1 = get_time();
+  for(int r=0; r<runs; r++) dt_histogram_collect_f(hist, BINS, rgb, width, height, 4*width, zero, one, DT_HISTOGRAM_RGB_MAX);
+  double t2 = get_time();
+  for(int r=0; r<runs; r++) reference_f(ref, rgb, width, height, zero, one, 1);
+  double t3 = get_time();
+  fprintf(stderr, "[histogram] %dx%d rgb: 1/16 sampled %7.3fms, all pixels %7.3fms (%d threads), all pixels scalar %7.3fms\n",
+          width, height, 1000.0*(t1-t0)/runs, 1000.0*(t2-t1)/runs, _dt_histogram_threads(), 1000.0*(t3-t2)/runs);
+
+  free(bgra);
+  free(lab);
+  free(rgb);
+  fprintf(stderr, "[passed] full resolution histograms match\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
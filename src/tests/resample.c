@@ -0,0 +1,175 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2014 the darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for dt_interpolation_resample(): compares the direct 2d kernel it used
+// to evaluate per output pixel with the separable version in common/resample.h for
+// the usual downscale ratios (lanczos3), and checks that both give the same image.
+#include "common/resample.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static double get_time()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + (1.0/1000000.0)*time.tv_usec;
+}
+
+static float lanczos3(float t)
+{
+  t = fabsf(t);
+  if(t < 1e-6f) return 1.0f;
+  if(t >= 3.0f) return 0.0f;
+  return 3.0f*sinf(M_PI*t)*sinf(M_PI*t/3.0f)/(M_PI*M_PI*t*t);
+}
+
+// same layout as prepare_resampling_plan() in common/interpolation.c, replicated borders.
+static void build_plan(dt_resample_plan_t *p, const int in, const int out, const float scale)
+{
+  const float support = scale < 1.0f ? 3.0f/scale : 3.0f;
+  const int maxtaps = 2*(int)ceilf(support) + 2;
+  p->out = out;
+  p->length = (int *)malloc(sizeof(int)*out);
+  p->meta = (int *)malloc(sizeof(int)*3*out);
+  p->kernel = (float *)malloc(sizeof(float)*maxtaps*out);
+  p->index = (int *)malloc(sizeof(int)*maxtaps*out);
+  int k = 0;
+  for(int x=0; x<out; x++)
+  {
+    const float c = (x + 0.5f)/scale - 0.5f;
+    const int first = (int)ceilf(c - support), last = (int)floorf(c + support);
+    p->meta[3*x+0] = x;
+    p->meta[3*x+1] = k;
+    p->meta[3*x+2] = k;
+    float norm = 0.0f;
+    const int k0 = k;
+    for(int i=first; i<=last; i++)
+    {
+      const float w = lanczos3((i - c)*(scale < 1.0f ? scale : 1.0f));
+      if(w == 0.0f) continue;
+      p->kernel[k] = w;
+      p->index[k] = i < 0 ? 0 : (i >= in ? in-1 : i);
+      norm += w;
+      k++;
+    }
+    for(int i=k0; i<k; i++) p->kernel[i] /= norm;
+    p->length[x] = k - k0;
+  }
+}
+
+static void free_plan(dt_resample_plan_t *p)
+{
+  free(p->length);
+  free(p->meta);
+  free(p->kernel);
+  free(p->index);
+}
+
+// the loop dt_interpolation_resample() used to run: all taps of the 2d kernel per output pixel.
+static void resample_direct(float *out, const int out_stride, const float *const in, const int in_stride,
+                            const dt_resample_plan_t *h, const dt_resample_plan_t *v)
+{
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int oy=0; oy<v->out; oy++)
+  {
+    const int vl = v->length[oy];
+    const float *vkernel = v->kernel + v->meta[3*oy+1];
+    const int *vindex = v->index + v->meta[3*oy+2];
+    int hidx = 0;
+    for(int ox=0; ox<h->out; ox++)
+    {
+      const int hl = h->length[ox];
+      __m128 vs = _mm_setzero_ps();
+      for(int iy=0; iy<vl; iy++)
+      {
+        const float *i = (const float *)((const char *)in + (size_t)in_stride*vindex[iy]);
+        __m128 vhs = _mm_setzero_ps();
+        for(int ix=0; ix<hl; ix++)
+          vhs = _mm_add_ps(vhs, _mm_mul_ps(_mm_load_ps(i + 4*h->index[hidx+ix]), _mm_set1_ps(h->kernel[hidx+ix])));
+        vs = _mm_add_ps(vs, _mm_mul_ps(vhs, _mm_set1_ps(vkernel[iy])));
+      }
+      _mm_stream_ps((float *)((char *)out + (size_t)out_stride*oy) + 4*ox, vs);
+      hidx += hl;
+    }
+  }
+  _mm_sfence();
+}
+
+int main(int argc, char *arg[])
+{
+  const int width  = argc > 1 ? atoi(arg[1]) : 6000;
+  const int height = argc > 2 ? atoi(arg[2]) : 4000;
+  const float scales[] = { 0.5f, 1.0f/3.0f, 0.25f, 0.125f, 1.5f };
+  const int nscales = sizeof(scales)/sizeof(scales[0]);
+
+  float *in = (float *)_mm_malloc(sizeof(float)*4*width*height, 16);
+  srand(1);
+  for(int j=0; j<height; j++) for(int i=0; i<width; i++) for(int c=0; c<4; c++)
+        in[4*((size_t)j*width+i)+c] = 0.5f + 0.4f*sinf(i*0.01f*(c+1))*cosf(j*0.007f) + 0.05f*(rand()/(float)RAND_MAX - 0.5f);
+
+  fprintf(stderr, "[resample] %dx%d pixels, lanczos3\n", width, height);
+  for(int s=0; s<nscales; s++)
+  {
+    const float scale = scales[s];
+    // keep the upscaled output at a sane size:
+    const int iw = scale > 1.0f ? width/4 : width, ih = scale > 1.0f ? height/4 : height;
+    const int ow = iw*scale, oh = ih*scale;
+    dt_resample_plan_t h, v;
+    double t0 = get_time();
+    build_plan(&h, iw, ow, scale);
+    build_plan(&v, ih, oh, scale);
+    double t1 = get_time();
+
+    float *ref  = (float *)_mm_malloc(sizeof(float)*4*ow*oh, 16);
+    float *fast = (float *)_mm_malloc(sizeof(float)*4*ow*oh, 16);
+    resample_direct(ref, 4*sizeof(float)*ow, in, 4*sizeof(float)*width, &h, &v);
+    double t2 = get_time();
+    const int err = dt_resample_separable(fast, 4*sizeof(float)*ow, in, 4*sizeof(float)*width, &h, &v);
+    assert(!err);
+    double t3 = get_time();
+
+    float maxerr = 0.0f;
+    for(size_t k=0; k<(size_t)4*ow*oh; k++) maxerr = fmaxf(maxerr, fabsf(ref[k] - fast[k]));
+    fprintf(stderr, "[resample] scale %.3f -> %5dx%-5d plan %7.4fs direct %7.3fs separable %7.3fs (%.1fx) max err %g\n",
+            scale, ow, oh, t1-t0, t2-t1, t3-t2, (t2-t1)/(t3-t2), maxerr);
+    assert(maxerr < 1e-5f);
+
+    _mm_free(fast);
+    _mm_free(ref);
+    free_plan(&v);
+    free_plan(&h);
+  }
+  _mm_free(in);
+  fprintf(stderr, "[passed] separable resampling matches the direct kernel\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -145,7 +145,7 @@ void expose(dt_view_t *self, cairo_t *cri, int32_t width_i, int32_t height_i, in
     dev->gui_synch = 0;
   }
 
-  if(dev->image_dirty || dev->pipe->input_timestamp < dev->preview_pipe->input_timestamp) dt_dev_process_image(dev);
+  if(dev->image_dirty || dev->image_damaged || dev->pipe->input_timestamp < dev->preview_pipe->input_timestamp) dt_dev_process_image(dev);
   if(dev->preview_dirty || dev->pipe->input_timestamp > dev->preview_pipe->input_timestamp) dt_dev_process_preview(dev);
 
   dt_pthread_mutex_t *mutex = NULL;
@@ -832,8 +832,9 @@ export_key_accel_callback(GtkAccelGroup *accel_group,
   g_free(format_name);
   g_free(storage_name);
   gboolean high_quality = dt_conf_get_bool("plugins/lighttable/export/high_quality_processing");
+  gboolean demosaic_half_size = dt_conf_get_bool("plugins/lighttable/export/demosaic_half_size");
   char *style = dt_conf_get_string("plugins/lighttable/export/style");
-  dt_control_export(dt_collection_get_selected(darktable.collection),max_width, max_height, format_index, storage_index, high_quality,style);
+  dt_control_export(dt_collection_get_selected(darktable.collection),max_width, max_height, format_index, storage_index, high_quality, demosaic_half_size, style);
   return TRUE;
 }
 
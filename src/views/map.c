@@ -58,6 +58,7 @@ typedef struct dt_map_image_t
   gint imgid;
   OsmGpsMapImage *image;
   gint width, height;
+  gint count; // > 1 for a cluster of images, imgid is one of them
 } dt_map_image_t;
 
 static const int thumb_size = 64, thumb_border = 1, pin_size = 13;
@@ -177,19 +178,8 @@ void init(dt_view_t *self)
     g_signal_connect(GTK_WIDGET(lib->map), "drag-failed", G_CALLBACK(_view_map_dnd_failed_callback), self);
   }
 
-  /* build the query string */
-  int max_images_drawn = dt_conf_get_int("plugins/map/max_images_drawn");
-  if(max_images_drawn == 0)
-    max_images_drawn = 100;
-  char *geo_query = g_strdup_printf("select * from (select id, latitude from images where \
-                              longitude >= ?1 and longitude <= ?2 and latitude <= ?3 and latitude >= ?4 \
-                              and longitude not NULL and latitude not NULL order by abs(latitude - ?5), abs(longitude - ?6) \
-                              limit 0, %d) order by (180 - latitude), id", max_images_drawn);
-
-  /* prepare the main query statement */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), geo_query, -1, &lib->statements.main_query, NULL);
-
-  g_free(geo_query);
+  /* the main query is prepared on first enter(), together with the spatial index */
+  lib->statements.main_query = NULL;
 }
 
 void cleanup(dt_view_t *self)
@@ -200,9 +190,109 @@ void cleanup(dt_view_t *self)
     g_object_unref(G_OBJECT(lib->pin));
     g_object_unref(G_OBJECT(lib->osd));
   }
+  if(lib->statements.main_query)
+    sqlite3_finalize(lib->statements.main_query);
   free(self->data);
 }
 
+/* r-tree over the geotagged images in the in-memory database. temporary triggers on the
+   images table keep it up to date on import, geotagging and removal of images. returns
+   FALSE if sqlite was built without the rtree module. */
+static gboolean _view_map_build_index()
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  const double start = dt_get_wtime();
+
+  if(sqlite3_exec(db, "create virtual table memory.map_index using rtree(id, min_lon, max_lon, min_lat, max_lat)",
+                  NULL, NULL, NULL) != SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_SQL, "[map] no spatial index, sqlite lacks the rtree module: %s\n", sqlite3_errmsg(db));
+    return FALSE;
+  }
+
+  dt_database_start_transaction(darktable.db);
+  DT_DEBUG_SQLITE3_EXEC(db, "insert into memory.map_index select id, longitude, longitude, latitude, latitude "
+                        "from main.images where longitude not null and latitude not null", NULL, NULL, NULL);
+  // table names inside triggers can't be qualified, map_index is only found in the memory database.
+  DT_DEBUG_SQLITE3_EXEC(db, "create temp trigger map_index_insert after insert on main.images "
+                        "when new.longitude not null and new.latitude not null begin "
+                        "insert into map_index values (new.id, new.longitude, new.longitude, new.latitude, new.latitude); end",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "create temp trigger map_index_update after update of longitude, latitude on main.images "
+                        "when old.longitude is not new.longitude or old.latitude is not new.latitude begin "
+                        "delete from map_index where id = old.id; "
+                        "insert into map_index select new.id, new.longitude, new.longitude, new.latitude, new.latitude "
+                        "where new.longitude not null and new.latitude not null; end",
+                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "create temp trigger map_index_delete after delete on main.images begin "
+                        "delete from map_index where id = old.id; end", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
+
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF, "[map] built spatial index in %.3f secs\n", dt_get_wtime() - start);
+  return TRUE;
+}
+
+/* the main query returns one row per marker: images falling into the same cell of a grid
+   with cells of ?5 x ?6 degrees are grouped, so zoomed out views show a few markers with
+   counts instead of an arbitrary subset of the images. ?7 turns the grouping off at the
+   highest zoom level, images at the very same position could not be told apart otherwise. */
+static void _view_map_prepare_query(dt_map_t *lib)
+{
+  int max_images_drawn = dt_conf_get_int("plugins/map/max_images_drawn");
+  if(max_images_drawn == 0)
+    max_images_drawn = 100;
+
+  const char *points = _view_map_build_index()
+                       ? "select id, (min_lon + max_lon) * 0.5 as lon, (min_lat + max_lat) * 0.5 as lat from memory.map_index "
+                         "where max_lon >= ?1 and min_lon <= ?2 and min_lat <= ?3 and max_lat >= ?4"
+                       : "select id, longitude as lon, latitude as lat from images "
+                         "where longitude >= ?1 and longitude <= ?2 and latitude <= ?3 and latitude >= ?4 "
+                         "and longitude not NULL and latitude not NULL";
+
+  // the grid is anchored to the corner of the world, not to the viewport, so clusters stay put while panning.
+  // both offsets are positive there, so the cast rounds down like floor() would.
+  char *geo_query = g_strdup_printf("select * from (select min(id), count(*), avg(lon), avg(lat) as clat from (%s) "
+                                    "group by cast((lon + 180) / ?5 as integer), cast((90 - lat) / ?6 as integer), "
+                                    "case when ?7 then id end "
+                                    "order by count(*) desc limit 0, %d) order by (180 - clat), 1",
+                                    points, max_images_drawn);
+
+  /* prepare the main query statement */
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), geo_query, -1, &lib->statements.main_query, NULL);
+
+  g_free(geo_query);
+}
+
+/* draws the number of images of a cluster across the top of its thumbnail */
+static void _view_map_draw_count(GdkPixbuf *thumb, const int w, const int count)
+{
+  const int h = 16;
+  char text[16];
+  snprintf(text, sizeof(text), "%d", count);
+
+  cairo_surface_t *cst = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+  cairo_t *cr = cairo_create(cst);
+  cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.6);
+  cairo_paint(cr);
+  cairo_select_font_face(cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+  cairo_set_font_size(cr, 11);
+  cairo_text_extents_t ext;
+  cairo_text_extents(cr, text, &ext);
+  cairo_move_to(cr, .5*(w - ext.width) - ext.x_bearing, .5*(h - ext.height) - ext.y_bearing);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_show_text(cr, text);
+  cairo_destroy(cr);
+  cairo_surface_flush(cst);
+
+  uint8_t *data = cairo_image_surface_get_data(cst);
+  dt_draw_cairo_to_gdk_pixbuf(data, w, h);
+  GdkPixbuf *badge = gdk_pixbuf_new_from_data(data, GDK_COLORSPACE_RGB, TRUE, 8, w, h, w*4, NULL, NULL);
+  gdk_pixbuf_composite(badge, thumb, thumb_border, thumb_border, w, h, thumb_border, thumb_border,
+                       1.0, 1.0, GDK_INTERP_NEAREST, 255);
+  g_object_unref(badge);
+  cairo_surface_destroy(cst);
+}
+
 void configure(dt_view_t *self, int wd, int ht)
 {
   //dt_capture_t *lib=(dt_capture_t*)self->data;
@@ -225,6 +315,9 @@ static void _view_map_changed_callback(OsmGpsMap *map, dt_view_t *self)
 {
   dt_map_t *lib = (dt_map_t *)self->data;
 
+  /* not entered yet */
+  if(!lib->statements.main_query) return;
+
   OsmGpsMapPoint bb[2];
 
   /* get bounding box coords */
@@ -245,13 +338,19 @@ static void _view_map_changed_callback(OsmGpsMap *map, dt_view_t *self)
   double south_border = lat0 - lat1, west_border = lon1 - lon0;
 
   /* get map view state and store  */
-  int zoom;
+  int zoom, max_zoom;
   float center_lat, center_lon;
-  g_object_get(G_OBJECT(map), "zoom", &zoom, "latitude", &center_lat, "longitude", &center_lon, NULL);
+  g_object_get(G_OBJECT(map), "zoom", &zoom, "max-zoom", &max_zoom, "latitude", &center_lat, "longitude", &center_lon, NULL);
   dt_conf_set_float("plugins/map/longitude", center_lon);
   dt_conf_set_float("plugins/map/latitude", center_lat);
   dt_conf_set_int("plugins/map/zoom", zoom);
 
+  /* size of the cluster cells: about one thumbnail on screen */
+  GtkAllocation allocation;
+  gtk_widget_get_allocation(GTK_WIDGET(map), &allocation);
+  const double cell_lon = MAX(1e-9, fabs(bb_1_lon - bb_0_lon) * thumb_size / MAX(1, allocation.width));
+  const double cell_lat = MAX(1e-9, fabs(bb_0_lat - bb_1_lat) * thumb_size / MAX(1, allocation.height));
+
   /* let's reset and reuse the main_query statement */
   DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
   DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
@@ -261,8 +360,9 @@ static void _view_map_changed_callback(OsmGpsMap *map, dt_view_t *self)
   DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 2, bb_1_lon);
   DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 3, bb_0_lat);
   DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 4, bb_1_lat - south_border);
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 5, center_lat);
-  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 6, center_lon);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 5, cell_lon);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->statements.main_query, 6, cell_lat);
+  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 7, zoom >= max_zoom);
 
   /* remove the old images */
   osm_gps_map_image_remove_all(map);
@@ -279,6 +379,7 @@ static void _view_map_changed_callback(OsmGpsMap *map, dt_view_t *self)
   while(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
   {
     int imgid = sqlite3_column_int(lib->statements.main_query, 0);
+    const int count = sqlite3_column_int(lib->statements.main_query, 1);
     dt_mipmap_buffer_t buf;
     dt_mipmap_cache_read_get(darktable.mipmap_cache, &buf, imgid, mip, DT_MIPMAP_BEST_EFFORT);
 
@@ -313,23 +414,37 @@ static void _view_map_changed_callback(OsmGpsMap *map, dt_view_t *self)
       gdk_pixbuf_scale(source, thumb, thumb_border, thumb_border, w, h, thumb_border, thumb_border,
                        (1.0*w) / buf.width, (1.0*h) / buf.height, GDK_INTERP_HYPER);
 
+      if(count > 1)
+        _view_map_draw_count(thumb, w, count);
+
       // and finally add the pin
       gdk_pixbuf_copy_area(lib->pin, 0, 0, w+2*thumb_border, pin_size, thumb, 0, h+2*thumb_border);
 
-      const dt_image_t *cimg = dt_image_cache_read_get(darktable.image_cache, imgid);
-      if(!cimg) goto map_changed_failure;
       dt_map_image_t *entry = (dt_map_image_t*)malloc(sizeof(dt_map_image_t));
-      if(!entry)
+      if(!entry) goto map_changed_failure;
+      if(count > 1)
       {
+        // clusters sit at the mean position of their images
+        entry->image = osm_gps_map_image_add_with_alignment(map, sqlite3_column_double(lib->statements.main_query, 3),
+                       sqlite3_column_double(lib->statements.main_query, 2), thumb, 0, 1);
+      }
+      else
+      {
+        // the index only keeps single precision coordinates, take the exact ones for single images
+        const dt_image_t *cimg = dt_image_cache_read_get(darktable.image_cache, imgid);
+        if(!cimg)
+        {
+          free(entry);
+          goto map_changed_failure;
+        }
+        entry->image = osm_gps_map_image_add_with_alignment(map, cimg->latitude, cimg->longitude, thumb, 0, 1);
         dt_image_cache_read_release(darktable.image_cache, cimg);
-        goto map_changed_failure;
       }
       entry->imgid = imgid;
-      entry->image = osm_gps_map_image_add_with_alignment(map, cimg->latitude, cimg->longitude, thumb, 0, 1);
       entry->width = w;
       entry->height = h;
+      entry->count = count;
       lib->images = g_slist_prepend(lib->images, entry);
-      dt_image_cache_read_release(darktable.image_cache, cimg);
 
 map_changed_failure:
       if(source)
@@ -372,6 +487,9 @@ static int _view_map_get_img_at_pos(dt_view_t *self, double x, double y)
     gint img_x=0, img_y=0;
     osm_gps_map_convert_geographic_to_screen(lib->map, pt, &img_x, &img_y);
     img_y -= pin_size;
+    // clusters can't be dragged or opened, double clicking them zooms in instead.
+    // at the highest zoom level there are none left.
+    if(entry->count > 1) continue;
     if(x >= img_x && x <= img_x + entry->width && y <= img_y && y >= img_y - entry->height)
       return entry->imgid;
   }
@@ -499,6 +617,9 @@ void enter(dt_view_t *self)
   lib->selected_image = 0;
   lib->start_drag = FALSE;
 
+  if(!lib->statements.main_query)
+    _view_map_prepare_query(lib);
+
   /* replace center widget */
   GtkWidget *parent = gtk_widget_get_parent(dt_ui_center(darktable.gui->ui));
   gtk_widget_hide(dt_ui_center(darktable.gui->ui));